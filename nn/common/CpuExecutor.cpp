@@ -18,13 +18,19 @@
 
 #include "CpuExecutor.h"
 
+#include "MemoryPlanner.h"
 #include "NeuralNetworks.h"
 #include "Operations.h"
+#include "ScratchArena.h"
 #include "Tracing.h"
 
 #include "Eigen/Core"
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
 #include <omp.h>
 #include <sys/mman.h>
+#include <thread>
 
 namespace android {
 namespace nn {
@@ -175,16 +181,618 @@ static bool setInfoAndAllocateIfNeeded(RunTimeOperandInfo* info, const Shape& sh
     info->dimensions = shape.dimensions;
     info->scale = shape.scale;
     info->zeroPoint = shape.offset;
-    if (info->lifetime == OperandLifeTime::TEMPORARY_VARIABLE && info->buffer == nullptr) {
+    if (info->lifetime == OperandLifeTime::TEMPORARY_VARIABLE) {
         uint32_t length = sizeOfData(info->type, info->dimensions);
-        info->buffer = new uint8_t[length];
+        if (info->buffer != nullptr && length > info->length) {
+            // The memory planned for this temporary is too small for the
+            // dimensions computed at execution time.
+            info->buffer = nullptr;
+        }
         if (info->buffer == nullptr) {
+            info->buffer = new uint8_t[length];
+            if (info->buffer == nullptr) {
+                return false;
+            }
+            info->length = length;
+        }
+    }
+    return true;
+}
+
+void OperationDependencies::initialize(const Model& model) {
+    NNTRACE_CPU(NNTRACE_PHASE_PREPARATION, "OperationDependencies::initialize");
+    const uint32_t operationCount = model.operations.size();
+    const uint32_t kNoOperation = ~0u;
+    std::vector<uint32_t> producers(model.operands.size(), kNoOperation);
+    std::vector<uint32_t> depths(operationCount, 0);
+    mConsumers.assign(operationCount, {});
+    mProducerCounts.assign(operationCount, 0);
+    for (uint32_t operationIndex = 0; operationIndex < operationCount; operationIndex++) {
+        const Operation& operation = model.operations[operationIndex];
+        for (uint32_t operandIndex : operation.inputs) {
+            const uint32_t producerIndex = producers[operandIndex];
+            if (producerIndex == kNoOperation) {
+                continue;
+            }
+            // The operation may read several outputs of the same producer.
+            std::vector<uint32_t>& consumers = mConsumers[producerIndex];
+            if (!consumers.empty() && consumers.back() == operationIndex) {
+                continue;
+            }
+            consumers.push_back(operationIndex);
+            mProducerCounts[operationIndex]++;
+            depths[operationIndex] = std::max(depths[operationIndex], depths[producerIndex] + 1);
+        }
+        for (uint32_t operandIndex : operation.outputs) {
+            producers[operandIndex] = operationIndex;
+        }
+    }
+
+    // The operations are sorted in execution order, so all the successors
+    // of an operation come after it.
+    mSuccessors.assign(operationCount, std::vector<bool>(operationCount, false));
+    for (uint32_t operationIndex = operationCount; operationIndex-- > 0;) {
+        std::vector<bool>& successors = mSuccessors[operationIndex];
+        for (uint32_t consumer : mConsumers[operationIndex]) {
+            successors[consumer] = true;
+            const std::vector<bool>& indirectSuccessors = mSuccessors[consumer];
+            for (uint32_t i = consumer + 1; i < operationCount; i++) {
+                if (indirectSuccessors[i]) {
+                    successors[i] = true;
+                }
+            }
+        }
+    }
+
+    std::vector<uint32_t> widths(operationCount, 0);
+    mMaxWidth = 0;
+    for (uint32_t depth : depths) {
+        mMaxWidth = std::max(mMaxWidth, ++widths[depth]);
+    }
+    VLOG(CPUEXE) << "OperationDependencies: " << operationCount << " operations, up to "
+                 << mMaxWidth << " at the same depth";
+}
+
+void TemporaryMemoryPlan::initialize(const Model& model,
+                                     const OperationDependencies* dependencies) {
+    NNTRACE_CPU(NNTRACE_PHASE_PREPARATION, "TemporaryMemoryPlan::initialize");
+    const uint32_t operandCount = model.operands.size();
+    mOffsets.assign(operandCount, kNotPlanned);
+
+    // The lifetime of a temporary goes from the operation that writes it to
+    // the last operation that reads it, as indexes into model.operations.
+    // With dependencies, we also need all the operations using each
+    // temporary: the one writing it first, then the ones reading it.
+    const uint32_t kNoOperation = ~0u;
+    std::vector<uint32_t> firstUse(operandCount, kNoOperation);
+    std::vector<uint32_t> lastUse(operandCount, 0);
+    std::vector<std::vector<uint32_t>> users(dependencies != nullptr ? operandCount : 0);
+    for (uint32_t operationIndex = 0; operationIndex < model.operations.size();
+         operationIndex++) {
+        const Operation& operation = model.operations[operationIndex];
+        for (uint32_t operandIndex : operation.inputs) {
+            lastUse[operandIndex] = std::max(lastUse[operandIndex], operationIndex);
+            if (dependencies != nullptr) {
+                users[operandIndex].push_back(operationIndex);
+            }
+        }
+        for (uint32_t operandIndex : operation.outputs) {
+            firstUse[operandIndex] = operationIndex;
+            lastUse[operandIndex] = std::max(lastUse[operandIndex], operationIndex);
+            if (dependencies != nullptr) {
+                users[operandIndex].push_back(operationIndex);
+            }
+        }
+    }
+
+    auto isPlannable = [&](uint32_t operandIndex) {
+        const Operand& operand = model.operands[operandIndex];
+        return operand.lifetime == OperandLifeTime::TEMPORARY_VARIABLE &&
+               firstUse[operandIndex] != kNoOperation && operand.dimensions.size() > 0 &&
+               std::find(operand.dimensions.begin(), operand.dimensions.end(), 0) ==
+                       operand.dimensions.end();
+    };
+
+    // The output of a RESHAPE or a SQUEEZE holds the same bytes as its
+    // input.  When both are temporaries, the output is a view of the input,
+    // which is then alive until the output is no longer used.
+    std::vector<uint32_t> viewed(operandCount);
+    for (uint32_t operandIndex = 0; operandIndex < operandCount; operandIndex++) {
+        viewed[operandIndex] = operandIndex;
+    }
+    for (const Operation& operation : model.operations) {
+        if ((operation.type != OperationType::RESHAPE &&
+             operation.type != OperationType::SQUEEZE) ||
+            operation.inputs.empty() || operation.outputs.size() != 1) {
+            continue;
+        }
+        // The input may itself be a view.
+        const uint32_t input = viewed[operation.inputs[0]];
+        const uint32_t output = operation.outputs[0];
+        if (!isPlannable(input) || !isPlannable(output) ||
+            sizeOfData(model.operands[input]) != sizeOfData(model.operands[output])) {
+            continue;
+        }
+        viewed[output] = input;
+        lastUse[input] = std::max(lastUse[input], lastUse[output]);
+        if (dependencies != nullptr) {
+            users[input].insert(users[input].end(), users[output].begin(), users[output].end());
+        }
+    }
+
+    MemoryPlanner planner(kScratchArenaAlignment);
+    std::vector<std::pair<uint32_t, uint32_t>> planned;  // (operand, buffer) indexes
+    for (uint32_t operandIndex = 0; operandIndex < operandCount; operandIndex++) {
+        if (!isPlannable(operandIndex) || viewed[operandIndex] != operandIndex) {
+            continue;
+        }
+        planned.emplace_back(operandIndex,
+                             planner.addBuffer(sizeOfData(model.operands[operandIndex]),
+                                               firstUse[operandIndex], lastUse[operandIndex]));
+    }
+    if (dependencies == nullptr) {
+        planner.plan();
+    } else {
+        // Returns true if all the operations using the first buffer complete
+        // before the operation writing the second buffer starts.
+        auto isDoneBefore = [&](uint32_t bufferIndex1, uint32_t bufferIndex2) {
+            const std::vector<uint32_t>& users1 = users[planned[bufferIndex1].first];
+            const uint32_t writer2 = firstUse[planned[bufferIndex2].first];
+            return std::all_of(users1.begin(), users1.end(), [&](uint32_t operationIndex) {
+                return dependencies->precedes(operationIndex, writer2);
+            });
+        };
+        planner.plan([&isDoneBefore](uint32_t bufferIndex1, uint32_t bufferIndex2) {
+            return !isDoneBefore(bufferIndex1, bufferIndex2) &&
+                   !isDoneBefore(bufferIndex2, bufferIndex1);
+        });
+    }
+    for (const auto& p : planned) {
+        mOffsets[p.first] = planner.getOffset(p.second);
+    }
+    uint32_t viewCount = 0;
+    for (uint32_t operandIndex = 0; operandIndex < operandCount; operandIndex++) {
+        if (viewed[operandIndex] != operandIndex) {
+            mOffsets[operandIndex] = mOffsets[viewed[operandIndex]];
+            viewCount++;
+        }
+    }
+    mArenaSize = planner.getArenaSize();
+    mTotalSizeOfTemporaries = planner.getTotalSize();
+    VLOG(CPUEXE) << "TemporaryMemoryPlan: " << planned.size() << " temporaries and "
+                 << viewCount << " views, arena of " << mArenaSize << " bytes instead of "
+                 << mTotalSizeOfTemporaries << " bytes";
+}
+
+bool PreparedWeights::initialize(const Model& model,
+                                 const std::vector<RunTimePoolInfo>& poolInfos) {
+    NNTRACE_CPU(NNTRACE_PHASE_PREPARATION, "PreparedWeights::initialize");
+    mBuffers.assign(model.operands.size(), nullptr);
+    mOutputMultipliers.clear();
+    mCopiedSize = 0;
+    mLSTMSequences.clear();
+    mLSTMSequenceSteps.clear();
+    mHashtableLookupIndexes.clear();
+#if NN_HAS_FLOAT16
+    mFloat16Buffers.clear();
+#endif
+
+    auto getValue = [&model, &poolInfos](const Operand& operand) -> const uint8_t* {
+        if (operand.lifetime == OperandLifeTime::CONSTANT_COPY) {
+            return &model.operandValues[operand.location.offset];
+        }
+        nnAssert(operand.location.poolIndex < poolInfos.size());
+        return poolInfos[operand.location.poolIndex].getBuffer() + operand.location.offset;
+    };
+    auto getShape = [&model](uint32_t operandIndex) {
+        const Operand& operand = model.operands[operandIndex];
+        return Shape{.type = operand.type, .dimensions = operand.dimensions,
+                     .scale = operand.scale, .offset = operand.zeroPoint};
+    };
+
+    // The weights to copy, and where they go in mAllocation.
+    std::vector<std::pair<uint32_t, size_t>> copies;
+    size_t totalSize = 0;
+    auto addWeights = [&](const Operation& operation, uint32_t input) {
+        if (input >= operation.inputs.size()) {
+            return;
+        }
+        const uint32_t operandIndex = operation.inputs[input];
+        const Operand& operand = model.operands[operandIndex];
+        // A CONSTANT_REFERENCE value is left where it is mapped, as copying
+        // it would keep a second copy of the weights resident.
+        if (operand.lifetime != OperandLifeTime::CONSTANT_COPY ||
+            operand.location.length == 0 || mBuffers[operandIndex] != nullptr) {
+            return;
+        }
+        // The kernels read the weights as arrays of their element type.
+        const uint32_t alignment = sizeOfData(operand.type, {});
+        const uintptr_t address = reinterpret_cast<uintptr_t>(getValue(operand));
+        if (alignment <= 1 || address % alignment == 0) {
+            return;
+        }
+        // Marks the operand as copied, until the copy is made below.
+        mBuffers[operandIndex] = reinterpret_cast<const uint8_t*>(address);
+        copies.push_back({operandIndex, totalSize});
+        totalSize += (operand.location.length + kScratchArenaAlignment - 1) &
+                     ~size_t(kScratchArenaAlignment - 1);
+    };
+
+#if NN_HAS_FLOAT16
+    // Returns false if the input is not a constant float32 tensor, or if
+    // some of its values are out of the range of Float16.
+    auto addFloat16Weights = [&](const Operation& operation, uint32_t input) {
+        if (input >= operation.inputs.size()) {
             return false;
         }
+        const uint32_t operandIndex = operation.inputs[input];
+        const Operand& operand = model.operands[operandIndex];
+        if ((operand.lifetime != OperandLifeTime::CONSTANT_COPY &&
+             operand.lifetime != OperandLifeTime::CONSTANT_REFERENCE) ||
+            operand.type != OperandType::TENSOR_FLOAT32 || operand.location.length == 0) {
+            return false;
+        }
+        if (mFloat16Buffers.count(operandIndex) != 0) {
+            return true;
+        }
+        const uint8_t* value = getValue(operand);
+        const uint32_t count = operand.location.length / sizeof(float);
+        std::vector<Float16> converted(count);
+        for (uint32_t i = 0; i < count; i++) {
+            // The value may not be aligned for a float.
+            float weight;
+            memcpy(&weight, value + i * sizeof(float), sizeof(float));
+            if (!(std::abs(weight) <= kFloat16Max)) {
+                return false;
+            }
+            converted[i] = static_cast<Float16>(weight);
+        }
+        mFloat16Buffers[operandIndex] = std::move(converted);
+        return true;
+    };
+#endif
+
+    for (const Operation& operation : model.operations) {
+        switch (operation.type) {
+            case OperationType::CONV_2D:
+            case OperationType::DEPTHWISE_CONV_2D:
+            case OperationType::FULLY_CONNECTED: {
+#if NN_HAS_FLOAT16
+                if (operation.type == OperationType::FULLY_CONNECTED &&
+                    model.relaxComputationFloat32toFloat16 && addFloat16Weights(operation, 1)) {
+                    break;
+                }
+#endif
+                addWeights(operation, 1);
+                if (operation.inputs.size() < 3 || operation.outputs.empty() ||
+                    model.operands[operation.inputs[0]].type !=
+                            OperandType::TENSOR_QUANT8_ASYMM) {
+                    break;
+                }
+                QuantizedMultiplier multiplier;
+                if (GetQuantizedConvolutionOutputMultiplier(
+                            getShape(operation.inputs[0]), getShape(operation.inputs[1]),
+                            getShape(operation.inputs[2]), getShape(operation.outputs[0]),
+                            &multiplier)) {
+                    mOutputMultipliers[operation.outputs[0]] = multiplier;
+                }
+                // Otherwise the execution fails the same check.
+            } break;
+            case OperationType::RNN:
+                addWeights(operation, RNN::kWeightsTensor);
+                addWeights(operation, RNN::kRecurrentWeightsTensor);
+                break;
+            case OperationType::SVDF:
+                addWeights(operation, SVDF::kWeightsFeatureTensor);
+                addWeights(operation, SVDF::kWeightsTimeTensor);
+                break;
+            case OperationType::LSTM:
+                for (uint32_t input = LSTMCell::kInputToInputWeightsTensor;
+                     input <= LSTMCell::kRecurrentToOutputWeightsTensor; input++) {
+                    addWeights(operation, input);
+                }
+                addWeights(operation, LSTMCell::kProjectionWeightsTensor);
+                break;
+            case OperationType::HASHTABLE_LOOKUP: {
+                if (operation.inputs.size() <= HashtableLookup::kKeyTensor) {
+                    break;
+                }
+                const uint32_t operandIndex = operation.inputs[HashtableLookup::kKeyTensor];
+                const Operand& operand = model.operands[operandIndex];
+                if ((operand.lifetime != OperandLifeTime::CONSTANT_COPY &&
+                     operand.lifetime != OperandLifeTime::CONSTANT_REFERENCE) ||
+                    operand.type != OperandType::TENSOR_INT32 || operand.dimensions.size() != 1 ||
+                    operand.location.length != operand.dimensions[0] * sizeof(int32_t) ||
+                    mHashtableLookupIndexes.count(operandIndex) != 0) {
+                    break;
+                }
+                // The value may not be aligned for an int32_t.
+                std::vector<int32_t> keys(operand.dimensions[0]);
+                memcpy(keys.data(), getValue(operand), operand.location.length);
+                HashtableLookup::BuildIndex(keys.data(), keys.size(),
+                                            &mHashtableLookupIndexes[operandIndex]);
+            } break;
+            default:
+                break;
+        }
     }
+
+    mAllocation.reset();
+    if (totalSize > 0) {
+        mAllocation.reset(new (std::nothrow) uint8_t[totalSize + kScratchArenaAlignment - 1]);
+        if (mAllocation == nullptr) {
+            LOG(ERROR) << "PreparedWeights: could not allocate " << totalSize << " bytes";
+            return false;
+        }
+        const uintptr_t address = reinterpret_cast<uintptr_t>(mAllocation.get());
+        uint8_t* buffer = mAllocation.get() + (-address & (kScratchArenaAlignment - 1));
+        for (const auto& copy : copies) {
+            const uint32_t operandIndex = copy.first;
+            uint8_t* to = buffer + copy.second;
+            memcpy(to, mBuffers[operandIndex], model.operands[operandIndex].location.length);
+            mBuffers[operandIndex] = to;
+            mCopiedSize += model.operands[operandIndex].location.length;
+        }
+    }
+    findLSTMSequences(model, getValue);
+    VLOG(CPUEXE) << "PreparedWeights: copied " << copies.size() << " weights, " << mCopiedSize
+                 << " bytes, computed " << mOutputMultipliers.size()
+                 << " output multipliers, found " << mLSTMSequences.size()
+                 << " LSTM sequences, indexed " << mHashtableLookupIndexes.size()
+                 << " hashtable keys";
+#if NN_HAS_FLOAT16
+    VLOG(CPUEXE) << "PreparedWeights: converted " << mFloat16Buffers.size()
+                 << " weights to float16";
+#endif
     return true;
 }
 
+void PreparedWeights::findLSTMSequences(
+        const Model& model, const std::function<const uint8_t*(const Operand&)>& getValue) {
+    auto isConstant = [&model](uint32_t operandIndex) {
+        const OperandLifeTime lifetime = model.operands[operandIndex].lifetime;
+        return lifetime == OperandLifeTime::CONSTANT_COPY ||
+               lifetime == OperandLifeTime::CONSTANT_REFERENCE;
+    };
+    auto hasNoValue = [&model](uint32_t operandIndex) {
+        return model.operands[operandIndex].lifetime == OperandLifeTime::NO_VALUE;
+    };
+    // Whether the LSTM can be a timestep of a sequence: its input is known
+    // before the sequence starts, and its gate weights and biases can be
+    // concatenated.
+    auto canBeTimestep = [&](const Operation& operation) {
+        if (operation.type != OperationType::LSTM || operation.inputs.size() != 23 ||
+            operation.outputs.size() != 4) {
+            return false;
+        }
+        const uint32_t input = operation.inputs[LSTMCell::kInputTensor];
+        if (model.operands[input].type != OperandType::TENSOR_FLOAT32 ||
+            (model.operands[input].lifetime != OperandLifeTime::MODEL_INPUT &&
+             !isConstant(input))) {
+            return false;
+        }
+        const bool useCifg = hasNoValue(operation.inputs[LSTMCell::kInputToInputWeightsTensor]);
+        for (uint32_t i : {LSTMCell::kInputToInputWeightsTensor,
+                           LSTMCell::kInputGateBiasTensor}) {
+            if (!isConstant(operation.inputs[i]) &&
+                !(useCifg && hasNoValue(operation.inputs[i]))) {
+                return false;
+            }
+        }
+        for (uint32_t i : {LSTMCell::kInputToForgetWeightsTensor,
+                           LSTMCell::kInputToCellWeightsTensor,
+                           LSTMCell::kInputToOutputWeightsTensor,
+                           LSTMCell::kForgetGateBiasTensor, LSTMCell::kCellGateBiasTensor,
+                           LSTMCell::kOutputGateBiasTensor}) {
+            if (!isConstant(operation.inputs[i])) {
+                return false;
+            }
+        }
+        const Operand& weights =
+                model.operands[operation.inputs[LSTMCell::kInputToOutputWeightsTensor]];
+        return weights.dimensions.size() == 2 && weights.dimensions[0] > 0 &&
+               weights.dimensions[1] > 0;
+    };
+    // Whether the second LSTM is the timestep after the first one.
+    auto isNextTimestep = [](const Operation& first, const Operation& second) {
+        for (uint32_t i = 0; i < first.inputs.size(); i++) {
+            if (i == LSTMCell::kInputTensor) {
+                continue;
+            }
+            const uint32_t expected =
+                    i == LSTMCell::kOutputStateInTensor
+                            ? first.outputs[LSTMCell::kOutputStateOutTensor]
+                            : i == LSTMCell::kCellStateInTensor
+                                      ? first.outputs[LSTMCell::kCellStateOutTensor]
+                                      : first.inputs[i];
+            if (second.inputs[i] != expected) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    const uint32_t operationCount = model.operations.size();
+    // The timestep after each LSTM, and whether each one has a timestep
+    // before it.
+    std::vector<int32_t> next(operationCount, -1);
+    std::vector<bool> hasPrevious(operationCount, false);
+    // The LSTM reading each operand as its output state.  A state read by
+    // several of them does not make a sequence.
+    std::unordered_map<uint32_t, int32_t> readers;
+    for (uint32_t i = 0; i < operationCount; i++) {
+        const Operation& operation = model.operations[i];
+        if (canBeTimestep(operation)) {
+            const uint32_t state = operation.inputs[LSTMCell::kOutputStateInTensor];
+            auto inserted = readers.insert({state, int32_t(i)});
+            if (!inserted.second) {
+                inserted.first->second = -1;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < operationCount; i++) {
+        const Operation& operation = model.operations[i];
+        if (!canBeTimestep(operation)) {
+            continue;
+        }
+        auto it = readers.find(operation.outputs[LSTMCell::kOutputStateOutTensor]);
+        if (it != readers.end() && it->second >= 0 &&
+            isNextTimestep(operation, model.operations[it->second])) {
+            next[i] = it->second;
+            hasPrevious[it->second] = true;
+        }
+    }
+
+    auto appendValue = [&model, &getValue](uint32_t operandIndex, std::vector<float>* values) {
+        const Operand& operand = model.operands[operandIndex];
+        // The value may not be aligned for floats where the model keeps it.
+        const size_t size = values->size();
+        values->resize(size + operand.location.length / sizeof(float));
+        memcpy(values->data() + size, getValue(operand), operand.location.length);
+    };
+    for (uint32_t first = 0; first < operationCount; first++) {
+        if (next[first] < 0 || hasPrevious[first]) {
+            continue;
+        }
+        const Operation& operation = model.operations[first];
+        const Operand& weights =
+                model.operands[operation.inputs[LSTMCell::kInputToOutputWeightsTensor]];
+        LSTMSequence sequence;
+        sequence.cellCount = weights.dimensions[0];
+        sequence.inputSize = weights.dimensions[1];
+        const bool useCifg = hasNoValue(operation.inputs[LSTMCell::kInputToInputWeightsTensor]);
+        sequence.gateCount = useCifg ? 3 : 4;
+        // The order of the scratch buffer: input, cell, forget and output
+        // gates.
+        std::vector<std::pair<uint32_t, uint32_t>> gates = {
+                {LSTMCell::kInputToCellWeightsTensor, LSTMCell::kCellGateBiasTensor},
+                {LSTMCell::kInputToForgetWeightsTensor, LSTMCell::kForgetGateBiasTensor},
+                {LSTMCell::kInputToOutputWeightsTensor, LSTMCell::kOutputGateBiasTensor}};
+        if (!useCifg) {
+            gates.insert(gates.begin(), {LSTMCell::kInputToInputWeightsTensor,
+                                         LSTMCell::kInputGateBiasTensor});
+        }
+        bool validSizes = true;
+        for (const auto& gate : gates) {
+            const uint32_t weightsIndex = operation.inputs[gate.first];
+            const uint32_t biasIndex = operation.inputs[gate.second];
+            validSizes = validSizes &&
+                         model.operands[weightsIndex].location.length ==
+                                 sequence.cellCount * sequence.inputSize * sizeof(float) &&
+                         model.operands[biasIndex].location.length ==
+                                 sequence.cellCount * sizeof(float);
+            if (validSizes) {
+                appendValue(weightsIndex, &sequence.inputWeights);
+                appendValue(biasIndex, &sequence.biases);
+            }
+        }
+        if (!validSizes) {
+            // The operations fail at execution time.
+            continue;
+        }
+        const uint32_t sequenceIndex = mLSTMSequences.size();
+        for (int32_t i = first; i >= 0; i = next[i]) {
+            const Operation& timestep = model.operations[i];
+            mLSTMSequenceSteps[timestep.outputs[LSTMCell::kScratchBufferTensor]] = {
+                    .sequence = sequenceIndex,
+                    .timestep = static_cast<uint32_t>(sequence.inputs.size())};
+            sequence.inputs.push_back(timestep.inputs[LSTMCell::kInputTensor]);
+        }
+        mLSTMSequences.push_back(std::move(sequence));
+    }
+}
+
+size_t CpuExecutor::getScratchSizeRequirement(const Model& model) {
+    size_t size = 0;
+    auto getShape = [&model](uint32_t operandIndex) {
+        const Operand& operand = model.operands[operandIndex];
+        return Shape{.type = operand.type, .dimensions = operand.dimensions};
+    };
+    auto isFullySpecified = [](const Shape& shape) {
+        return shape.dimensions.size() == 4 &&
+               std::find(shape.dimensions.begin(), shape.dimensions.end(), 0) ==
+                       shape.dimensions.end();
+    };
+    for (const Operation& operation : model.operations) {
+        uint64_t byteSize = 0;
+        if (operation.type == OperationType::CONV_2D) {
+            const Shape input = getShape(operation.inputs[0]);
+            const Shape filter = getShape(operation.inputs[1]);
+            const Shape output = getShape(operation.outputs[0]);
+            if (!isFullySpecified(input) || !isFullySpecified(filter) ||
+                !isFullySpecified(output)) {
+                // The arena will grow at execution time if needed.
+                continue;
+            }
+            byteSize = getConvIm2colByteSize(input, filter, output);
+        } else if (operation.type == OperationType::MEAN) {
+            const Shape input = getShape(operation.inputs[0]);
+            const Shape axis = getShape(operation.inputs[1]);
+            const Shape output = getShape(operation.outputs[0]);
+            if (input.dimensions.empty() || axis.dimensions.size() != 1 ||
+                std::find(output.dimensions.begin(), output.dimensions.end(), 0) !=
+                        output.dimensions.end()) {
+                continue;
+            }
+            byteSize = getMeanScratchByteSize(input, axis, output);
+        } else {
+            continue;
+        }
+        // Such an operation is rejected at execution time, see convFloat32.
+        if (byteSize >= 0x7fffffff) {
+            continue;
+        }
+        size = std::max(size, static_cast<size_t>(byteSize));
+    }
+    VLOG(CPUEXE) << "CpuExecutor::getScratchSizeRequirement: " << size << " bytes";
+    return size;
+}
+
+ThreadPool* CpuExecutor::getOperationThreadPool() {
+    // Never destroyed, like ThreadPool::get().  This is a separate pool, as
+    // CpuExecutor::run() itself often runs on a worker of ThreadPool::get(),
+    // which would run any task it schedules on the calling thread.
+    static ThreadPool* pool = new ThreadPool(0 /* one thread per core */, 64);
+    return pool;
+}
+
+CpuPreparedModel::CpuPreparedModel(Model model) : mModel(std::move(model)) {
+#ifdef NN_DEBUGGABLE
+    mParallelOperations = (getProp("debug.nn.cpuexe.parallel") != 0);
+    mFuseOperations = (getProp("debug.nn.cpuexe.fusion", 1) != 0);
+#endif  // NN_DEBUGGABLE
+}
+
+bool CpuPreparedModel::initialize() {
+    NNTRACE_CPU(NNTRACE_PHASE_PREPARATION, "CpuPreparedModel::initialize");
+    if (!setRunTimePoolInfosFromHidlMemories(&mModelPoolInfos, mModel.pools)) {
+        return false;
+    }
+    if (mFuseOperations) {
+        fuseOperations(&mModel, mModelPoolInfos, &mFusionReport);
+    }
+    if (mParallelOperations) {
+        mDependencies.initialize(mModel);
+    }
+    if (!mWeights.initialize(mModel, mModelPoolInfos)) {
+        return false;
+    }
+    mTemporaryPlan.initialize(mModel, mParallelOperations ? &mDependencies : nullptr);
+    return mScratchArenas.initialize(CpuExecutor::getScratchSizeRequirement(mModel),
+                                     mTemporaryPlan.getArenaSize());
+}
+
+int CpuPreparedModel::run(const Request& request,
+                          const std::vector<RunTimePoolInfo>& requestPoolInfos) {
+    std::unique_ptr<ScratchArena> scratch = mScratchArenas.acquire();
+    CpuExecutor executor(scratch.get(), &mTemporaryPlan,
+                         mParallelOperations ? &mDependencies : nullptr, &mScratchArenas,
+                         &mWeights);
+    int n = executor.run(mModel, request, mModelPoolInfos, requestPoolInfos);
+    mScratchArenas.release(std::move(scratch));
+    return n;
+}
+
 // Ignore the .pools entry in model and request.  This will have been taken care of
 // by the caller.
 int CpuExecutor::run(const V1_0::Model& model, const Request& request,
@@ -203,15 +811,40 @@ int CpuExecutor::run(const V1_1::Model& model, const Request& request,
 
     ScopedOpenmpSettings openMpSettings;
 
+    // Without an arena from the caller, use one that lives as long as the
+    // thread: it is reused by all the executions run on this thread.
+    static thread_local ScratchArena threadScratch;
+    mScratch = mArena != nullptr ? mArena : &threadScratch;
+    if (mPlan != nullptr && mPlan->getArenaSize() > 0) {
+        mTemporariesSize = mPlan->getArenaSize();
+        mTemporaries = mScratch->getTemporariesBuffer(mTemporariesSize);
+        if (mTemporaries == nullptr) {
+            mScratch = nullptr;
+            mTemporariesSize = 0;
+            return ANEURALNETWORKS_OUT_OF_MEMORY;
+        }
+    }
+
     mModel = &model;
     mRequest = &request; // TODO check if mRequest is needed
     initializeRunTimeInfo(modelPoolInfos, requestPoolInfos);
-    // The model has serialized the operation in execution order.
-    for (const auto& operation : model.operations) {
-        int n = executeOperation(operation);
+    mBufferOwners.clear();
+    if (mWeights != nullptr) {
+        mLSTMProjections.resize(mWeights->getLSTMSequenceCount());
+    }
+    if (mDependencies != nullptr) {
+        int n = executeOperationsConcurrently();
         if (n != ANEURALNETWORKS_NO_ERROR) {
             return n;
         }
+    } else {
+        // The model has serialized the operation in execution order.
+        for (const auto& operation : model.operations) {
+            int n = executeOperation(operation, mScratch);
+            if (n != ANEURALNETWORKS_NO_ERROR) {
+                return n;
+            }
+        }
     }
     for (auto& runtimeInfo : modelPoolInfos) {
         runtimeInfo.update();
@@ -221,6 +854,9 @@ int CpuExecutor::run(const V1_1::Model& model, const Request& request,
     }
     mModel = nullptr;
     mRequest = nullptr;
+    mScratch = nullptr;
+    mTemporaries = nullptr;
+    mTemporariesSize = 0;
     VLOG(CPUEXE) << "Completed run normally";
     return ANEURALNETWORKS_NO_ERROR;
 }
@@ -244,6 +880,11 @@ bool CpuExecutor::initializeRunTimeInfo(const std::vector<RunTimePoolInfo>& mode
         switch (from.lifetime) {
             case OperandLifeTime::TEMPORARY_VARIABLE:
                 to.buffer = nullptr;
+                if (mTemporaries != nullptr &&
+                    mPlan->getOffset(i) != TemporaryMemoryPlan::kNotPlanned) {
+                    to.buffer = mTemporaries + mPlan->getOffset(i);
+                    to.length = sizeOfData(from);
+                }
                 to.numberOfUsesLeft = from.numberOfConsumers;
                 break;
             case OperandLifeTime::CONSTANT_COPY:
@@ -268,6 +909,10 @@ bool CpuExecutor::initializeRunTimeInfo(const std::vector<RunTimePoolInfo>& mode
                 nnAssert(false);
                 break;
         }
+        if (mWeights != nullptr && mWeights->getBuffer(i) != nullptr) {
+            // The kernels only read the weights.
+            to.buffer = const_cast<uint8_t*>(mWeights->getBuffer(i));
+        }
     }
 
     // Adjust the runtime info for the arguments passed to the model,
@@ -304,9 +949,190 @@ bool CpuExecutor::initializeRunTimeInfo(const std::vector<RunTimePoolInfo>& mode
     return true;
 }
 
+// The state shared by the threads running the operations of one execution
+// in executeOperationsConcurrently().  Threads of the pool that only start
+// once the execution is over still see it, hence the shared ownership.
+struct CpuExecutor::DataflowState {
+    std::mutex mutex;
+    std::condition_variable condition;
+    // The operations whose inputs are all ready, that no thread runs yet.
+    std::vector<uint32_t> readyOperations;
+    // For each operation, the number of operations it depends on that have
+    // not completed yet.
+    std::vector<uint32_t> pendingProducerCounts;
+    uint32_t remainingOperationCount = 0;
+    uint32_t runningOperationCount = 0;
+    // The number of pool threads taking part in the execution.
+    uint32_t activeHelperCount = 0;
+    // The number of threads each operation may use for itself.
+    int intraOperationThreadCount = 0;
+    int result = ANEURALNETWORKS_NO_ERROR;
+    // Once set, the pool threads that start must not touch the executor.
+    bool finished = false;
+};
+
+int CpuExecutor::executeOperationsConcurrently() {
+    const uint32_t operationCount = mDependencies->getOperationCount();
+    nnAssert(operationCount == mModel->operations.size());
+    nnAssert(mArenaPool != nullptr);
+    if (operationCount == 0) {
+        return ANEURALNETWORKS_NO_ERROR;
+    }
+    auto state = std::make_shared<DataflowState>();
+    state->pendingProducerCounts.resize(operationCount);
+    // The ready operations are taken from the back: push them in reverse
+    // order so that they start in the order of model.operations.
+    for (uint32_t operationIndex = operationCount; operationIndex-- > 0;) {
+        state->pendingProducerCounts[operationIndex] =
+                mDependencies->getProducerCount(operationIndex);
+        if (state->pendingProducerCounts[operationIndex] == 0) {
+            state->readyOperations.push_back(operationIndex);
+        }
+    }
+    state->remainingOperationCount = operationCount;
+
+    // The calling thread runs operations too.  Share the cores between the
+    // threads, rather than letting each operation use all of them through
+    // Eigen or gemmlowp.
+    ThreadPool* pool = getOperationThreadPool();
+    const uint32_t helperCount = std::min(mDependencies->getMaxWidth() - 1,
+                                          pool->getNumThreads());
+    const uint32_t coreCount = std::max(std::thread::hardware_concurrency(), 1u);
+    state->intraOperationThreadCount = std::max(coreCount / (helperCount + 1), 1u);
+    VLOG(CPUEXE) << "CpuExecutor::executeOperationsConcurrently: " << helperCount
+                 << " helper threads, " << state->intraOperationThreadCount
+                 << " threads per operation";
+
+    for (uint32_t i = 0; i < helperCount; i++) {
+        pool->schedule([this, state] {
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->finished) {
+                    return;
+                }
+                state->activeHelperCount++;
+            }
+            ScopedOpenmpSettings openMpSettings;
+            std::unique_ptr<ScratchArena> scratch = mArenaPool->acquire();
+            executeReadyOperations(state, scratch.get());
+            mArenaPool->release(std::move(scratch));
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->activeHelperCount--;
+            }
+            state->condition.notify_all();
+        });
+    }
+    executeReadyOperations(state, mScratch);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->condition.wait(lock, [&state] {
+        return state->runningOperationCount == 0 && state->activeHelperCount == 0;
+    });
+    state->finished = true;
+    return state->result;
+}
+
+void CpuExecutor::executeReadyOperations(const std::shared_ptr<DataflowState>& state,
+                                         ScratchArena* scratch) {
+    const int ompThreadCountInitial = omp_get_max_threads();
+    omp_set_num_threads(state->intraOperationThreadCount);
+    scratch->setMaxNumThreads(state->intraOperationThreadCount);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while (true) {
+        state->condition.wait(lock, [&state] {
+            return !state->readyOperations.empty() || state->remainingOperationCount == 0 ||
+                   state->result != ANEURALNETWORKS_NO_ERROR;
+        });
+        if (state->remainingOperationCount == 0 || state->result != ANEURALNETWORKS_NO_ERROR) {
+            break;
+        }
+        const uint32_t operationIndex = state->readyOperations.back();
+        state->readyOperations.pop_back();
+        state->runningOperationCount++;
+        lock.unlock();
+        int n = executeOperation(mModel->operations[operationIndex], scratch);
+        lock.lock();
+        state->runningOperationCount--;
+        if (n != ANEURALNETWORKS_NO_ERROR) {
+            if (state->result == ANEURALNETWORKS_NO_ERROR) {
+                state->result = n;
+            }
+            state->condition.notify_all();
+            continue;
+        }
+        state->remainingOperationCount--;
+        uint32_t newlyReadyCount = 0;
+        for (uint32_t consumer : mDependencies->getConsumers(operationIndex)) {
+            if (--state->pendingProducerCounts[consumer] == 0) {
+                state->readyOperations.push_back(consumer);
+                newlyReadyCount++;
+            }
+        }
+        // This thread takes one of the newly ready operations itself.
+        if (newlyReadyCount > 1 || state->remainingOperationCount == 0 ||
+            state->result != ANEURALNETWORKS_NO_ERROR) {
+            state->condition.notify_all();
+        }
+    }
+    lock.unlock();
+
+    scratch->setMaxNumThreads(0);
+    omp_set_num_threads(ompThreadCountInitial);
+}
+
+bool CpuExecutor::setInfoAndViewIfPossible(uint32_t inputIndex, uint32_t outputIndex,
+                                           const Shape& shape) {
+    // Operations running concurrently may free the input, or make views of
+    // it, while this reads its buffer and uses.
+    std::unique_lock<std::mutex> lock(mFreeMutex, std::defer_lock);
+    if (mDependencies != nullptr) {
+        lock.lock();
+    }
+    RunTimeOperandInfo& input = mOperands[inputIndex];
+    RunTimeOperandInfo* output = &mOperands[outputIndex];
+    // Already a view if the plan made it one.
+    if (output->lifetime != OperandLifeTime::TEMPORARY_VARIABLE || input.buffer == nullptr ||
+        output->buffer == input.buffer) {
+        return setInfoAndAllocateIfNeeded(output, shape);
+    }
+    // Model arguments, constants, and temporaries whose buffer is not owned
+    // by the operand, i.e. views of those, are never freed nor written again.
+    const bool readOnly = input.lifetime != OperandLifeTime::TEMPORARY_VARIABLE ||
+                          input.numberOfUsesLeft == 0;
+    // Otherwise the memory of a planned temporary may be reused once its last
+    // reader is done, which the view would outlive.
+    if (!readOnly && isInTemporaries(input.buffer)) {
+        return setInfoAndAllocateIfNeeded(output, shape);
+    }
+    output->buffer = input.buffer;
+    output->length = input.length;
+    if (!setInfoAndAllocateIfNeeded(output, shape)) {
+        return false;
+    }
+    if (readOnly) {
+        output->numberOfUsesLeft = 0;
+        return true;
+    }
+    // The buffer is freed once the readers of the view are done too.
+    auto owner = mBufferOwners.find(inputIndex);
+    const uint32_t ownerIndex = owner != mBufferOwners.end() ? owner->second : inputIndex;
+    mOperands[ownerIndex].numberOfUsesLeft += output->numberOfUsesLeft;
+    mBufferOwners[outputIndex] = ownerIndex;
+    return true;
+}
+
 void CpuExecutor::freeNoLongerUsedOperands(const std::vector<uint32_t>& inputs) {
+    // Operations running concurrently may read the same operands.
+    std::unique_lock<std::mutex> lock(mFreeMutex, std::defer_lock);
+    if (mDependencies != nullptr) {
+        lock.lock();
+    }
     for (uint32_t i : inputs) {
-        auto& info = mOperands[i];
+        // The uses of a view count against the operand owning the buffer.
+        auto owner = mBufferOwners.find(i);
+        auto& info = mOperands[owner != mBufferOwners.end() ? owner->second : i];
         // Check if it's a static or model input/output.
         if (info.numberOfUsesLeft == 0) {
             continue;
@@ -314,13 +1140,66 @@ void CpuExecutor::freeNoLongerUsedOperands(const std::vector<uint32_t>& inputs)
         info.numberOfUsesLeft--;
         if (info.numberOfUsesLeft == 0) {
             nnAssert(info.buffer != nullptr);
-            delete[] info.buffer;
+            if (!isInTemporaries(info.buffer)) {
+                delete[] info.buffer;
+            }
             info.buffer = nullptr;
         }
     }
 }
 
-int CpuExecutor::executeOperation(const Operation& operation) {
+const float* CpuExecutor::getLSTMProjectedInput(const Operation& operation,
+                                                ScratchArena* scratch) {
+    if (mWeights == nullptr) {
+        return nullptr;
+    }
+    const PreparedWeights::LSTMSequenceStep* step =
+            mWeights->getLSTMSequenceStep(operation.outputs[LSTMCell::kScratchBufferTensor]);
+    if (step == nullptr) {
+        return nullptr;
+    }
+    const PreparedWeights::LSTMSequence& sequence = mWeights->getLSTMSequence(step->sequence);
+    std::vector<float>& projections = mLSTMProjections[step->sequence];
+    const RunTimeOperandInfo& input = mOperands[operation.inputs[LSTMCell::kInputTensor]];
+    const uint32_t batchCount = input.dimensions.size() == 2 ? input.dimensions[0] : 0;
+    if (batchCount == 0) {
+        return nullptr;
+    }
+    const size_t timestepSize = size_t(batchCount) * sequence.gateCount * sequence.cellCount;
+    if (step->timestep == 0) {
+        projections.clear();
+        // All the timesteps must have inputs of the same size, otherwise
+        // each of them is computed on its own.
+        const size_t inputSize = size_t(batchCount) * sequence.inputSize;
+        for (uint32_t operandIndex : sequence.inputs) {
+            const RunTimeOperandInfo& timestepInput = mOperands[operandIndex];
+            if (timestepInput.buffer == nullptr || timestepInput.dimensions.size() != 2 ||
+                timestepInput.dimensions[0] != batchCount ||
+                timestepInput.dimensions[1] != sequence.inputSize) {
+                return nullptr;
+            }
+        }
+        const size_t timestepCount = sequence.inputs.size();
+        float* inputs = reinterpret_cast<float*>(
+                scratch->getBuffer(timestepCount * inputSize * sizeof(float)));
+        if (inputs == nullptr) {
+            return nullptr;
+        }
+        for (size_t t = 0; t < timestepCount; t++) {
+            memcpy(inputs + t * inputSize, mOperands[sequence.inputs[t]].buffer,
+                   inputSize * sizeof(float));
+        }
+        projections.resize(timestepCount * timestepSize);
+        LSTMCell::ProjectInputs(sequence.inputWeights.data(), sequence.biases.data(),
+                                sequence.gateCount, sequence.cellCount, sequence.inputSize,
+                                inputs, timestepCount, batchCount, projections.data());
+    } else if (projections.size() != sequence.inputs.size() * timestepSize) {
+        return nullptr;
+    }
+    return projections.data() + step->timestep * timestepSize;
+}
+
+int CpuExecutor::executeOperation(const Operation& operation, ScratchArena* scratch) {
     // VLOG(CPUEXE) << "CpuExecutor::executeOperation(" << toString(operation) << ")";
     const hidl_vec<uint32_t>& ins = operation.inputs;
     const hidl_vec<uint32_t>& outs = operation.outputs;
@@ -544,7 +1423,7 @@ int CpuExecutor::executeOperation(const Operation& operation) {
                                               stride_width, stride_height,
                                               depth_multiplier, activation,
                                               reinterpret_cast<uint8_t*>(output.buffer),
-                                              outShape);
+                                              outShape, getOutputMultiplier(operation));
             }
 
         } break;
@@ -607,7 +1486,8 @@ int CpuExecutor::executeOperation(const Operation& operation) {
                                       padding_left, padding_right,
                                       padding_top, padding_bottom,
                                       stride_width, stride_height, activation,
-                                      reinterpret_cast<float*>(output.buffer), outShape);
+                                      reinterpret_cast<float*>(output.buffer), outShape,
+                                      scratch);
             } else if (input.type == OperandType::TENSOR_QUANT8_ASYMM) {
                 success = convPrepare(input.shape(), filter.shape(), bias.shape(),
                                       padding_left, padding_right,
@@ -625,7 +1505,7 @@ int CpuExecutor::executeOperation(const Operation& operation) {
                                      padding_top, padding_bottom,
                                      stride_width, stride_height, activation,
                                      reinterpret_cast<uint8_t*>(output.buffer),
-                                     outShape);
+                                     outShape, getOutputMultiplier(operation), scratch);
             }
         } break;
         case OperationType::AVERAGE_POOL_2D: {
@@ -1011,6 +1891,26 @@ int CpuExecutor::executeOperation(const Operation& operation) {
             RunTimeOperandInfo& output = mOperands[outs[0]];
             Shape outShape = output.shape();
 
+#if NN_HAS_FLOAT16
+            const Float16* float16Weights =
+                    mWeights != nullptr ? mWeights->getFloat16Buffer(ins[1]) : nullptr;
+            if (input.type == OperandType::TENSOR_FLOAT32 && float16Weights != nullptr) {
+                success = fullyConnectedPrepare(input.shape(), weights.shape(), bias.shape(),
+                                                &outShape) &&
+                          setInfoAndAllocateIfNeeded(&output, outShape) &&
+                          fullyConnectedFloat32WithFloat16Weights(
+                                  reinterpret_cast<const float*>(input.buffer),
+                                  input.shape(),
+                                  float16Weights,
+                                  weights.shape(),
+                                  reinterpret_cast<const float*>(bias.buffer),
+                                  bias.shape(),
+                                  activation,
+                                  reinterpret_cast<float*>(output.buffer),
+                                  outShape);
+                break;
+            }
+#endif
             if (input.type == OperandType::TENSOR_FLOAT32) {
                 success = fullyConnectedPrepare(input.shape(), weights.shape(), bias.shape(),
                                                 &outShape) &&
@@ -1036,7 +1936,8 @@ int CpuExecutor::executeOperation(const Operation& operation) {
                                                bias.shape(),
                                                activation,
                                                reinterpret_cast<uint8_t*>(output.buffer),
-                                               outShape);
+                                               outShape, getOutputMultiplier(operation),
+                                               scratch);
             }
         } break;
         case OperationType::CONCATENATION: {
@@ -1140,11 +2041,12 @@ int CpuExecutor::executeOperation(const Operation& operation) {
                                      reinterpret_cast<const int32_t*>(targetShape.buffer),
                                      getNumberOfElements(targetShape.shape()),
                                      &outShape) &&
-                      setInfoAndAllocateIfNeeded(&output, outShape) &&
-                      reshapeGeneric(reinterpret_cast<const void*>(input.buffer),
-                                     input.shape(),
-                                     reinterpret_cast<void*>(output.buffer),
-                                     outShape);
+                      setInfoAndViewIfPossible(ins[0], outs[0], outShape) &&
+                      (output.buffer == input.buffer ||
+                       reshapeGeneric(reinterpret_cast<const void*>(input.buffer),
+                                      input.shape(),
+                                      reinterpret_cast<void*>(output.buffer),
+                                      outShape));
         } break;
         case OperationType::RESIZE_BILINEAR: {
             if (!allParametersPresent(3, 1)) {
@@ -1237,7 +2139,11 @@ int CpuExecutor::executeOperation(const Operation& operation) {
                 mOperands[outs[HashtableLookup::kHitsTensor]];
 
             Shape outputShape, hitShape;
-            HashtableLookup lookup(operation, mOperands);
+            HashtableLookup lookup(
+                operation, mOperands,
+                mWeights != nullptr ? mWeights->getHashtableLookupIndex(
+                                          ins[HashtableLookup::kKeyTensor])
+                                    : nullptr);
 
             success = hashtableLookupPrepare(lookups.shape(), keys.shape(), values.shape(),
                                              &outputShape, &hitShape) &&
@@ -1258,7 +2164,7 @@ int CpuExecutor::executeOperation(const Operation& operation) {
                 lsh.Eval();
         } break;
         case OperationType::LSTM: {
-            RunTimeOperandInfo &scratch =
+            RunTimeOperandInfo &scratchBuffer =
                 mOperands[outs[LSTMCell::kScratchBufferTensor]];
             RunTimeOperandInfo &outputStateOut =
                 mOperands[outs[LSTMCell::kOutputStateOutTensor]];
@@ -1273,11 +2179,16 @@ int CpuExecutor::executeOperation(const Operation& operation) {
             success = LSTMCell::Prepare(operation, mOperands,
                                         &scratchShape, &outputStateShape,
                                         &cellStateShape, &outputShape) &&
-                setInfoAndAllocateIfNeeded(&scratch, scratchShape) &&
+                setInfoAndAllocateIfNeeded(&scratchBuffer, scratchShape) &&
                 setInfoAndAllocateIfNeeded(&outputStateOut, outputStateShape) &&
                 setInfoAndAllocateIfNeeded(&cellStateOut, cellStateShape) &&
-                setInfoAndAllocateIfNeeded(&output, outputShape) &&
-                lstm_cell.Eval();
+                setInfoAndAllocateIfNeeded(&output, outputShape);
+            if (success) {
+                const float* projectedInput = getLSTMProjectedInput(operation, scratch);
+                success = projectedInput != nullptr
+                                  ? lstm_cell.EvalWithProjectedInput(projectedInput)
+                                  : lstm_cell.Eval();
+            }
         } break;
         case OperationType::RNN: {
             RunTimeOperandInfo &hiddenStateOut =
@@ -1391,11 +2302,12 @@ int CpuExecutor::executeOperation(const Operation& operation) {
                                      reinterpret_cast<const int32_t*>(squeezeDims.buffer),
                                      squeezeDims.shape(),
                                      &outShape) &&
-                      setInfoAndAllocateIfNeeded(&output, outShape) &&
-                      squeezeGeneric(input.buffer,
-                                     input.shape(),
-                                     output.buffer,
-                                     outShape);
+                      setInfoAndViewIfPossible(ins[0], outs[0], outShape) &&
+                      (output.buffer == input.buffer ||
+                       squeezeGeneric(input.buffer,
+                                      input.shape(),
+                                      output.buffer,
+                                      outShape));
         } break;
         case OperationType::TRANSPOSE: {
             if (!allParametersPresent(2, 1)) {
@@ -1474,6 +2386,16 @@ int CpuExecutor::executeOperation(const Operation& operation) {
                                      activation,
                                      reinterpret_cast<float*>(out.buffer),
                                      outShape);
+            } else if (in1.type == OperandType::TENSOR_QUANT8_ASYMM) {
+                success = addMulPrepare(in1.shape(), in2.shape(), &outShape) &&
+                          setInfoAndAllocateIfNeeded(&out, outShape) &&
+                          divQuant8(reinterpret_cast<const uint8_t*>(in1.buffer),
+                                    in1.shape(),
+                                    reinterpret_cast<const uint8_t*>(in2.buffer),
+                                    in2.shape(),
+                                    activation,
+                                    reinterpret_cast<uint8_t*>(out.buffer),
+                                    outShape);
             }
         } break;
         case OperationType::SUB: {
@@ -1497,6 +2419,16 @@ int CpuExecutor::executeOperation(const Operation& operation) {
                                      activation,
                                      reinterpret_cast<float*>(out.buffer),
                                      outShape);
+            } else if (in1.type == OperandType::TENSOR_QUANT8_ASYMM) {
+                success = addMulPrepare(in1.shape(), in2.shape(), &outShape) &&
+                          setInfoAndAllocateIfNeeded(&out, outShape) &&
+                          subQuant8(reinterpret_cast<const uint8_t*>(in1.buffer),
+                                    in1.shape(),
+                                    reinterpret_cast<const uint8_t*>(in2.buffer),
+                                    in2.shape(),
+                                    activation,
+                                    reinterpret_cast<uint8_t*>(out.buffer),
+                                    outShape);
             }
         } break;
         case OperationType::MEAN: {
@@ -1522,7 +2454,7 @@ int CpuExecutor::executeOperation(const Operation& operation) {
                                   axis.shape(),
                                   keepDims > 0,
                                   output.buffer,
-                                  outShape);
+                                  outShape, scratch);
         } break;
         default:
             nnAssert(false);
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "MemoryPlanner"
+
+#include "MemoryPlanner.h"
+
+#include "Utils.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace android {
+namespace nn {
+
+uint32_t MemoryPlanner::addBuffer(uint32_t size, uint32_t firstUse, uint32_t lastUse) {
+    nnAssert(firstUse <= lastUse);
+    mBuffers.push_back({.size = size, .firstUse = firstUse, .lastUse = lastUse, .offset = 0});
+    return mBuffers.size() - 1;
+}
+
+void MemoryPlanner::plan() {
+    plan([this](uint32_t bufferIndex1, uint32_t bufferIndex2) {
+        const Buffer& b1 = mBuffers[bufferIndex1];
+        const Buffer& b2 = mBuffers[bufferIndex2];
+        return b1.firstUse <= b2.lastUse && b2.firstUse <= b1.lastUse;
+    });
+}
+
+void MemoryPlanner::plan(const ConflictFunction& conflict) {
+    // Place the largest buffers first: they are the hardest to fit in the
+    // gaps left by others.
+    std::vector<uint32_t> order(mBuffers.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        return mBuffers[a].size > mBuffers[b].size;
+    });
+
+    mArenaSize = 0;
+    mTotalSize = 0;
+    std::vector<uint32_t> placed;
+    std::vector<const Buffer*> conflicts;
+    for (uint32_t index : order) {
+        Buffer& buffer = mBuffers[index];
+        mTotalSize += buffer.size;
+
+        // Find the placed buffers alive at the same time as this one.
+        conflicts.clear();
+        for (uint32_t other : placed) {
+            if (conflict(index, other)) {
+                conflicts.push_back(&mBuffers[other]);
+            }
+        }
+        std::sort(conflicts.begin(), conflicts.end(),
+                  [](const Buffer* a, const Buffer* b) { return a->offset < b->offset; });
+
+        // Take the first gap between them large enough for this buffer.
+        uint32_t offset = 0;
+        for (const Buffer* b : conflicts) {
+            if (offset + buffer.size <= b->offset) {
+                break;
+            }
+            offset = std::max(offset, align(b->offset + b->size));
+        }
+        buffer.offset = offset;
+        mArenaSize = std::max(mArenaSize, align(offset + buffer.size));
+        placed.push_back(index);
+    }
+}
+
+}  // namespace nn
+}  // namespace android
@@ -0,0 +1,362 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "OperationFusion"
+
+#include "OperationFusion.h"
+
+#include "CpuExecutor.h"
+#include "Tracing.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace android {
+namespace nn {
+
+namespace {
+
+bool hasKnownDimensions(const Operand& operand) {
+    return operand.dimensions.size() > 0 &&
+           std::find(operand.dimensions.begin(), operand.dimensions.end(), 0) ==
+                   operand.dimensions.end();
+}
+
+uint32_t getElementCount(const Operand& operand) {
+    uint32_t count = 1;
+    for (uint32_t d : operand.dimensions) {
+        count *= d;
+    }
+    return count;
+}
+
+// Applies the fusions to copies of the operands, operations and operand
+// values of a model, then writes them back to the model.
+class OperationFuser {
+public:
+    OperationFuser(Model* model, const std::vector<RunTimePoolInfo>& poolInfos,
+                   FusionReport* report);
+    void run();
+
+private:
+    // Returns the value of a constant operand, or nullptr if the operand is
+    // not a constant.  The pointer is invalidated by addConstant().
+    const uint8_t* getConstantData(uint32_t operandIndex) const;
+    // Reads the fused activation of the operation, which is always its last
+    // input.  Returns false if it is not a constant.
+    bool getActivation(const Operation& operation, int32_t* activation) const;
+    // Adds a CONSTANT_COPY operand with the type of another operand.
+    uint32_t addConstant(uint32_t likeOperandIndex, const void* data, uint32_t length);
+    // Adds an INT32 constant holding a FusedActivationFunc.
+    uint32_t addActivation(FusedActivationFunc activation);
+    // Replaces an input of an operation.
+    void replaceInput(Operation* operation, uint32_t inputIndex, uint32_t operandIndex);
+
+    bool fuseActivation(uint32_t producerIndex, uint32_t consumerIndex);
+    bool foldPerChannelConstant(uint32_t producerIndex, uint32_t consumerIndex);
+    // Makes the producer write the output of the consumer, and drops the
+    // consumer.
+    void absorb(uint32_t producerIndex, uint32_t consumerIndex);
+
+    Model* mModel;
+    const std::vector<RunTimePoolInfo>& mPoolInfos;
+    FusionReport* mReport;
+    std::vector<Operand> mOperands;
+    std::vector<Operation> mOperations;
+    std::vector<uint8_t> mOperandValues;
+    // For each operand, the operations reading it, once per input.  Not
+    // kept up to date for constants.
+    std::vector<std::vector<uint32_t>> mConsumers;
+    std::vector<bool> mRemoved;
+};
+
+OperationFuser::OperationFuser(Model* model, const std::vector<RunTimePoolInfo>& poolInfos,
+                               FusionReport* report)
+    : mModel(model),
+      mPoolInfos(poolInfos),
+      mReport(report),
+      mOperands(model->operands),
+      mOperations(model->operations),
+      mOperandValues(model->operandValues),
+      mConsumers(mOperands.size()),
+      mRemoved(mOperations.size(), false) {
+    for (uint32_t operationIndex = 0; operationIndex < mOperations.size(); operationIndex++) {
+        for (uint32_t operandIndex : mOperations[operationIndex].inputs) {
+            mConsumers[operandIndex].push_back(operationIndex);
+        }
+    }
+}
+
+const uint8_t* OperationFuser::getConstantData(uint32_t operandIndex) const {
+    const Operand& operand = mOperands[operandIndex];
+    switch (operand.lifetime) {
+        case OperandLifeTime::CONSTANT_COPY:
+            return mOperandValues.data() + operand.location.offset;
+        case OperandLifeTime::CONSTANT_REFERENCE:
+            if (operand.location.poolIndex >= mPoolInfos.size()) {
+                return nullptr;
+            }
+            return mPoolInfos[operand.location.poolIndex].getBuffer() + operand.location.offset;
+        default:
+            return nullptr;
+    }
+}
+
+bool OperationFuser::getActivation(const Operation& operation, int32_t* activation) const {
+    const uint8_t* data = getConstantData(operation.inputs[operation.inputs.size() - 1]);
+    if (data == nullptr) {
+        return false;
+    }
+    memcpy(activation, data, sizeof(*activation));
+    return true;
+}
+
+uint32_t OperationFuser::addConstant(uint32_t likeOperandIndex, const void* data,
+                                     uint32_t length) {
+    // Keep the values aligned for the kernels reading them in place.
+    const uint32_t offset = (mOperandValues.size() + 7) & ~7;
+    mOperandValues.resize(offset + length);
+    memcpy(mOperandValues.data() + offset, data, length);
+    Operand operand = mOperands[likeOperandIndex];
+    operand.numberOfConsumers = 0;
+    operand.lifetime = OperandLifeTime::CONSTANT_COPY;
+    operand.location = {.poolIndex = 0, .offset = offset, .length = length};
+    mOperands.push_back(operand);
+    mConsumers.emplace_back();
+    return mOperands.size() - 1;
+}
+
+uint32_t OperationFuser::addActivation(FusedActivationFunc activation) {
+    const int32_t value = static_cast<int32_t>(activation);
+    const uint32_t offset = (mOperandValues.size() + 7) & ~7;
+    mOperandValues.resize(offset + sizeof(value));
+    memcpy(mOperandValues.data() + offset, &value, sizeof(value));
+    mOperands.push_back({.type = OperandType::INT32,
+                         .dimensions = {},
+                         .numberOfConsumers = 0,
+                         .scale = 0.0f,
+                         .zeroPoint = 0,
+                         .lifetime = OperandLifeTime::CONSTANT_COPY,
+                         .location = {.poolIndex = 0, .offset = offset, .length = sizeof(value)}});
+    mConsumers.emplace_back();
+    return mOperands.size() - 1;
+}
+
+void OperationFuser::replaceInput(Operation* operation, uint32_t inputIndex,
+                                  uint32_t operandIndex) {
+    mOperands[operation->inputs[inputIndex]].numberOfConsumers--;
+    operation->inputs[inputIndex] = operandIndex;
+    mOperands[operandIndex].numberOfConsumers++;
+}
+
+void OperationFuser::absorb(uint32_t producerIndex, uint32_t consumerIndex) {
+    Operation& producer = mOperations[producerIndex];
+    const Operation& consumer = mOperations[consumerIndex];
+    const uint32_t intermediate = producer.outputs[0];
+    for (uint32_t operandIndex : consumer.inputs) {
+        mOperands[operandIndex].numberOfConsumers--;
+    }
+    mConsumers[intermediate].clear();
+    if (hasKnownDimensions(mOperands[intermediate])) {
+        mReport->eliminatedBytes += sizeOfData(mOperands[intermediate]);
+    }
+    producer.outputs[0] = consumer.outputs[0];
+    mRemoved[consumerIndex] = true;
+    mReport->fusedPairs.emplace_back(producer.type, consumer.type);
+    VLOG(CPUEXE) << "fuseOperations: fused operation " << consumerIndex << " ("
+                 << getOperationName(consumer.type) << ") into operation " << producerIndex
+                 << " (" << getOperationName(producer.type) << ")";
+}
+
+bool OperationFuser::fuseActivation(uint32_t producerIndex, uint32_t consumerIndex) {
+    Operation& producer = mOperations[producerIndex];
+    const Operation& consumer = mOperations[consumerIndex];
+    FusedActivationFunc fusedActivation;
+    switch (consumer.type) {
+        case OperationType::RELU:
+            fusedActivation = FusedActivationFunc::RELU;
+            break;
+        case OperationType::RELU1:
+            fusedActivation = FusedActivationFunc::RELU1;
+            break;
+        case OperationType::RELU6:
+            fusedActivation = FusedActivationFunc::RELU6;
+            break;
+        default:
+            return false;
+    }
+    int32_t activation;
+    if (!getActivation(producer, &activation) ||
+        activation != static_cast<int32_t>(FusedActivationFunc::NONE)) {
+        return false;
+    }
+    // The fused activation clamps in the quantized domain of the output of
+    // the producer.
+    const Operand& intermediate = mOperands[producer.outputs[0]];
+    const Operand& output = mOperands[consumer.outputs[0]];
+    if (output.type != intermediate.type || output.scale != intermediate.scale ||
+        output.zeroPoint != intermediate.zeroPoint) {
+        return false;
+    }
+    replaceInput(&producer, producer.inputs.size() - 1, addActivation(fusedActivation));
+    absorb(producerIndex, consumerIndex);
+    return true;
+}
+
+bool OperationFuser::foldPerChannelConstant(uint32_t producerIndex, uint32_t consumerIndex) {
+    Operation& producer = mOperations[producerIndex];
+    const Operation& consumer = mOperations[consumerIndex];
+    if (consumer.type != OperationType::ADD && consumer.type != OperationType::MUL) {
+        return false;
+    }
+    if (producer.type != OperationType::CONV_2D &&
+        producer.type != OperationType::DEPTHWISE_CONV_2D &&
+        producer.type != OperationType::FULLY_CONNECTED) {
+        return false;
+    }
+    int32_t activation;
+    if (!getActivation(producer, &activation) ||
+        activation != static_cast<int32_t>(FusedActivationFunc::NONE)) {
+        return false;
+    }
+
+    const uint32_t intermediateIndex = producer.outputs[0];
+    const uint32_t constantIndex =
+            consumer.inputs[0] == intermediateIndex ? consumer.inputs[1] : consumer.inputs[0];
+    const uint32_t filterIndex = producer.inputs[1];
+    const uint32_t biasIndex = producer.inputs[2];
+    const Operand& intermediate = mOperands[intermediateIndex];
+    const Operand& constant = mOperands[constantIndex];
+    const Operand& filter = mOperands[filterIndex];
+    const Operand& bias = mOperands[biasIndex];
+    if (intermediate.type != OperandType::TENSOR_FLOAT32 ||
+        constant.type != OperandType::TENSOR_FLOAT32 || !hasKnownDimensions(constant) ||
+        !hasKnownDimensions(filter) || !hasKnownDimensions(bias) ||
+        bias.dimensions.size() != 1) {
+        return false;
+    }
+    // The constant must hold a single value or one value per output channel
+    // along its last dimension, so that it does not change the shape of the
+    // result.
+    // The output channel is the first dimension of the filter of CONV_2D and
+    // FULLY_CONNECTED, and the last one for DEPTHWISE_CONV_2D.
+    const uint32_t channelCount = bias.dimensions[0];
+    const bool channelIsLast = producer.type == OperationType::DEPTHWISE_CONV_2D;
+    if ((channelIsLast ? filter.dimensions.back() : filter.dimensions[0]) != channelCount) {
+        return false;
+    }
+    const uint32_t constantCount = getElementCount(constant);
+    if (constant.dimensions.size() > intermediate.dimensions.size() ||
+        (constantCount != 1 &&
+         (constantCount != channelCount || constant.dimensions.back() != channelCount))) {
+        return false;
+    }
+    const float* constantData = reinterpret_cast<const float*>(getConstantData(constantIndex));
+    const float* filterData = reinterpret_cast<const float*>(getConstantData(filterIndex));
+    const float* biasData = reinterpret_cast<const float*>(getConstantData(biasIndex));
+    if (constantData == nullptr || filterData == nullptr || biasData == nullptr) {
+        return false;
+    }
+    auto getConstant = [constantData, constantCount](uint32_t channel) {
+        return constantData[constantCount == 1 ? 0 : channel];
+    };
+
+    std::vector<float> newBias(biasData, biasData + channelCount);
+    std::vector<float> newFilter;
+    if (consumer.type == OperationType::ADD) {
+        for (uint32_t c = 0; c < channelCount; c++) {
+            newBias[c] += getConstant(c);
+        }
+    } else {
+        const uint32_t filterCount = getElementCount(filter);
+        const uint32_t innerCount = filterCount / channelCount;
+        newFilter.assign(filterData, filterData + filterCount);
+        for (uint32_t i = 0; i < filterCount; i++) {
+            newFilter[i] *= getConstant(channelIsLast ? i % channelCount : i / innerCount);
+        }
+        for (uint32_t c = 0; c < channelCount; c++) {
+            newBias[c] *= getConstant(c);
+        }
+    }
+
+    // Adding operands invalidates the references above.
+    if (!newFilter.empty()) {
+        replaceInput(&producer, 1,
+                     addConstant(filterIndex, newFilter.data(), newFilter.size() * sizeof(float)));
+    }
+    replaceInput(&producer, 2,
+                 addConstant(biasIndex, newBias.data(), newBias.size() * sizeof(float)));
+    // The producer now applies the activation of the consumer.
+    replaceInput(&producer, producer.inputs.size() - 1,
+                 consumer.inputs[consumer.inputs.size() - 1]);
+    absorb(producerIndex, consumerIndex);
+    return true;
+}
+
+void OperationFuser::run() {
+    for (uint32_t operationIndex = 0; operationIndex < mOperations.size(); operationIndex++) {
+        const OperationType type = mOperations[operationIndex].type;
+        if (mRemoved[operationIndex] ||
+            (type != OperationType::CONV_2D && type != OperationType::DEPTHWISE_CONV_2D &&
+             type != OperationType::FULLY_CONNECTED && type != OperationType::ADD &&
+             type != OperationType::MUL)) {
+            continue;
+        }
+        // Fuse as many consumers as possible, e.g. a per-channel ADD and then
+        // a RELU.
+        while (true) {
+            const uint32_t output = mOperations[operationIndex].outputs[0];
+            if (mOperands[output].lifetime != OperandLifeTime::TEMPORARY_VARIABLE ||
+                mConsumers[output].size() != 1) {
+                break;
+            }
+            const uint32_t consumerIndex = mConsumers[output][0];
+            if (!fuseActivation(operationIndex, consumerIndex) &&
+                !foldPerChannelConstant(operationIndex, consumerIndex)) {
+                break;
+            }
+        }
+    }
+    if (mReport->fusedPairs.empty()) {
+        return;
+    }
+
+    std::vector<Operation> operations;
+    operations.reserve(mOperations.size());
+    for (uint32_t operationIndex = 0; operationIndex < mOperations.size(); operationIndex++) {
+        if (!mRemoved[operationIndex]) {
+            operations.push_back(std::move(mOperations[operationIndex]));
+        }
+    }
+    mModel->operations = operations;
+    mModel->operands = mOperands;
+    mModel->operandValues = mOperandValues;
+}
+
+}  // anonymous namespace
+
+void fuseOperations(Model* model, const std::vector<RunTimePoolInfo>& poolInfos,
+                    FusionReport* report) {
+    NNTRACE_CPU(NNTRACE_PHASE_PREPARATION, "fuseOperations");
+    *report = FusionReport();
+    OperationFuser(model, poolInfos, report).run();
+    VLOG(CPUEXE) << "fuseOperations: " << report->fusedPairs.size() << " operations fused, "
+                 << report->eliminatedBytes << " bytes of intermediate operands eliminated";
+}
+
+}  // namespace nn
+}  // namespace android
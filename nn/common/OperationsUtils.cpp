@@ -20,7 +20,9 @@
 #include "Operations.h"
 #include "Utils.h"
 
+#include <algorithm>
 #include <cmath>
+#include <omp.h>
 
 namespace android {
 namespace nn {
@@ -37,6 +39,12 @@ bool SameShape(const Shape& in1, const Shape& in2) {
     return true;
 }
 
+int getOpenMPThreadCount(uint64_t workItems, uint64_t work, uint64_t minWorkPerThread) {
+    const uint64_t maxThreads = std::max(omp_get_max_threads(), 1);
+    return static_cast<int>(std::max<uint64_t>(
+            std::min({maxThreads, workItems, work / minWorkPerThread}), 1));
+}
+
 bool SetShape(const Shape& in, Shape* out) {
     if (in.type != out->type || in.dimensions.size() != out->dimensions.size()) {
         return false;
@@ -125,6 +133,18 @@ bool GetQuantizedConvolutionMultipler(const Shape& inputShape,
     return true;
 }
 
+bool GetQuantizedConvolutionOutputMultiplier(const Shape& inputShape,
+                                             const Shape& filterShape,
+                                             const Shape& biasShape,
+                                             const Shape& outputShape,
+                                             QuantizedMultiplier* multiplier) {
+    float real_multiplier = 0.0;
+    return GetQuantizedConvolutionMultipler(inputShape, filterShape, biasShape,
+                                            outputShape, &real_multiplier) &&
+           QuantizeMultiplierSmallerThanOne(real_multiplier, &multiplier->multiplier,
+                                            &multiplier->shift);
+}
+
 void CalculateActivationRangeUint8(int32_t activation,
                                    const Shape& outputShape,
                                    int32_t* act_min,
@@ -731,9 +751,14 @@ bool transposePrepare(const Shape& input,
     NN_OPS_CHECK(getNumberOfDimensions(permShape) == 1);
     NN_OPS_CHECK(numInputDims == getSizeOfDimension(permShape, 0));
 
+    // perm must be a permutation of the input axes; a repeated axis would make
+    // the kernel read outside the input.
     std::vector<uint32_t> outDims(numInputDims);
+    std::vector<bool> seenAxis(numInputDims, false);
     for (int32_t idx = 0; idx < static_cast<int32_t>(numInputDims); ++idx) {
         NN_OPS_CHECK(permData[idx] >= 0 && permData[idx] < static_cast<int32_t>(numInputDims));
+        NN_OPS_CHECK(!seenAxis[permData[idx]]);
+        seenAxis[permData[idx]] = true;
         outDims[idx] = getSizeOfDimension(input, permData[idx]);
     }
 
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ScratchArena"
+
+#include "ScratchArena.h"
+
+#include "Utils.h"
+
+#include "public/gemmlowp.h"
+
+#include <new>
+
+namespace android {
+namespace nn {
+
+ScratchArena::ScratchArena() {}
+
+// Defined here, where gemmlowp::GemmContext is a complete type.
+ScratchArena::~ScratchArena() {}
+
+bool ScratchArena::Region::reserve(size_t newSize) {
+    if (newSize <= size) {
+        return true;
+    }
+    // The previous content does not need to be preserved, so release the old
+    // buffer first to lower the peak memory usage.
+    allocation.reset();
+    buffer = nullptr;
+    size = 0;
+    allocation.reset(new (std::nothrow) uint8_t[newSize + kScratchArenaAlignment - 1]);
+    if (allocation == nullptr) {
+        LOG(ERROR) << "ScratchArena: could not allocate " << newSize << " bytes";
+        return false;
+    }
+    const uintptr_t address = reinterpret_cast<uintptr_t>(allocation.get());
+    buffer = allocation.get() + (-address & (kScratchArenaAlignment - 1));
+    size = newSize;
+    return true;
+}
+
+bool ScratchArena::reserve(size_t size) {
+    return mScratch.reserve(size);
+}
+
+uint8_t* ScratchArena::getBuffer(size_t size) {
+    return mScratch.reserve(size) ? mScratch.buffer : nullptr;
+}
+
+uint8_t* ScratchArena::getTemporariesBuffer(size_t size) {
+    return mTemporaries.reserve(size) ? mTemporaries.buffer : nullptr;
+}
+
+gemmlowp::GemmContext* ScratchArena::getGemmContext() {
+    if (mGemmContext == nullptr) {
+        mGemmContext.reset(new gemmlowp::GemmContext);
+        // Allow gemmlowp automatically decide how many threads to use, unless
+        // limited by setMaxNumThreads().
+        mGemmContext->set_max_num_threads(mMaxNumThreads);
+    }
+    return mGemmContext.get();
+}
+
+void ScratchArena::setMaxNumThreads(int maxNumThreads) {
+    mMaxNumThreads = maxNumThreads;
+    if (mGemmContext != nullptr) {
+        mGemmContext->set_max_num_threads(maxNumThreads);
+    }
+}
+
+std::unique_ptr<ScratchArena> ScratchArenaPool::create(bool reserveTemporaries,
+                                                       bool* fail) const {
+    std::unique_ptr<ScratchArena> arena(new ScratchArena);
+    if (!arena->reserve(mScratchSize) ||
+        (reserveTemporaries && arena->getTemporariesBuffer(mTemporariesSize) == nullptr)) {
+        *fail = true;
+    }
+    return arena;
+}
+
+bool ScratchArenaPool::initialize(size_t scratchSize, size_t temporariesSize) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mScratchSize = scratchSize;
+    mTemporariesSize = temporariesSize;
+    bool fail = false;
+    std::unique_ptr<ScratchArena> arena = create(true /* reserveTemporaries */, &fail);
+    if (fail) {
+        return false;
+    }
+    mAvailable.push_back(std::move(arena));
+    return true;
+}
+
+std::unique_ptr<ScratchArena> ScratchArenaPool::acquire() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mAvailable.empty()) {
+        std::unique_ptr<ScratchArena> arena = std::move(mAvailable.back());
+        mAvailable.pop_back();
+        return arena;
+    }
+    // All the arenas are in use by other executions.  A failure to reserve is
+    // not fatal here: the arena tries again when the execution needs the memory.
+    VLOG(CPUEXE) << "ScratchArenaPool: creating an arena of " << mScratchSize << " bytes";
+    bool fail = false;
+    return create(false /* reserveTemporaries */, &fail);
+}
+
+void ScratchArenaPool::release(std::unique_ptr<ScratchArena> arena) {
+    nnAssert(arena != nullptr);
+    std::lock_guard<std::mutex> lock(mMutex);
+    mAvailable.push_back(std::move(arena));
+}
+
+}  // namespace nn
+}  // namespace android
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ThreadPool"
+
+#include "ThreadPool.h"
+
+#include "Tracing.h"
+#include "Utils.h"
+
+#include <algorithm>
+
+namespace android {
+namespace nn {
+
+namespace {
+
+// The pool whose worker is the current thread, if any.
+thread_local const ThreadPool* tCurrentPool = nullptr;
+
+const uint32_t kDefaultMaxQueueDepth = 64;
+
+}  // namespace
+
+ThreadPool::ThreadPool(uint32_t numThreads, uint32_t maxQueueDepth)
+    : mMaxQueueDepth(std::max(maxQueueDepth, 1u)) {
+    if (numThreads == 0) {
+        numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    VLOG(CPUEXE) << "ThreadPool: " << numThreads << " threads, queue depth " << mMaxQueueDepth;
+    mWorkers.reserve(numThreads);
+    for (uint32_t i = 0; i < numThreads; i++) {
+        mWorkers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mCondition.notify_all();
+    for (std::thread& worker : mWorkers) {
+        worker.join();
+    }
+}
+
+bool ThreadPool::isWorkerThread() const {
+    return tCurrentPool == this;
+}
+
+bool ThreadPool::enqueue(std::function<void()>* task, bool canWait) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (mQueue.size() >= mMaxQueueDepth) {
+        if (!canWait) {
+            VLOG(CPUEXE) << "ThreadPool: queue full, running the task on the calling worker";
+            return false;
+        }
+        VLOG(CPUEXE) << "ThreadPool: queue full, waiting for room";
+        NNTRACE_FULL(NNTRACE_LAYER_UTILITY, NNTRACE_PHASE_UNSPECIFIED,
+                     "ThreadPool::waitForRoom");
+        mNotFullCondition.wait(lock, [this] { return mQueue.size() < mMaxQueueDepth; });
+    }
+    mQueue.push_back({.function = std::move(*task),
+                      .queuedTime = std::chrono::steady_clock::now()});
+    NNTRACE_COUNTER(NNTRACE_LAYER_UTILITY, "ThreadPool::queueDepth", mQueue.size());
+    lock.unlock();
+    mCondition.notify_one();
+    return true;
+}
+
+void ThreadPool::schedule(std::function<void()> task) {
+    if (isWorkerThread()) {
+        task();
+        return;
+    }
+    enqueue(&task, /* canWait = */ true);
+}
+
+void ThreadPool::scheduleNonBlocking(std::function<void()> task) {
+    if (!enqueue(&task, /* canWait = */ !isWorkerThread())) {
+        task();
+    }
+}
+
+void ThreadPool::workerLoop() {
+    tCurrentPool = this;
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this] { return mStopping || !mQueue.empty(); });
+            if (mQueue.empty()) {
+                return;  // mStopping
+            }
+            task = std::move(mQueue.front());
+            mQueue.pop_front();
+            NNTRACE_COUNTER(NNTRACE_LAYER_UTILITY, "ThreadPool::queueDepth", mQueue.size());
+        }
+        mNotFullCondition.notify_one();
+        const auto waited = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - task.queuedTime);
+        NNTRACE_COUNTER(NNTRACE_LAYER_UTILITY, "ThreadPool::queueWaitUs", waited.count());
+        task.function();
+    }
+}
+
+ThreadPool* ThreadPool::get() {
+    // Never destroyed, so that tasks still running when the process exits
+    // do not race with the destruction of the pool.
+    static ThreadPool* pool = [] {
+        uint32_t numThreads = 0;
+        uint32_t maxQueueDepth = kDefaultMaxQueueDepth;
+#ifdef NN_DEBUGGABLE
+        numThreads = getProp("debug.nn.threadpool.size", numThreads);
+        maxQueueDepth = getProp("debug.nn.threadpool.queuedepth", maxQueueDepth);
+#endif  // NN_DEBUGGABLE
+        return new ThreadPool(numThreads, maxQueueDepth);
+    }();
+    return pool;
+}
+
+}  // namespace nn
+}  // namespace android
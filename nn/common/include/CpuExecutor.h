@@ -18,11 +18,18 @@
 #define ANDROID_ML_NN_COMMON_CPU_EXECUTOR_H
 
 #include "HalInterfaces.h"
+#include "OperationFusion.h"
 #include "OperationsUtils.h"
+#include "ScratchArena.h"
+#include "ThreadPool.h"
 #include "Utils.h"
 
 #include <algorithm>
 #include <android-base/macros.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 namespace android {
@@ -100,9 +107,227 @@ private:
 bool setRunTimePoolInfosFromHidlMemories(std::vector<RunTimePoolInfo>* poolInfos,
                                          const hidl_vec<hidl_memory>& pools);
 
+// The dependencies between the operations of a model, through the operands
+// that some operations write and others read.
+//
+// Used to run independent operations concurrently: an operation can start
+// as soon as all the operations it depends on have completed.
+class OperationDependencies {
+public:
+    // Computes the dependencies of the operations of the model, which must be
+    // sorted in execution order.
+    void initialize(const Model& model);
+
+    uint32_t getOperationCount() const { return mConsumers.size(); }
+
+    // The operations reading an operand written by the operation.
+    const std::vector<uint32_t>& getConsumers(uint32_t operationIndex) const {
+        return mConsumers[operationIndex];
+    }
+
+    // The number of operations writing an operand read by the operation.
+    uint32_t getProducerCount(uint32_t operationIndex) const {
+        return mProducerCounts[operationIndex];
+    }
+
+    // Returns true if operation "before" has to complete before operation
+    // "after" starts, i.e., if "after" depends on it, directly or not.
+    bool precedes(uint32_t before, uint32_t after) const {
+        return mSuccessors[before][after];
+    }
+
+    // The largest number of operations at the same depth in the graph: an
+    // estimate of how many operations can run at the same time.
+    uint32_t getMaxWidth() const { return mMaxWidth; }
+
+private:
+    std::vector<std::vector<uint32_t>> mConsumers;
+    std::vector<uint32_t> mProducerCounts;
+    // mSuccessors[i][j] is true if operation j depends on operation i.
+    std::vector<std::vector<bool>> mSuccessors;
+    uint32_t mMaxWidth = 0;
+};
+
+// Where the temporaries of a model live during execution.
+//
+// Computed once, when the model is prepared, from the lifetimes of the
+// temporaries over the operations in execution order: each temporary whose
+// size is known from the model is given an offset into a single arena, and
+// temporaries that are never alive at the same time share memory.  The
+// executions then get all the temporaries from one buffer instead of
+// allocating and freeing each one of them.
+//
+// The output of a RESHAPE or a SQUEEZE whose input is a planned temporary is
+// given the offset of the input, whose memory is kept until the output is
+// no longer used: the operation then has nothing to copy.
+class TemporaryMemoryPlan {
+public:
+    // Plans the temporaries of the model, whose operations must be sorted
+    // in execution order.  If dependencies is not nullptr, the operations
+    // may run in any order compatible with it, including concurrently, and
+    // two temporaries only share memory if the dependencies guarantee that
+    // one is no longer used by the time the other is written.
+    void initialize(const Model& model, const OperationDependencies* dependencies = nullptr);
+
+    // Returned by getOffset() for temporaries that are allocated separately
+    // at execution time, e.g. because their dimensions are not known yet.
+    static constexpr uint32_t kNotPlanned = ~0u;
+
+    // Returns the offset of the operand in the arena, or kNotPlanned.
+    uint32_t getOffset(uint32_t operandIndex) const { return mOffsets[operandIndex]; }
+
+    // The size of the arena holding all the planned temporaries.
+    uint32_t getArenaSize() const { return mArenaSize; }
+
+    // The size the planned temporaries would need if none shared memory.
+    uint64_t getTotalSizeOfTemporaries() const { return mTotalSizeOfTemporaries; }
+
+private:
+    std::vector<uint32_t> mOffsets;
+    uint32_t mArenaSize = 0;
+    uint64_t mTotalSizeOfTemporaries = 0;
+};
+
+// The constant weights of a model, and what can be computed from them,
+// prepared once for all the executions of the model.
+//
+// The constant weights of the CONV_2D, DEPTHWISE_CONV_2D, FULLY_CONNECTED,
+// RNN, SVDF and LSTM operations that the model copied into its operand
+// values without aligning them for their element type are copied to aligned
+// memory, from which the kernels then read them.  ModelBuilder aligns the
+// values it copies, so this is only for models built otherwise.  The output
+// multipliers of the quantized CONV_2D, DEPTHWISE_CONV_2D and FULLY_CONNECTED
+// operations, which only depend on the scales of their operands, are
+// computed here too instead of on each execution.
+//
+// Unrolled LSTMs are found here as well: chains of LSTM operations with the
+// same constant weights, each of which takes the state written by the
+// previous one.  The input weights of their gates are concatenated into a
+// single matrix, so that the executor can multiply it with the inputs of all
+// the timesteps at once, when the first of the operations runs, and only
+// compute the recurrent part of each timestep after that.
+//
+// If the model relaxes its float32 computations to float16, and the target
+// has a Float16 type, the constant float32 weights of its FULLY_CONNECTED
+// operations are converted to Float16 instead of being copied, so that each
+// execution reads half as many bytes of weights.
+//
+// The constant keys of the HASHTABLE_LOOKUP operations are indexed in a hash
+// table, so that each lookup probes a few slots instead of searching them.
+class PreparedWeights {
+public:
+    struct LSTMSequence {
+        // The input operand of each timestep, which is a model input or a
+        // constant, and so is known when the first timestep runs.
+        std::vector<uint32_t> inputs;
+        // {gateCount * cellCount, inputSize}, the gates in the order of the
+        // scratch buffer of LSTMCell.
+        std::vector<float> inputWeights;
+        // {gateCount * cellCount}, in the same order.
+        std::vector<float> biases;
+        uint32_t gateCount;
+        uint32_t cellCount;
+        uint32_t inputSize;
+    };
+    struct LSTMSequenceStep {
+        uint32_t sequence;
+        uint32_t timestep;
+    };
+
+    // Returns false if the aligned copies could not be allocated.
+    bool initialize(const Model& model, const std::vector<RunTimePoolInfo>& poolInfos);
+
+    // Returns the aligned copy of the value of the operand, or nullptr if
+    // the value is read from where the model keeps it.
+    const uint8_t* getBuffer(uint32_t operandIndex) const { return mBuffers[operandIndex]; }
+
+    // Returns the output multiplier of the operation writing the operand,
+    // or nullptr if it has to be computed at execution time.
+    const QuantizedMultiplier* getOutputMultiplier(uint32_t outputOperandIndex) const {
+        auto it = mOutputMultipliers.find(outputOperandIndex);
+        return it != mOutputMultipliers.end() ? &it->second : nullptr;
+    }
+
+    // The number of bytes of weights that were copied.
+    size_t getCopiedSize() const { return mCopiedSize; }
+
+#if NN_HAS_FLOAT16
+    // Returns the Float16 conversion of the value of the operand, or nullptr
+    // if it is used as float32.
+    const Float16* getFloat16Buffer(uint32_t operandIndex) const {
+        auto it = mFloat16Buffers.find(operandIndex);
+        return it != mFloat16Buffers.end() ? it->second.data() : nullptr;
+    }
+#endif
+
+    // Returns the index HashtableLookup::BuildIndex() built from the value of
+    // the operand, or nullptr if it is not the constant keys of a
+    // HASHTABLE_LOOKUP operation.
+    const std::vector<int32_t>* getHashtableLookupIndex(uint32_t keyOperandIndex) const {
+        auto it = mHashtableLookupIndexes.find(keyOperandIndex);
+        return it != mHashtableLookupIndexes.end() ? &it->second : nullptr;
+    }
+
+    size_t getLSTMSequenceCount() const { return mLSTMSequences.size(); }
+    const LSTMSequence& getLSTMSequence(uint32_t index) const { return mLSTMSequences[index]; }
+
+    // Returns where the LSTM operation writing the operand as its scratch
+    // buffer is in its sequence, or nullptr if it is not part of one.
+    const LSTMSequenceStep* getLSTMSequenceStep(uint32_t scratchOperandIndex) const {
+        auto it = mLSTMSequenceSteps.find(scratchOperandIndex);
+        return it != mLSTMSequenceSteps.end() ? &it->second : nullptr;
+    }
+
+private:
+    // Finds the unrolled LSTMs of the model.
+    void findLSTMSequences(const Model& model,
+                           const std::function<const uint8_t*(const Operand&)>& getValue);
+
+    std::unique_ptr<uint8_t[]> mAllocation;
+    std::vector<const uint8_t*> mBuffers;
+    std::unordered_map<uint32_t, QuantizedMultiplier> mOutputMultipliers;
+    size_t mCopiedSize = 0;
+    std::vector<LSTMSequence> mLSTMSequences;
+    std::unordered_map<uint32_t, LSTMSequenceStep> mLSTMSequenceSteps;
+    std::unordered_map<uint32_t, std::vector<int32_t>> mHashtableLookupIndexes;
+#if NN_HAS_FLOAT16
+    std::unordered_map<uint32_t, std::vector<Float16>> mFloat16Buffers;
+#endif
+};
+
 // This class is used to execute a model on the CPU.
 class CpuExecutor {
 public:
+    // The operations get their working memory from the given arena, which
+    // must not be used by any other execution while run() is executing.  If
+    // arena is nullptr, an arena owned by the calling thread is used.
+    //
+    // If plan is not nullptr, it must have been initialized with the model
+    // passed to run(), and the temporaries are placed in the arena as it
+    // specifies.  Otherwise each temporary is allocated separately.
+    //
+    // If dependencies is not nullptr, it must have been initialized with the
+    // model passed to run(), and operations that do not depend on each other
+    // may run concurrently on the threads of getOperationThreadPool().  Each
+    // thread running operations for this execution gets its own arena from
+    // arenaPool, which must then not be nullptr either.
+    //
+    // If weights is not nullptr, it must have been initialized with the
+    // model passed to run(), and the operations use the weights and the
+    // output multipliers it prepared.
+    explicit CpuExecutor(ScratchArena* arena = nullptr,
+                         const TemporaryMemoryPlan* plan = nullptr,
+                         const OperationDependencies* dependencies = nullptr,
+                         ScratchArenaPool* arenaPool = nullptr,
+                         const PreparedWeights* weights = nullptr)
+        : mArena(arena), mPlan(plan), mDependencies(dependencies), mArenaPool(arenaPool),
+          mWeights(weights) {}
+
+    // Returns the number of bytes of scratch memory the operations of the
+    // model need, as far as can be told from the dimensions in the model.
+    // Meant to size the ScratchArena when the model is prepared.
+    static size_t getScratchSizeRequirement(const Model& model);
+
     // Executes the model. The results will be stored at the locations
     // specified in the constructor.
     // The model must outlive the executor.  We prevent it from being modified
@@ -114,20 +339,67 @@ public:
             const std::vector<RunTimePoolInfo>& modelPoolInfos,
             const std::vector<RunTimePoolInfo>& requestPoolInfos);
 
+    // The threads on which the operations of all the executions using
+    // OperationDependencies run, in addition to the threads calling run().
+    static ThreadPool* getOperationThreadPool();
+
 private:
+    struct DataflowState;
+
     bool initializeRunTimeInfo(const std::vector<RunTimePoolInfo>& modelPoolInfos,
                                const std::vector<RunTimePoolInfo>& requestPoolInfos);
+    // Runs the operations, as many at a time as their dependencies allow.
+    int executeOperationsConcurrently();
+    // Runs ready operations until none is left to run.  Called on each of
+    // the threads taking part in executeOperationsConcurrently().
+    void executeReadyOperations(const std::shared_ptr<DataflowState>& state,
+                                ScratchArena* scratch);
     // Runs one operation of the graph.
-    int executeOperation(const Operation& entry);
+    int executeOperation(const Operation& entry, ScratchArena* scratch);
+    // For RESHAPE and SQUEEZE, whose output holds the same bytes as their
+    // input: makes the output a view of the input rather than a copy, when
+    // the input is read-only or owns memory of its own.  Otherwise same as
+    // setInfoAndAllocateIfNeeded().
+    bool setInfoAndViewIfPossible(uint32_t inputIndex, uint32_t outputIndex, const Shape& shape);
     // Decrement the usage count for the operands listed.  Frees the memory
     // allocated for any temporary variable with a count of zero.
     void freeNoLongerUsedOperands(const std::vector<uint32_t>& inputs);
+    // Returns true if the buffer is part of the memory of the planned
+    // temporaries, as opposed to being allocated separately.
+    bool isInTemporaries(const uint8_t* buffer) const {
+        return buffer >= mTemporaries && buffer < mTemporaries + mTemporariesSize;
+    }
+    // Returns the gate biases plus the input products of the LSTM
+    // operation, if it is a timestep of an LSTM sequence of mWeights, or
+    // nullptr if it has to compute them itself.  The first timestep of a
+    // sequence computes them for all the others.
+    const float* getLSTMProjectedInput(const Operation& operation, ScratchArena* scratch);
+    // Returns the output multiplier prepared for the operation, if any.
+    const QuantizedMultiplier* getOutputMultiplier(const Operation& operation) const {
+        return mWeights != nullptr ? mWeights->getOutputMultiplier(operation.outputs[0])
+                                   : nullptr;
+    }
 
     // The model and the request that we'll execute. Only valid while run()
     // is being executed.
     const Model* mModel = nullptr;
     const Request* mRequest = nullptr;
 
+    // The arguments passed to the constructor.
+    ScratchArena* const mArena;
+    const TemporaryMemoryPlan* const mPlan;
+    const OperationDependencies* const mDependencies;
+    ScratchArenaPool* const mArenaPool;
+    const PreparedWeights* const mWeights;
+    // Protects the numberOfUsesLeft of the operands when operations run
+    // concurrently.
+    std::mutex mFreeMutex;
+    // The arena used by the operations, and the memory of the planned
+    // temporaries within it. Only valid while run() is being executed.
+    ScratchArena* mScratch = nullptr;
+    uint8_t* mTemporaries = nullptr;
+    uint32_t mTemporariesSize = 0;
+
     // We're copying the list of all the dimensions from the model, as
     // these may be modified when we run the operatins.  Since we're
     // making a full copy, the indexes used in the operand description
@@ -135,6 +407,73 @@ private:
     //    std::vector<uint32_t> mDimensions;
     // Runtime information about all the operands.
     std::vector<RunTimeOperandInfo> mOperands;
+    // For each view made at execution time of a temporary owning its
+    // memory, the operand owning it.  Protected by mFreeMutex.
+    std::unordered_map<uint32_t, uint32_t> mBufferOwners;
+    // For each LSTM sequence of mWeights, the rows computed by its first
+    // timestep, see getLSTMProjectedInput().  Only the operations of the
+    // sequence, which run one after the other, use them.
+    std::vector<std::vector<float>> mLSTMProjections;
+};
+
+// A model prepared for execution on the CPU.
+//
+// Holds everything about the execution of a model that does not depend on
+// the request: the model, its mapped memory pools, its prepared weights, the
+// layout of its temporaries and the working memory of the executions.  It is created once,
+// when the model is prepared or compiled, so that each execution only has to
+// bind its inputs and outputs before running.
+//
+// run() can be called concurrently from several threads.
+//
+// By default, the operations run one at a time, in the order of
+// model.operations.  On debuggable builds, setting the system property
+// debug.nn.cpuexe.parallel to 1 lets independent operations run
+// concurrently instead.
+//
+// When it is prepared, the model is rewritten by fuseOperations(), unless
+// the system property debug.nn.cpuexe.fusion is set to 0 on debuggable
+// builds.
+class CpuPreparedModel {
+    DISALLOW_COPY_AND_ASSIGN(CpuPreparedModel);
+public:
+    explicit CpuPreparedModel(Model model);
+
+    // For testing only: whether independent operations may run
+    // concurrently.  Must be called before initialize().
+    void setParallelOperations(bool parallelOperations) {
+        mParallelOperations = parallelOperations;
+    }
+
+    // For testing only: whether operations are fused.  Must be called
+    // before initialize().
+    void setFuseOperations(bool fuseOperations) { mFuseOperations = fuseOperations; }
+
+    // Returns false if the memory pools of the model could not be mapped, or
+    // if the working memory could not be allocated.
+    bool initialize();
+
+    // The model as it is executed, i.e., after fusion.  Its inputs and
+    // outputs are those of the model passed to the constructor.
+    const Model& getModel() const { return mModel; }
+
+    // What the fusion did to the model.  Only valid after initialize().
+    const FusionReport& getFusionReport() const { return mFusionReport; }
+
+    // Executes the model for the request, whose memory pools have already
+    // been mapped.  Returns an ANEURALNETWORKS_* result code.
+    int run(const Request& request, const std::vector<RunTimePoolInfo>& requestPoolInfos);
+
+private:
+    Model mModel;
+    bool mParallelOperations = false;
+    bool mFuseOperations = true;
+    FusionReport mFusionReport;
+    std::vector<RunTimePoolInfo> mModelPoolInfos;
+    OperationDependencies mDependencies;  // only used if mParallelOperations
+    PreparedWeights mWeights;
+    TemporaryMemoryPlan mTemporaryPlan;
+    ScratchArenaPool mScratchArenas;
 };
 
 // Class for setting reasonable OpenMP threading settings. (OpenMP is used by
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_ML_NN_COMMON_MEMORY_PLANNER_H
+#define ANDROID_ML_NN_COMMON_MEMORY_PLANNER_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace android {
+namespace nn {
+
+// Lays out a set of buffers in a single arena, such that buffers that are
+// alive at the same time do not overlap, while buffers with disjoint
+// lifetimes can share the same bytes.
+//
+// The lifetime of a buffer is an inclusive range of steps (e.g. indexes into
+// the list of operations sorted in execution order): a buffer is alive from
+// the step that writes it to the last step that reads it.
+//
+// Buffers are placed greedily by decreasing size, each one at the lowest
+// aligned offset that does not overlap the already placed buffers whose
+// lifetimes intersect its own.
+//
+// When the steps do not run in a fixed order (e.g. independent operations
+// running concurrently), the caller can instead tell which buffers may be
+// alive at the same time through a ConflictFunction.
+class MemoryPlanner {
+public:
+    // Returns true if the buffers with the given indexes may be alive at the
+    // same time, and thus must not overlap.
+    using ConflictFunction = std::function<bool(uint32_t bufferIndex1, uint32_t bufferIndex2)>;
+
+    // All offsets, and the arena size, are multiples of alignment, which
+    // must be a power of two.
+    explicit MemoryPlanner(uint32_t alignment) : mAlignment(alignment) {}
+
+    // Adds a buffer of size bytes alive from step firstUse to step lastUse,
+    // both included.  Returns the index of the buffer, to be passed to
+    // getOffset().
+    uint32_t addBuffer(uint32_t size, uint32_t firstUse, uint32_t lastUse);
+
+    // Computes the offsets of all the buffers added so far.
+    void plan();
+
+    // Same as above, but with the conflicts between buffers given by the
+    // function rather than by their lifetimes.
+    void plan(const ConflictFunction& conflict);
+
+    // Returns the offset of the buffer in the arena.  Only valid after plan().
+    uint32_t getOffset(uint32_t bufferIndex) const { return mBuffers[bufferIndex].offset; }
+
+    // Returns the size of the arena needed to hold all the buffers.  Only
+    // valid after plan().
+    uint32_t getArenaSize() const { return mArenaSize; }
+
+    // Returns the size the buffers would need if each had its own memory.
+    uint64_t getTotalSize() const { return mTotalSize; }
+
+private:
+    struct Buffer {
+        uint32_t size;
+        uint32_t firstUse;
+        uint32_t lastUse;
+        uint32_t offset;
+    };
+
+    uint32_t align(uint32_t size) const { return (size + mAlignment - 1) & ~(mAlignment - 1); }
+
+    const uint32_t mAlignment;
+    std::vector<Buffer> mBuffers;
+    uint32_t mArenaSize = 0;
+    uint64_t mTotalSize = 0;
+};
+
+}  // namespace nn
+}  // namespace android
+
+#endif  // ANDROID_ML_NN_COMMON_MEMORY_PLANNER_H
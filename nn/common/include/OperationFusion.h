@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_ML_NN_COMMON_OPERATION_FUSION_H
+#define ANDROID_ML_NN_COMMON_OPERATION_FUSION_H
+
+#include "HalInterfaces.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace android {
+namespace nn {
+
+class RunTimePoolInfo;
+
+// What fuseOperations() did to a model.
+struct FusionReport {
+    // For each fusion, the type of the operation that absorbed another one,
+    // and the type of the operation it absorbed.
+    std::vector<std::pair<OperationType, OperationType>> fusedPairs;
+    // The total size of the intermediate operands that are no longer
+    // computed, as far as it is known from the model.
+    uint64_t eliminatedBytes = 0;
+};
+
+// Rewrites the model so that fewer operations compute the same outputs.
+//
+// An operation is fused into the CONV_2D, DEPTHWISE_CONV_2D,
+// FULLY_CONNECTED, ADD or MUL operation producing its input when that
+// input is a temporary read by no other operation, and:
+// - it is a RELU, RELU1 or RELU6, and the producer has no fused activation
+//   yet: the producer applies the activation itself;
+// - or it is a float ADD or MUL by a constant holding one value per output
+//   channel, the producer is a float CONV_2D, DEPTHWISE_CONV_2D or
+//   FULLY_CONNECTED with constant weights and bias and no fused activation:
+//   the constant is folded into the weights and bias of the producer, which
+//   takes over the fused activation of the ADD or MUL.
+// Intermediate operands that are model outputs are never eliminated.
+//
+// The operations of the model must be sorted in execution order, and stay
+// so.  poolInfos are the mapped memory pools of the model, from which the
+// values of CONSTANT_REFERENCE operands are read.  The new constants are
+// added to model->operandValues.  Operands that are no longer used are left
+// in the model, with no consumers.
+void fuseOperations(Model* model, const std::vector<RunTimePoolInfo>& poolInfos,
+                    FusionReport* report);
+
+}  // namespace nn
+}  // namespace android
+
+#endif  // ANDROID_ML_NN_COMMON_OPERATION_FUSION_H
@@ -17,6 +17,8 @@
 #ifndef ANDROID_ML_NN_COMMON_OPERATIONS_H
 #define ANDROID_ML_NN_COMMON_OPERATIONS_H
 
+#include "OperationsUtils.h"
+
 #include "operations/EmbeddingLookup.h"
 #include "operations/HashtableLookup.h"
 #include "operations/LSHProjection.h"
@@ -32,7 +34,9 @@
 namespace android {
 namespace nn {
 
+struct QuantizedMultiplier;
 struct Shape;
+class ScratchArena;
 
 bool addFloat32(const float* in1, const Shape& shape1,
                 const float* in2, const Shape& shape2,
@@ -68,6 +72,8 @@ bool depthwiseConvFloat32(const float* inputData, const Shape& inputShape,
                           int32_t stride_width, int32_t stride_height,
                           int32_t depth_multiplier, int32_t activation,
                           float* outputData, const Shape& outputShape);
+// If outputMultiplier is nullptr, depthwiseConvQuant8, convQuant8 and
+// fullyConnectedQuant8 compute it from the shapes on each call.
 bool depthwiseConvQuant8(const uint8_t* inputData, const Shape& inputShape,
                          const uint8_t* filterData, const Shape& filterShape,
                          const int32_t* biasData, const Shape& biasShape,
@@ -75,7 +81,8 @@ bool depthwiseConvQuant8(const uint8_t* inputData, const Shape& inputShape,
                          int32_t padding_top, int32_t padding_bottom,
                          int32_t stride_width, int32_t stride_height,
                          int32_t depth_multiplier, int32_t activation,
-                         uint8_t* outputData, const Shape& outputShape);
+                         uint8_t* outputData, const Shape& outputShape,
+                         const QuantizedMultiplier* outputMultiplier);
 
 bool convFloat32(const float* inputData, const Shape& inputShape,
                  const float* filterData, const Shape& filterShape,
@@ -84,7 +91,8 @@ bool convFloat32(const float* inputData, const Shape& inputShape,
                  int32_t padding_top, int32_t padding_bottom,
                  int32_t stride_width, int32_t stride_height,
                  int32_t activation,
-                 float* outputData, const Shape& outputShape);
+                 float* outputData, const Shape& outputShape,
+                 ScratchArena* scratch);
 bool convQuant8(const uint8_t* inputData, const Shape& inputShape,
                 const uint8_t* filterData, const Shape& filterShape,
                 const int32_t* biasData, const Shape& biasShape,
@@ -92,7 +100,13 @@ bool convQuant8(const uint8_t* inputData, const Shape& inputShape,
                 int32_t padding_top, int32_t padding_bottom,
                 int32_t stride_width, int32_t stride_height,
                 int32_t activation,
-                uint8_t* outputData, const Shape& outputShape);
+                uint8_t* outputData, const Shape& outputShape,
+                const QuantizedMultiplier* outputMultiplier,
+                ScratchArena* scratch);
+// Returns the size of the im2col buffer convFloat32 and convQuant8 take from
+// the scratch arena.
+uint64_t getConvIm2colByteSize(const Shape& inputShape, const Shape& filterShape,
+                               const Shape& outputShape);
 
 bool averagePoolFloat32(const float* inputData, const Shape& inputShape,
                         int32_t padding_left, int32_t padding_right,
@@ -155,11 +169,23 @@ bool fullyConnectedFloat32(const float* inputData, const Shape& inputShape,
                            const float* biasData, const Shape& biasShape,
                            int32_t activation,
                            float* outputData, const Shape& outputShape);
+#if NN_HAS_FLOAT16
+// For relaxed models: the weights are stored as Float16, the products are
+// accumulated in float32.
+bool fullyConnectedFloat32WithFloat16Weights(const float* inputData, const Shape& inputShape,
+                                             const Float16* weightsData,
+                                             const Shape& weightsShape,
+                                             const float* biasData, const Shape& biasShape,
+                                             int32_t activation,
+                                             float* outputData, const Shape& outputShape);
+#endif
 bool fullyConnectedQuant8(const uint8_t* inputData, const Shape& inputShape,
                           const uint8_t* weights, const Shape& weightsShape,
                           const int32_t* biasData, const Shape& biasShape,
                           int32_t activation,
-                          uint8_t* outputData, const Shape& outputShape);
+                          uint8_t* outputData, const Shape& outputShape,
+                          const QuantizedMultiplier* outputMultiplier,
+                          ScratchArena* scratch);
 
 bool concatenationFloat32(const std::vector<const float*>& inputDataPtrs,
                           const std::vector<Shape>& inputShapes, int32_t axis,
@@ -209,6 +235,10 @@ bool subFloat32(const float* in1, const Shape& shape1,
                 const float* in2, const Shape& shape2,
                 int32_t activation,
                 float* out, const Shape& shapeOut);
+bool subQuant8(const uint8_t* in1, const Shape& shape1,
+               const uint8_t* in2, const Shape& shape2,
+               int32_t activation,
+               uint8_t* out, const Shape& shapeOut);
 
 bool squeezeGeneric(const void* inputData, const Shape& inputShape,
                     void* outputData, const Shape& outputShape);
@@ -217,6 +247,10 @@ bool divFloat32(const float* in1, const Shape& shape1,
                 const float* in2, const Shape& shape2,
                 int32_t activation,
                 float* out, const Shape& shapeOut);
+bool divQuant8(const uint8_t* in1, const Shape& shape1,
+               const uint8_t* in2, const Shape& shape2,
+               int32_t activation,
+               uint8_t* out, const Shape& shapeOut);
 
 bool transposeGeneric(const uint8_t* inputData, const Shape& inputShape,
                       const int32_t* perm, const Shape& permShape,
@@ -224,7 +258,11 @@ bool transposeGeneric(const uint8_t* inputData, const Shape& inputShape,
 
 bool meanGeneric(const uint8_t* inputData, const Shape& inputShape,
                  const int32_t* axis, const Shape& axisShape, bool keepDims,
-                 uint8_t* outputData, const Shape& outputShape);
+                 uint8_t* outputData, const Shape& outputShape,
+                 ScratchArena* scratch);
+// Returns the size of the buffer meanGeneric takes from the scratch arena.
+uint64_t getMeanScratchByteSize(const Shape& inputShape, const Shape& axisShape,
+                                const Shape& outputShape);
 
 bool stridedSliceGeneric(const uint8_t* inputData, const Shape& inputShape,
                          const int32_t* beginData, const int32_t* endData,
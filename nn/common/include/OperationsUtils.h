@@ -67,6 +67,12 @@ uint32_t getNumberOfDimensions(const Shape& shape);
 
 uint32_t getSizeOfDimension(const Shape& shape, uint32_t dimensionIdx);
 
+// Returns the number of OpenMP threads among which to split the workItems
+// independent items of an operation doing work units of work in all, such
+// that each thread gets at least minWorkPerThread units.  Returns 1 when the
+// work is too small to be worth splitting.
+int getOpenMPThreadCount(uint64_t workItems, uint64_t work, uint64_t minWorkPerThread);
+
 inline uint32_t computeOutSize(uint32_t imageSize, uint32_t filterSize, uint32_t stride,
                                uint32_t paddingHead, uint32_t paddingTail) {
     return (imageSize - filterSize + stride + paddingHead + paddingTail) / stride;
@@ -89,6 +95,40 @@ bool GetQuantizedConvolutionMultipler(const Shape& inputShape,
                                       const Shape& outputShape,
                                       float* multiplier);
 
+// The multiplier that quantized convolutions and fully connected layers
+// apply to their accumulators, in the fixed-point form of
+// QuantizeMultiplierSmallerThanOne().
+struct QuantizedMultiplier {
+    int32_t multiplier = 0;
+    int32_t shift = 0;
+};
+
+// Computes the output multiplier from the scales of the operands.  It does
+// not depend on the dimensions, so it can be computed once per model.
+__wur
+bool GetQuantizedConvolutionOutputMultiplier(const Shape& inputShape,
+                                             const Shape& filterShape,
+                                             const Shape& biasShape,
+                                             const Shape& outputShape,
+                                             QuantizedMultiplier* multiplier);
+
+// The IEEE half-precision float in which the constant weights of a model
+// whose float32 computations are relaxed to float16 may be stored, on the
+// targets where the compiler has such a type.  Arithmetic on it is done in
+// float32.
+#if defined(__ARM_FP16_FORMAT_IEEE)
+#define NN_HAS_FLOAT16 1
+typedef __fp16 Float16;
+#elif defined(__FLT16_MAX__)
+#define NN_HAS_FLOAT16 1
+typedef _Float16 Float16;
+#else
+#define NN_HAS_FLOAT16 0
+#endif
+
+// The largest finite IEEE half-precision float.
+const float kFloat16Max = 65504.0f;
+
 void CalculateActivationRangeUint8(int32_t activation,
                                    const Shape& outputShape,
                                    int32_t* act_min,
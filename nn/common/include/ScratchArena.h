@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_ML_NN_COMMON_SCRATCH_ARENA_H
+#define ANDROID_ML_NN_COMMON_SCRATCH_ARENA_H
+
+#include <android-base/macros.h>
+#include <stddef.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace gemmlowp {
+class GemmContext;
+}  // namespace gemmlowp
+
+namespace android {
+namespace nn {
+
+// Alignment of the memory handed out by a ScratchArena.
+constexpr uint32_t kScratchArenaAlignment = 64;
+
+// Working memory and non-threadsafe library state used by the operation
+// kernels of a single execution.
+//
+// Some kernels need a large scratch buffer (e.g. the im2col buffer of
+// CONV_2D) or a gemmlowp::GemmContext, neither of which may be used by two
+// computations at the same time.  Instead of sharing process-wide instances
+// behind a lock, every execution uses its own arena, so that independent
+// executions can run these kernels concurrently.
+//
+// The arena should be reserved at preparation time to the size reported by
+// CpuExecutor::getScratchSizeRequirement() for the model.  If a kernel needs
+// more (e.g. because some dimensions were only known at execution time), the
+// arena grows and keeps the larger buffer for later executions.
+class ScratchArena {
+    DISALLOW_COPY_AND_ASSIGN(ScratchArena);
+public:
+    ScratchArena();
+    ~ScratchArena();
+
+    // Makes sure the scratch buffer holds at least size bytes.
+    // Returns false if the memory could not be allocated.
+    bool reserve(size_t size);
+
+    // Returns a scratch buffer of at least size bytes, or nullptr if the
+    // memory could not be allocated.  The buffer is only valid until the next
+    // call to reserve() or getBuffer(), and its content is undefined.
+    uint8_t* getBuffer(size_t size);
+
+    size_t getSize() const { return mScratch.size; }
+
+    // Returns a buffer of at least size bytes to hold the temporaries of a
+    // model, laid out by a TemporaryMemoryPlan, or nullptr if the memory could
+    // not be allocated.  Unlike the scratch buffer, kernels never reallocate
+    // it: it stays valid until the next call to getTemporariesBuffer().
+    uint8_t* getTemporariesBuffer(size_t size);
+
+    // Returns the gemmlowp context to use for quantized matrix products.
+    gemmlowp::GemmContext* getGemmContext();
+
+    // Limits the number of threads gemmlowp may use for one matrix product,
+    // e.g. when several operations run concurrently.  0 lets gemmlowp decide.
+    void setMaxNumThreads(int maxNumThreads);
+
+private:
+    // A buffer aligned to kScratchArenaAlignment that only ever grows.
+    struct Region {
+        bool reserve(size_t size);
+        std::unique_ptr<uint8_t[]> allocation;
+        uint8_t* buffer = nullptr;
+        size_t size = 0;
+    };
+
+    Region mScratch;
+    Region mTemporaries;
+    std::unique_ptr<gemmlowp::GemmContext> mGemmContext;
+    int mMaxNumThreads = 0;
+};
+
+// A set of arenas shared by all the executions of one prepared model.
+//
+// Each execution borrows an arena for its whole duration, so concurrent
+// executions never share one.  Arenas are only created when all the existing
+// ones are in use, and are kept for reuse by later executions, so that in the
+// steady state an execution does not allocate any scratch memory.
+class ScratchArenaPool {
+    DISALLOW_COPY_AND_ASSIGN(ScratchArenaPool);
+public:
+    ScratchArenaPool() {}
+
+    // Sets the sizes new arenas reserve for the scratch buffer and for the
+    // temporaries, and creates a first arena so that the first execution does
+    // not have to.  Meant to be called when the model is prepared.  Returns
+    // false if the memory could not be allocated.
+    bool initialize(size_t scratchSize, size_t temporariesSize);
+
+    // Returns an arena for the exclusive use of the caller.  Never nullptr.
+    // An arena created by this call only reserves the memory of the
+    // temporaries when it is first asked for, as arenas used to run
+    // operations concurrently with the main one of an execution never are.
+    std::unique_ptr<ScratchArena> acquire();
+
+    // Returns an arena obtained by acquire() to the pool.
+    void release(std::unique_ptr<ScratchArena> arena);
+
+private:
+    // Creates an arena with the scratch memory reserved, and the memory of
+    // the temporaries too if reserveTemporaries is true.
+    std::unique_ptr<ScratchArena> create(bool reserveTemporaries, bool* fail) const;
+
+    std::mutex mMutex;
+    size_t mScratchSize = 0;
+    size_t mTemporariesSize = 0;
+    std::vector<std::unique_ptr<ScratchArena>> mAvailable;
+};
+
+}  // namespace nn
+}  // namespace android
+
+#endif  // ANDROID_ML_NN_COMMON_SCRATCH_ARENA_H
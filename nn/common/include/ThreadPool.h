@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_ML_NN_COMMON_THREAD_POOL_H
+#define ANDROID_ML_NN_COMMON_THREAD_POOL_H
+
+#include <android-base/macros.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace nn {
+
+// A fixed set of worker threads running tasks from a queue.
+//
+// Used to run asynchronous executions without paying for the creation and
+// teardown of a thread per execution.
+//
+// A task may itself wait for other tasks (e.g. a partitioned execution waits
+// for each of its steps).  To keep such a task from waiting for tasks queued
+// behind it, schedule() runs the task on the calling thread when called from
+// a worker of the same pool.
+//
+// Other threads never run the tasks they schedule: they may be application
+// threads that expect to return at once, e.g. from startCompute.  When the
+// queue is full, they wait for a worker to take a task off it instead, which
+// bounds the work the application can queue up.  The workers never wait for
+// room, since the tasks ahead of theirs may be waiting for them; they run the
+// task themselves instead.
+class ThreadPool {
+    DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+public:
+    // numThreads
+    //     The number of worker threads, or 0 for one per CPU core.
+    // maxQueueDepth
+    //     The largest number of tasks waiting for a worker, at least 1.  When
+    //     that many are queued, tasks scheduled by the workers run inline, and
+    //     other threads wait for room.
+    ThreadPool(uint32_t numThreads, uint32_t maxQueueDepth);
+
+    // Waits for the queued tasks to complete, then joins the workers.
+    ~ThreadPool();
+
+    // Runs task on a worker thread, or on the calling thread before
+    // returning, as explained above.  May wait for room in the queue when
+    // not called from a worker.  The task must not throw.
+    void schedule(std::function<void()> task);
+
+    // Same as schedule(), except that the task is queued even when called
+    // from a worker of this pool, unless the queue is full, in which case
+    // the worker runs it before returning.  Other threads wait for room in
+    // the queue, as with schedule().  Only for tasks
+    // that never wait for other tasks of the pool, e.g. to let a task start
+    // several others that run at the same time.
+    void scheduleNonBlocking(std::function<void()> task);
+
+    // Returns true if called from one of the workers of this pool.
+    bool isWorkerThread() const;
+
+    uint32_t getNumThreads() const { return mWorkers.size(); }
+    uint32_t getMaxQueueDepth() const { return mMaxQueueDepth; }
+
+    // Returns the pool shared by the runtime and the drivers of the process.
+    // On debuggable builds, its size and queue depth can be set through the
+    // system properties debug.nn.threadpool.size and
+    // debug.nn.threadpool.queuedepth.
+    static ThreadPool* get();
+
+private:
+    struct Task {
+        std::function<void()> function;
+        std::chrono::steady_clock::time_point queuedTime;
+    };
+
+    // Queues the task and returns true.  When the queue is full, waits for
+    // room if canWait, and otherwise returns false.
+    bool enqueue(std::function<void()>* task, bool canWait);
+    void workerLoop();
+
+    const uint32_t mMaxQueueDepth;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::condition_variable mNotFullCondition;
+    std::deque<Task> mQueue;  // protected by mMutex
+    bool mStopping = false;   // protected by mMutex
+    std::vector<std::thread> mWorkers;
+};
+
+}  // namespace nn
+}  // namespace android
+
+#endif  // ANDROID_ML_NN_COMMON_THREAD_POOL_H
@@ -121,6 +121,13 @@
 #define NNTRACE_FULL_RAW(layer, phase, detail) android::ScopedTrace PASTE(___tracer, __LINE__) \
         (ATRACE_TAG, ("[NN_" layer "_" phase "]" detail))
 
+// Counter macro, for values sampled over time rather than timed scopes (e.g.,
+// how long a task waited in a queue). Arguments:
+// - layer: one of the NNTRACE_LAYER_* macros defined below.
+// - detail: free-form string constant naming the counter.
+// - value: integer value of the counter.
+#define NNTRACE_COUNTER(layer, detail, value) ATRACE_INT64(("[NN_" layer "]" detail), value)
+
 // Tracing buckets - for calculating timing summaries over.
 //
 // Phases
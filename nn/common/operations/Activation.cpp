@@ -19,58 +19,83 @@
 
 #include "tensorflow/contrib/lite/kernels/internal/optimized/optimized_ops.h"
 
+#include "Eigen/Core"
+
 #include "Tracing.h"
 
 namespace android {
 namespace nn {
 
+namespace {
+
+using FloatArray = Eigen::Map<Eigen::ArrayXf>;
+using ConstFloatArray = Eigen::Map<const Eigen::ArrayXf>;
+
+// Below this many elements per thread, splitting an activation between
+// threads costs more than it saves.
+const int kMinElementsPerThread = 16 * 1024;
+
+// Applies the activation to the elements of inputData, writing the results
+// to outputData.  The activation is computed with Eigen, which vectorizes it
+// for the instruction set the library is built for.  Large tensors are split
+// between the OpenMP threads.
+template <typename Activation>
+void applyFloat32(const float* inputData, float* outputData, int numElements,
+                  Activation activation) {
+    const int numThreads = getOpenMPThreadCount(numElements, numElements, kMinElementsPerThread);
+    if (numThreads <= 1) {
+        FloatArray(outputData, numElements) =
+                activation(ConstFloatArray(inputData, numElements));
+        return;
+    }
+#pragma omp parallel for num_threads(numThreads)
+    for (int thread = 0; thread < numThreads; thread++) {
+        const int begin = static_cast<int64_t>(numElements) * thread / numThreads;
+        const int end = static_cast<int64_t>(numElements) * (thread + 1) / numThreads;
+        FloatArray(outputData + begin, end - begin) =
+                activation(ConstFloatArray(inputData + begin, end - begin));
+    }
+}
+
+}  // namespace
+
 bool reluFloat32(const float* inputData, const Shape& inputShape,
                  float* outputData, const Shape& outputShape) {
     NNTRACE_COMP("reluFloat32");
-    int numElements = getNumberOfElements(inputShape);
-    for (int i=0; i<numElements; i++, inputData++, outputData++) {
-        *outputData = std::max(0.f, *inputData);
-    }
+    applyFloat32(inputData, outputData, getNumberOfElements(inputShape),
+                 [](const ConstFloatArray& x) { return x.max(0.f); });
     return true;
 }
 
 bool relu1Float32(const float* inputData, const Shape& inputShape,
                   float* outputData, const Shape& outputShape) {
     NNTRACE_COMP("relu1Float32");
-    int numElements = getNumberOfElements(inputShape);
-    for (int i=0; i<numElements; i++, inputData++, outputData++) {
-        *outputData = std::min(std::max(-1.f, *inputData), 1.f);
-    }
+    applyFloat32(inputData, outputData, getNumberOfElements(inputShape),
+                 [](const ConstFloatArray& x) { return x.max(-1.f).min(1.f); });
     return true;
 }
 
 bool relu6Float32(const float* inputData, const Shape& inputShape,
                   float* outputData, const Shape& outputShape) {
     NNTRACE_COMP("relu6Float32");
-    int numElements = getNumberOfElements(inputShape);
-    for (int i=0; i<numElements; i++, inputData++, outputData++) {
-        *outputData = std::min(std::max(0.f, *inputData), 6.f);
-    }
+    applyFloat32(inputData, outputData, getNumberOfElements(inputShape),
+                 [](const ConstFloatArray& x) { return x.max(0.f).min(6.f); });
     return true;
 }
 
 bool tanhFloat32(const float* inputData, const Shape& inputShape,
                  float* outputData, const Shape& outputShape) {
     NNTRACE_COMP("tanhFloat32");
-    int numElements = getNumberOfElements(inputShape);
-    for (int i=0; i<numElements; i++, inputData++, outputData++) {
-        *outputData = std::tanh(*inputData);
-    }
+    applyFloat32(inputData, outputData, getNumberOfElements(inputShape),
+                 [](const ConstFloatArray& x) { return x.tanh(); });
     return true;
 }
 
 bool logisticFloat32(const float* inputData, const Shape& inputShape,
                      float* outputData, const Shape& outputShape) {
     NNTRACE_COMP("logisticFloat32");
-    int numElements = getNumberOfElements(inputShape);
-    for (int i=0; i<numElements; i++, inputData++, outputData++) {
-        *outputData = 1.f / (1.f + std::exp(-*inputData));
-    }
+    applyFloat32(inputData, outputData, getNumberOfElements(inputShape),
+                 [](const ConstFloatArray& x) { return x.logistic(); });
     return true;
 }
 
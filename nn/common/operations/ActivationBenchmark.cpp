@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares the float activation kernels with the per-element loops they
+// replaced.
+
+#include "Operations.h"
+#include "OperationsUtils.h"
+
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <vector>
+
+namespace android {
+namespace nn {
+namespace {
+
+using Kernel = bool (*)(const float*, const Shape&, float*, const Shape&);
+
+bool scalarRelu(const float* inputData, const Shape& inputShape,
+                float* outputData, const Shape& outputShape) {
+    int numElements = getNumberOfElements(inputShape);
+    for (int i = 0; i < numElements; i++, inputData++, outputData++) {
+        *outputData = std::max(0.f, *inputData);
+    }
+    return true;
+}
+
+bool scalarRelu6(const float* inputData, const Shape& inputShape,
+                 float* outputData, const Shape& outputShape) {
+    int numElements = getNumberOfElements(inputShape);
+    for (int i = 0; i < numElements; i++, inputData++, outputData++) {
+        *outputData = std::min(std::max(0.f, *inputData), 6.f);
+    }
+    return true;
+}
+
+bool scalarTanh(const float* inputData, const Shape& inputShape,
+                float* outputData, const Shape& outputShape) {
+    int numElements = getNumberOfElements(inputShape);
+    for (int i = 0; i < numElements; i++, inputData++, outputData++) {
+        *outputData = std::tanh(*inputData);
+    }
+    return true;
+}
+
+bool scalarLogistic(const float* inputData, const Shape& inputShape,
+                    float* outputData, const Shape& outputShape) {
+    int numElements = getNumberOfElements(inputShape);
+    for (int i = 0; i < numElements; i++, inputData++, outputData++) {
+        *outputData = 1.f / (1.f + std::exp(-*inputData));
+    }
+    return true;
+}
+
+// Runs the kernel on a {1, state.range(0)} tensor of values in [-8, 8].
+void runActivation(benchmark::State& state, Kernel kernel) {
+    const uint32_t size = state.range(0);
+    const Shape shape = {.type = OperandType::TENSOR_FLOAT32, .dimensions = {1, size}};
+    std::vector<float> input(size);
+    std::vector<float> output(size);
+    for (uint32_t i = 0; i < size; i++) {
+        input[i] = 16.f * i / size - 8.f;
+    }
+    for (auto _ : state) {
+        kernel(input.data(), shape, output.data(), shape);
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+}
+
+#define ANDROID_NN_ACTIVATION_BENCHMARK(name, kernel) \
+    void BM_##name(benchmark::State& state) { runActivation(state, kernel); } \
+    BENCHMARK(BM_##name)->Arg(1 << 10)->Arg(1 << 14)->Arg(1 << 18)->Arg(1 << 22)
+
+ANDROID_NN_ACTIVATION_BENCHMARK(ScalarRelu, scalarRelu);
+ANDROID_NN_ACTIVATION_BENCHMARK(Relu, reluFloat32);
+ANDROID_NN_ACTIVATION_BENCHMARK(ScalarRelu6, scalarRelu6);
+ANDROID_NN_ACTIVATION_BENCHMARK(Relu6, relu6Float32);
+ANDROID_NN_ACTIVATION_BENCHMARK(ScalarTanh, scalarTanh);
+ANDROID_NN_ACTIVATION_BENCHMARK(Tanh, tanhFloat32);
+ANDROID_NN_ACTIVATION_BENCHMARK(ScalarLogistic, scalarLogistic);
+ANDROID_NN_ACTIVATION_BENCHMARK(Logistic, logisticFloat32);
+
+#undef ANDROID_NN_ACTIVATION_BENCHMARK
+
+}  // namespace
+}  // namespace nn
+}  // namespace android
+
+BENCHMARK_MAIN();
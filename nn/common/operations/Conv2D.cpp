@@ -16,6 +16,7 @@
 
 #include "Operations.h"
 #include "CpuOperationUtils.h"
+#include "ScratchArena.h"
 
 #include "tensorflow/contrib/lite/kernels/internal/optimized/optimized_ops.h"
 
@@ -24,14 +25,13 @@
 namespace android {
 namespace nn {
 
-// If possible we will use this static buffer for the tensor.
-static constexpr size_t kStaticBufferSize = 1605632;
-static char static_scratch_buffer[kStaticBufferSize];
-
-// executionMutex is used to protect concurrent access of the static_scratch_buffer
-// and other non-threadsafe resources like gemmlowp::GemmContext.
-// std::mutex is safe for pthreads on Android.
-static std::mutex executionMutex;
+uint64_t getConvIm2colByteSize(const Shape& inputShape, const Shape& filterShape,
+                               const Shape& outputShape) {
+    return static_cast<uint64_t>(sizeOfData(inputShape.type, {})) *
+           getSizeOfDimension(outputShape, 0) * getSizeOfDimension(outputShape, 1) *
+           getSizeOfDimension(outputShape, 2) * getSizeOfDimension(inputShape, 3) *
+           getSizeOfDimension(filterShape, 1) * getSizeOfDimension(filterShape, 2);
+}
 
 #define ANDROID_NN_CONV_PARAMETERS(Type)                                        \
     uint32_t height       = getSizeOfDimension(inputShape, 1);                  \
@@ -56,26 +56,19 @@ static std::mutex executionMutex;
         im2colDim.strides[i] = im2colDim.strides[i-1] * im2colDim.sizes[i-1];   \
     }                                                                           \
                                                                                 \
-    Type* im2colData = nullptr;                                                 \
-    uint64_t im2colByteSize = sizeof(Type);                                     \
-    std::unique_ptr<Type[]> im2colGuard;                                        \
-    for (int i=0; i<4; i++) {                                                   \
-        im2colByteSize *= im2colDim.sizes[i];                                   \
-    }                                                                           \
+    uint64_t im2colByteSize = getConvIm2colByteSize(inputShape, filterShape,    \
+                                                    outputShape);               \
     /* http://b/77982879, tflite::optimized_ops::Conv uses int for offsets */   \
     if (im2colByteSize >= 0x7fffffff)  {                                        \
         LOG(ERROR) << "Conv size is too large, not enough memory";              \
         return false;                                                           \
     }                                                                           \
-    if (im2colByteSize <= kStaticBufferSize) {                                  \
-        im2colData = reinterpret_cast<Type *>(static_scratch_buffer);           \
-    } else {                                                                    \
-        im2colData = new (std::nothrow) Type[im2colByteSize / sizeof(Type)];    \
-        if (im2colData == nullptr) {                                            \
-            LOG(ERROR) << "Conv size is too large, not enough memory";          \
-            return false;                                                       \
-        }                                                                       \
-        im2colGuard.reset(im2colData);                                          \
+    /* The arena is owned by this execution, so no locking is needed. */        \
+    Type* im2colData =                                                          \
+            reinterpret_cast<Type*>(scratch->getBuffer(im2colByteSize));        \
+    if (im2colData == nullptr) {                                                \
+        LOG(ERROR) << "Conv size is too large, not enough memory";              \
+        return false;                                                           \
     }
 
 bool convFloat32(const float* inputData, const Shape& inputShape,
@@ -85,7 +78,8 @@ bool convFloat32(const float* inputData, const Shape& inputShape,
                  int32_t padding_top, int32_t padding_bottom,
                  int32_t stride_width, int32_t stride_height,
                  int32_t activation,
-                 float* outputData, const Shape& outputShape) {
+                 float* outputData, const Shape& outputShape,
+                 ScratchArena* scratch) {
     NNTRACE_TRANS("convFloat32");
 
     ANDROID_NN_CONV_PARAMETERS(float)
@@ -96,8 +90,6 @@ bool convFloat32(const float* inputData, const Shape& inputShape,
 
     int32_t dilationWidthFactor = 1, dilationHeightFactor = 1;
 
-    // Prevent concurrent executions that may access the scratch buffer.
-    std::unique_lock<std::mutex> lock(executionMutex);
     NNTRACE_COMP_SWITCH("optimized_ops::Conv");
     tflite::optimized_ops::Conv(
             inputData, convertShapeToDims(inputShape),
@@ -119,7 +111,9 @@ bool convQuant8(const uint8_t* inputData, const Shape& inputShape,
                 int32_t padding_top, int32_t padding_bottom,
                 int32_t stride_width, int32_t stride_height,
                 int32_t activation,
-                uint8_t* outputData, const Shape& outputShape) {
+                uint8_t* outputData, const Shape& outputShape,
+                const QuantizedMultiplier* outputMultiplier,
+                ScratchArena* scratch) {
     NNTRACE_TRANS("convQuant8");
 
     ANDROID_NN_CONV_PARAMETERS(uint8_t)
@@ -128,40 +122,31 @@ bool convQuant8(const uint8_t* inputData, const Shape& inputShape,
     int32_t filterOffset = -filterShape.offset;
     int32_t outputOffset = outputShape.offset;
 
-    float real_multiplier = 0.0;
-    int32_t output_multiplier = 0;
-    int32_t output_shift = 0;
+    QuantizedMultiplier computedMultiplier;
     int32_t output_activation_min = 0;
     int32_t output_activation_max = 0;
 
-    if (!GetQuantizedConvolutionMultipler(inputShape, filterShape, biasShape,
-                                          outputShape, &real_multiplier) ||
-            !QuantizeMultiplierSmallerThanOne(real_multiplier, &output_multiplier,
-                                              &output_shift)){
-        return false;
+    if (outputMultiplier == nullptr) {
+        if (!GetQuantizedConvolutionOutputMultiplier(inputShape, filterShape, biasShape,
+                                                     outputShape, &computedMultiplier)) {
+            return false;
+        }
+        outputMultiplier = &computedMultiplier;
     }
     CalculateActivationRangeUint8(activation, outputShape,
                                   &output_activation_min,
                                   &output_activation_max);
 
-    static gemmlowp::GemmContext gemm_context;
-
-    // Prevent concurrent executions that may access the scratch buffer and
-    // gemm_context.
-    std::unique_lock<std::mutex> lock(executionMutex);
-    // Alow gemmlowp automatically decide how many threads to use.
-    gemm_context.set_max_num_threads(0);
-
     NNTRACE_COMP_SWITCH("optimized_ops::Conv");
     tflite::optimized_ops::Conv(
             inputData, convertShapeToDims(inputShape), inputOffset,
             filterData, convertShapeToDims(filterShape), filterOffset,
             biasData, convertShapeToDims(biasShape),
             stride_width, stride_height, paddingWidth, paddingHeight,
-            outputOffset, output_multiplier, output_shift,
+            outputOffset, outputMultiplier->multiplier, outputMultiplier->shift,
             output_activation_min, output_activation_max,
             outputData, convertShapeToDims(outputShape),
-            im2colData, im2colDim, &gemm_context);
+            im2colData, im2colDim, scratch->getGemmContext());
     return true;
 }
 
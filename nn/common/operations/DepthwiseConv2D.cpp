@@ -73,23 +73,22 @@ bool depthwiseConvQuant8(const uint8_t* inputData, const Shape& inputShape,
                          int32_t padding_top, int32_t padding_bottom,
                          int32_t stride_width, int32_t stride_height,
                          int32_t depth_multiplier, int32_t activation,
-                         uint8_t* outputData, const Shape& outputShape) {
+                         uint8_t* outputData, const Shape& outputShape,
+                         const QuantizedMultiplier* outputMultiplier) {
     NNTRACE_TRANS("depthwiseConvQuant8");
 
     ANDROID_NN_DEPTHWISE_CONV_PARAMETERS
 
-    float real_multiplier = 0.0;
-    int32_t output_multiplier = 0;
-    int32_t output_shift = 0;
+    QuantizedMultiplier computedMultiplier;
     int32_t output_activation_min = 0;
     int32_t output_activation_max = 0;
 
-
-    if (!GetQuantizedConvolutionMultipler(inputShape, filterShape, biasShape,
-                                          outputShape, &real_multiplier) ||
-            !QuantizeMultiplierSmallerThanOne(real_multiplier, &output_multiplier,
-                                              &output_shift)) {
-        return false;
+    if (outputMultiplier == nullptr) {
+        if (!GetQuantizedConvolutionOutputMultiplier(inputShape, filterShape, biasShape,
+                                                     outputShape, &computedMultiplier)) {
+            return false;
+        }
+        outputMultiplier = &computedMultiplier;
     }
     CalculateActivationRangeUint8(activation, outputShape,
                                   &output_activation_min,
@@ -106,7 +105,7 @@ bool depthwiseConvQuant8(const uint8_t* inputData, const Shape& inputShape,
             biasData, convertShapeToDims(biasShape),
             stride_width, stride_height,
             paddingWidth, paddingHeight, depth_multiplier,
-            outputOffset, output_multiplier, output_shift,
+            outputOffset, outputMultiplier->multiplier, outputMultiplier->shift,
             output_activation_min, output_activation_max,
             outputData, convertShapeToDims(outputShape));
 
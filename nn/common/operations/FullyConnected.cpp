@@ -16,20 +16,18 @@
 
 #include "Operations.h"
 #include "CpuOperationUtils.h"
+#include "ScratchArena.h"
 
 #include "tensorflow/contrib/lite/kernels/internal/optimized/optimized_ops.h"
 #include "tensorflow/contrib/lite/kernels/internal/reference/reference_ops.h"
 
+#include "Eigen/Core"
+
 #include "Tracing.h"
 
 namespace android {
 namespace nn {
 
-// executionMutex is used to protect concurrent access of non-threadsafe resources
-// like gemmlowp::GemmContext.
-// std::mutex is safe for pthreads on Android.
-static std::mutex executionMutex;
-
 bool fullyConnectedFloat32(const float* inputData, const Shape& inputShape,
                            const float* weightsData, const Shape& weightsShape,
                            const float* biasData, const Shape& biasShape,
@@ -64,47 +62,95 @@ bool fullyConnectedFloat32(const float* inputData, const Shape& inputShape,
     return true;
 }
 
+#if NN_HAS_FLOAT16
+namespace {
+
+// Below this many multiplications per thread, splitting a fully connected
+// layer between threads costs more than it saves.
+const uint64_t kMinMultiplicationsPerThread = 64 * 1024;
+
+}  // namespace
+
+bool fullyConnectedFloat32WithFloat16Weights(const float* inputData, const Shape& inputShape,
+                                             const Float16* weightsData,
+                                             const Shape& weightsShape,
+                                             const float* biasData, const Shape& biasShape,
+                                             int32_t activation,
+                                             float* outputData, const Shape& outputShape) {
+    NNTRACE_COMP("fullyConnectedFloat32WithFloat16Weights");
+    float output_activation_min, output_activation_max;
+    CalculateActivationRangeFloat(activation, &output_activation_min,
+                                  &output_activation_max);
+
+    const uint32_t batchSize = getSizeOfDimension(outputShape, 0);
+    const uint32_t numUnits = getSizeOfDimension(weightsShape, 0);
+    const uint32_t inputSize = getSizeOfDimension(weightsShape, 1);
+    const int numThreads = getOpenMPThreadCount(
+            numUnits, static_cast<uint64_t>(batchSize) * numUnits * inputSize,
+            kMinMultiplicationsPerThread);
+
+    // Each thread converts the weights of one unit at a time to float32, and
+    // multiplies them with the input of every batch.  The weights are thus
+    // read once, at half the size of float32 weights.
+#pragma omp parallel num_threads(numThreads) if (numThreads > 1)
+    {
+        std::vector<float> unitWeights(inputSize);
+#pragma omp for
+        for (int32_t unit = 0; unit < static_cast<int32_t>(numUnits); unit++) {
+            const Float16* weights = weightsData + static_cast<size_t>(unit) * inputSize;
+            for (uint32_t i = 0; i < inputSize; i++) {
+                unitWeights[i] = static_cast<float>(weights[i]);
+            }
+            Eigen::Map<const Eigen::VectorXf> unitVector(unitWeights.data(), inputSize);
+            for (uint32_t b = 0; b < batchSize; b++) {
+                Eigen::Map<const Eigen::VectorXf> input(
+                        inputData + static_cast<size_t>(b) * inputSize, inputSize);
+                const float sum = unitVector.dot(input) + biasData[unit];
+                outputData[static_cast<size_t>(b) * numUnits + unit] =
+                        std::min(std::max(sum, output_activation_min), output_activation_max);
+            }
+        }
+    }
+    return true;
+}
+#endif
+
 bool fullyConnectedQuant8(const uint8_t* inputData, const Shape& inputShape,
                           const uint8_t* weightsData, const Shape& weightsShape,
                           const int32_t* biasData, const Shape& biasShape,
                           int32_t activation,
-                          uint8_t* outputData, const Shape& outputShape) {
+                          uint8_t* outputData, const Shape& outputShape,
+                          const QuantizedMultiplier* outputMultiplier,
+                          ScratchArena* scratch) {
     NNTRACE_TRANS("fullyConnectedQuant8");
     int32_t inputOffset = -inputShape.offset;
     int32_t weightsOffset = -weightsShape.offset;
     int32_t outputOffset = outputShape.offset;
 
-    float real_multiplier = 0.0;
-    int32_t output_multiplier = 0;
-    int32_t output_shift = 0;
+    QuantizedMultiplier computedMultiplier;
     int32_t output_activation_min = 0;
     int32_t output_activation_max = 0;
 
-    if (!GetQuantizedConvolutionMultipler(inputShape, weightsShape, biasShape,
-                                          outputShape, &real_multiplier) ||
-            !QuantizeMultiplierSmallerThanOne(real_multiplier, &output_multiplier,
-                                              &output_shift)) {
-        return false;
+    if (outputMultiplier == nullptr) {
+        if (!GetQuantizedConvolutionOutputMultiplier(inputShape, weightsShape, biasShape,
+                                                     outputShape, &computedMultiplier)) {
+            return false;
+        }
+        outputMultiplier = &computedMultiplier;
     }
     CalculateActivationRangeUint8(activation, outputShape,
                                   &output_activation_min,
                                   &output_activation_max);
 
-    static gemmlowp::GemmContext gemm_context;
-
-    // Prevent concurrent executions that access gemm_context.
-    std::unique_lock<std::mutex> lock(executionMutex);
-    // Alow gemmlowp automatically decide how many threads to use.
-    gemm_context.set_max_num_threads(0);
-
     NNTRACE_COMP_SWITCH("optimized_ops::FullyConnected");
     tflite::optimized_ops::FullyConnected(
             inputData, convertShapeToDims(inputShape), inputOffset,
             weightsData, convertShapeToDims(weightsShape), weightsOffset,
             biasData, convertShapeToDims(biasShape),
-            outputOffset, output_multiplier, output_shift,
+            outputOffset, outputMultiplier->multiplier, outputMultiplier->shift,
             output_activation_min, output_activation_max,
-            outputData, convertShapeToDims(outputShape), &gemm_context);
+            outputData, convertShapeToDims(outputShape),
+            scratch->getGemmContext());
 
     return true;
 }
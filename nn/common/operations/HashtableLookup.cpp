@@ -22,19 +22,48 @@
 
 #include "Tracing.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace android {
 namespace nn {
 
 namespace {
 
-int greater(const void* a, const void* b) {
-  return *static_cast<const int*>(a) - *static_cast<const int*>(b);
+// The lookups are processed by batches of this many: the rows of a batch are
+// found, then prefetched, then copied, so the copies do not wait on memory
+// one row at a time.
+constexpr int kLookupBatchSize = 16;
+
+// Below this many bytes of output per thread, splitting the lookups costs
+// more than it saves.
+constexpr size_t kLookupMinBytesPerThread = 64 * 1024;
+
+int compareKeys(const void* a, const void* b) {
+  const int32_t x = *static_cast<const int32_t*>(a);
+  const int32_t y = *static_cast<const int32_t*>(b);
+  return (x > y) - (x < y);
+}
+
+uint32_t hashKey(int32_t key, int shift) {
+  // Fibonacci hashing: the high bits of the product are well mixed even for
+  // consecutive keys.
+  return (static_cast<uint32_t>(key) * 2654435769u) >> shift;
+}
+
+// The index holds (key, row) pairs in a power-of-two number of slots, at
+// most half full; an empty slot has row -1.
+int getIndexShift(const std::vector<int32_t>& index) {
+  const uint32_t num_slots = index.size() / 2;
+  return 32 - __builtin_ctz(num_slots);
 }
 
 }  // anonymous namespace
 
 HashtableLookup::HashtableLookup(const Operation& operation,
-                                 std::vector<RunTimeOperandInfo>& operands) {
+                                 std::vector<RunTimeOperandInfo>& operands,
+                                 const std::vector<int32_t>* index)
+    : index_(index) {
   lookup_ = GetInput(operation, operands, kLookupTensor);
   key_ = GetInput(operation, operands, kKeyTensor);
   value_ = GetInput(operation, operands, kValueTensor);
@@ -43,28 +72,83 @@ HashtableLookup::HashtableLookup(const Operation& operation,
   hits_ = GetOutput(operation, operands, kHitsTensor);
 }
 
+void HashtableLookup::BuildIndex(const int32_t* keys, int num_keys,
+                                 std::vector<int32_t>* index) {
+  uint32_t num_slots = 2;
+  while (num_slots < 2 * static_cast<uint32_t>(num_keys)) {
+    num_slots *= 2;
+  }
+  index->assign(2 * num_slots, -1);
+  const int shift = getIndexShift(*index);
+  const uint32_t mask = num_slots - 1;
+  for (int row = 0; row < num_keys; row++) {
+    uint32_t slot = hashKey(keys[row], shift);
+    while ((*index)[2 * slot + 1] >= 0 && (*index)[2 * slot] != keys[row]) {
+      slot = (slot + 1) & mask;
+    }
+    if ((*index)[2 * slot + 1] < 0) {
+      (*index)[2 * slot] = keys[row];
+      (*index)[2 * slot + 1] = row;
+    }
+  }
+}
+
+int HashtableLookup::FindRow(int32_t key) const {
+  if (index_ == nullptr) {
+    const int32_t* keys = reinterpret_cast<const int32_t*>(key_->buffer);
+    const void* pointer = bsearch(&key, keys, key_->shape().dimensions[0],
+                                  sizeof(int32_t), compareKeys);
+    if (pointer == nullptr) {
+      return -1;
+    }
+    return static_cast<const int32_t*>(pointer) - keys;
+  }
+  const int32_t* slots = index_->data();
+  const uint32_t mask = index_->size() / 2 - 1;
+  uint32_t slot = hashKey(key, getIndexShift(*index_));
+  while (slots[2 * slot + 1] >= 0) {
+    if (slots[2 * slot] == key) {
+      return slots[2 * slot + 1];
+    }
+    slot = (slot + 1) & mask;
+  }
+  return -1;
+}
+
 bool HashtableLookup::Eval() {
   NNTRACE_COMP("HashtableLookup::Eval");
   const int num_rows = value_->shape().dimensions[0];
-  const int row_bytes = sizeOfData(value_->type, value_->dimensions) / num_rows;
-  void* pointer = nullptr;
-
-  for (int i = 0; i < static_cast<int>(lookup_->shape().dimensions[0]); i++) {
-    int idx = -1;
-    pointer = bsearch(lookup_->buffer + sizeof(int) * i, key_->buffer,
-                      num_rows, sizeof(int), greater);
-    if (pointer != nullptr) {
-      idx =
-          (reinterpret_cast<uint8_t*>(pointer) - key_->buffer) / sizeof(float);
-    }
+  const size_t row_bytes =
+      sizeOfData(value_->type, value_->dimensions) / num_rows;
+  const int num_lookups = lookup_->shape().dimensions[0];
+  const int32_t* lookups = reinterpret_cast<const int32_t*>(lookup_->buffer);
 
-    if (idx >= num_rows || idx < 0) {
-      memset(output_->buffer + i * row_bytes, 0, row_bytes);
-      hits_->buffer[i] = 0;
-    } else {
-      memcpy(output_->buffer + i * row_bytes, value_->buffer + idx * row_bytes,
-             row_bytes);
-      hits_->buffer[i] = 1;
+  const int num_batches =
+      (num_lookups + kLookupBatchSize - 1) / kLookupBatchSize;
+  const int num_threads = getOpenMPThreadCount(
+      num_batches, static_cast<uint64_t>(num_lookups) * row_bytes,
+      kLookupMinBytesPerThread);
+#pragma omp parallel for num_threads(num_threads) if (num_threads > 1)
+  for (int batch = 0; batch < num_batches; batch++) {
+    const int first = batch * kLookupBatchSize;
+    const int count = std::min(kLookupBatchSize, num_lookups - first);
+    int rows[kLookupBatchSize];
+    for (int j = 0; j < count; j++) {
+      rows[j] = FindRow(lookups[first + j]);
+      if (rows[j] >= 0 && rows[j] < num_rows) {
+        __builtin_prefetch(value_->buffer + rows[j] * row_bytes);
+      }
+    }
+    for (int j = 0; j < count; j++) {
+      const int i = first + j;
+      if (rows[j] >= num_rows || rows[j] < 0) {
+        memset(output_->buffer + i * row_bytes, 0, row_bytes);
+        hits_->buffer[i] = 0;
+      } else {
+        memcpy(output_->buffer + i * row_bytes,
+               value_->buffer + rows[j] * row_bytes, row_bytes);
+        hits_->buffer[i] = 1;
+      }
     }
   }
 
@@ -17,6 +17,7 @@
 #ifndef FRAMEWORKS_ML_NN_HASHTABLE_LOOKUP_H
 #define FRAMEWORKS_ML_NN_HASHTABLE_LOOKUP_H
 
+#include <cstdint>
 #include <vector>
 
 namespace android {
@@ -36,12 +37,21 @@ struct RunTimeOperandInfo;
 
 class HashtableLookup {
  public:
+  // If index is not nullptr, it must have been built by BuildIndex() from
+  // the keys of the operation, and is used instead of searching them.
   HashtableLookup(
       const android::hardware::neuralnetworks::V1_1::Operation &operation,
-      std::vector<RunTimeOperandInfo> &operands);
+      std::vector<RunTimeOperandInfo> &operands,
+      const std::vector<int32_t> *index = nullptr);
 
   bool Eval();
 
+  // Builds an open-addressing hash table from the num_keys keys to their
+  // rows, e.g. once for constant keys.  If a key is repeated, its first row
+  // is found.
+  static void BuildIndex(const int32_t *keys, int num_keys,
+                         std::vector<int32_t> *index);
+
   static constexpr int kLookupTensor = 0;
   static constexpr int kKeyTensor = 1;
   static constexpr int kValueTensor = 2;
@@ -50,9 +60,13 @@ class HashtableLookup {
   static constexpr int kHitsTensor = 1;
 
  private:
+  // Returns the row of the key, or -1 if it is not one of the keys.
+  int FindRow(int32_t key) const;
+
   const RunTimeOperandInfo *lookup_;
   const RunTimeOperandInfo *key_;
   const RunTimeOperandInfo *value_;
+  const std::vector<int32_t> *index_;
 
   RunTimeOperandInfo *output_;
   RunTimeOperandInfo *hits_;
@@ -303,7 +303,25 @@ bool LSTMCell::Prepare(const Operation &operation,
 
 bool LSTMCell::Eval() {
   NNTRACE_COMP("LSTMCell::Eval");
+  return EvalImpl(nullptr);
+}
+
+bool LSTMCell::EvalWithProjectedInput(const float* projected_input) {
+  NNTRACE_COMP("LSTMCell::EvalWithProjectedInput");
+  return EvalImpl(projected_input);
+}
 
+void LSTMCell::ProjectInputs(const float* weights, const float* biases, uint32_t n_gate,
+                             uint32_t n_cell, uint32_t n_input, const float* inputs,
+                             uint32_t n_step, uint32_t n_batch, float* result) {
+  NNTRACE_COMP("LSTMCell::ProjectInputs");
+  tflite::tensor_utils::VectorBatchVectorAssign(biases, n_gate * n_cell, n_step * n_batch,
+                                                result);
+  tflite::tensor_utils::MatrixBatchVectorMultiplyAccumulate(
+      weights, n_gate * n_cell, n_input, inputs, n_step * n_batch, result, /*result_stride*/1);
+}
+
+bool LSTMCell::EvalImpl(const float* projected_input) {
   const uint32_t n_batch = input_->shape().dimensions[0];
   const uint32_t n_input = input_->shape().dimensions[1];
   // n_cell and n_output will be the same size when there is no projection.
@@ -331,33 +349,46 @@ bool LSTMCell::Eval() {
     output_gate_scratch = input_gate_scratch + 3 * n_cell * n_batch;
   }
 
-  // Initialize scratch buffers with bias.
-  if (!use_cifg) {
-    tflite::tensor_utils::VectorBatchVectorAssign(GetBuffer<float>(input_gate_bias_),
-                                                  n_cell, n_batch, input_gate_scratch);
-  }
-  tflite::tensor_utils::VectorBatchVectorAssign(GetBuffer<float>(forget_gate_bias_),
-                                                n_cell, n_batch, forget_gate_scratch);
-  tflite::tensor_utils::VectorBatchVectorAssign(GetBuffer<float>(cell_bias_),
-                                                n_cell, n_batch, cell_scratch);
-  tflite::tensor_utils::VectorBatchVectorAssign(GetBuffer<float>(output_gate_bias_),
-                                                n_cell, n_batch, output_gate_scratch);
-
-  // For each batch and cell: compute input_weight * input.
-  if (!use_cifg) {
+  if (projected_input != nullptr) {
+    // Each row holds the gates of a batch, in the order of the scratch
+    // buffer: spread it to the gates.
+    const uint32_t n_gate = use_cifg ? 3 : 4;
+    float* first_gate_scratch = use_cifg ? cell_scratch : input_gate_scratch;
+    for (uint32_t b = 0; b < n_batch; b++) {
+      for (uint32_t g = 0; g < n_gate; g++) {
+        tflite::tensor_utils::CopyVector(projected_input + (b * n_gate + g) * n_cell, n_cell,
+                                         first_gate_scratch + (g * n_batch + b) * n_cell);
+      }
+    }
+  } else {
+    // Initialize scratch buffers with bias.
+    if (!use_cifg) {
+      tflite::tensor_utils::VectorBatchVectorAssign(GetBuffer<float>(input_gate_bias_),
+                                                    n_cell, n_batch, input_gate_scratch);
+    }
+    tflite::tensor_utils::VectorBatchVectorAssign(GetBuffer<float>(forget_gate_bias_),
+                                                  n_cell, n_batch, forget_gate_scratch);
+    tflite::tensor_utils::VectorBatchVectorAssign(GetBuffer<float>(cell_bias_),
+                                                  n_cell, n_batch, cell_scratch);
+    tflite::tensor_utils::VectorBatchVectorAssign(GetBuffer<float>(output_gate_bias_),
+                                                  n_cell, n_batch, output_gate_scratch);
+
+    // For each batch and cell: compute input_weight * input.
+    if (!use_cifg) {
+      tflite::tensor_utils::MatrixBatchVectorMultiplyAccumulate(
+          GetBuffer<float>(input_to_input_weights_), n_cell, n_input,
+          GetBuffer<float>(input_), n_batch, input_gate_scratch, /*result_stride*/1);
+    }
+    tflite::tensor_utils::MatrixBatchVectorMultiplyAccumulate(
+        GetBuffer<float>(input_to_forget_weights_), n_cell, n_input,
+        GetBuffer<float>(input_), n_batch, forget_gate_scratch, /*result_stride*/1);
     tflite::tensor_utils::MatrixBatchVectorMultiplyAccumulate(
-        GetBuffer<float>(input_to_input_weights_), n_cell, n_input,
-        GetBuffer<float>(input_), n_batch, input_gate_scratch, /*result_stride*/1);
+        GetBuffer<float>(input_to_cell_weights_), n_cell, n_input,
+        GetBuffer<float>(input_), n_batch, cell_scratch, /*result_stride*/1);
+    tflite::tensor_utils::MatrixBatchVectorMultiplyAccumulate(
+        GetBuffer<float>(input_to_output_weights_), n_cell, n_input,
+        GetBuffer<float>(input_), n_batch, output_gate_scratch, /*result_stride*/1);
   }
-  tflite::tensor_utils::MatrixBatchVectorMultiplyAccumulate(
-      GetBuffer<float>(input_to_forget_weights_), n_cell, n_input,
-      GetBuffer<float>(input_), n_batch, forget_gate_scratch, /*result_stride*/1);
-  tflite::tensor_utils::MatrixBatchVectorMultiplyAccumulate(
-      GetBuffer<float>(input_to_cell_weights_), n_cell, n_input,
-      GetBuffer<float>(input_), n_batch, cell_scratch, /*result_stride*/1);
-  tflite::tensor_utils::MatrixBatchVectorMultiplyAccumulate(
-      GetBuffer<float>(input_to_output_weights_), n_cell, n_input,
-      GetBuffer<float>(input_), n_batch, output_gate_scratch, /*result_stride*/1);
 
   // For each batch and cell: compute recurrent_weight * output_state.
   if (!use_cifg) {
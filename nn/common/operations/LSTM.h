@@ -58,6 +58,20 @@ class LSTMCell {
                       Shape *outputShape);
   bool Eval();
 
+  // Same as Eval(), for a timestep of an unrolled LSTM whose gate biases
+  // and input products were computed ahead by ProjectInputs().
+  bool EvalWithProjectedInput(const float* projected_input);
+
+  // Computes the gate biases plus the products of the input weights with
+  // n_step inputs of size {n_batch, n_input}, laid out one after the other,
+  // with a single matrix multiplication.  weights holds the input weights
+  // of the n_gate gates, {n_gate * n_cell, n_input}, concatenated in the
+  // order of the scratch buffer; biases likewise.  Each batch of each step
+  // gets a row of n_gate * n_cell values in result.
+  static void ProjectInputs(const float* weights, const float* biases, uint32_t n_gate,
+                            uint32_t n_cell, uint32_t n_input, const float* inputs,
+                            uint32_t n_step, uint32_t n_batch, float* result);
+
   // Input Tensors of size {n_batch, n_input}
   static constexpr int kInputTensor = 0;
 
@@ -103,6 +117,9 @@ class LSTMCell {
   static constexpr int kOutputTensor = 3;
 
  private:
+  // projected_input is nullptr to compute the input products here.
+  bool EvalImpl(const float* projected_input);
+
   static bool CheckInputTensorDimensions(
       const android::hardware::neuralnetworks::V1_1::Operation &operation,
       std::vector<RunTimeOperandInfo> &operands, uint32_t n_input,
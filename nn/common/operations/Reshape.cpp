@@ -22,7 +22,6 @@
 #include "CpuOperationUtils.h"
 
 #include "tensorflow/contrib/lite/kernels/internal/optimized/optimized_ops.h"
-#include "tensorflow/contrib/lite/kernels/internal/reference/reference_ops.h"
 
 #include "Tracing.h"
 
@@ -219,39 +218,149 @@ bool squeezeGeneric(const void* inputData, const Shape& inputShape,
     return true;
 }
 
+namespace {
+
+// The side, in elements, of the square tiles in which a transpose that moves
+// the innermost input axis is done, so that both the rows read from the input
+// and the rows written to the output stay in the cache.
+const uint32_t kTransposeTileSize = 32;
+
+// Below this many elements per thread, splitting a TRANSPOSE between threads
+// costs more than it saves.
+const uint64_t kTransposeMinElementsPerThread = 64 * 1024;
+
+const uint32_t kTransposeMaxDims = 4;
+
+// Transposes inputData into outputData, copying the elements as T.
+//
+// The output axes are first simplified: axes of size 1 are dropped, and two
+// consecutive output axes that are also consecutive in the input are merged,
+// so that e.g. NHWC to NCHW becomes a batch of [HW, C] to [C, HW] transposes.
+// If the innermost output axis then remains the innermost input axis, the
+// output is made of contiguous runs of the input, which are copied with
+// memcpy.  Otherwise the input and output innermost axes are transposed in
+// tiles of kTransposeTileSize x kTransposeTileSize elements.  Either way the
+// work is split between OpenMP threads over the outer axes.
+template <typename T>
+void transposeTensor(const T* inputData, const Shape& inputShape, const int32_t* perm,
+                     T* outputData) {
+    const uint32_t numDims = getNumberOfDimensions(inputShape);
+    uint64_t inputStrides[kTransposeMaxDims];
+    uint64_t stride = 1;
+    for (int32_t i = static_cast<int32_t>(numDims) - 1; i >= 0; i--) {
+        inputStrides[i] = stride;
+        stride *= getSizeOfDimension(inputShape, i);
+    }
+    const uint64_t numElements = stride;
+
+    // The simplified output axes, outermost first, with their input strides.
+    uint32_t rank = 0;
+    uint64_t dims[kTransposeMaxDims];
+    uint64_t strides[kTransposeMaxDims];
+    for (uint32_t i = 0; i < numDims; i++) {
+        const uint64_t dim = getSizeOfDimension(inputShape, perm[i]);
+        const uint64_t inputStride = inputStrides[perm[i]];
+        if (dim == 1) {
+            continue;
+        }
+        if (rank > 0 && strides[rank - 1] == dim * inputStride) {
+            dims[rank - 1] *= dim;
+            strides[rank - 1] = inputStride;
+        } else {
+            dims[rank] = dim;
+            strides[rank] = inputStride;
+            rank++;
+        }
+    }
+    if (rank <= 1) {
+        memcpy(outputData, inputData, numElements * sizeof(T));
+        return;
+    }
+    uint64_t outputStrides[kTransposeMaxDims];
+    stride = 1;
+    for (int32_t i = static_cast<int32_t>(rank) - 1; i >= 0; i--) {
+        outputStrides[i] = stride;
+        stride *= dims[i];
+    }
+
+    const uint32_t innermost = rank - 1;
+    if (strides[innermost] == 1) {
+        const uint64_t runLength = dims[innermost];
+        const int64_t runs = static_cast<int64_t>(numElements / runLength);
+        const int numThreads =
+                getOpenMPThreadCount(runs, numElements, kTransposeMinElementsPerThread);
+#pragma omp parallel for num_threads(numThreads) if (numThreads > 1)
+        for (int64_t run = 0; run < runs; run++) {
+            uint64_t remainder = run;
+            uint64_t inputOffset = 0;
+            for (int32_t i = static_cast<int32_t>(innermost) - 1; i >= 0; i--) {
+                inputOffset += (remainder % dims[i]) * strides[i];
+                remainder /= dims[i];
+            }
+            memcpy(outputData + run * runLength, inputData + inputOffset,
+                   runLength * sizeof(T));
+        }
+        return;
+    }
+
+    // The output axis along which the input is contiguous.
+    uint32_t contiguous = 0;
+    while (strides[contiguous] != 1) {
+        contiguous++;
+    }
+    const uint64_t rows = dims[contiguous];
+    const uint64_t columns = dims[innermost];
+    const uint64_t columnStride = strides[innermost];
+    const uint64_t rowStride = outputStrides[contiguous];
+    const uint64_t rowTiles = (rows + kTransposeTileSize - 1) / kTransposeTileSize;
+    const uint64_t outerCount = numElements / (rows * columns);
+    const int64_t workItems = static_cast<int64_t>(outerCount * rowTiles);
+    const int numThreads =
+            getOpenMPThreadCount(workItems, numElements, kTransposeMinElementsPerThread);
+#pragma omp parallel for num_threads(numThreads) if (numThreads > 1)
+    for (int64_t item = 0; item < workItems; item++) {
+        uint64_t remainder = item / rowTiles;
+        uint64_t inputOffset = 0;
+        uint64_t outputOffset = 0;
+        for (int32_t i = static_cast<int32_t>(innermost) - 1; i >= 0; i--) {
+            if (i == static_cast<int32_t>(contiguous)) {
+                continue;
+            }
+            const uint64_t index = remainder % dims[i];
+            remainder /= dims[i];
+            inputOffset += index * strides[i];
+            outputOffset += index * outputStrides[i];
+        }
+        const uint64_t firstRow = (item % rowTiles) * kTransposeTileSize;
+        const uint64_t lastRow = std::min<uint64_t>(firstRow + kTransposeTileSize, rows);
+        for (uint64_t firstColumn = 0; firstColumn < columns; firstColumn += kTransposeTileSize) {
+            const uint64_t lastColumn =
+                    std::min<uint64_t>(firstColumn + kTransposeTileSize, columns);
+            for (uint64_t row = firstRow; row < lastRow; row++) {
+                const T* input = inputData + inputOffset + row;
+                T* output = outputData + outputOffset + row * rowStride;
+                for (uint64_t column = firstColumn; column < lastColumn; column++) {
+                    output[column] = input[column * columnStride];
+                }
+            }
+        }
+    }
+}
+
+}  // namespace
+
 bool transposeGeneric(const uint8_t* inputData, const Shape& inputShape,
                       const int32_t* perm, const Shape& permShape,
                       uint8_t* outputData, const Shape& outputShape) {
     NNTRACE_TRANS("transposeGeneric");
-    // Reverse the permuted axes and convert to 4D due to the way Dims are
-    // constructed.
-    const int32_t kOutputDimensionNum = 4;
-
-    int32_t permSize = static_cast<int32_t>(getSizeOfDimension(permShape, 0));
-    int32_t reversed_perm[kOutputDimensionNum];
-    for (int32_t output_k = 0, input_k = permSize - 1; output_k < permSize;
-             ++output_k, --input_k) {
-        reversed_perm[output_k] = permSize - perm[input_k] - 1;
-    }
-    for (int32_t k = permSize; k < kOutputDimensionNum; ++k) {
-        reversed_perm[k] = k;
-    }
     if (inputShape.type == OperandType::TENSOR_FLOAT32) {
-        NNTRACE_COMP_SWITCH("optimized_ops::Transpose::float");
-        tflite::reference_ops::Transpose(
-                reinterpret_cast<const float*>(inputData),
-                convertShapeToDims(inputShape),
-                reinterpret_cast<float*>(outputData),
-                convertShapeToDims(outputShape),
-                reversed_perm);
+        NNTRACE_COMP_SWITCH("transposeTensor::float");
+        transposeTensor(reinterpret_cast<const float*>(inputData), inputShape, perm,
+                        reinterpret_cast<float*>(outputData));
     } else if (inputShape.type == OperandType::TENSOR_QUANT8_ASYMM) {
-        NNTRACE_COMP_SWITCH("optimized_ops::Transpose::uint8");
-        tflite::reference_ops::Transpose(
-                reinterpret_cast<const uint8_t*>(inputData),
-                convertShapeToDims(inputShape),
-                reinterpret_cast<uint8_t*>(outputData),
-                convertShapeToDims(outputShape),
-                reversed_perm);
+        NNTRACE_COMP_SWITCH("transposeTensor::uint8");
+        transposeTensor(reinterpret_cast<const uint8_t*>(inputData), inputShape, perm,
+                        reinterpret_cast<uint8_t*>(outputData));
     } else {
         LOG(ERROR) << "Unsupported data type";
         return false;
@@ -20,10 +20,13 @@
 
 #include "Operations.h"
 #include "CpuOperationUtils.h"
+#include "ScratchArena.h"
 
 #include "tensorflow/contrib/lite/kernels/internal/optimized/optimized_ops.h"
 #include "tensorflow/contrib/lite/kernels/internal/reference/reference_ops.h"
 
+#include "Eigen/Core"
+
 #include "Tracing.h"
 
 namespace android {
@@ -48,39 +51,248 @@ namespace nn {
             return false;                                                   \
     }
 
-bool addFloat32(const float* in1, const Shape& shape1,
-                const float* in2, const Shape& shape2,
-                int32_t activation,
-                float* out, const Shape& shapeOut) {
-    NNTRACE_TRANS("addFloat32");
-    bool needBroadcast = !SameShape(shape1, shape2);
+namespace {
+
+// Below this many output elements per thread, splitting an elementwise
+// operation between threads costs more than it saves.  This is also the
+// size of the blocks of the innermost axis that are computed at once.
+const uint64_t kElementwiseMinElementsPerThread = 16 * 1024;
+
+const uint32_t kElementwiseMaxDims = 4;
+
+// The axes along which an elementwise operation walks its output, outermost
+// first, with the strides of its two inputs along them.  An input is
+// broadcast along the axes where its stride is 0.
+struct ElementwiseAxes {
+    uint32_t count = 0;
+    uint64_t dims[kElementwiseMaxDims];
+    uint64_t strides1[kElementwiseMaxDims];
+    uint64_t strides2[kElementwiseMaxDims];
+};
+
+// Fills strides with the stride, in an input of the given shape, of each of
+// the numDims axes of the output, the trailing dimensions of both being
+// aligned.
+void getBroadcastStrides(const Shape& shape, uint32_t numDims, uint64_t* strides) {
+    const uint32_t inputDims = getNumberOfDimensions(shape);
+    uint64_t stride = 1;
+    for (uint32_t i = 1; i <= numDims; i++) {
+        if (i > inputDims || getSizeOfDimension(shape, inputDims - i) == 1) {
+            strides[numDims - i] = 0;
+        } else {
+            strides[numDims - i] = stride;
+            stride *= getSizeOfDimension(shape, inputDims - i);
+        }
+    }
+}
 
-    if (needBroadcast) {
-        NNTRACE_COMP_SWITCH("optimized_ops::BroadcastAdd");
-        #define ANDROID_NN_BROADCAST_ADD(activation)                                              \
-            tflite::optimized_ops::BroadcastAdd<tflite::FusedActivationFunctionType::activation>( \
-                    in1, convertShapeToDims(shape1),                                              \
-                    in2, convertShapeToDims(shape2),                                              \
-                    out, convertShapeToDims(shapeOut))
+// Returns the axes of an elementwise operation of inputs of shape1 and
+// shape2.  The output axes of size 1 are dropped, and consecutive axes along
+// which both inputs are either contiguous or broadcast are merged, so that
+// the innermost axis is as long as possible.  Along the innermost axis, an
+// input is then either contiguous or broadcast.
+ElementwiseAxes getElementwiseAxes(const Shape& shape1, const Shape& shape2,
+                                   const Shape& shapeOut) {
+    const uint32_t numDims = getNumberOfDimensions(shapeOut);
+    uint64_t strides1[kElementwiseMaxDims];
+    uint64_t strides2[kElementwiseMaxDims];
+    getBroadcastStrides(shape1, numDims, strides1);
+    getBroadcastStrides(shape2, numDims, strides2);
+    ElementwiseAxes axes;
+    for (uint32_t i = 0; i < numDims; i++) {
+        const uint64_t dim = getSizeOfDimension(shapeOut, i);
+        if (dim == 1) {
+            continue;
+        }
+        const uint32_t last = axes.count - 1;
+        if (axes.count > 0 && axes.strides1[last] == dim * strides1[i] &&
+            axes.strides2[last] == dim * strides2[i]) {
+            axes.dims[last] *= dim;
+            axes.strides1[last] = strides1[i];
+            axes.strides2[last] = strides2[i];
+        } else {
+            axes.dims[axes.count] = dim;
+            axes.strides1[axes.count] = strides1[i];
+            axes.strides2[axes.count] = strides2[i];
+            axes.count++;
+        }
+    }
+    if (axes.count == 0) {
+        // A single element.
+        axes.count = 1;
+        axes.dims[0] = 1;
+        axes.strides1[0] = 1;
+        axes.strides2[0] = 1;
+    }
+    return axes;
+}
 
-        ANDROID_NN_MACRO_DISPATCH(ANDROID_NN_BROADCAST_ADD)
-        #undef ANDROID_NN_BROADCAST_ADD
-    } else {
-        float output_activation_min, output_activation_max;
-        CalculateActivationRangeFloat(activation, &output_activation_min,
-                                      &output_activation_max);
+// Computes out = operation(in1, in2), with in1 and in2 broadcast to the shape
+// of out.  operation maps two Eigen array expressions of T to an expression
+// of U, which Eigen vectorizes for the instruction set the library is built
+// for.  The output is computed a block of its innermost axis at a time, an
+// input broadcast along that axis being passed as a constant array, and the
+// blocks are split between the OpenMP threads.
+template <typename T, typename U, typename Operation>
+void computeElementwise(const T* in1, const Shape& shape1, const T* in2, const Shape& shape2,
+                        U* out, const Shape& shapeOut, Operation operation) {
+    using ArrayT = Eigen::Array<T, Eigen::Dynamic, 1>;
+    using ArrayU = Eigen::Array<U, Eigen::Dynamic, 1>;
+    const ElementwiseAxes axes = getElementwiseAxes(shape1, shape2, shapeOut);
+    const uint32_t innermost = axes.count - 1;
+    const uint64_t runLength = axes.dims[innermost];
+    const uint64_t numElements = getNumberOfElements(shapeOut);
+    const uint64_t blocksPerRun =
+            (runLength + kElementwiseMinElementsPerThread - 1) / kElementwiseMinElementsPerThread;
+    const int64_t blocks = static_cast<int64_t>(numElements / runLength * blocksPerRun);
+    const int numThreads =
+            getOpenMPThreadCount(blocks, numElements, kElementwiseMinElementsPerThread);
+
+#pragma omp parallel for num_threads(numThreads) if (numThreads > 1)
+    for (int64_t block = 0; block < blocks; block++) {
+        const uint64_t run = block / blocksPerRun;
+        const uint64_t first = (block % blocksPerRun) * kElementwiseMinElementsPerThread;
+        const Eigen::Index count = std::min(runLength - first, kElementwiseMinElementsPerThread);
+        uint64_t remainder = run;
+        uint64_t offset1 = 0;
+        uint64_t offset2 = 0;
+        for (int32_t i = static_cast<int32_t>(innermost) - 1; i >= 0; i--) {
+            const uint64_t index = remainder % axes.dims[i];
+            remainder /= axes.dims[i];
+            offset1 += index * axes.strides1[i];
+            offset2 += index * axes.strides2[i];
+        }
+        Eigen::Map<ArrayU> output(out + run * runLength + first, count);
+        if (axes.strides1[innermost] == 0) {
+            output = operation(ArrayT::Constant(count, in1[offset1]),
+                               Eigen::Map<const ArrayT>(in2 + offset2 + first, count));
+        } else if (axes.strides2[innermost] == 0) {
+            output = operation(Eigen::Map<const ArrayT>(in1 + offset1 + first, count),
+                               ArrayT::Constant(count, in2[offset2]));
+        } else {
+            output = operation(Eigen::Map<const ArrayT>(in1 + offset1 + first, count),
+                               Eigen::Map<const ArrayT>(in2 + offset2 + first, count));
+        }
+    }
+}
 
-        NNTRACE_COMP_SWITCH("optimized_ops::Add");
-        tflite::optimized_ops::Add(
-                in1, convertShapeToDims(shape1),
-                in2, convertShapeToDims(shape2),
-                output_activation_min, output_activation_max,
-                out, convertShapeToDims(shapeOut));
+// Computes out = operation(in) for the numElements elements of in, in blocks
+// split between the OpenMP threads.  See computeElementwise().
+template <typename T, typename U, typename Operation>
+void computeUnaryElementwise(const T* in, U* out, uint64_t numElements, Operation operation) {
+    using ArrayT = Eigen::Array<T, Eigen::Dynamic, 1>;
+    using ArrayU = Eigen::Array<U, Eigen::Dynamic, 1>;
+    const int64_t blocks = static_cast<int64_t>(
+            (numElements + kElementwiseMinElementsPerThread - 1) / kElementwiseMinElementsPerThread);
+    const int numThreads =
+            getOpenMPThreadCount(blocks, numElements, kElementwiseMinElementsPerThread);
+
+#pragma omp parallel for num_threads(numThreads) if (numThreads > 1)
+    for (int64_t block = 0; block < blocks; block++) {
+        const uint64_t first = block * kElementwiseMinElementsPerThread;
+        const Eigen::Index count = std::min(numElements - first, kElementwiseMinElementsPerThread);
+        Eigen::Map<ArrayU>(out + first, count) =
+                operation(Eigen::Map<const ArrayT>(in + first, count));
     }
+}
 
+// Applies the fused activation Ac to an Eigen array expression of floats.
+// As Ac is known at compile time, nothing is done when there is none.
+template <tflite::FusedActivationFunctionType Ac>
+struct FloatActivation;
+
+template <>
+struct FloatActivation<tflite::FusedActivationFunctionType::kNone> {
+    template <typename Expression>
+    static Expression apply(const Expression& x) { return x; }
+};
+
+template <>
+struct FloatActivation<tflite::FusedActivationFunctionType::kRelu> {
+    template <typename Expression>
+    static auto apply(const Expression& x) { return x.max(0.f); }
+};
+
+template <>
+struct FloatActivation<tflite::FusedActivationFunctionType::kRelu1> {
+    template <typename Expression>
+    static auto apply(const Expression& x) { return x.max(-1.f).min(1.f); }
+};
+
+template <>
+struct FloatActivation<tflite::FusedActivationFunctionType::kRelu6> {
+    template <typename Expression>
+    static auto apply(const Expression& x) { return x.max(0.f).min(6.f); }
+};
+
+// Computes the binary operation on float inputs, followed by the activation.
+template <typename Operation>
+bool computeFloat32(const float* in1, const Shape& shape1,
+                    const float* in2, const Shape& shape2,
+                    int32_t activation,
+                    float* out, const Shape& shapeOut,
+                    Operation operation) {
+    #define ANDROID_NN_COMPUTE_FLOAT32(activation)                                      \
+        computeElementwise(in1, shape1, in2, shape2, out, shapeOut,                     \
+                           [operation](const auto& a, const auto& b) {                  \
+                               return FloatActivation<                                  \
+                                       tflite::FusedActivationFunctionType::activation> \
+                                       ::apply(operation(a, b));                        \
+                           })
+
+    ANDROID_NN_MACRO_DISPATCH(ANDROID_NN_COMPUTE_FLOAT32)
+    #undef ANDROID_NN_COMPUTE_FLOAT32
+    return true;
+}
+
+// Computes the binary operation on quant8 inputs in float: the inputs are
+// dequantized, and the result of operation is requantized to the scale and
+// offset of the output, rounding to nearest, then clamped to the range of
+// the activation.
+template <typename Operation>
+bool computeQuant8(const uint8_t* in1, const Shape& shape1,
+                   const uint8_t* in2, const Shape& shape2,
+                   int32_t activation,
+                   uint8_t* out, const Shape& shapeOut,
+                   Operation operation) {
+    int32_t output_activation_min = 0;
+    int32_t output_activation_max = 0;
+    CalculateActivationRangeUint8(activation, shapeOut,
+                                  &output_activation_min,
+                                  &output_activation_max);
+    const float input1_offset = shape1.offset;
+    const float input1_scale = shape1.scale;
+    const float input2_offset = shape2.offset;
+    const float input2_scale = shape2.scale;
+    const float output_offset = shapeOut.offset;
+    const float output_scale = shapeOut.scale;
+    const float output_min = output_activation_min;
+    const float output_max = output_activation_max;
+    computeElementwise(in1, shape1, in2, shape2, out, shapeOut,
+                       [=](const auto& a, const auto& b) {
+                           const auto real = operation(
+                                   (a.template cast<float>() - input1_offset) * input1_scale,
+                                   (b.template cast<float>() - input2_offset) * input2_scale);
+                           return (real / output_scale + output_offset)
+                                   .round()
+                                   .max(output_min)
+                                   .min(output_max)
+                                   .template cast<uint8_t>();
+                       });
     return true;
 }
 
+}  // namespace
+
+bool addFloat32(const float* in1, const Shape& shape1,
+                const float* in2, const Shape& shape2,
+                int32_t activation,
+                float* out, const Shape& shapeOut) {
+    NNTRACE_COMP("addFloat32");
+    return computeFloat32(in1, shape1, in2, shape2, activation, out, shapeOut,
+                          [](const auto& a, const auto& b) { return a + b; });
+}
+
 bool addQuant8(const uint8_t* in1, const Shape& shape1,
                const uint8_t* in2, const Shape& shape2,
                int32_t activation,
@@ -158,33 +370,9 @@ bool mulFloat32(const float* in1, const Shape& shape1,
                 const float* in2, const Shape& shape2,
                 int32_t activation,
                 float* out, const Shape& shapeOut) {
-    NNTRACE_TRANS("mulFloat32");
-    bool needBroadcast = !SameShape(shape1, shape2);
-
-    if (needBroadcast) {
-        NNTRACE_COMP_SWITCH("optimized_ops::BroadcastMul");
-        #define ANDROID_NN_BROADCAST_MUL(activation)                                          \
-        tflite::optimized_ops::BroadcastMul<tflite::FusedActivationFunctionType::activation>( \
-                in1, convertShapeToDims(shape1),                                              \
-                in2, convertShapeToDims(shape2),                                              \
-                out, convertShapeToDims(shapeOut))
-
-        ANDROID_NN_MACRO_DISPATCH(ANDROID_NN_BROADCAST_MUL)
-        #undef ANDROID_NN_BROADCAST_MUL
-    } else {
-        float output_activation_min, output_activation_max;
-        CalculateActivationRangeFloat(activation, &output_activation_min,
-                                      &output_activation_max);
-
-        NNTRACE_COMP_SWITCH("optimized_ops::Mul");
-        tflite::optimized_ops::Mul(
-                in1, convertShapeToDims(shape1),
-                in2, convertShapeToDims(shape2),
-                output_activation_min, output_activation_max,
-                out, convertShapeToDims(shapeOut));
-    }
-
-    return true;
+    NNTRACE_COMP("mulFloat32");
+    return computeFloat32(in1, shape1, in2, shape2, activation, out, shapeOut,
+                          [](const auto& a, const auto& b) { return a * b; });
 }
 
 bool mulQuant8(const uint8_t* in1, const Shape& shape1,
@@ -224,22 +412,22 @@ bool mulQuant8(const uint8_t* in1, const Shape& shape1,
 bool floorFloat32(const float* inputData,
                   float* outputData,
                   const Shape& shape) {
-    NNTRACE_TRANS("floorFloat32");
-    tflite::Dims<4> dim = convertShapeToDims(shape);
-    NNTRACE_COMP_SWITCH("optimized_ops::Floor");
-    tflite::optimized_ops::Floor(inputData, dim, outputData, dim);
+    NNTRACE_COMP("floorFloat32");
+    computeUnaryElementwise(inputData, outputData, getNumberOfElements(shape),
+                            [](const auto& x) { return x.floor(); });
     return true;
 }
 
 bool dequantizeQuant8ToFloat32(const uint8_t* inputData,
                                float* outputData,
                                const Shape& shape) {
-    NNTRACE_TRANS("dequantizeQuant8ToFloat32");
-    tflite::Dims<4> dim = convertShapeToDims(shape);
-    NNTRACE_COMP_SWITCH("optimized_ops::Dequantize");
-    tflite::optimized_ops::Dequantize(inputData, dim,
-                                      shape.offset, shape.scale,
-                                      outputData, dim);
+    NNTRACE_COMP("dequantizeQuant8ToFloat32");
+    const float offset = shape.offset;
+    const float scale = shape.scale;
+    computeUnaryElementwise(inputData, outputData, getNumberOfElements(shape),
+                            [offset, scale](const auto& x) {
+                                return (x.template cast<float>() - offset) * scale;
+                            });
     return true;
 }
 
@@ -247,113 +435,180 @@ bool subFloat32(const float* in1, const Shape& shape1,
                 const float* in2, const Shape& shape2,
                 int32_t activation,
                 float* out, const Shape& shapeOut) {
-    NNTRACE_TRANS("subFloat32");
-    float output_activation_min, output_activation_max;
-    CalculateActivationRangeFloat(activation, &output_activation_min,
-                                  &output_activation_max);
+    NNTRACE_COMP("subFloat32");
+    return computeFloat32(in1, shape1, in2, shape2, activation, out, shapeOut,
+                          [](const auto& a, const auto& b) { return a - b; });
+}
 
-    bool needBroadcast = !SameShape(shape1, shape2);
-    if (needBroadcast) {
-        NNTRACE_COMP_SWITCH("optimized_ops::BroadcastSub");
-        tflite::optimized_ops::BroadcastSub(
-                in1, convertShapeToDims(shape1),
-                in2, convertShapeToDims(shape2),
-                output_activation_min, output_activation_max,
-                out, convertShapeToDims(shapeOut));
-    } else {
-        NNTRACE_COMP_SWITCH("optimized_ops::Sub");
-        tflite::optimized_ops::Sub(
-                in1, convertShapeToDims(shape1),
-                in2, convertShapeToDims(shape2),
-                output_activation_min, output_activation_max,
-                out, convertShapeToDims(shapeOut));
-    }
-    return true;
+bool subQuant8(const uint8_t* in1, const Shape& shape1,
+               const uint8_t* in2, const Shape& shape2,
+               int32_t activation,
+               uint8_t* out, const Shape& shapeOut) {
+    NNTRACE_COMP("subQuant8");
+    return computeQuant8(in1, shape1, in2, shape2, activation, out, shapeOut,
+                         [](const auto& a, const auto& b) { return a - b; });
 }
 
 bool divFloat32(const float* in1, const Shape& shape1,
                 const float* in2, const Shape& shape2,
                 int32_t activation,
                 float* out, const Shape& shapeOut) {
-    NNTRACE_TRANS("divFloat32");
-    float output_activation_min, output_activation_max;
-    CalculateActivationRangeFloat(activation, &output_activation_min,
-                                  &output_activation_max);
+    NNTRACE_COMP("divFloat32");
+    return computeFloat32(in1, shape1, in2, shape2, activation, out, shapeOut,
+                          [](const auto& a, const auto& b) { return a / b; });
+}
 
-    bool needBroadcast = !SameShape(shape1, shape2);
-    if (needBroadcast) {
-        NNTRACE_COMP_SWITCH("optimized_ops::BroadcastDiv");
-        tflite::optimized_ops::BroadcastDiv(
-                in1, convertShapeToDims(shape1),
-                in2, convertShapeToDims(shape2),
-                output_activation_min, output_activation_max,
-                out, convertShapeToDims(shapeOut));
-    } else {
-        NNTRACE_COMP_SWITCH("optimized_ops::Div");
-        tflite::optimized_ops::Div(
-                in1, convertShapeToDims(shape1),
-                in2, convertShapeToDims(shape2),
-                output_activation_min, output_activation_max,
-                out, convertShapeToDims(shapeOut));
+bool divQuant8(const uint8_t* in1, const Shape& shape1,
+               const uint8_t* in2, const Shape& shape2,
+               int32_t activation,
+               uint8_t* out, const Shape& shapeOut) {
+    NNTRACE_COMP("divQuant8");
+    // A division by zero saturates to the range of the output, except 0 / 0,
+    // which is 0.
+    return computeQuant8(in1, shape1, in2, shape2, activation, out, shapeOut,
+                         [](const auto& a, const auto& b) {
+                             const auto quotient = a / b;
+                             return (quotient == quotient).select(quotient, 0.f);
+                         });
+}
+
+uint64_t getMeanScratchByteSize(const Shape& inputShape, const Shape& axisShape,
+                                const Shape& outputShape) {
+    // The sums of the output elements, then the index and the resolved axes
+    // used by tflite::reference_ops::Mean.  The sums are floats or int32_t.
+    return (static_cast<uint64_t>(getNumberOfElements(outputShape)) +
+            getNumberOfDimensions(inputShape) + getSizeOfDimension(axisShape, 0)) *
+           sizeof(int32_t);
+}
+
+namespace {
+
+// The number of channels one thread sums at a time in meanOverSpatialAxes.
+const uint32_t kMeanChannelBlockSize = 64;
+
+// Below this many input elements per thread, splitting a MEAN between
+// threads costs more than it saves.
+const uint64_t kMeanMinElementsPerThread = 64 * 1024;
+
+// Returns true if the axes are exactly the spatial axes {1, 2} of a 4-D
+// NHWC input, in any order, possibly repeated or negative.
+bool isMeanOverSpatialAxes(const Shape& inputShape, const int32_t* axis, int32_t axisSize) {
+    const int32_t numDims = static_cast<int32_t>(getNumberOfDimensions(inputShape));
+    if (numDims != 4 || axisSize == 0) {
+        return false;
+    }
+    bool reduced[4] = {false, false, false, false};
+    for (int32_t i = 0; i < axisSize; i++) {
+        const int32_t current = axis[i] < 0 ? axis[i] + numDims : axis[i];
+        if (current < 0 || current >= numDims) {
+            return false;
+        }
+        reduced[current] = true;
+    }
+    return !reduced[0] && reduced[1] && reduced[2] && !reduced[3];
+}
+
+// Computes the MEAN of an NHWC input over its height and width, e.g. for
+// global average pooling, with the same arithmetic as
+// tflite::reference_ops::Mean.  Each block of channels of each batch is
+// summed over the rows of the input, a vector of channels at a time, on one
+// of the OpenMP threads.  sums must hold one U per output element.
+template <typename T, typename U>
+void meanOverSpatialAxes(const T* inputData, const Shape& inputShape, U* sums,
+                         T* outputData) {
+    using ArrayT = Eigen::Array<T, Eigen::Dynamic, 1>;
+    using ArrayU = Eigen::Array<U, Eigen::Dynamic, 1>;
+    const uint32_t batches = getSizeOfDimension(inputShape, 0);
+    const uint32_t spatialSize =
+            getSizeOfDimension(inputShape, 1) * getSizeOfDimension(inputShape, 2);
+    const uint32_t channels = getSizeOfDimension(inputShape, 3);
+    const uint32_t channelBlocks = (channels + kMeanChannelBlockSize - 1) / kMeanChannelBlockSize;
+    const int32_t blocks = static_cast<int32_t>(batches * channelBlocks);
+    const uint64_t numElements = static_cast<uint64_t>(batches) * spatialSize * channels;
+    const int numThreads = getOpenMPThreadCount(blocks, numElements, kMeanMinElementsPerThread);
+
+#pragma omp parallel for num_threads(numThreads) if (numThreads > 1)
+    for (int32_t block = 0; block < blocks; block++) {
+        const uint32_t batch = block / channelBlocks;
+        const uint32_t firstChannel = (block % channelBlocks) * kMeanChannelBlockSize;
+        const uint32_t count = std::min(kMeanChannelBlockSize, channels - firstChannel);
+        const uint32_t firstOutput = batch * channels + firstChannel;
+        Eigen::Map<ArrayU> sum(sums + firstOutput, count);
+        sum.setZero();
+        const T* row = inputData + static_cast<size_t>(batch) * spatialSize * channels +
+                       firstChannel;
+        for (uint32_t i = 0; i < spatialSize; i++, row += channels) {
+            sum += Eigen::Map<const ArrayT>(row, count).template cast<U>();
+        }
+        Eigen::Map<ArrayT>(outputData + firstOutput, count) =
+                (sum / static_cast<U>(spatialSize)).template cast<T>();
     }
-    return true;
 }
 
+}  // namespace
+
 bool meanGeneric(const uint8_t* inputData, const Shape& inputShape,
                  const int32_t* axis, const Shape& axisShape, bool keepDims,
-                 uint8_t* outputData, const Shape& outputShape) {
+                 uint8_t* outputData, const Shape& outputShape,
+                 ScratchArena* scratch) {
     NNTRACE_TRANS("meanGeneric");
-    // Creates a temp index to iterate through input data.
-    int32_t* scratchBuffer = new int32_t[getNumberOfDimensions(inputShape)];
+    const uint64_t scratchByteSize = getMeanScratchByteSize(inputShape, axisShape, outputShape);
+    int32_t* scratchData = scratchByteSize < 0x7fffffff
+            ? reinterpret_cast<int32_t*>(scratch->getBuffer(scratchByteSize))
+            : nullptr;
+    if (scratchData == nullptr) {
+        LOG(ERROR) << "Failed to allocate scratch memory for MEAN";
+        return false;
+    }
+    const int32_t axisSize = static_cast<int32_t>(getSizeOfDimension(axisShape, 0));
+    const bool overSpatialAxes = isMeanOverSpatialAxes(inputShape, axis, axisSize);
 
-    // Creates a temp tensor to store resolved axis given input data.
-    int32_t axisSize = static_cast<int32_t>(getSizeOfDimension(axisShape, 0));
-    int32_t* resolvedAxis = new int32_t[axisSize];
+    // See getMeanScratchByteSize().
+    int32_t* tempSumBuffer = scratchData;
+    int32_t* scratchBuffer = tempSumBuffer + getNumberOfElements(outputShape);
+    int32_t* resolvedAxis = scratchBuffer + getNumberOfDimensions(inputShape);
 
-    bool result = true;
     if (inputShape.type == OperandType::TENSOR_FLOAT32) {
-        float* tempSumBuffer = new (std::nothrow) float[getNumberOfElements(outputShape)];
-        if (!tempSumBuffer) {
-            LOG(ERROR) << "Failed to allocate tempSumBuffer for MEAN";
-            result = false;
-        } else {
-            NNTRACE_COMP_SWITCH("optimized_ops::Mean");
-            tflite::reference_ops::Mean<float, float>(
-                    const_cast<float*>(reinterpret_cast<const float*>(inputData)),
-                    reinterpret_cast<const int*>(inputShape.dimensions.data()),
-                    getNumberOfDimensions(inputShape),
-                    reinterpret_cast<float*>(outputData),
-                    reinterpret_cast<const int*>(outputShape.dimensions.data()),
-                    getNumberOfDimensions(outputShape),
-                    axis, axisSize, keepDims, scratchBuffer, resolvedAxis,
-                    tempSumBuffer);
-            delete[] tempSumBuffer;
+        if (overSpatialAxes) {
+            NNTRACE_COMP_SWITCH("meanOverSpatialAxes");
+            meanOverSpatialAxes<float, float>(reinterpret_cast<const float*>(inputData),
+                                              inputShape,
+                                              reinterpret_cast<float*>(tempSumBuffer),
+                                              reinterpret_cast<float*>(outputData));
+            return true;
         }
+        NNTRACE_COMP_SWITCH("optimized_ops::Mean");
+        tflite::reference_ops::Mean<float, float>(
+                const_cast<float*>(reinterpret_cast<const float*>(inputData)),
+                reinterpret_cast<const int*>(inputShape.dimensions.data()),
+                getNumberOfDimensions(inputShape),
+                reinterpret_cast<float*>(outputData),
+                reinterpret_cast<const int*>(outputShape.dimensions.data()),
+                getNumberOfDimensions(outputShape),
+                axis, axisSize, keepDims, scratchBuffer, resolvedAxis,
+                reinterpret_cast<float*>(tempSumBuffer));
     } else if (inputShape.type == OperandType::TENSOR_QUANT8_ASYMM) {
-        int32_t* tempSumBuffer = new (std::nothrow) int32_t[getNumberOfElements(outputShape)];
-        if (!tempSumBuffer) {
-            LOG(ERROR) << "Failed to allocate tempSumBuffer for MEAN";
-            result = false;
-        } else {
-            NNTRACE_COMP_SWITCH("optimized_ops::Mean");
-            tflite::reference_ops::Mean<uint8_t, int32_t>(
-                    const_cast<uint8_t*>(inputData),
-                    reinterpret_cast<const int*>(inputShape.dimensions.data()),
-                    getNumberOfDimensions(inputShape),
-                    outputData,
-                    reinterpret_cast<const int*>(outputShape.dimensions.data()),
-                    getNumberOfDimensions(outputShape),
-                    axis, axisSize, keepDims, scratchBuffer, resolvedAxis,
-                    tempSumBuffer);
-            delete[] tempSumBuffer;
+        if (overSpatialAxes) {
+            NNTRACE_COMP_SWITCH("meanOverSpatialAxes");
+            meanOverSpatialAxes<uint8_t, int32_t>(inputData, inputShape, tempSumBuffer,
+                                                  outputData);
+            return true;
         }
+        NNTRACE_COMP_SWITCH("optimized_ops::Mean");
+        tflite::reference_ops::Mean<uint8_t, int32_t>(
+                const_cast<uint8_t*>(inputData),
+                reinterpret_cast<const int*>(inputShape.dimensions.data()),
+                getNumberOfDimensions(inputShape),
+                outputData,
+                reinterpret_cast<const int*>(outputShape.dimensions.data()),
+                getNumberOfDimensions(outputShape),
+                axis, axisSize, keepDims, scratchBuffer, resolvedAxis,
+                tempSumBuffer);
     } else {
         LOG(ERROR) << "Unsupported data type";
-        result = false;
+        return false;
     }
-    delete[] scratchBuffer;
-    delete[] resolvedAxis;
-    return result;
+    return true;
 }
 } // namespace nn
 } // namespace android
@@ -21,61 +21,129 @@
 #include "Operations.h"
 #include "CpuOperationUtils.h"
 
-#include "tensorflow/contrib/lite/kernels/internal/reference/reference_ops.h"
-
 #include "Tracing.h"
 
 namespace android {
 namespace nn {
 
-bool stridedSliceGeneric(const uint8_t* inputData, const Shape& inputShape,
-                         const int32_t* beginData, const int32_t* endData,
-                         const int32_t* stridesData,
-                         int32_t beginMask, int32_t endMask, int32_t shrinkAxisMask,
-                         uint8_t* outputData, const Shape& outputShape) {
-    NNTRACE_TRANS("stridedSliceGeneric");
-    // This Op only supports 1-4D cases and since we use the reference 4D
-    // implementation, the 1-3D tensors are mapped to 4D.
-    const int kMaxDim = 4;
+namespace {
+
+// Below this many elements per thread, splitting a STRIDED_SLICE between
+// threads costs more than it saves.
+const uint64_t kStridedSliceMinElementsPerThread = 64 * 1024;
+
+const uint32_t kStridedSliceMaxDims = 4;
 
-    std::vector<int> starts;
-    std::vector<int> stops;
-    std::vector<int> strides;
+// Copies the slice of inputData into outputData, as T.
+//
+// The first element, the element count and the step of each input axis are
+// resolved as in stridedSlicePrepare().  Axes of a single element only move
+// the first element, and two consecutive axes whose elements are evenly
+// spaced in the input are merged, so that the output is made of runs along
+// the innermost remaining axis.  Runs of unit stride are copied with memcpy.
+// The runs are split between OpenMP threads.
+template <typename T>
+void stridedSliceTensor(const T* inputData, const Shape& inputShape,
+                        const int32_t* beginData, const int32_t* endData,
+                        const int32_t* stridesData, int32_t beginMask, int32_t endMask,
+                        T* outputData) {
+    const uint32_t numDims = getNumberOfDimensions(inputShape);
+    int64_t inputStrides[kStridedSliceMaxDims];
+    int64_t inputStride = 1;
+    for (int32_t i = static_cast<int32_t>(numDims) - 1; i >= 0; i--) {
+        inputStrides[i] = inputStride;
+        inputStride *= getSizeOfDimension(inputShape, i);
+    }
 
-    int32_t numInputDims = static_cast<int32_t>(getNumberOfDimensions(inputShape));
-    for (int32_t idx = numInputDims - 1; idx >= 0; --idx) {
-      starts.emplace_back(beginData[idx]);
-      stops.emplace_back(endData[idx]);
-      strides.emplace_back(stridesData[idx]);
+    // The merged axes, outermost first, with the step between their elements
+    // in the input.
+    uint32_t rank = 0;
+    uint64_t counts[kStridedSliceMaxDims];
+    int64_t steps[kStridedSliceMaxDims];
+    int64_t firstOffset = 0;
+    uint64_t numElements = 1;
+    for (uint32_t i = 0; i < numDims; i++) {
+        const int32_t dim = static_cast<int32_t>(getSizeOfDimension(inputShape, i));
+        const int32_t stride = stridesData[i];
+        const bool positiveStride = stride > 0;
+        const int32_t begin = beginMask & (1 << i)
+                ? positiveStride ? 0 : dim - 1
+                : ClampedIndex(beginData[i], dim, positiveStride);
+        const int32_t end = endMask & (1 << i)
+                ? positiveStride ? dim : -1
+                : ClampedIndex(endData[i], dim, positiveStride);
+        const int64_t distance = positiveStride ? end - begin : begin - end;
+        const int64_t absoluteStride = positiveStride ? stride : -int64_t(stride);
+        if (distance <= 0) {
+            return;
+        }
+        const uint64_t count = (distance + absoluteStride - 1) / absoluteStride;
+        const int64_t step = stride * inputStrides[i];
+        numElements *= count;
+        firstOffset += begin * inputStrides[i];
+        if (count == 1) {
+            continue;
+        }
+        if (rank > 0 && steps[rank - 1] == static_cast<int64_t>(count) * step) {
+            counts[rank - 1] *= count;
+            steps[rank - 1] = step;
+        } else {
+            counts[rank] = count;
+            steps[rank] = step;
+            rank++;
+        }
+    }
+    if (rank == 0) {
+        outputData[0] = inputData[firstOffset];
+        return;
     }
 
-    for (int i = numInputDims; i < kMaxDim; i++) {
-      starts.emplace_back(0);
-      stops.emplace_back(1);
-      strides.emplace_back(1);
+    const uint32_t innermost = rank - 1;
+    const uint64_t runLength = counts[innermost];
+    const int64_t runStep = steps[innermost];
+    const int64_t runs = static_cast<int64_t>(numElements / runLength);
+    const int numThreads =
+            getOpenMPThreadCount(runs, numElements, kStridedSliceMinElementsPerThread);
+#pragma omp parallel for num_threads(numThreads) if (numThreads > 1)
+    for (int64_t run = 0; run < runs; run++) {
+        int64_t remainder = run;
+        int64_t inputOffset = firstOffset;
+        for (int32_t i = static_cast<int32_t>(innermost) - 1; i >= 0; i--) {
+            inputOffset += (remainder % counts[i]) * steps[i];
+            remainder /= counts[i];
+        }
+        const T* input = inputData + inputOffset;
+        T* output = outputData + run * runLength;
+        if (runStep == 1) {
+            memcpy(output, input, runLength * sizeof(T));
+        } else {
+            for (uint64_t j = 0; j < runLength; j++) {
+                output[j] = input[j * runStep];
+            }
+        }
     }
+}
 
-    beginMask = ReverseMaskBits(beginMask, numInputDims);
-    endMask = ReverseMaskBits(endMask, numInputDims);
+}  // namespace
 
+bool stridedSliceGeneric(const uint8_t* inputData, const Shape& inputShape,
+                         const int32_t* beginData, const int32_t* endData,
+                         const int32_t* stridesData,
+                         int32_t beginMask, int32_t endMask, int32_t shrinkAxisMask,
+                         uint8_t* outputData, const Shape& outputShape) {
+    NNTRACE_TRANS("stridedSliceGeneric");
+    // The axes in shrinkAxisMask have a single element, so they are dropped
+    // from the output without any change to the order of its elements.
     if (inputShape.type == OperandType::TENSOR_FLOAT32) {
-        NNTRACE_COMP_SWITCH("reference_ops::StridedSlice::float");
-        tflite::reference_ops::StridedSlice(
-                reinterpret_cast<const float*>(inputData),
-                convertShapeToDims(inputShape),
-                beginMask, endMask,
-                starts, stops, strides,
-                reinterpret_cast<float*>(outputData),
-                convertShapeToDims(outputShape));
+        NNTRACE_COMP_SWITCH("stridedSliceTensor::float");
+        stridedSliceTensor(reinterpret_cast<const float*>(inputData), inputShape,
+                           beginData, endData, stridesData, beginMask, endMask,
+                           reinterpret_cast<float*>(outputData));
     } else if (inputShape.type == OperandType::TENSOR_QUANT8_ASYMM) {
-        NNTRACE_COMP_SWITCH("reference_ops::StridedSlice::uint8");
-        tflite::reference_ops::StridedSlice(
-                reinterpret_cast<const uint8_t*>(inputData),
-                convertShapeToDims(inputShape),
-                beginMask, endMask,
-                starts, stops, strides,
-                reinterpret_cast<uint8_t*>(outputData),
-                convertShapeToDims(outputShape));
+        NNTRACE_COMP_SWITCH("stridedSliceTensor::uint8");
+        stridedSliceTensor(reinterpret_cast<const uint8_t*>(inputData), inputShape,
+                           beginData, endData, stridesData, beginMask, endMask,
+                           reinterpret_cast<uint8_t*>(outputData));
     } else {
         LOG(ERROR) << "Unsupported data type";
         return false;
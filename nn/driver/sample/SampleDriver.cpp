@@ -20,12 +20,12 @@
 
 #include "CpuExecutor.h"
 #include "HalInterfaces.h"
+#include "ThreadPool.h"
 #include "Tracing.h"
 #include "ValidateHal.h"
 
 #include <android-base/logging.h>
 #include <hidl/LegacySupport.h>
-#include <thread>
 
 namespace android {
 namespace nn {
@@ -119,7 +119,7 @@ int SampleDriver::run() {
 }
 
 bool SamplePreparedModel::initialize() {
-    return setRunTimePoolInfosFromHidlMemories(&mPoolInfos, mModel.pools);
+    return mCpuPreparedModel.initialize();
 }
 
 void SamplePreparedModel::asyncExecute(const Request& request,
@@ -134,8 +134,7 @@ void SamplePreparedModel::asyncExecute(const Request& request,
 
     NNTRACE_FULL_SWITCH(NNTRACE_LAYER_DRIVER, NNTRACE_PHASE_EXECUTION,
                         "SampleDriver::asyncExecute");
-    CpuExecutor executor;
-    int n = executor.run(mModel, request, mPoolInfos, requestPoolInfos);
+    int n = mCpuPreparedModel.run(request, requestPoolInfos);
     VLOG(DRIVER) << "executor.run returned " << n;
     ErrorStatus executionStatus =
             n == ANEURALNETWORKS_NO_ERROR ? ErrorStatus::NONE : ErrorStatus::GENERAL_FAILURE;
@@ -154,14 +153,17 @@ Return<ErrorStatus> SamplePreparedModel::execute(const Request& request,
         LOG(ERROR) << "invalid callback passed to execute";
         return ErrorStatus::INVALID_ARGUMENT;
     }
-    if (!validateRequest(request, mModel)) {
+    if (!validateRequest(request, mCpuPreparedModel.getModel())) {
         callback->notify(ErrorStatus::INVALID_ARGUMENT);
         return ErrorStatus::INVALID_ARGUMENT;
     }
 
-    // This thread is intentionally detached because the sample driver service
-    // is expected to live forever.
-    std::thread([this, request, callback]{ asyncExecute(request, callback); }).detach();
+    // The task holds a strong reference so that the prepared model outlives
+    // the execution even if the client releases it before it runs.
+    sp<SamplePreparedModel> preparedModel = this;
+    ThreadPool::get()->schedule([preparedModel, request, callback] {
+        preparedModel->asyncExecute(request, callback);
+    });
 
     return ErrorStatus::NONE;
 }
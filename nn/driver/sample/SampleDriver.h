@@ -54,7 +54,7 @@ protected:
 
 class SamplePreparedModel : public IPreparedModel {
 public:
-    SamplePreparedModel(const Model& model) : mModel(model) {}
+    SamplePreparedModel(const Model& model) : mCpuPreparedModel(model) {}
     ~SamplePreparedModel() override {}
     bool initialize();
     Return<ErrorStatus> execute(const Request& request,
@@ -63,8 +63,7 @@ public:
 private:
     void asyncExecute(const Request& request, const sp<IExecutionCallback>& callback);
 
-    Model mModel;
-    std::vector<RunTimePoolInfo> mPoolInfos;
+    CpuPreparedModel mCpuPreparedModel;
 };
 
 } // namespace sample_driver
@@ -0,0 +1,383 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "BatchBuilder"
+
+#include "BatchBuilder.h"
+
+#include "CompilationBuilder.h"
+#include "ExecutionBuilder.h"
+#include "ModelBuilder.h"
+#include "Tracing.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace android {
+namespace nn {
+
+namespace {
+
+const uint32_t kDefaultMaxQueueSize = 16;
+const std::chrono::nanoseconds kDefaultMaxQueueDelay = std::chrono::milliseconds(1);
+
+bool isConstant(const Operand& operand) {
+    return operand.lifetime == OperandLifeTime::CONSTANT_COPY ||
+           operand.lifetime == OperandLifeTime::CONSTANT_REFERENCE;
+}
+
+// A constant operand of a broadcasting operation must not broadcast the
+// other operand along the batch dimension, or move that dimension.
+bool broadcastKeepsBatch(const ModelBuilder* model, const Operation& operation) {
+    for (uint32_t i = 0; i < 2; i++) {
+        const Operand& operand = model->getOperand(operation.inputs[i]);
+        const Operand& other = model->getOperand(operation.inputs[1 - i]);
+        if (!isConstant(operand) || isConstant(other)) {
+            continue;
+        }
+        if (operand.dimensions.size() > other.dimensions.size() ||
+            (operand.dimensions.size() == other.dimensions.size() &&
+             operand.dimensions[0] != 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The data of an argument set by pointer or from memory.
+uint8_t* getArgumentData(const MemoryTracker& memories, const ModelArgumentInfo& info) {
+    switch (info.state) {
+        case ModelArgumentInfo::POINTER:
+            return static_cast<uint8_t*>(info.buffer);
+        case ModelArgumentInfo::MEMORY: {
+            uint8_t* data = nullptr;
+            if (memories[info.locationAndLength.poolIndex]->getPointer(&data) !=
+                ANEURALNETWORKS_NO_ERROR) {
+                return nullptr;
+            }
+            return data + info.locationAndLength.offset;
+        }
+        default:
+            return nullptr;
+    }
+}
+
+}  // anonymous namespace
+
+BatchBuilder::BatchBuilder(const CompilationBuilder* compilation) :
+        mCompilation(compilation),
+        mModel(compilation->mModel),
+        mBatchable(isBatchable(mModel)),
+        mMaxQueueSize(kDefaultMaxQueueSize),
+        mMaxQueueDelay(kDefaultMaxQueueDelay) {
+    // Drivers check the dimensions of the arguments against those of the
+    // model, so a batch may only run on a device if the model leaves the
+    // first dimension of its inputs and outputs unspecified.
+    if (mBatchable && compilation->mPlan.usesDevice()) {
+        auto unspecified = [this](const std::vector<uint32_t>& indexes) {
+            return std::all_of(indexes.begin(), indexes.end(), [this](uint32_t index) {
+                return mModel->getOperand(index).dimensions[0] == 0;
+            });
+        };
+        mBatchable = unspecified(mModel->getInputOperandIndexes()) &&
+                     unspecified(mModel->getOutputOperandIndexes());
+    }
+    VLOG(EXECUTION) << "BatchBuilder::BatchBuilder batchable = " << mBatchable;
+}
+
+BatchBuilder::~BatchBuilder() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mCondition.notify_all();
+    if (mQueueThread.joinable()) {
+        mQueueThread.join();
+    }
+}
+
+bool BatchBuilder::isBatchable(const ModelBuilder* model) {
+    auto batchable = [model](const std::vector<uint32_t>& indexes) {
+        return std::all_of(indexes.begin(), indexes.end(), [model](uint32_t index) {
+            const Operand& operand = model->getOperand(index);
+            return !operand.dimensions.empty() && operand.dimensions[0] <= 1;
+        });
+    };
+    if (!batchable(model->getInputOperandIndexes()) ||
+        !batchable(model->getOutputOperandIndexes())) {
+        return false;
+    }
+    for (const Operation& operation : model->getOperations()) {
+        switch (operation.type) {
+            case OperationType::ADD:
+            case OperationType::DIV:
+            case OperationType::MUL:
+            case OperationType::SUB:
+                if (!broadcastKeepsBatch(model, operation)) {
+                    return false;
+                }
+                break;
+            case OperationType::CONCATENATION: {
+                const Operand& axis = model->getOperand(operation.inputs.back());
+                if (axis.lifetime != OperandLifeTime::CONSTANT_COPY) {
+                    return false;
+                }
+                int32_t value;
+                memcpy(&value, model->getPointerToOperandValue(axis.location.offset),
+                       sizeof(value));
+                if (value == 0) {
+                    return false;
+                }
+                break;
+            }
+            case OperationType::AVERAGE_POOL_2D:
+            case OperationType::CONV_2D:
+            case OperationType::DEPTHWISE_CONV_2D:
+            case OperationType::DEPTH_TO_SPACE:
+            case OperationType::DEQUANTIZE:
+            case OperationType::FLOOR:
+            case OperationType::FULLY_CONNECTED:
+            case OperationType::L2_NORMALIZATION:
+            case OperationType::L2_POOL_2D:
+            case OperationType::LOCAL_RESPONSE_NORMALIZATION:
+            case OperationType::LOGISTIC:
+            case OperationType::MAX_POOL_2D:
+            case OperationType::RELU:
+            case OperationType::RELU1:
+            case OperationType::RELU6:
+            case OperationType::RESIZE_BILINEAR:
+            case OperationType::SOFTMAX:
+            case OperationType::SPACE_TO_DEPTH:
+            case OperationType::TANH:
+                break;
+            default:
+                // E.g. RESHAPE, whose target shape includes the batch; or
+                // the recurrent operations, whose state is per model.
+                return false;
+        }
+    }
+    return true;
+}
+
+bool BatchBuilder::computeBatched(const std::vector<ExecutionBuilder*>& executions) {
+    if (!mBatchable || executions.size() < 2) {
+        return false;
+    }
+    NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "BatchBuilder::computeBatched");
+    const uint32_t batchSize = static_cast<uint32_t>(executions.size());
+    ExecutionBuilder batch(mCompilation);
+
+    // Checks that the arguments of the executions all have the same
+    // dimensions, with a first dimension of 1, and sets the argument of
+    // batch to a staging buffer for all of them.  For inputs, also copies
+    // the data of the executions to the staging buffer.
+    auto stage = [&executions, batchSize](bool isInput, uint32_t index,
+                                          std::vector<uint8_t>* staging,
+                                          ModelArgumentInfo* batchInfo) {
+        auto getInfo = [isInput, index](const ExecutionBuilder* execution)
+                -> const ModelArgumentInfo& {
+            return isInput ? execution->mInputs[index] : execution->mOutputs[index];
+        };
+        const ModelArgumentInfo& first = getInfo(executions[0]);
+        const uint32_t length = first.locationAndLength.length;
+        if (first.dimensions.empty() || first.dimensions[0] != 1 ||
+            uint64_t(length) * batchSize > 0xFFFFFFFF) {
+            return false;
+        }
+        staging->resize(length * batchSize);
+        for (uint32_t i = 0; i < batchSize; i++) {
+            const ModelArgumentInfo& info = getInfo(executions[i]);
+            if ((info.state != ModelArgumentInfo::POINTER &&
+                 info.state != ModelArgumentInfo::MEMORY) ||
+                info.dimensions != first.dimensions || info.locationAndLength.length != length) {
+                return false;
+            }
+            if (isInput) {
+                const uint8_t* data = getArgumentData(executions[i]->mMemories, info);
+                if (data == nullptr) {
+                    return false;
+                }
+                memcpy(staging->data() + i * length, data, length);
+            }
+        }
+        batchInfo->state = ModelArgumentInfo::POINTER;
+        batchInfo->buffer = staging->data();
+        batchInfo->locationAndLength = {.poolIndex = 0, .offset = 0,
+                                        .length = length * batchSize};
+        batchInfo->dimensions = first.dimensions;
+        batchInfo->dimensions[0] = batchSize;
+        return true;
+    };
+
+    std::vector<std::vector<uint8_t>> inputs(mModel->inputCount());
+    for (uint32_t i = 0; i < inputs.size(); i++) {
+        if (!stage(true, i, &inputs[i], &batch.mInputs[i])) {
+            VLOG(EXECUTION) << "BatchBuilder cannot pack input " << i;
+            return false;
+        }
+    }
+    std::vector<std::vector<uint8_t>> outputs(mModel->outputCount());
+    for (uint32_t i = 0; i < outputs.size(); i++) {
+        if (!stage(false, i, &outputs[i], &batch.mOutputs[i])) {
+            VLOG(EXECUTION) << "BatchBuilder cannot pack output " << i;
+            return false;
+        }
+    }
+
+    VLOG(EXECUTION) << "BatchBuilder::computeBatched " << batchSize << " executions";
+    int n = batch.compute();
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        VLOG(EXECUTION) << "BatchBuilder batched computation failed: " << n;
+        return false;
+    }
+    mBatchedComputationCount++;
+
+    for (uint32_t i = 0; i < outputs.size(); i++) {
+        const uint32_t length = batch.mOutputs[i].locationAndLength.length / batchSize;
+        for (uint32_t j = 0; j < batchSize; j++) {
+            const ExecutionBuilder* execution = executions[j];
+            uint8_t* data = getArgumentData(execution->mMemories, execution->mOutputs[i]);
+            memcpy(data, outputs[i].data() + j * length, length);
+        }
+    }
+    return true;
+}
+
+int BatchBuilder::compute(const std::vector<ExecutionBuilder*>& executions) {
+    for (ExecutionBuilder* execution : executions) {
+        if (execution->mPlan != &mCompilation->mPlan) {
+            LOG(ERROR) << "ANeuralNetworksBatch_compute passed an execution of another "
+                          "compilation";
+            return ANEURALNETWORKS_BAD_DATA;
+        }
+        int n = execution->checkCanCompute("ANeuralNetworksBatch_compute");
+        if (n != ANEURALNETWORKS_NO_ERROR) {
+            return n;
+        }
+    }
+    std::vector<ExecutionBuilder*> sorted(executions);
+    std::sort(sorted.begin(), sorted.end());
+    if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+        LOG(ERROR) << "ANeuralNetworksBatch_compute passed the same execution more than once";
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+
+    for (ExecutionBuilder* execution : executions) {
+        execution->startComputation();
+    }
+    int n = ANEURALNETWORKS_NO_ERROR;
+    if (!computeBatched(executions)) {
+        // Every execution has been started, so each one is computed even if
+        // an earlier one fails; the first error is returned.
+        for (ExecutionBuilder* execution : executions) {
+            int result = execution->computeChecked();
+            if (n == ANEURALNETWORKS_NO_ERROR) {
+                n = result;
+            }
+        }
+    }
+    for (ExecutionBuilder* execution : executions) {
+        execution->finishComputation();
+    }
+    return n;
+}
+
+int BatchBuilder::setQueueLimits(uint32_t maxSize, std::chrono::nanoseconds maxDelay) {
+    if (maxSize == 0) {
+        LOG(ERROR) << "ANeuralNetworksBatch_setQueueLimits passed a maxSize of 0";
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mMaxQueueSize = maxSize;
+        mMaxQueueDelay = maxDelay;
+    }
+    mCondition.notify_all();
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+int BatchBuilder::startCompute(ExecutionBuilder* execution,
+                               sp<ExecutionCallback>* synchronizationCallback) {
+    *synchronizationCallback = nullptr;
+    if (execution->mPlan != &mCompilation->mPlan) {
+        LOG(ERROR) << "ANeuralNetworksBatch_startCompute passed an execution of another "
+                      "compilation";
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    // Also fails if the execution is still queued.
+    int n = execution->checkCanCompute("ANeuralNetworksBatch_startCompute");
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return n;
+    }
+    execution->startComputation();
+
+    sp<ExecutionCallback> executionCallback = new ExecutionCallback();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mQueueThread.joinable()) {
+            mQueueThread = std::thread([this] { runQueue(); });
+        }
+        if (mQueue.empty()) {
+            mQueueDeadline = std::chrono::steady_clock::now() + mMaxQueueDelay;
+        }
+        mQueue.push_back({execution, executionCallback});
+    }
+    mCondition.notify_all();
+    *synchronizationCallback = executionCallback;
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+void BatchBuilder::runQueue() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mCondition.wait(lock, [this] { return mStopping || !mQueue.empty(); });
+        if (mQueue.empty()) {
+            return;
+        }
+        // Executions left over from a full batch are already late.
+        mCondition.wait_until(lock, mQueueDeadline, [this] {
+            return mStopping || mQueue.size() >= mMaxQueueSize;
+        });
+        const size_t count = std::min<size_t>(mQueue.size(), mMaxQueueSize);
+        std::vector<QueuedExecution> queued(mQueue.begin(), mQueue.begin() + count);
+        mQueue.erase(mQueue.begin(), mQueue.begin() + count);
+        lock.unlock();
+
+        std::vector<ExecutionBuilder*> executions;
+        executions.reserve(count);
+        for (const auto& q : queued) {
+            executions.push_back(q.execution);
+        }
+        if (computeBatched(executions)) {
+            for (const auto& q : queued) {
+                q.execution->finishComputation();
+                q.callback->notify(ErrorStatus::NONE);
+            }
+        } else {
+            for (const auto& q : queued) {
+                const int n = q.execution->computeChecked();
+                q.execution->finishComputation();
+                q.callback->notify(convertResultCodeToErrorStatus(n));
+            }
+        }
+
+        lock.lock();
+    }
+}
+
+}  // namespace nn
+}  // namespace android
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_ML_NN_RUNTIME_BATCH_BUILDER_H
+#define ANDROID_ML_NN_RUNTIME_BATCH_BUILDER_H
+
+#include "Callbacks.h"
+#include "NeuralNetworks.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using ::android::hardware::neuralnetworks::V1_0::implementation::ExecutionCallback;
+
+namespace android {
+namespace nn {
+
+class CompilationBuilder;
+class ExecutionBuilder;
+class ModelBuilder;
+
+// Evaluates several executions of the same compilation as one.
+//
+// Each execution describes a single sample: its inputs and outputs have a
+// first dimension of 1.  The inputs of the executions are packed along
+// that dimension into staging buffers, the model is run once with a batch
+// of N, and the outputs are scattered back to the executions.  This only
+// works for models whose operations process the samples of a batch
+// independently, see isBatchable(); for other models, and for executions
+// that cannot be packed, the executions are computed one at a time.
+//
+// Executions may either be computed together with compute(), or queued
+// with startCompute(): the queue is then run as a batch once it holds
+// mMaxQueueSize executions, or mMaxQueueDelay after the first of them was
+// queued, whichever comes first.  The executions follow the same rules as
+// with ExecutionBuilder::compute(): one that is not reusable may only be
+// computed once, and none may be computed again before its computation is
+// done, so an execution may not appear twice in a batch either.
+class BatchBuilder {
+public:
+    BatchBuilder(const CompilationBuilder* compilation);
+    // Runs the executions still queued.
+    ~BatchBuilder();
+
+    int compute(const std::vector<ExecutionBuilder*>& executions);
+
+    int setQueueLimits(uint32_t maxSize, std::chrono::nanoseconds maxDelay);
+    int startCompute(ExecutionBuilder* execution, sp<ExecutionCallback>* synchronizationCallback);
+
+    // Whether the operations of the model process the samples of a batch
+    // independently, and its inputs and outputs have a first dimension
+    // that can be the size of the batch.
+    static bool isBatchable(const ModelBuilder* model);
+
+    // The number of computations of several executions as one, for tests.
+    uint32_t getBatchedComputationCount() const { return mBatchedComputationCount; }
+
+private:
+    // Checks that the executions can be packed, and if so computes them as
+    // one.  Returns false if they cannot, or if the batched computation
+    // failed, in which case the executions must be computed one at a time.
+    bool computeBatched(const std::vector<ExecutionBuilder*>& executions);
+
+    void runQueue();
+
+    const CompilationBuilder* mCompilation;
+    const ModelBuilder* mModel;
+    bool mBatchable;
+
+    struct QueuedExecution {
+        ExecutionBuilder* execution;
+        sp<ExecutionCallback> callback;
+    };
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::vector<QueuedExecution> mQueue;
+    // When the queue must be run, if it does not fill up first.
+    std::chrono::steady_clock::time_point mQueueDeadline;
+    uint32_t mMaxQueueSize;
+    std::chrono::nanoseconds mMaxQueueDelay;
+    bool mStopping = false;
+    // Started by the first call to startCompute().  This is a thread of its
+    // own rather than a task of ThreadPool::get(): it sleeps until the
+    // deadline of the queue for as long as the batch lives, which would
+    // keep one of the few workers of the pool from running the executions
+    // and their steps.
+    std::thread mQueueThread;
+    std::atomic<uint32_t> mBatchedComputationCount{0};
+};
+
+}  // namespace nn
+}  // namespace android
+
+#endif  // ANDROID_ML_NN_RUNTIME_BATCH_BUILDER_H
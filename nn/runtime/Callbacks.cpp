@@ -54,6 +54,12 @@ bool CallbackBase::on_finish(std::function<bool(void)> post_work) {
         LOG(ERROR) << "CallbackBase::on_finish -- the new post-work function is invalid";
         return false;
     }
+    if (mNotified) {
+        if (!post_work()) {
+            LOG(ERROR) << "CallbackBase::on_finish -- post work failed";
+        }
+        return true;
+    }
     mPostWork = std::move(post_work);
     return true;
 }
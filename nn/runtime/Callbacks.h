@@ -97,8 +97,8 @@ class CallbackBase {
      * callback object it is bound to, as this could cause a deadlock.
      *
      * CallbackBase::on_finish can be called at most once on a given callback
-     * object, and the call to CallbackBase::on_finish must finish before
-     * CallbackBase::notify is called.
+     * object.  If CallbackBase::notify has already been called, the function
+     * is executed by CallbackBase::on_finish itself.
      *
      * @param post_work Function to be invoked the first time
      *                  CallbackBase::notify is called. Must have a target --
@@ -18,17 +18,21 @@
 
 #include "CompilationBuilder.h"
 
+#include "BatchBuilder.h"
 #include "ExecutionBuilder.h"
 #include "ExecutionPlan.h"
 #include "Manager.h"
 #include "ModelBuilder.h"
+#include "PerformanceHistory.h"
+#include "StreamBuilder.h"
 #include "Utils.h"
 
 namespace android {
 namespace nn {
 
 CompilationBuilder::CompilationBuilder(const ModelBuilder* model) :
-        mModel(model), mPartitioning(DeviceManager::get()->getPartitioning()) {
+        mModel(model), mPartitioning(DeviceManager::get()->getPartitioning()),
+        mPartitioner(DeviceManager::get()->getPartitioner()) {
     VLOG(COMPILATION) << "CompilationBuilder::CompilationBuilder";
 }
 
@@ -47,7 +51,8 @@ int CompilationBuilder::finish(const std::vector<std::shared_ptr<Device>>& devic
     mFinished = true;
 
     if (mPartitioning) {
-        int n = mModel->partitionTheWork(devices, mPreference, &mPlan);
+        int n = mModel->partitionTheWork(devices, mPreference, mPartitioner,
+                                         PerformanceHistory::get(), &mPlan);
         switch (n) {
             case ANEURALNETWORKS_NO_ERROR:
                 break;
@@ -68,9 +73,41 @@ int CompilationBuilder::finish(const std::vector<std::shared_ptr<Device>>& devic
         }
     }
 
+    if (mPlan.usesDevice()) {
+        reserveArgumentMemory();
+    }
+
     return ANEURALNETWORKS_NO_ERROR;
 }
 
+// Size of the region that StepExecutor::allocatePointerArgumentsToPool()
+// lays the given operands out in, or 0 if not known until execution time.
+static uint64_t getPointerArgumentsSize(const ModelBuilder* model,
+                                        const std::vector<uint32_t>& operandIndexes) {
+    uint64_t total = 0;
+    for (uint32_t operandIndex : operandIndexes) {
+        const uint32_t size = sizeOfData(model->getOperand(operandIndex));
+        if (size == 0) {
+            return 0;
+        }
+        total += alignBytesNeeded(static_cast<uint32_t>(total), size);
+        total += size;
+    }
+    return total;
+}
+
+void CompilationBuilder::reserveArgumentMemory() {
+    for (const auto* operandIndexes : {&mModel->getInputOperandIndexes(),
+                                       &mModel->getOutputOperandIndexes()}) {
+        const uint64_t size = getPointerArgumentsSize(mModel, *operandIndexes);
+        if (size > 0 && size <= 0xFFFFFFFF &&
+            mMemoryPool->reserve(static_cast<uint32_t>(size)) != ANEURALNETWORKS_NO_ERROR) {
+            // Not fatal: the executions allocate what they need.
+            VLOG(COMPILATION) << "Could not reserve " << size << " bytes for arguments";
+        }
+    }
+}
+
 int CompilationBuilder::setPreference(int32_t preference) {
     if (mFinished) {
         LOG(ERROR) <<
@@ -97,6 +134,17 @@ int CompilationBuilder::setPartitioning(uint32_t partitioning) {
     return ANEURALNETWORKS_NO_ERROR;
 }
 
+int CompilationBuilder::setPartitioner(uint32_t partitioner) {
+    if (mFinished) {
+        LOG(ERROR) <<
+                "ANeuralNetworksCompilation_setPartitioner can't modify after compilation finished";
+        return ANEURALNETWORKS_BAD_STATE;
+    }
+
+    mPartitioner = partitioner;
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
 int CompilationBuilder::createExecution(ExecutionBuilder **execution) {
     if (!mFinished) {
         LOG(ERROR) << "ANeuralNetworksExecution_create passed an unfinished compilation";
@@ -107,5 +155,25 @@ int CompilationBuilder::createExecution(ExecutionBuilder **execution) {
     return (*execution ? ANEURALNETWORKS_NO_ERROR : ANEURALNETWORKS_OUT_OF_MEMORY);
 }
 
+int CompilationBuilder::createBatch(BatchBuilder** batch) {
+    if (!mFinished) {
+        LOG(ERROR) << "ANeuralNetworksBatch_create passed an unfinished compilation";
+        *batch = nullptr;
+        return ANEURALNETWORKS_BAD_STATE;
+    }
+    *batch = new (std::nothrow) BatchBuilder(this);
+    return (*batch ? ANEURALNETWORKS_NO_ERROR : ANEURALNETWORKS_OUT_OF_MEMORY);
+}
+
+int CompilationBuilder::createStream(StreamBuilder** stream) {
+    if (!mFinished) {
+        LOG(ERROR) << "ANeuralNetworksStream_create passed an unfinished compilation";
+        *stream = nullptr;
+        return ANEURALNETWORKS_BAD_STATE;
+    }
+    *stream = new (std::nothrow) StreamBuilder(this);
+    return (*stream ? ANEURALNETWORKS_NO_ERROR : ANEURALNETWORKS_OUT_OF_MEMORY);
+}
+
 }  // namespace nn
 }  // namespace android
@@ -26,12 +26,15 @@
 namespace android {
 namespace nn {
 
+class BatchBuilder;
 class Device;
 class ExecutionBuilder;
 class ModelBuilder;
+class StreamBuilder;
 
 class CompilationBuilder {
 public:
+    friend class BatchBuilder;
     friend class ExecutionBuilder;  // TODO remove this
 
     CompilationBuilder(const ModelBuilder* model);
@@ -40,15 +43,29 @@ public:
 
     int setPartitioning(uint32_t partitioning);
 
+    int setPartitioner(uint32_t partitioner);
+
+    int registerBuffer(const Memory* memory, void* buffer) {
+        return mRegisteredBuffers->add(memory, buffer);
+    }
+
     int finish();
 
     int finish(const std::vector<std::shared_ptr<Device>>& devices);
 
     int createExecution(ExecutionBuilder** execution);
 
+    int createBatch(BatchBuilder** batch);
+
+    int createStream(StreamBuilder** stream);
+
     const ExecutionPlan& forTest_getExecutionPlan() const { return mPlan; }
 
 private:
+    // Allocates, ahead of the first execution, the shared memory that the
+    // inputs and the outputs of the model take when passed by pointer.
+    void reserveArgumentMemory();
+
     const ModelBuilder* mModel;
 
     ExecutionPlan mPlan;
@@ -61,6 +78,19 @@ private:
     // we can override this later.
     uint32_t mPartitioning;
 
+    // See class DeviceManager.  Captured from DeviceManager like
+    // mPartitioning.
+    uint32_t mPartitioner;
+
+    // Shared memory for the pointer arguments of the executions, see
+    // StepExecutor::allocatePointerArgumentsToPool().
+    std::shared_ptr<SharedMemoryPool> mMemoryPool = std::make_shared<SharedMemoryPool>();
+
+    // The buffers registered by the application, see
+    // StepExecutor::allocatePointerArgumentsToPool().
+    std::shared_ptr<RegisteredBuffers> mRegisteredBuffers =
+            std::make_shared<RegisteredBuffers>();
+
     // Once the compilation has been finished, we should not allow further
     // modifications to the compilation.
     bool mFinished = false;
@@ -23,11 +23,14 @@
 #include "HalInterfaces.h"
 #include "Manager.h"
 #include "ModelBuilder.h"
+#include "PerformanceHistory.h"
+#include "ThreadPool.h"
 #include "Tracing.h"
 #include "Utils.h"
 
+#include <chrono>
+#include <memory>
 #include <mutex>
-#include <thread>
 #include <vector>
 
 namespace android {
@@ -130,6 +133,8 @@ ExecutionBuilder::ExecutionBuilder(const CompilationBuilder* compilation) :
         mModel(compilation->mModel),
         mPlan(&compilation->mPlan),
         mPartitioning(compilation->mPartitioning),
+        mMemoryPool(compilation->mMemoryPool),
+        mRegisteredBuffers(compilation->mRegisteredBuffers),
         mInputs(mModel->inputCount()),
         mOutputs(mModel->outputCount()) {
     VLOG(EXECUTION) << "ExecutionBuilder::ExecutionBuilder";
@@ -137,13 +142,17 @@ ExecutionBuilder::ExecutionBuilder(const CompilationBuilder* compilation) :
 
 int ExecutionBuilder::setInput(uint32_t index, const ANeuralNetworksOperandType* type,
                                const void* buffer, size_t length) {
+    int n = checkNotComputing("ANeuralNetworksExecution_setInput");
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return n;
+    }
     uint32_t count = static_cast<uint32_t>(mInputs.size());
     if (index >= count) {
         LOG(ERROR) << "ANeuralNetworksExecution_setInput bad index " << index << " " << count;
         return ANEURALNETWORKS_BAD_DATA;
     }
     if (type != nullptr) {
-        int n = validateOperandType(*type, "ANeuralNetworksExecution_setInput", false);
+        n = validateOperandType(*type, "ANeuralNetworksExecution_setInput", false);
         if (n != ANEURALNETWORKS_NO_ERROR) {
             return n;
         }
@@ -161,6 +170,10 @@ int ExecutionBuilder::setInputFromMemory(uint32_t index, const ANeuralNetworksOp
                                          const Memory* memory, size_t offset, size_t length) {
     // Should be similar to StepExecutor::setInputOrOutputFromTemporaryMemory()
 
+    int n = checkNotComputing("ANeuralNetworksExecution_setInputFromMemory");
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return n;
+    }
     uint32_t count = static_cast<uint32_t>(mInputs.size());
     if (index >= count) {
         LOG(ERROR) << "ANeuralNetworksExecution_setInputFromMemory bad index " << index << " "
@@ -178,13 +191,17 @@ int ExecutionBuilder::setInputFromMemory(uint32_t index, const ANeuralNetworksOp
 
 int ExecutionBuilder::setOutput(uint32_t index, const ANeuralNetworksOperandType* type, void* buffer,
                                 size_t length) {
+    int n = checkNotComputing("ANeuralNetworksExecution_setOutput");
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return n;
+    }
     uint32_t count = static_cast<uint32_t>(mOutputs.size());
     if (index >= count) {
         LOG(ERROR) << "ANeuralNetworksExecution_setOutput bad index " << index << " " << count;
         return ANEURALNETWORKS_BAD_DATA;
     }
     if (type != nullptr) {
-        int n = validateOperandType(*type, "ANeuralNetworksExecution_setOutput", false);
+        n = validateOperandType(*type, "ANeuralNetworksExecution_setOutput", false);
         if (n != ANEURALNETWORKS_NO_ERROR) {
             return n;
         }
@@ -201,6 +218,10 @@ int ExecutionBuilder::setOutputFromMemory(uint32_t index, const ANeuralNetworksO
                                           const Memory* memory, size_t offset, size_t length) {
     // Should be similar to StepExecutor::setInputOrOutputFromTemporaryMemory()
 
+    int n = checkNotComputing("ANeuralNetworksExecution_setOutputFromMemory");
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return n;
+    }
     uint32_t count = static_cast<uint32_t>(mOutputs.size());
     if (index >= count) {
         LOG(ERROR) << "ANeuralNetworksExecution_setOutputFromMemory bad index " << index << " "
@@ -216,136 +237,388 @@ int ExecutionBuilder::setOutputFromMemory(uint32_t index, const ANeuralNetworksO
                                          length);
 }
 
+// Points the argument to another buffer, if it was set from a buffer.
+static int rebindPointerArgument(const char* name, std::vector<ModelArgumentInfo>* arguments,
+                                 uint32_t index, void* buffer) {
+    if (index >= arguments->size()) {
+        LOG(ERROR) << name << " bad index " << index << " " << arguments->size();
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    ModelArgumentInfo& info = (*arguments)[index];
+    if (info.state != ModelArgumentInfo::POINTER || buffer == nullptr) {
+        LOG(ERROR) << name << " argument " << index << " is not set from a buffer";
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    info.buffer = buffer;
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+int ExecutionBuilder::rebindInput(uint32_t index, const void* buffer) {
+    int n = checkNotComputing("ExecutionBuilder::rebindInput");
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return n;
+    }
+    return rebindPointerArgument("ExecutionBuilder::rebindInput", &mInputs, index,
+                                 const_cast<void*>(buffer));
+}
+
+int ExecutionBuilder::rebindOutput(uint32_t index, void* buffer) {
+    int n = checkNotComputing("ExecutionBuilder::rebindOutput");
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return n;
+    }
+    return rebindPointerArgument("ExecutionBuilder::rebindOutput", &mOutputs, index, buffer);
+}
+
 // Attempt synchronous execution of full model on CPU.
-// Ensure that executionCallback->notify() is called.
-static void cpuFallbackFull(const ExecutionBuilder* executionBuilder,
-                            const sp<ExecutionCallback>& executionCallback) {
+static int cpuFallbackFull(const ExecutionBuilder* executionBuilder) {
     NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "cpuFallbackFull");
     VLOG(EXECUTION) << "cpuFallbackFull";
     StepExecutor executor(executionBuilder, executionBuilder->getModel(),
-                          nullptr /* no VersionedIDevice, so CPU */,
-                          nullptr /* no IPreparedModel */);
+                          nullptr /* no Device, so CPU */,
+                          nullptr /* no IPreparedModel */,
+                          nullptr /* no CpuPreparedModel, so prepare */);
     executor.mapInputsAndOutputsTrivially();
-    sp<ExecutionCallback> fallbackCallback;
-    int n = executor.startCompute(&fallbackCallback);
-    if (n != ANEURALNETWORKS_NO_ERROR) {
-        executionCallback->notify(convertResultCodeToErrorStatus(n));
-        return;
-    }
-    fallbackCallback->wait();
-    executionCallback->notify(fallbackCallback->getStatus());
+    return executor.compute();
 }
 
 // Attempt synchronous execution on CPU.
 // (1) First, attempt to execute this step on CPU.  If successful,
-//     return true.  (Do not call executionCallback->notify().)
-// (2) If unsuccessful, attempt to execute the full model on CPU,
-//     ensure that executionCallback->notify() is called, and return
-//     false.
+//     return true.
+// (2) If unsuccessful, attempt to execute the full model on CPU, set
+//     *fullResult to the outcome, and return false.
 static bool cpuFallbackPartial(const ExecutionBuilder* executionBuilder,
                                const ExecutionPlan* plan,
                                std::shared_ptr<ExecutionPlan::Controller> controller,
-                               const sp<ExecutionCallback>& executionCallback) {
+                               int* fullResult) {
     NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "cpuFallbackPartial");
     VLOG(EXECUTION) << "cpuFallbackPartial";
     std::shared_ptr<StepExecutor> executor;
     int n = plan->fallback(controller, &executor);
-    if (n != ANEURALNETWORKS_NO_ERROR || executor->isCpu()) {
-        cpuFallbackFull(executionBuilder, executionCallback);
-        return false;
-    }
-    sp<ExecutionCallback> fallbackCallback;
-    if (executor->startComputeOnCpu(&fallbackCallback) != ANEURALNETWORKS_NO_ERROR) {
-        cpuFallbackFull(executionBuilder, executionCallback);
-        return false;
+    if (n == ANEURALNETWORKS_NO_ERROR && !executor->isCpu() &&
+        executor->computeOnCpu() == ANEURALNETWORKS_NO_ERROR) {
+        return true;
     }
-    fallbackCallback->wait();
-    if (fallbackCallback->getStatus() != ErrorStatus::NONE) {
-        cpuFallbackFull(executionBuilder, executionCallback);
-        return false;
-    }
-    return true;
+    *fullResult = cpuFallbackFull(executionBuilder);
+    return false;
 }
 
-static void asyncStartComputePartitioned(const ExecutionBuilder* executionBuilder,
-                                         const ExecutionPlan* plan,
-                                         std::shared_ptr<ExecutionPlan::Controller> controller,
-                                         bool allowFallback,
-                                         const sp<ExecutionCallback>& executionCallback) {
-    VLOG(EXECUTION) << "ExecutionBuilder::startCompute (from plan, iteratively)";
+// Executes the steps of a plan one at a time, in order, on the calling
+// thread.
+static int computePartitioned(const ExecutionBuilder* executionBuilder,
+                              const ExecutionPlan* plan,
+                              std::shared_ptr<ExecutionPlan::Controller> controller,
+                              bool allowFallback) {
+    VLOG(EXECUTION) << "ExecutionBuilder::compute (from plan, iteratively)";
     while (true) {
         std::shared_ptr<StepExecutor> executor;
         VLOG(EXECUTION) << "looking for next StepExecutor";
         int n = plan->next(controller, &executor);
         if (n != ANEURALNETWORKS_NO_ERROR) {
-            if (allowFallback) {
-                cpuFallbackFull(executionBuilder, executionCallback);
-            } else {
-                executionCallback->notify(convertResultCodeToErrorStatus(n));
-            }
-            return;
+            return allowFallback ? cpuFallbackFull(executionBuilder) : n;
         }
         if (executor == nullptr) {
-            executionCallback->notify(ErrorStatus::NONE);
-            return;
+            return ANEURALNETWORKS_NO_ERROR;
         }
 
-        sp<ExecutionCallback> stepCallback;
-        n = executor->startCompute(&stepCallback);
+        n = executor->compute();
         if (n != ANEURALNETWORKS_NO_ERROR) {
-            if (allowFallback) {
-                if (cpuFallbackPartial(executionBuilder, plan, controller, executionCallback)) {
-                    // Successfully executed one step on CPU.
-                    continue;
-                } else {
-                    // Either successfully executed entire plan on
-                    // CPU, or tried and failed to do so.
-                    return;
-                }
-            } else {
-                executionCallback->notify(convertResultCodeToErrorStatus(n));
-                return;
+            if (!allowFallback) {
+                return n;
+            }
+            if (!cpuFallbackPartial(executionBuilder, plan, controller, &n)) {
+                // Either successfully executed entire plan on
+                // CPU, or tried and failed to do so.
+                return n;
             }
+            // Successfully executed one step on CPU.
+        }
+    }
+}
+
+namespace {
+
+// State shared by the tasks running the steps of a plan concurrently, see
+// asyncStartComputeConcurrently().
+struct ConcurrentExecution {
+    const ExecutionBuilder* executionBuilder;
+    const ExecutionPlan* plan;
+    std::shared_ptr<ExecutionPlan::Controller> controller;
+    bool allowFallback;
+    sp<ExecutionCallback> executionCallback;
+
+    std::mutex mutex;
+    // For each step, the number of steps it depends on that have not
+    // completed yet.  The step is launched when this gets to zero.
+    std::vector<uint32_t> pendingPredecessors;
+    // Steps launched and not completed yet.
+    uint32_t launchedSteps = 0;
+    uint32_t completedSteps = 0;
+    // Steps actually computing, for tracing.
+    uint32_t runningCpuSteps = 0;
+    uint32_t runningDeviceSteps = 0;
+    // Status of the first step that failed.  Once a step has failed, no
+    // other step is launched.
+    ErrorStatus status = ErrorStatus::NONE;
+};
+
+}  // namespace
+
+static void launchConcurrentStep(const std::shared_ptr<ConcurrentExecution>& execution,
+                                 uint32_t stepIndex);
+
+static void traceRunningSteps(ConcurrentExecution* execution, bool isCpu, int delta) {
+    std::lock_guard<std::mutex> lock(execution->mutex);
+    if (isCpu) {
+        execution->runningCpuSteps += delta;
+        NNTRACE_COUNTER(NNTRACE_LAYER_RUNTIME, "runningCpuSteps", execution->runningCpuSteps);
+    } else {
+        execution->runningDeviceSteps += delta;
+        NNTRACE_COUNTER(NNTRACE_LAYER_RUNTIME, "runningDeviceSteps",
+                        execution->runningDeviceSteps);
+    }
+}
+
+// Runs the executor synchronously.
+static ErrorStatus computeStep(ConcurrentExecution* execution, StepExecutor* executor,
+                               bool onCpu) {
+    traceRunningSteps(execution, onCpu, 1);
+    int n = onCpu ? executor->computeOnCpu() : executor->compute();
+    traceRunningSteps(execution, onCpu, -1);
+    return convertResultCodeToErrorStatus(n);
+}
+
+// Records the completion of a step, and launches the steps that were only
+// waiting for it.  Whichever step completes last finishes the execution:
+// it notifies executionCallback, or runs the full model on the CPU if a
+// step failed and fallback is allowed.
+static void completeConcurrentStep(const std::shared_ptr<ConcurrentExecution>& execution,
+                                   uint32_t stepIndex, ErrorStatus status) {
+    std::vector<uint32_t> readySteps;
+    bool finished = false;
+    {
+        std::lock_guard<std::mutex> lock(execution->mutex);
+        execution->completedSteps++;
+        if (status != ErrorStatus::NONE && execution->status == ErrorStatus::NONE) {
+            execution->status = status;
         }
-        stepCallback->wait();
-        ErrorStatus status = stepCallback->getStatus();
-        if (status != ErrorStatus::NONE) {
-            if (allowFallback) {
-                if (cpuFallbackPartial(executionBuilder, plan, controller, executionCallback)) {
-                    // Successfully executed one step on CPU.
-                    continue;
-                } else {
-                    // Either successfully executed entire plan on
-                    // CPU, or tried and failed to do so.
-                    return;
+        if (execution->status == ErrorStatus::NONE) {
+            for (uint32_t successor : execution->plan->getStepSuccessors(stepIndex)) {
+                if (--execution->pendingPredecessors[successor] == 0) {
+                    readySteps.push_back(successor);
                 }
-            } else {
-                executionCallback->notify(status);
-                return;
             }
         }
+        execution->launchedSteps += readySteps.size();
+        finished = (execution->launchedSteps == execution->completedSteps);
+    }
+
+    for (uint32_t readyStep : readySteps) {
+        launchConcurrentStep(execution, readyStep);
+    }
+    if (!finished) {
+        return;
+    }
+    // No other step is running, and none will be launched.
+    if (execution->status == ErrorStatus::NONE) {
+        nnAssert(execution->completedSteps == execution->plan->getStepCount());
+        execution->executionCallback->notify(ErrorStatus::NONE);
+    } else if (execution->allowFallback) {
+        execution->executionCallback->notify(
+                convertResultCodeToErrorStatus(cpuFallbackFull(execution->executionBuilder)));
+    } else {
+        execution->executionCallback->notify(execution->status);
     }
 }
 
-int ExecutionBuilder::startCompute(sp<ExecutionCallback>* synchronizationCallback) {
-    *synchronizationCallback = nullptr;
+static void runConcurrentStep(const std::shared_ptr<ConcurrentExecution>& execution,
+                              uint32_t stepIndex) {
+    NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "runConcurrentStep");
+    VLOG(EXECUTION) << "runConcurrentStep " << stepIndex;
+    std::shared_ptr<StepExecutor> executor;
+    int n = execution->plan->makeStepExecutor(execution->controller, stepIndex, &executor);
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        completeConcurrentStep(execution, stepIndex, convertResultCodeToErrorStatus(n));
+        return;
+    }
+    const bool isCpu = executor->isCpu();
+    ErrorStatus status = computeStep(execution.get(), executor.get(), isCpu);
+    if (status != ErrorStatus::NONE && execution->allowFallback && !isCpu) {
+        // Attempt to execute this step on CPU, like cpuFallbackPartial().
+        VLOG(EXECUTION) << "runConcurrentStep " << stepIndex << " falling back to CPU";
+        n = execution->plan->makeStepExecutor(execution->controller, stepIndex, &executor);
+        status = (n == ANEURALNETWORKS_NO_ERROR)
+                ? computeStep(execution.get(), executor.get(), true)
+                : convertResultCodeToErrorStatus(n);
+    }
+    completeConcurrentStep(execution, stepIndex, status);
+}
+
+static void launchConcurrentStep(const std::shared_ptr<ConcurrentExecution>& execution,
+                                 uint32_t stepIndex) {
+    // A step task only waits for its own computation, never for other
+    // tasks of the pool, so it may be queued from a worker.
+    ThreadPool::get()->scheduleNonBlocking([execution, stepIndex] {
+        runConcurrentStep(execution, stepIndex);
+    });
+}
 
+// Executes the steps of a plan as soon as the steps they depend on have
+// completed, rather than one at a time, so that steps on different devices
+// (or on a device and the CPU) overlap.  Returns immediately: the step tasks
+// notify executionCallback.
+static void asyncStartComputeConcurrently(const ExecutionBuilder* executionBuilder,
+                                          const ExecutionPlan* plan,
+                                          std::shared_ptr<ExecutionPlan::Controller> controller,
+                                          bool allowFallback,
+                                          const sp<ExecutionCallback>& executionCallback) {
+    VLOG(EXECUTION) << "ExecutionBuilder::startCompute (from plan, concurrently)";
+    auto execution = std::make_shared<ConcurrentExecution>();
+    execution->executionBuilder = executionBuilder;
+    execution->plan = plan;
+    execution->controller = controller;
+    execution->allowFallback = allowFallback;
+    execution->executionCallback = executionCallback;
+
+    const uint32_t stepCount = plan->getStepCount();
+    std::vector<uint32_t> readySteps;
+    execution->pendingPredecessors.resize(stepCount);
+    for (uint32_t stepIndex = 0; stepIndex < stepCount; stepIndex++) {
+        execution->pendingPredecessors[stepIndex] = plan->getStepPredecessorCount(stepIndex);
+        if (execution->pendingPredecessors[stepIndex] == 0) {
+            readySteps.push_back(stepIndex);
+        }
+    }
+    nnAssert(!readySteps.empty());
+    // Account for all the first steps before launching any, so that none of
+    // them may think it is the last one to complete.
+    execution->launchedSteps = readySteps.size();
+    for (uint32_t readyStep : readySteps) {
+        launchConcurrentStep(execution, readyStep);
+    }
+}
+
+static void asyncStartComputePartitioned(const ExecutionBuilder* executionBuilder,
+                                         const ExecutionPlan* plan,
+                                         std::shared_ptr<ExecutionPlan::Controller> controller,
+                                         bool allowFallback,
+                                         const sp<ExecutionCallback>& executionCallback) {
+    if (plan->hasIndependentSteps()) {
+        asyncStartComputeConcurrently(executionBuilder, plan, controller, allowFallback,
+                                      executionCallback);
+        return;
+    }
+    executionCallback->notify(convertResultCodeToErrorStatus(
+            computePartitioned(executionBuilder, plan, controller, allowFallback)));
+}
+
+int ExecutionBuilder::checkArgumentsSpecified(const char* name) const {
     // TODO validate that we have full types for all inputs and outputs,
     // that the graph is not cyclic,
 
     for (auto& p : mInputs) {
         if (p.state == ModelArgumentInfo::UNSPECIFIED) {
-            LOG(ERROR) << "ANeuralNetworksExecution_startCompute not all inputs specified";
+            LOG(ERROR) << name << " not all inputs specified";
             return ANEURALNETWORKS_BAD_DATA;
         }
     }
     for (auto& p : mOutputs) {
         if (p.state == ModelArgumentInfo::UNSPECIFIED) {
-            LOG(ERROR) << "ANeuralNetworksExecution_startCompute not all outputs specified";
+            LOG(ERROR) << name << " not all outputs specified";
             return ANEURALNETWORKS_BAD_DATA;
         }
     }
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+int ExecutionBuilder::checkNotComputing(const char* name) const {
+    if (mComputing) {
+        LOG(ERROR) << name << " called while the execution is computing";
+        return ANEURALNETWORKS_BAD_STATE;
+    }
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+int ExecutionBuilder::checkCanCompute(const char* name) const {
+    int n = checkNotComputing(name);
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return n;
+    }
+    if (mStarted && !mReusable) {
+        LOG(ERROR) << name << " called again on an execution that is not reusable";
+        return ANEURALNETWORKS_BAD_STATE;
+    }
+    return checkArgumentsSpecified(name);
+}
+
+void ExecutionBuilder::startComputation() {
+    if (mStarted) {
+        forgetUnusedMemories();
+    }
+    mStarted = true;
+    mComputing = true;
+}
+
+int ExecutionBuilder::setReusable(bool reusable) {
+    if (mStarted) {
+        LOG(ERROR) << "ANeuralNetworksExecution_setReusable called after the execution started";
+        return ANEURALNETWORKS_BAD_STATE;
+    }
+    mReusable = reusable;
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+void ExecutionBuilder::forgetUnusedMemories() {
+    MemoryTracker memories;
+    auto remap = [this, &memories](std::vector<ModelArgumentInfo>& argumentInfos) {
+        for (ModelArgumentInfo& argumentInfo : argumentInfos) {
+            if (argumentInfo.state == ModelArgumentInfo::MEMORY) {
+                DataLocation& loc = argumentInfo.locationAndLength;
+                loc.poolIndex = memories.add(mMemories[loc.poolIndex]);
+            }
+        }
+    };
+    remap(mInputs);
+    remap(mOutputs);
+    mMemories = std::move(memories);
+}
+
+std::shared_ptr<ExecutionPlan::Controller> ExecutionBuilder::getController() {
+    if (!mReusable) {
+        return mPlan->makeController(this);
+    }
+    if (mController == nullptr) {
+        mController = mPlan->makeController(this, true /* reusable */);
+    } else {
+        mPlan->rewind(mController);
+    }
+    return mController;
+}
 
+int ExecutionBuilder::startCompute(sp<ExecutionCallback>* synchronizationCallback) {
+    *synchronizationCallback = nullptr;
+
+    int n = checkCanCompute("ANeuralNetworksExecution_startCompute");
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return n;
+    }
+    startComputation();
+
+    n = startComputeChecked(synchronizationCallback);
+    if (*synchronizationCallback == nullptr) {
+        finishComputation();
+    } else {
+        // Finished before the event is signaled, so that the execution can be
+        // modified as soon as ANeuralNetworksEvent_wait() returns.
+        (*synchronizationCallback)->on_finish([this] {
+            finishComputation();
+            return true;
+        });
+    }
+    return n;
+}
+
+int ExecutionBuilder::startComputeChecked(sp<ExecutionCallback>* synchronizationCallback) {
 #ifndef DISABLE_PARTITIONED_EXECUTION
     {
         // TODO: Remove the non-plan-based path once we've fully integrated ExecutionPlan
@@ -357,24 +630,23 @@ int ExecutionBuilder::startCompute(sp<ExecutionCallback>* synchronizationCallbac
         // it to wrap the plan-based-path.
         if (mPartitioning > 0) {
             const bool allowFallback = DeviceManager::partitioningAllowsFallback(mPartitioning);
-            std::shared_ptr<ExecutionPlan::Controller> controller = mPlan->makeController(this);
+            std::shared_ptr<ExecutionPlan::Controller> controller = getController();
             if (controller == nullptr) {
                 if (!allowFallback) {
                     return ANEURALNETWORKS_OP_FAILED;
                 }
             } else {
-                // TODO: use a thread pool
-
                 // Prepare the callback for asynchronous execution.
                 // sp<ExecutionCallback> object is returned when the
                 // execution has been successfully launched, otherwise a
                 // nullptr is returned.  The executionCallback is
                 // abstracted in the NN API as an "event".
                 sp<ExecutionCallback> executionCallback = new ExecutionCallback();
-                std::thread thread(asyncStartComputePartitioned, this, mPlan, controller,
-                                   allowFallback,
-                                   executionCallback);
-                executionCallback->bind_thread(std::move(thread));
+                ThreadPool::get()->schedule([this, controller, allowFallback,
+                                             executionCallback] {
+                    asyncStartComputePartitioned(this, mPlan, controller, allowFallback,
+                                                 executionCallback);
+                });
                 *synchronizationCallback = executionCallback;
                 return ANEURALNETWORKS_NO_ERROR;
             }
@@ -398,8 +670,9 @@ int ExecutionBuilder::startCompute(sp<ExecutionCallback>* synchronizationCallbac
             device->getSupportedOperations(hidlModel, &supports);
             if (std::find(supports.begin(), supports.end(), false) == supports.end()) {
                 VLOG(EXECUTION) << "ExecutionBuilder::startCompute (without plan) on " << device->getName();
-                StepExecutor executor(this, mModel, device->getInterface(),
-                                      nullptr /* no IPreparedModel, so compile */);
+                StepExecutor executor(this, mModel, device,
+                                      nullptr /* no IPreparedModel, so compile */,
+                                      nullptr /* no CpuPreparedModel */);
                 executor.mapInputsAndOutputsTrivially();
                 return executor.startCompute(synchronizationCallback);
             }
@@ -410,16 +683,91 @@ int ExecutionBuilder::startCompute(sp<ExecutionCallback>* synchronizationCallbac
     // Run on the CPU.
     VLOG(EXECUTION) << "ExecutionBuilder::startCompute (without plan) on CPU";
     StepExecutor executor(this, mModel,
-                          nullptr /* no VersionedIDevice, so CPU */,
-                          nullptr /* no IPreparedModel */);
+                          nullptr /* no Device, so CPU */,
+                          nullptr /* no IPreparedModel */,
+                          nullptr /* no CpuPreparedModel, so prepare */);
     executor.mapInputsAndOutputsTrivially();
     return executor.startCompute(synchronizationCallback);
 }
 
+// Like startCompute(), but on the calling thread, without an
+// ExecutionCallback for the execution as a whole.  Only a plan whose steps
+// may run concurrently still goes through the thread pool.
+int ExecutionBuilder::compute() {
+    int n = checkCanCompute("ANeuralNetworksExecution_compute");
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return n;
+    }
+    startComputation();
+    n = computeChecked();
+    finishComputation();
+    return n;
+}
+
+int ExecutionBuilder::computeChecked() {
+#ifndef DISABLE_PARTITIONED_EXECUTION
+    if (mPartitioning > 0) {
+        const bool allowFallback = DeviceManager::partitioningAllowsFallback(mPartitioning);
+        std::shared_ptr<ExecutionPlan::Controller> controller = getController();
+        if (controller == nullptr) {
+            if (!allowFallback) {
+                return ANEURALNETWORKS_OP_FAILED;
+            }
+        } else if (mPlan->hasIndependentSteps()) {
+            sp<ExecutionCallback> executionCallback = new ExecutionCallback();
+            asyncStartComputeConcurrently(this, mPlan, controller, allowFallback,
+                                          executionCallback);
+            executionCallback->wait();
+            return convertErrorStatusToResultCode(executionCallback->getStatus());
+        } else {
+            return computePartitioned(this, mPlan, controller, allowFallback);
+        }
+    }
+
+    // Run on the CPU.
+    VLOG(EXECUTION) << "ExecutionBuilder::compute (without plan) on CPU";
+    StepExecutor executor(this, mModel,
+                          nullptr /* no Device, so CPU */,
+                          nullptr /* no IPreparedModel */,
+                          nullptr /* no CpuPreparedModel, so prepare */);
+    executor.mapInputsAndOutputsTrivially();
+    return executor.compute();
+#else
+    sp<ExecutionCallback> executionCallback;
+    int n = startComputeChecked(&executionCallback);
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return n;
+    }
+    executionCallback->wait();
+    return convertErrorStatusToResultCode(executionCallback->getStatus());
+#endif  // DISABLE_PARTITIONED_EXECUTION
+}
+
 // Figures out how to place each of the input or outputs in a buffer. This just does the layout,
 // it does not copy data.  Aligns each input a bit.
-int StepExecutor::allocatePointerArgumentsToPool(std::vector<ModelArgumentInfo>* args,
-                                                 Memory* memory) {
+//
+// Arguments that point into a buffer registered with the compilation are
+// turned into arguments in that memory, and need no copying at all.  The
+// others are placed in a region taken from the SharedMemoryPool of the
+// compilation.
+int StepExecutor::allocatePointerArgumentsToPool(
+        std::vector<ModelArgumentInfo>* args, std::shared_ptr<Memory>* memory,
+        std::vector<std::shared_ptr<const Memory>>* registeredMemories) {
+    for (auto& info : *args) {
+        if (info.state == ModelArgumentInfo::POINTER) {
+            DataLocation& loc = info.locationAndLength;
+            uint32_t offset = 0;
+            std::shared_ptr<const Memory> registered =
+                    mExecutionBuilder->mRegisteredBuffers->find(info.buffer, loc.length,
+                                                                &offset);
+            if (registered != nullptr) {
+                loc.poolIndex = mMemories.add(registered.get());
+                registeredMemories->push_back(std::move(registered));
+                loc.offset = offset;
+                info.state = ModelArgumentInfo::MEMORY;
+            }
+        }
+    }
     uint32_t nextPoolIndex = mMemories.size();
     int64_t total = 0;
     for (auto& info : *args) {
@@ -437,10 +785,12 @@ int StepExecutor::allocatePointerArgumentsToPool(std::vector<ModelArgumentInfo>*
                       "2^32.";
         return ANEURALNETWORKS_BAD_DATA;
     }
-    hidl_memory hidlMemory;
     if (total > 0) {
-        memory->create(total);  // TODO check error
-        mMemories.add(memory);
+        *memory = mExecutionBuilder->mMemoryPool->acquire(static_cast<uint32_t>(total));
+        if (*memory == nullptr) {
+            return ANEURALNETWORKS_OUT_OF_MEMORY;
+        }
+        mMemories.add(memory->get());
     }
     return ANEURALNETWORKS_NO_ERROR;
 }
@@ -460,17 +810,57 @@ static void setRequestArgumentArray(const std::vector<ModelArgumentInfo>& argume
 
 StepExecutor::StepExecutor(const ExecutionBuilder* executionBuilder,
                            const ModelBuilder* model,
-                           VersionedIDevice* driver, sp<IPreparedModel> preparedModel) :
-    mExecutionBuilder(executionBuilder), mModel(model),
-    mDriver(driver), mPreparedModel(preparedModel),
+                           std::shared_ptr<Device> device, sp<IPreparedModel> preparedModel,
+                           std::shared_ptr<CpuPreparedModel> cpuPreparedModel) :
+    mExecutionBuilder(executionBuilder), mModel(model), mDevice(device),
+    mDriver(device == nullptr ? nullptr : device->getInterface()),
+    mPreparedModel(preparedModel), mCpuPreparedModel(cpuPreparedModel),
     mInputs(model->inputCount()), mOutputs(model->outputCount()) {}
 
 void StepExecutor::mapInputsAndOutputsTrivially() {
+    mMappedTrivially = true;
     mInputs = mExecutionBuilder->mInputs;
     mOutputs = mExecutionBuilder->mOutputs;
     mMemories = mExecutionBuilder->mMemories;
 }
 
+void StepExecutor::rebind() {
+    if (mMappedTrivially) {
+        mapInputsAndOutputsTrivially();
+        return;
+    }
+    mInputs.assign(mModel->inputCount(), ModelArgumentInfo());
+    mOutputs.assign(mModel->outputCount(), ModelArgumentInfo());
+    mMemories = MemoryTracker();
+    for (const Binding& binding : mBindings) {
+        switch (binding.kind) {
+            case Binding::INPUT:
+                mapInputOrOutput(mExecutionBuilder->mInputs[binding.from],
+                                 &mInputs[binding.to]);
+                break;
+            case Binding::OUTPUT:
+                mapInputOrOutput(mExecutionBuilder->mOutputs[binding.from],
+                                 &mOutputs[binding.to]);
+                break;
+            case Binding::OUTPUT_TO_INPUT:
+                mapInputOrOutput(mExecutionBuilder->mOutputs[binding.from],
+                                 &mInputs[binding.to]);
+                break;
+            case Binding::TEMPORARY_INPUT:
+                // Cannot fail, it did not the first time.
+                setInputOrOutputFromTemporaryMemory(mModel->getInputOperand(binding.to),
+                                                    binding.temporaryMemory, binding.from,
+                                                    &mInputs[binding.to]);
+                break;
+            case Binding::TEMPORARY_OUTPUT:
+                setInputOrOutputFromTemporaryMemory(mModel->getOutputOperand(binding.to),
+                                                    binding.temporaryMemory, binding.from,
+                                                    &mOutputs[binding.to]);
+                break;
+        }
+    }
+}
+
 void StepExecutor::mapInputOrOutput(const ModelArgumentInfo& builderInputOrOutput,
                                     ModelArgumentInfo* executorInputOrOutput) {
     *executorInputOrOutput = builderInputOrOutput;
@@ -543,6 +933,23 @@ int StepExecutor::startCompute(sp<ExecutionCallback>* synchronizationCallback) {
     }
 }
 
+int StepExecutor::compute() {
+    if (VLOG_IS_ON(EXECUTION)) {
+        logArguments("input", mInputs);
+        logArguments("output", mOutputs);
+    }
+    if (mDriver == nullptr) {
+        return computeOnCpu();
+    }
+    // Returns once the device has completed the execution.
+    sp<ExecutionCallback> executionCallback;
+    int n = startComputeOnDevice(&executionCallback);
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return n;
+    }
+    return convertErrorStatusToResultCode(executionCallback->getStatus());
+}
+
 int StepExecutor::startComputeOnDevice(sp<ExecutionCallback>* synchronizationCallback) {
     nnAssert(mDriver != nullptr);
 
@@ -585,15 +992,21 @@ int StepExecutor::startComputeOnDevice(sp<ExecutionCallback>* synchronizationCal
     // We separate the input & output pools so that we reduce the copying done if we
     // do an eventual remoting (hidl_memory->update()).  We could also use it to set
     // protection on read only memory but that's not currently done.
-    Memory inputPointerArguments;
-    Memory outputPointerArguments;
+    // The regions go back to the pool of the compilation when this function
+    // returns, and the memories of the registered buffers are kept until
+    // then even if the application frees them meanwhile.
+    std::shared_ptr<Memory> inputPointerArguments;
+    std::shared_ptr<Memory> outputPointerArguments;
+    std::vector<std::shared_ptr<const Memory>> registeredMemories;
 
     // Layout the input and output data
-    int n = allocatePointerArgumentsToPool(&mInputs, &inputPointerArguments);
+    int n = allocatePointerArgumentsToPool(&mInputs, &inputPointerArguments,
+                                           &registeredMemories);
     if (n != ANEURALNETWORKS_NO_ERROR) {
         return n;
     }
-    n = allocatePointerArgumentsToPool(&mOutputs, &outputPointerArguments);
+    n = allocatePointerArgumentsToPool(&mOutputs, &outputPointerArguments,
+                                       &registeredMemories);
     if (n != ANEURALNETWORKS_NO_ERROR) {
         return n;
     }
@@ -604,7 +1017,7 @@ int StepExecutor::startComputeOnDevice(sp<ExecutionCallback>* synchronizationCal
         if (info.state == ModelArgumentInfo::POINTER) {
             DataLocation& loc = info.locationAndLength;
             uint8_t* data = nullptr;
-            int n = inputPointerArguments.getPointer(&data);
+            int n = inputPointerArguments->getPointer(&data);
             if (n != ANEURALNETWORKS_NO_ERROR) {
                 return n;
             }
@@ -645,6 +1058,7 @@ int StepExecutor::startComputeOnDevice(sp<ExecutionCallback>* synchronizationCal
     // maybe the HIDL infrastructure handles this magically? At worst,
     // it seems like this is a small memory leak, if the Callback stays
     // alive forever.
+    const auto executeStart = std::chrono::steady_clock::now();
     Return<ErrorStatus> executeStatus = mPreparedModel->execute(request, executionCallback);
     if (!executeStatus.isOk() || executeStatus != ErrorStatus::NONE) {
         VLOG(EXECUTION) << "**Execute failed**";
@@ -665,6 +1079,8 @@ int StepExecutor::startComputeOnDevice(sp<ExecutionCallback>* synchronizationCal
                 ? convertErrorStatusToResultCode(callbackStatus)
                 : ANEURALNETWORKS_OP_FAILED;
     }
+    PerformanceHistory::get()->recordExecution(mDevice.get(), mModel,
+                                               std::chrono::steady_clock::now() - executeStart);
 
     // Copy the output data from shared memory to the output buffers.
     // TODO: Move this block of code somewhere else. It should not be in the
@@ -675,7 +1091,7 @@ int StepExecutor::startComputeOnDevice(sp<ExecutionCallback>* synchronizationCal
         if (info.state == ModelArgumentInfo::POINTER) {
             DataLocation& loc = info.locationAndLength;
             uint8_t* data = nullptr;
-            int n = outputPointerArguments.getPointer(&data);
+            int n = outputPointerArguments->getPointer(&data);
             if (n != ANEURALNETWORKS_NO_ERROR) {
                 return n;
             }
@@ -688,72 +1104,110 @@ int StepExecutor::startComputeOnDevice(sp<ExecutionCallback>* synchronizationCal
     return ANEURALNETWORKS_NO_ERROR;
 }
 
-static void asyncStartComputeOnCpu(const Model& model, const Request& request,
-                                   const std::vector<RunTimePoolInfo>& modelPoolInfos,
+static int runOnCpu(const ModelBuilder* model,
+                    const std::shared_ptr<CpuPreparedModel>& preparedModel,
+                    const Request& request,
+                    const std::vector<RunTimePoolInfo>& requestPoolInfos) {
+    const auto runStart = std::chrono::steady_clock::now();
+    int err = preparedModel->run(request, requestPoolInfos);
+    if (err == ANEURALNETWORKS_NO_ERROR) {
+        PerformanceHistory::get()->recordExecution(nullptr /* CPU */, model,
+                                                   std::chrono::steady_clock::now() - runStart);
+    }
+    return err;
+}
+
+static void asyncStartComputeOnCpu(const ModelBuilder* model,
+                                   const std::shared_ptr<CpuPreparedModel>& preparedModel,
+                                   const Request& request,
                                    const std::vector<RunTimePoolInfo>& requestPoolInfos,
                                    const sp<IExecutionCallback>& executionCallback) {
     NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "asyncStartComputeOnCpu");
-    CpuExecutor executor;
-    int err = executor.run(model, request, modelPoolInfos, requestPoolInfos);
+    int err = runOnCpu(model, preparedModel, request, requestPoolInfos);
     executionCallback->notify(convertResultCodeToErrorStatus(err));
 }
 
-int StepExecutor::startComputeOnCpu(sp<ExecutionCallback>* synchronizationCallback) {
-    // TODO: use a thread pool
-    // TODO(mikie): this could have NNTRACE so we could measure the overhead of
-    //              spinning up a new thread.
-
-    Model model;
-    mModel->setHidlModel(&model);
-
-    // Prepare the callback for asynchronous execution. sp<ExecutionCallback>
-    // object is returned when the execution has been successfully launched,
-    // otherwise a nullptr is returned. The executionCallback is abstracted in
-    // the NN API as an "event".
-    sp<ExecutionCallback> executionCallback = new ExecutionCallback();
-    *synchronizationCallback = nullptr;
-
-    std::vector<RunTimePoolInfo> modelPoolInfos;
-    if (!setRunTimePoolInfosFromHidlMemories(&modelPoolInfos, model.pools)) {
-        return ANEURALNETWORKS_UNMAPPABLE;
+int StepExecutor::prepareForCpu(std::shared_ptr<CpuPreparedModel>* preparedModel,
+                                Request* request,
+                                std::vector<RunTimePoolInfo>* requestPoolInfos) {
+    *preparedModel = mCpuPreparedModel;
+    if (*preparedModel == nullptr) {
+        // The model was not prepared for the CPU at compilation time, e.g.
+        // because we are falling back from a device to the CPU.
+        Model model;
+        mModel->setHidlModel(&model);
+        *preparedModel = std::make_shared<CpuPreparedModel>(std::move(model));
+        if (!(*preparedModel)->initialize()) {
+            return ANEURALNETWORKS_UNMAPPABLE;
+        }
     }
 
-    std::vector<RunTimePoolInfo> requestPoolInfos;
-    requestPoolInfos.reserve(mMemories.size());
+    requestPoolInfos->reserve(mMemories.size());
     bool fail = false;
     for (const Memory* mem : mMemories) {
-        requestPoolInfos.emplace_back(mem->getHidlMemory(), &fail);
+        requestPoolInfos->emplace_back(mem->getHidlMemory(), &fail);
     }
     if (fail) {
         return ANEURALNETWORKS_UNMAPPABLE;
     }
     // Create as many pools as there are input / output.
-    auto fixPointerArguments = [&requestPoolInfos](std::vector<ModelArgumentInfo>& argumentInfos) {
+    auto fixPointerArguments = [requestPoolInfos](std::vector<ModelArgumentInfo>& argumentInfos) {
         for (ModelArgumentInfo& argumentInfo : argumentInfos) {
             if (argumentInfo.state == ModelArgumentInfo::POINTER) {
                 argumentInfo.locationAndLength.poolIndex =
-                            static_cast<uint32_t>(requestPoolInfos.size());
+                            static_cast<uint32_t>(requestPoolInfos->size());
                 argumentInfo.locationAndLength.offset = 0;
-                requestPoolInfos.emplace_back(static_cast<uint8_t*>(argumentInfo.buffer));
+                requestPoolInfos->emplace_back(static_cast<uint8_t*>(argumentInfo.buffer));
             }
         }
     };
     fixPointerArguments(mInputs);
     fixPointerArguments(mOutputs);
 
+    setRequestArgumentArray(mInputs, &request->inputs);
+    setRequestArgumentArray(mOutputs, &request->outputs);
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+int StepExecutor::startComputeOnCpu(sp<ExecutionCallback>* synchronizationCallback) {
+    // Prepare the callback for asynchronous execution. sp<ExecutionCallback>
+    // object is returned when the execution has been successfully launched,
+    // otherwise a nullptr is returned. The executionCallback is abstracted in
+    // the NN API as an "event".
+    sp<ExecutionCallback> executionCallback = new ExecutionCallback();
+    *synchronizationCallback = nullptr;
+
+    std::shared_ptr<CpuPreparedModel> preparedModel;
     Request request;
-    setRequestArgumentArray(mInputs, &request.inputs);
-    setRequestArgumentArray(mOutputs, &request.outputs);
+    std::vector<RunTimePoolInfo> requestPoolInfos;
+    int n = prepareForCpu(&preparedModel, &request, &requestPoolInfos);
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return n;
+    }
 
-    // TODO: should model be moved with a std::cref?
-    std::thread thread(asyncStartComputeOnCpu, model, std::move(request),
-                       std::move(modelPoolInfos), std::move(requestPoolInfos),
-                       executionCallback);
-    executionCallback->bind_thread(std::move(thread));
+    // RunTimePoolInfo is move-only, and std::function requires a copyable
+    // callable, hence the shared_ptr.
+    auto poolInfos = std::make_shared<std::vector<RunTimePoolInfo>>(std::move(requestPoolInfos));
+    const ModelBuilder* model = mModel;
+    ThreadPool::get()->schedule([model, preparedModel, request, poolInfos, executionCallback] {
+        asyncStartComputeOnCpu(model, preparedModel, request, *poolInfos, executionCallback);
+    });
 
     *synchronizationCallback = executionCallback;
     return ANEURALNETWORKS_NO_ERROR;
 }
 
+int StepExecutor::computeOnCpu() {
+    NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "StepExecutor::computeOnCpu");
+    std::shared_ptr<CpuPreparedModel> preparedModel;
+    Request request;
+    std::vector<RunTimePoolInfo> requestPoolInfos;
+    int n = prepareForCpu(&preparedModel, &request, &requestPoolInfos);
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return n;
+    }
+    return runOnCpu(mModel, preparedModel, request, requestPoolInfos);
+}
+
 }  // namespace nn
 }  // namespace android
@@ -18,11 +18,14 @@
 #define ANDROID_ML_NN_RUNTIME_EXECUTION_BUILDER_H
 
 #include "Callbacks.h"
+#include "ExecutionPlan.h"
 #include "HalInterfaces.h"
 #include "Memory.h"
 #include "ModelBuilder.h"
 #include "NeuralNetworks.h"
 
+#include <atomic>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -32,10 +35,14 @@ using ::android::hardware::neuralnetworks::V1_0::implementation::PreparedModelCa
 namespace android {
 namespace nn {
 
+class BatchBuilder;
 class CompilationBuilder;
+class CpuPreparedModel;
+class Device;
 class ExecutionPlan;
 class Memory;
 class ModelBuilder;
+class RunTimePoolInfo;
 class StepExecutor;
 class VersionedIDevice;
 
@@ -64,6 +71,7 @@ struct ModelArgumentInfo {
 };
 
 class ExecutionBuilder {
+    friend class BatchBuilder;
     friend class StepExecutor;
 public:
     ExecutionBuilder(const CompilationBuilder* compilation);
@@ -76,11 +84,39 @@ public:
                   size_t length);
     int setOutputFromMemory(uint32_t index, const ANeuralNetworksOperandType* type,
                             const Memory* memory, size_t offset, size_t length);
+    // Point an input or output set from a buffer to another buffer of the
+    // same length, without checking its type again.
+    int rebindInput(uint32_t index, const void* buffer);
+    int rebindOutput(uint32_t index, void* buffer);
+    int setReusable(bool reusable);
     int startCompute(sp<ExecutionCallback>* synchronizationCallback);
+    // Executes synchronously, on the calling thread when possible.
+    int compute();
 
     const ModelBuilder* getModel() const { return mModel; }
 
 private:
+    int checkArgumentsSpecified(const char* name) const;
+    // Fails while a computation of the execution is running.
+    int checkNotComputing(const char* name) const;
+    // Fails unless the execution can be computed now.
+    int checkCanCompute(const char* name) const;
+    // Mark the start and the end of a computation, once the execution has
+    // been checked with checkCanCompute().
+    void startComputation();
+    void finishComputation() { mComputing = false; }
+    // startCompute() and compute() between the two.
+    int startComputeChecked(sp<ExecutionCallback>* synchronizationCallback);
+    int computeChecked();
+    // The arguments of a reusable execution may have been respecified since
+    // its previous computation, and the memories they used freed since.
+    // Forgets the memories no argument uses any longer.
+    void forgetUnusedMemories();
+    // Returns the controller for a new execution of the plan: a new one,
+    // or the one kept from the previous execution if this ExecutionBuilder
+    // is reusable.
+    std::shared_ptr<ExecutionPlan::Controller> getController();
+
     const ModelBuilder* mModel;
     const ExecutionPlan* mPlan;
 
@@ -88,6 +124,23 @@ private:
     // CompilationBuilder when the ExecutionBuilder is constructed.
     uint32_t mPartitioning;
 
+    // Whether the execution may be computed more than once, whether it has
+    // been computed, and whether a computation is running: from the start
+    // of compute() or startCompute() until the execution completes, as
+    // signaled to the event of startCompute().
+    bool mReusable = false;
+    bool mStarted = false;
+    std::atomic<bool> mComputing{false};
+    // Only kept if mReusable.
+    std::shared_ptr<ExecutionPlan::Controller> mController;
+
+    // Shared memory for the pointer arguments of the steps that run on a
+    // device, shared by all the executions of the compilation.
+    std::shared_ptr<SharedMemoryPool> mMemoryPool;
+
+    // The buffers registered with the compilation.
+    std::shared_ptr<const RegisteredBuffers> mRegisteredBuffers;
+
     // The information we'll send to the driver about the inputs and outputs.
     // Note that we build this in two steps:
     // 1. As the arguments are specified, set the corresponding mInputs or mOutputs element.
@@ -114,13 +167,18 @@ public:
     // model
     //     The model to be executed by the executor.  Possibly a
     //     submodel of the model from executionBuilder.
-    // driver, preparedModel
+    // device, preparedModel
     //     The device on which to execute the "step", and the prepared
     //     model to execute on that device.  (Both are nullptr in the
     //     case of CPU.)
+    // cpuPreparedModel
+    //     The model prepared for execution on the CPU, if it was
+    //     prepared at compilation time; otherwise nullptr, in which case
+    //     startComputeOnCpu() prepares it for each execution.
     StepExecutor(const ExecutionBuilder* executionBuilder,
                  const ModelBuilder* model,
-                 VersionedIDevice* driver, sp<IPreparedModel> preparedModel);
+                 std::shared_ptr<Device> device, sp<IPreparedModel> preparedModel,
+                 std::shared_ptr<CpuPreparedModel> cpuPreparedModel);
 
     // Map inputs and outputs from ExecutionBuilder to StepExecutor,
     // in the case where we have a single-"step" execution (i.e., the executor
@@ -131,14 +189,17 @@ public:
     // one at a time.  Note that these are input/output indexes, not
     // operand indexes.
     void mapInput(uint32_t builderIndex, uint32_t executorIndex) {
+        mBindings.push_back({Binding::INPUT, builderIndex, executorIndex, nullptr});
         mapInputOrOutput(mExecutionBuilder->mInputs[builderIndex],
                          &mInputs[executorIndex]);
     }
     void mapOutput(uint32_t builderIndex, uint32_t executorIndex) {
+        mBindings.push_back({Binding::OUTPUT, builderIndex, executorIndex, nullptr});
         mapInputOrOutput(mExecutionBuilder->mOutputs[builderIndex],
                          &mOutputs[executorIndex]);
     }
     void mapOutputToInput(uint32_t builderIndex, uint32_t executorIndex) {
+        mBindings.push_back({Binding::OUTPUT_TO_INPUT, builderIndex, executorIndex, nullptr});
         mapInputOrOutput(mExecutionBuilder->mOutputs[builderIndex],
                          &mInputs[executorIndex]);
     }
@@ -146,16 +207,25 @@ public:
     // The input or output is assumed to have the size of the
     // corresponding operand.
     int setInputFromTemporaryMemory(uint32_t inputIndex, const Memory* memory, uint32_t offset) {
+        mBindings.push_back({Binding::TEMPORARY_INPUT, offset, inputIndex, memory});
         return setInputOrOutputFromTemporaryMemory(mModel->getInputOperand(inputIndex),
                                                    memory, offset,
                                                    &mInputs.at(inputIndex));
     }
     int setOutputFromTemporaryMemory(uint32_t outputIndex, const Memory* memory, uint32_t offset) {
+        mBindings.push_back({Binding::TEMPORARY_OUTPUT, offset, outputIndex, memory});
         return setInputOrOutputFromTemporaryMemory(mModel->getOutputOperand(outputIndex),
                                                    memory, offset,
                                                    &mOutputs.at(outputIndex));
     }
 
+    // Maps the inputs and outputs again, the same way as they were mapped
+    // by the calls above, to the arguments the ExecutionBuilder has now.
+    // Used to run the StepExecutor again, for another execution of a
+    // reusable ExecutionBuilder: a computation changes the arguments of the
+    // StepExecutor, e.g. when it places them in shared memory.
+    void rebind();
+
     // Executes using the (driver, preparedModel) specified at construction time.
     int startCompute(sp<ExecutionCallback>* synchronizationCallback);
 
@@ -163,11 +233,22 @@ public:
     // preparedModel) specified at construction time.
     int startComputeOnCpu(sp<ExecutionCallback>* synchronizationCallback);
 
+    // Synchronous versions of startCompute() and startComputeOnCpu(), which
+    // execute on the calling thread.
+    int compute();
+    int computeOnCpu();
+
     bool isCpu() const { return mDriver == nullptr; }
 
 private:
-    int allocatePointerArgumentsToPool(std::vector<ModelArgumentInfo>* args, Memory* memory);
+    // The memories of the registered buffers the arguments are turned into
+    // are added to registeredMemories, and must outlive the execution.
+    int allocatePointerArgumentsToPool(
+            std::vector<ModelArgumentInfo>* args, std::shared_ptr<Memory>* memory,
+            std::vector<std::shared_ptr<const Memory>>* registeredMemories);
     int startComputeOnDevice(sp<ExecutionCallback>* synchronizationCallback);
+    int prepareForCpu(std::shared_ptr<CpuPreparedModel>* preparedModel, Request* request,
+                      std::vector<RunTimePoolInfo>* requestPoolInfos);
 
     void mapInputOrOutput(const ModelArgumentInfo& builderInputOrOutput,
                           ModelArgumentInfo* executorInputOrOutput);
@@ -182,8 +263,10 @@ private:
     // model to be executed on the executor, in both original and
     // compiled forms; and device on which to execute it
     const ModelBuilder* mModel;
+    std::shared_ptr<Device> mDevice;    // nullptr if CPU execution
     VersionedIDevice* mDriver;          // nullptr if CPU execution
     sp<IPreparedModel> mPreparedModel;  // nullptr if CPU execution or if bypassing ExecutionPlan
+    std::shared_ptr<CpuPreparedModel> mCpuPreparedModel;  // may be nullptr
 
     // The information we'll send to the driver about the inputs and outputs.
     // Note that we build this in two steps:
@@ -198,6 +281,21 @@ private:
     std::vector<ModelArgumentInfo> mInputs;
     std::vector<ModelArgumentInfo> mOutputs;
     MemoryTracker mMemories;
+
+    // How the inputs and outputs were mapped, for rebind().
+    struct Binding {
+        enum {
+            INPUT, OUTPUT, OUTPUT_TO_INPUT, TEMPORARY_INPUT, TEMPORARY_OUTPUT
+        } kind;
+        // Index of the ExecutionBuilder input or output, or offset into
+        // the temporary memory.
+        uint32_t from;
+        // Index of the StepExecutor input or output.
+        uint32_t to;
+        const Memory* temporaryMemory;  // nullptr unless TEMPORARY_*
+    };
+    bool mMappedTrivially = false;
+    std::vector<Binding> mBindings;
 };
 
 } // namespace nn
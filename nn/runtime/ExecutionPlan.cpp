@@ -20,15 +20,27 @@
 
 #include "Callbacks.h"
 #include "CompilationBuilder.h"
+#include "CpuExecutor.h"
 #include "ExecutionBuilder.h"
 #include "Manager.h"
+#include "MemoryPlanner.h"
 #include "ModelBuilder.h"
+#include "PerformanceHistory.h"
+#include "ThreadPool.h"
 #include "Tracing.h"
 #include "Utils.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
 #include <functional>
+#include <limits>
 #include <map>
+#include <mutex>
 #include <queue>
+#include <set>
+#include <string>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -39,6 +51,21 @@ using ::android::hardware::neuralnetworks::V1_0::implementation::PreparedModelCa
 namespace android {
 namespace nn {
 
+// Prepares the model for execution on the CPU.  Returns nullptr on failure,
+// in which case each execution prepares the model on its own (see
+// StepExecutor::startComputeOnCpu()).
+static std::shared_ptr<CpuPreparedModel> prepareForCpu(const ModelBuilder* model) {
+    NNTRACE_RT(NNTRACE_PHASE_COMPILATION, "prepareForCpu");
+    Model hidlModel;
+    model->setHidlModel(&hidlModel);
+    auto preparedModel = std::make_shared<CpuPreparedModel>(std::move(hidlModel));
+    if (!preparedModel->initialize()) {
+        LOG(WARNING) << "Could not prepare the model for CPU execution ahead of time";
+        return nullptr;
+    }
+    return preparedModel;
+}
+
 static int compile(std::shared_ptr<Device> device, const ModelBuilder* model,
                    int32_t executionPreference, sp<IPreparedModel>* preparedModel) {
     nnAssert(device != nullptr);  // nullptr indicates CPU
@@ -293,6 +320,113 @@ void ExecutionPlan::CompoundBody::findTempsAsSubModelOutputs() {
     }
 }
 
+void ExecutionPlan::CompoundBody::findStepDependencies() {
+    const uint32_t stepCount = mSteps.size();
+    std::unordered_map<uint32_t, uint32_t> outputToDefiningStep;
+    for (uint32_t stepIndex = 0; stepIndex < stepCount; stepIndex++) {
+        for (const auto& output : mSteps[stepIndex]->getModelOutputs()) {
+            outputToDefiningStep[output.first] = stepIndex;
+        }
+    }
+
+    mStepSuccessors.assign(stepCount, {});
+    mStepPredecessorCounts.assign(stepCount, 0);
+    mStepPrecedes.assign(stepCount, std::vector<bool>(stepCount, false));
+    for (uint32_t stepIndex = 0; stepIndex < stepCount; stepIndex++) {
+        std::set<uint32_t> predecessors;
+        for (const auto& input : mSteps[stepIndex]->getTempsAsSubModelInputs()) {
+            predecessors.insert(mTemporaryToDefiningStep.at(input.first));
+        }
+        for (const auto& input : mSteps[stepIndex]->getOutputsAsSubModelInputs()) {
+            predecessors.insert(outputToDefiningStep.at(input.first));
+        }
+        mStepPredecessorCounts[stepIndex] = predecessors.size();
+        for (uint32_t predecessor : predecessors) {
+            // Steps are created in execution order.
+            nnAssert(predecessor < stepIndex);
+            mStepSuccessors[predecessor].push_back(stepIndex);
+            mStepPrecedes[predecessor][stepIndex] = true;
+            for (uint32_t i = 0; i < predecessor; i++) {
+                if (mStepPrecedes[i][predecessor]) {
+                    mStepPrecedes[i][stepIndex] = true;
+                }
+            }
+        }
+    }
+
+    bool concurrent = true;
+#ifdef NN_DEBUGGABLE
+    concurrent = (getProp("debug.nn.partition.concurrent", 1) != 0);
+#endif  // NN_DEBUGGABLE
+    mHasIndependentSteps = false;
+    for (uint32_t i = 0; concurrent && !mHasIndependentSteps && i < stepCount; i++) {
+        for (uint32_t j = i + 1; j < stepCount; j++) {
+            if (!mStepPrecedes[i][j]) {
+                mHasIndependentSteps = true;
+                break;
+            }
+        }
+    }
+}
+
+void ExecutionPlan::CompoundBody::layOutTemporaries(const ModelBuilder* fromModel) {
+    // A temporary is live from the step that defines it until all the steps
+    // that read it have completed.
+    std::map<uint32_t, std::vector<uint32_t>> readers;
+    for (uint32_t stepIndex = 0; stepIndex < mSteps.size(); stepIndex++) {
+        for (const auto& input : mSteps[stepIndex]->getTempsAsSubModelInputs()) {
+            readers[input.first].push_back(stepIndex);
+        }
+    }
+
+    // Temporaries are aligned on a 4-byte boundary, see alignBytesNeeded().
+    MemoryPlanner planner(4);
+    std::vector<std::pair<uint32_t, uint32_t>> buffers;  // (operand, buffer) indexes
+    std::vector<uint32_t> definingSteps;  // by buffer index
+    std::vector<const std::vector<uint32_t>*> readingSteps;  // by buffer index
+    for (uint32_t stepIndex = 0; stepIndex < mSteps.size(); stepIndex++) {
+        for (const auto& output : mSteps[stepIndex]->getTempsAsSubModelOutputs()) {
+            const uint32_t fromModelOperandIndex = output.first;
+            nnAssert(mTemporaryToDefiningStep.at(fromModelOperandIndex) == stepIndex);
+            const auto it = readers.find(fromModelOperandIndex);
+            nnAssert(it != readers.end());
+            const uint32_t size = sizeOfData(fromModel->getOperand(fromModelOperandIndex));
+            buffers.emplace_back(fromModelOperandIndex,
+                                 planner.addBuffer(size, stepIndex, it->second.back()));
+            definingSteps.push_back(stepIndex);
+            readingSteps.push_back(&it->second);
+        }
+    }
+    if (buffers.empty()) {
+        return;
+    }
+
+    // Steps that do not depend on one another may run in any order, or at
+    // the same time, so that step indexes do not tell whether two
+    // temporaries are live at the same time.  They are not if every step
+    // reading one of them precedes the step defining the other.
+    auto readBefore = [this, &definingSteps, &readingSteps](uint32_t buffer, uint32_t other) {
+        for (uint32_t reader : *readingSteps[buffer]) {
+            if (!mStepPrecedes[reader][definingSteps[other]]) {
+                return false;
+            }
+        }
+        return true;
+    };
+    planner.plan([&readBefore](uint32_t buffer1, uint32_t buffer2) {
+        return !readBefore(buffer1, buffer2) && !readBefore(buffer2, buffer1);
+    });
+
+    auto subModelInputsAndOutputs = std::make_shared<std::map<uint32_t, uint32_t>>();
+    for (const auto& buffer : buffers) {
+        subModelInputsAndOutputs->insert(
+                std::make_pair(buffer.first, planner.getOffset(buffer.second)));
+    }
+    mSubModelInputsAndOutputs = subModelInputsAndOutputs;
+    mTotalSizeOfTemporaries = planner.getArenaSize();
+    mUnsharedSizeOfTemporaries = planner.getTotalSize();
+}
+
 void ExecutionStep::logSubModel() const {
     VLOG(COMPILATION) << "ExecutionStep::finishSubModel, step " << mIndex;
 
@@ -351,8 +485,7 @@ static void convertModelInputsOrOutputs(
     }
 }
 
-int ExecutionStep::finishSubModel(const ModelBuilder* fromModel, bool* hasOutputOfUnknownSize,
-                                  int32_t executionPreference) {
+int ExecutionStep::finishSubModel(const ModelBuilder* fromModel, bool* hasOutputOfUnknownSize) {
     if (VLOG_IS_ON(COMPILATION)) {
         logSubModel();
     }
@@ -428,14 +561,21 @@ int ExecutionStep::finishSubModel(const ModelBuilder* fromModel, bool* hasOutput
         }
     }
 
-    // TODO: Move compilation elsewhere?
+    return ANEURALNETWORKS_NO_ERROR;
+}
 
+int ExecutionStep::compileSubModel(int32_t executionPreference) {
+    const auto start = std::chrono::steady_clock::now();
+    int n = ANEURALNETWORKS_NO_ERROR;
     if (mDevice == nullptr) {
-        return ANEURALNETWORKS_NO_ERROR;
+        mCpuPreparedSubModel = prepareForCpu(&mSubModel);
+    } else {
+        VLOG(COMPILATION) << "ExecutionStep::compileSubModel, compilation";
+        n = compile(mDevice, &mSubModel, executionPreference, &mPreparedSubModel);
     }
-
-    VLOG(COMPILATION) << "ExecutionStep::finishSubModel, compilation";
-    return compile(mDevice, &mSubModel, executionPreference, &mPreparedSubModel);
+    mCompileTime = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+    return n;
 }
 
 void ExecutionStep::dump() const {
@@ -443,27 +583,74 @@ void ExecutionStep::dump() const {
     mSubModel.setHidlModel(&model);
     if (VLOG_IS_ON(COMPILATION)) {
         VLOG(COMPILATION) << "ExecutionStep#" << mIndex
-                          << " for " << (mDevice == nullptr ? "CPU" : mDevice->getName());
+                          << " for " << (mDevice == nullptr ? "CPU" : mDevice->getName())
+                          << ", compiled in " << mCompileTime.count() << " us";
         logModelToInfo(model);
     }
 }
 
+// Compiles the submodels of all the steps, each on its own task of the
+// thread pool so that the drivers compile them at the same time.  Returns
+// the result of the first step, in step order, that fails to compile.
+static int compileSubModels(const std::vector<std::shared_ptr<ExecutionStep>>& steps,
+                            int32_t executionPreference) {
+    std::vector<int> results(steps.size(), ANEURALNETWORKS_NO_ERROR);
+    std::mutex mutex;
+    std::condition_variable completed;
+    size_t pending = steps.size();
+    for (size_t i = 0; i < steps.size(); i++) {
+        // Runs inline when called from a worker of the pool, so waiting
+        // below cannot deadlock.
+        ThreadPool::get()->schedule([&, i] {
+            NNTRACE_RT(NNTRACE_PHASE_COMPILATION, "compileSubModel");
+            const int n = steps[i]->compileSubModel(executionPreference);
+            std::lock_guard<std::mutex> lock(mutex);
+            results[i] = n;
+            if (--pending == 0) {
+                completed.notify_one();
+            }
+        });
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        completed.wait(lock, [&pending] { return pending == 0; });
+    }
+    for (int n : results) {
+        if (n != ANEURALNETWORKS_NO_ERROR) {
+            return n;
+        }
+    }
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
 int ExecutionPlan::CompoundBody::finish(const ModelBuilder* fromModel,
                                         int32_t executionPreference) {
     findTempsAsSubModelOutputs();
     for (const auto& step : mSteps) {
-        int n = step->finishSubModel(fromModel, &mHasSubModelOutputOfUnknownSize,
-                                     executionPreference);
+        int n = step->finishSubModel(fromModel, &mHasSubModelOutputOfUnknownSize);
         if (n != ANEURALNETWORKS_NO_ERROR) {
             VLOG(COMPILATION) << "ExecutionPlan::CompoundBody::finish -- finishSubModel failed";
             return n;
         }
     }
     if (mHasSubModelOutputOfUnknownSize) {
+        // No need to compile a plan that cannot be executed.
         VLOG(COMPILATION) << "ExecutionPlan::CompoundBody::finish -- mHasSubModelOutputOfUnknownSize";
         return ANEURALNETWORKS_OP_FAILED;
     }
 
+    const auto start = std::chrono::steady_clock::now();
+    int n = compileSubModels(mSteps, executionPreference);
+    mCompileTime = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        VLOG(COMPILATION) << "ExecutionPlan::CompoundBody::finish -- compileSubModel failed";
+        return n;
+    }
+
+    findStepDependencies();
+    layOutTemporaries(fromModel);
+
     mSuccessfulFinish = true;
     return ANEURALNETWORKS_NO_ERROR;
 }
@@ -471,6 +658,7 @@ int ExecutionPlan::CompoundBody::finish(const ModelBuilder* fromModel,
 int ExecutionPlan::SimpleBody::finish([[maybe_unused]] const ModelBuilder* fromModel,
                                       int32_t executionPreference) {
     if (mDevice == nullptr) {
+        mCpuPreparedModel = prepareForCpu(mModel);
         mSuccessfulFinish = true;
         return ANEURALNETWORKS_NO_ERROR;
     }
@@ -490,64 +678,36 @@ ExecutionPlan::Controller::Controller(
     const ExecutionPlan* plan,
     const ExecutionBuilder* executionBuilder,
     std::shared_ptr<const SubModelInputsAndOutputsType> subModelInputsAndOutputs,
-    uint32_t totalSizeOfTemporaries) :
+    uint32_t totalSizeOfTemporaries,
+    uint32_t reusableStepCount) :
         mPlan(plan), mExecutionBuilder(executionBuilder),
-        mSubModelInputsAndOutputs(subModelInputsAndOutputs), mNextStepIndex(0) {
+        mSubModelInputsAndOutputs(subModelInputsAndOutputs), mNextStepIndex(0),
+        mStepExecutors(reusableStepCount) {
     if (totalSizeOfTemporaries) {
         if (mTemporaries.create(totalSizeOfTemporaries) != ANEURALNETWORKS_NO_ERROR) {
             LOG(ERROR) << "ExecutionPlan::Controller failed to allocate temporaries";
+            mTemporariesFailed = true;
             mNextStepIndex = kBadStepIndex;
         }
     }
 }
 
 std::shared_ptr<ExecutionPlan::Controller> ExecutionPlan::makeController(
-    const ExecutionBuilder* executionBuilder) const {
+    const ExecutionBuilder* executionBuilder, bool reusable) const {
     nnAssert((mState == EMPTY) == (mBody == nullptr));
     if (mBody && !mBody->mSuccessfulFinish) {
         VLOG(EXECUTION) << "ExecutionPlan::makeController -- unsuccessful finish";
         return std::shared_ptr<Controller>(nullptr);
     }
 
-    // Create the layout for a Memory object big enough for to hold
-    // every TEMPORARY in the original model that is live across
-    // partition boundaries.
-    //
-    // TODO: Rethink this approach for managing temporaries.  Some
-    // alternatives:
-    //
-    // 1) Adopt a memory layout scheme analogous to stack allocation,
-    // where objects of non-overlapping lifetime can occupy the same
-    // storage.  We would still have a single Memory object in this
-    // case.
-    //
-    // 2) Do something like what CpuExecutor does, and do allocations
-    // and deallocations on the fly (during execution) before first
-    // reference and after last reference, respectively.  This would
-    // mean having one Memory object per TEMPORARY; or, in a more
-    // complicated implementation, one Memory object per set of
-    // temporaries that have the same lifetime.  Note that the Android
-    // system limits the number of shared memory objects, which are
-    // what our Memory objects represent.
-    //
+    // The layout of the Memory object holding every TEMPORARY in the
+    // original model that is live across partition boundaries was computed
+    // by CompoundBody::finish(); each controller only allocates the memory.
     uint32_t totalSizeOfTemporaries = 0;
-    std::shared_ptr<Controller::SubModelInputsAndOutputsType> subModelInputsAndOutputs;
+    std::shared_ptr<const Controller::SubModelInputsAndOutputsType> subModelInputsAndOutputs;
     if (mState == COMPOUND) {
-        const ModelBuilder* fromModel = executionBuilder->getModel();
-        for (const auto& step : compound()->mSteps) {
-            for (const auto& output: step->getTempsAsSubModelOutputs()) {
-                const uint32_t fromModelOperandIndex = output.first;
-                const Operand& fromModelOperand = fromModel->getOperand(fromModelOperandIndex);
-                if (subModelInputsAndOutputs == nullptr) {
-                    subModelInputsAndOutputs =
-                            std::make_shared<Controller::SubModelInputsAndOutputsType>();
-                }
-                const uint32_t size = sizeOfData(fromModelOperand);
-                totalSizeOfTemporaries += alignBytesNeeded(totalSizeOfTemporaries, size);
-                subModelInputsAndOutputs->insert(std::make_pair(fromModelOperandIndex, totalSizeOfTemporaries));
-                totalSizeOfTemporaries += size;
-            }
-        }
+        subModelInputsAndOutputs = compound()->mSubModelInputsAndOutputs;
+        totalSizeOfTemporaries = compound()->mTotalSizeOfTemporaries;
         if (VLOG_IS_ON(EXECUTION) && (subModelInputsAndOutputs != nullptr)) {
             for (const auto& io : *subModelInputsAndOutputs) {
                 VLOG(EXECUTION) << "temp: origOpndIdx = " << io.first
@@ -556,9 +716,40 @@ std::shared_ptr<ExecutionPlan::Controller> ExecutionPlan::makeController(
         }
     }
 
+    uint32_t reusableStepCount = 0;
+    if (reusable) {
+        reusableStepCount = (mState == COMPOUND) ? compound()->mSteps.size() : 1;
+    }
+
     return std::shared_ptr<Controller>(new Controller(this, executionBuilder,
                                                       subModelInputsAndOutputs,
-                                                      totalSizeOfTemporaries));
+                                                      totalSizeOfTemporaries,
+                                                      reusableStepCount));
+}
+
+void ExecutionPlan::rewind(std::shared_ptr<Controller> controller) const {
+    controller->mNextStepIndex =
+            controller->mTemporariesFailed ? Controller::kBadStepIndex : 0;
+}
+
+bool ExecutionPlan::reuseStepExecutor(const std::shared_ptr<Controller>& controller,
+                                      uint32_t stepIndex,
+                                      std::shared_ptr<StepExecutor>* executor) const {
+    if (stepIndex >= controller->mStepExecutors.size() ||
+        controller->mStepExecutors[stepIndex] == nullptr) {
+        return false;
+    }
+    *executor = controller->mStepExecutors[stepIndex];
+    (*executor)->rebind();
+    return true;
+}
+
+void ExecutionPlan::keepStepExecutor(const std::shared_ptr<Controller>& controller,
+                                     uint32_t stepIndex,
+                                     const std::shared_ptr<StepExecutor>& executor) const {
+    if (stepIndex < controller->mStepExecutors.size()) {
+        controller->mStepExecutors[stepIndex] = executor;
+    }
 }
 
 
@@ -605,13 +796,16 @@ int ExecutionPlan::next(std::shared_ptr<Controller> controller,
     if (mState == SIMPLE) {
         if (controller->mNextStepIndex == 0) {
             // First (and only) step.
-            auto simpleBody = static_cast<const SimpleBody*>(mBody);
-            *executor = std::make_shared<StepExecutor>(
-                controller->mExecutionBuilder,
-                simpleBody->mModel,
-                (simpleBody->mDevice == nullptr ? nullptr : simpleBody->mDevice->getInterface()),
-                simpleBody->mPreparedModel);
-            (*executor)->mapInputsAndOutputsTrivially();
+            if (!reuseStepExecutor(controller, 0, executor)) {
+                auto simpleBody = static_cast<const SimpleBody*>(mBody);
+                *executor = std::make_shared<StepExecutor>(
+                    controller->mExecutionBuilder,
+                    simpleBody->mModel,
+                    simpleBody->mDevice,
+                    simpleBody->mPreparedModel, simpleBody->mCpuPreparedModel);
+                (*executor)->mapInputsAndOutputsTrivially();
+                keepStepExecutor(controller, 0, *executor);
+            }
             controller->mNextStepIndex = 1;
             return ANEURALNETWORKS_NO_ERROR;
         }
@@ -629,17 +823,42 @@ int ExecutionPlan::next(std::shared_ptr<Controller> controller,
         return ANEURALNETWORKS_NO_ERROR;
     }
 
+    int n = makeStepExecutor(controller, controller->mNextStepIndex, executor);
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        controller->mNextStepIndex = Controller::kBadStepIndex;
+        return n;
+    }
+
+    controller->mNextStepIndex++;
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+int ExecutionPlan::makeStepExecutor(std::shared_ptr<Controller> controller, uint32_t stepIndex,
+                                    std::shared_ptr<StepExecutor>* executor) const {
+    *executor = nullptr;
+
+    if (controller->mNextStepIndex == Controller::kBadStepIndex) {
+        return ANEURALNETWORKS_OP_FAILED;
+    }
+
+    auto compoundBody = compound();
+    nnAssert(stepIndex < compoundBody->mSteps.size());
+
+    if (reuseStepExecutor(controller, stepIndex, executor)) {
+        return ANEURALNETWORKS_NO_ERROR;
+    }
+
     // Input order: model inputs, temps as submodel inputs, outputs as submodel inputs
     // Output order: model outputs, temps as submodel outputs
     //
     // ExecutionStep::finishSubModel() establishes these orderings.
 
-    const auto step = compoundBody->mSteps[controller->mNextStepIndex];
+    const auto step = compoundBody->mSteps[stepIndex];
     *executor = std::make_shared<StepExecutor>(
         controller->mExecutionBuilder,
         step->getSubModel(),
-        (step->getDevice() == nullptr ? nullptr : step->getDevice()->getInterface()),
-        step->getPreparedSubModel());
+        step->getDevice(),
+        step->getPreparedSubModel(), step->getCpuPreparedSubModel());
     step->mapInputsAndOutputs(*executor);
     if (controller->mSubModelInputsAndOutputs != nullptr) {
         {
@@ -658,7 +877,6 @@ int ExecutionPlan::next(std::shared_ptr<Controller> controller,
                     &controller->mTemporaries,
                     offsetOfTemporary);
                 if (n != ANEURALNETWORKS_NO_ERROR) {
-                    controller->mNextStepIndex = Controller::kBadStepIndex;
                     return n;
                 }
             }
@@ -679,7 +897,6 @@ int ExecutionPlan::next(std::shared_ptr<Controller> controller,
                     &controller->mTemporaries,
                     offsetOfTemporary);
                 if (n != ANEURALNETWORKS_NO_ERROR) {
-                    controller->mNextStepIndex = Controller::kBadStepIndex;
                     return n;
                 }
             }
@@ -698,10 +915,42 @@ int ExecutionPlan::next(std::shared_ptr<Controller> controller,
         }
     }
 
-    controller->mNextStepIndex++;
+    keepStepExecutor(controller, stepIndex, *executor);
     return ANEURALNETWORKS_NO_ERROR;
 }
 
+bool ExecutionPlan::hasIndependentSteps() const {
+    return mState == COMPOUND && compound()->mHasIndependentSteps;
+}
+
+bool ExecutionPlan::usesDevice() const {
+    switch (mState) {
+        case SIMPLE:
+            return static_cast<const SimpleBody*>(mBody)->mDevice != nullptr;
+        case COMPOUND:
+            for (const auto& step : compound()->mSteps) {
+                if (step->getDevice() != nullptr) {
+                    return true;
+                }
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+uint32_t ExecutionPlan::getStepCount() const {
+    return compound()->mSteps.size();
+}
+
+const std::vector<uint32_t>& ExecutionPlan::getStepSuccessors(uint32_t stepIndex) const {
+    return compound()->mStepSuccessors.at(stepIndex);
+}
+
+uint32_t ExecutionPlan::getStepPredecessorCount(uint32_t stepIndex) const {
+    return compound()->mStepPredecessorCounts.at(stepIndex);
+}
+
 std::shared_ptr<ExecutionStep> ExecutionPlan::createNewStep(const std::shared_ptr<Device> device) {
     nnAssert(mState != SIMPLE);
     if (mState == EMPTY) {
@@ -766,12 +1015,279 @@ void ExecutionPlan::CompoundBody::dump() const {
     for (const auto& step : mSteps) {
         step->dump();
     }
+    for (uint32_t stepIndex = 0; stepIndex < mStepSuccessors.size(); stepIndex++) {
+        std::string successors;
+        for (uint32_t successor : mStepSuccessors[stepIndex]) {
+            successors += " " + std::to_string(successor);
+        }
+        VLOG(COMPILATION) << "COMPOUND step#" << stepIndex << " precedes:"
+                          << (successors.empty() ? " none" : successors);
+    }
+    VLOG(COMPILATION) << "COMPOUND steps run "
+                      << (mHasIndependentSteps ? "concurrently" : "sequentially");
+    std::chrono::microseconds sequentialCompileTime{0};
+    for (const auto& step : mSteps) {
+        sequentialCompileTime += step->getCompileTime();
+    }
+    VLOG(COMPILATION) << "COMPOUND compilation: " << mCompileTime.count() << " us ("
+                      << sequentialCompileTime.count() << " us for the steps one after another)";
+    VLOG(COMPILATION) << "COMPOUND temporaries: " << mTotalSizeOfTemporaries << " bytes ("
+                      << mUnsharedSizeOfTemporaries << " bytes without sharing)";
+}
+
+namespace {
+
+// An ExecutionStep to be created by partitionTheWork().
+struct PlannedStep {
+    int deviceIndex;
+    std::vector<uint32_t> operations;  // in execution order
+};
+
+// Groups the operations into steps, given the device each one runs on.
+//
+// Operations are sent to their device as soon as their inputs are known.
+// A step takes all the operations ready for one device, including those
+// that become ready while it is being filled; the CPU is served first, to
+// give it the chance to prepare more of the inputs required by the other
+// devices, and thus to maximize the size of the steps of the other devices.
+void formSteps(const ModelBuilder* model, const std::vector<int>& deviceForOperation,
+               size_t deviceCount, std::vector<PlannedStep>* steps) {
+    steps->clear();
+
+    // We keep track of the operations that are ready to run for each device.
+    std::vector<std::queue<uint32_t>> perDeviceQueue(deviceCount);
+    auto enqueueOnAppropriateDevice = [&](uint32_t operationIndex) {
+        perDeviceQueue[deviceForOperation[operationIndex]].push(operationIndex);
+    };
+
+    // Returns -1 if all queues are empty.
+    auto findNextDeviceToProcess = [&]() -> int {
+        for (int i = deviceCount - 1; i >= 0; i--) {
+            if (!perDeviceQueue[i].empty()) {
+                return i;
+            }
+        }
+        return -1;
+    };
+
+    OperandTracker tracker(model, enqueueOnAppropriateDevice);
+    // For each iteration of this loop, we'll plan an execution step.
+    while (true) {
+        int deviceIndex = findNextDeviceToProcess();
+        if (deviceIndex < 0) {
+            break;
+        }
+        steps->push_back({.deviceIndex = deviceIndex, .operations = {}});
+        auto& operations = steps->back().operations;
+        auto& queue = perDeviceQueue[deviceIndex];
+        while (!queue.empty()) {
+            uint32_t operationIndex = queue.front();
+            queue.pop();
+            operations.push_back(operationIndex);
+            tracker.markProcessed(operationIndex, enqueueOnAppropriateDevice);
+        }
+    }
+}
+
+// Estimates the cost of executing a model for a given assignment of its
+// operations to devices, and searches for a cheaper assignment.
+//
+// Costs are expressed in units of the time (or power, depending on the
+// execution preference) the CPU takes to compute one byte of output.  The
+// cost of an operation is the size of its outputs scaled by the relative
+// performance of its device.  On top of that, each step costs kStepCost,
+// and each temporary or model output read by a step other than the one
+// defining it costs kBoundaryCostPerByte per byte, for the step writing it
+// to shared memory and for each step reading it from there.
+//
+// The two constants are estimates, not measurements:
+// - kStepCost stands for launching a step on a driver: the IPC round trip
+//   of IPreparedModel::execute() and the wait for its callback, taken to
+//   be a few tens of microseconds.  That is about the time the CPU path
+//   takes to produce 16 KiB of output for a simple elementwise operation
+//   such as ADD.
+// - kBoundaryCostPerByte stands for the memcpy of a byte into or out of
+//   shared memory, taken to be a quarter of the cost of computing it,
+//   since a copy only streams through memory.
+// They have not been calibrated against devices, which is why the cost
+// model is not the default partitioner (see DeviceManager).
+class PartitioningCostModel {
+public:
+    PartitioningCostModel(const ModelBuilder* model,
+                          const std::vector<std::vector<float>>& perfForOperation,
+                          size_t deviceCount);
+
+    // Returns the estimated cost of the assignment, and sets *steps to the
+    // steps it results in.
+    double getCost(const std::vector<int>& deviceForOperation,
+                   std::vector<PlannedStep>* steps) const;
+
+    // Starting from *deviceForOperation, repeatedly moves a whole step, or
+    // a single operation, to another device able to execute it whenever this
+    // lowers the cost.  Stops at a local minimum, or after kMaxEvaluations
+    // assignments have been tried.
+    void minimize(std::vector<int>* deviceForOperation) const;
+
+private:
+    static constexpr double kStepCost = 16384;
+    static constexpr double kBoundaryCostPerByte = 0.25;
+    static const uint32_t kMaxEvaluations = 4096;
+
+    bool canRun(uint32_t operationIndex, int deviceIndex) const {
+        return std::isfinite(mPerfForOperation[operationIndex][deviceIndex]);
+    }
+
+    const ModelBuilder* mModel;
+    const std::vector<std::vector<float>>& mPerfForOperation;
+    const size_t mDeviceCount;
+    // By operation: the size of its outputs.
+    std::vector<double> mWork;
+    // Temporaries and model outputs read by some operation: the operand
+    // index, its size, the operation defining it and the operations reading
+    // it.
+    struct Edge {
+        uint32_t operandIndex;
+        double size;
+        uint32_t definingOperation;
+        std::vector<uint32_t> readingOperations;
+    };
+    std::vector<Edge> mEdges;
+};
+
+PartitioningCostModel::PartitioningCostModel(
+        const ModelBuilder* model, const std::vector<std::vector<float>>& perfForOperation,
+        size_t deviceCount)
+    : mModel(model), mPerfForOperation(perfForOperation), mDeviceCount(deviceCount) {
+    const auto& operations = mModel->getOperations();
+    mWork.resize(operations.size());
+    std::map<uint32_t, size_t> operandToEdge;
+    for (uint32_t operationIndex = 0; operationIndex < operations.size(); operationIndex++) {
+        double work = 0;
+        for (uint32_t operandIndex : operations[operationIndex].outputs) {
+            const double size = sizeOfData(mModel->getOperand(operandIndex));
+            work += size;
+            operandToEdge[operandIndex] = mEdges.size();
+            mEdges.push_back({.operandIndex = operandIndex,
+                              .size = size,
+                              .definingOperation = operationIndex,
+                              .readingOperations = {}});
+        }
+        // Operations whose outputs are of unknown size still have a cost.
+        mWork[operationIndex] = std::max(work, 1.0);
+    }
+    for (uint32_t operationIndex = 0; operationIndex < operations.size(); operationIndex++) {
+        for (uint32_t operandIndex : operations[operationIndex].inputs) {
+            const auto it = operandToEdge.find(operandIndex);
+            if (it != operandToEdge.end()) {
+                mEdges[it->second].readingOperations.push_back(operationIndex);
+            }
+        }
+    }
 }
 
+double PartitioningCostModel::getCost(const std::vector<int>& deviceForOperation,
+                                      std::vector<PlannedStep>* steps) const {
+    formSteps(mModel, deviceForOperation, mDeviceCount, steps);
+
+    std::vector<uint32_t> stepForOperation(deviceForOperation.size());
+    for (uint32_t stepIndex = 0; stepIndex < steps->size(); stepIndex++) {
+        for (uint32_t operationIndex : (*steps)[stepIndex].operations) {
+            stepForOperation[operationIndex] = stepIndex;
+        }
+    }
+
+    double cost = kStepCost * steps->size();
+    for (uint32_t operationIndex = 0; operationIndex < deviceForOperation.size();
+         operationIndex++) {
+        cost += mWork[operationIndex] *
+                mPerfForOperation[operationIndex][deviceForOperation[operationIndex]];
+    }
+    std::set<uint32_t> readingSteps;
+    for (const Edge& edge : mEdges) {
+        const uint32_t definingStep = stepForOperation[edge.definingOperation];
+        readingSteps.clear();
+        for (uint32_t operationIndex : edge.readingOperations) {
+            if (stepForOperation[operationIndex] != definingStep) {
+                readingSteps.insert(stepForOperation[operationIndex]);
+            }
+        }
+        if (!readingSteps.empty()) {
+            cost += kBoundaryCostPerByte * edge.size * (1 + readingSteps.size());
+        }
+    }
+    return cost;
+}
+
+void PartitioningCostModel::minimize(std::vector<int>* deviceForOperation) const {
+    std::vector<PlannedStep> steps;
+    std::vector<PlannedStep> candidateSteps;
+    double bestCost = getCost(*deviceForOperation, &steps);
+    VLOG(COMPILATION) << "PartitioningCostModel: initial cost " << bestCost << ", "
+                      << steps.size() << " steps";
+    uint32_t evaluations = 1;
+
+    // Returns true if the assignment was changed.
+    auto tryMove = [&](const std::vector<uint32_t>& operations, int deviceIndex) {
+        if (evaluations >= kMaxEvaluations) {
+            return false;
+        }
+        for (uint32_t operationIndex : operations) {
+            if (!canRun(operationIndex, deviceIndex)) {
+                return false;
+            }
+        }
+        std::vector<int> candidate = *deviceForOperation;
+        for (uint32_t operationIndex : operations) {
+            candidate[operationIndex] = deviceIndex;
+        }
+        evaluations++;
+        const double cost = getCost(candidate, &candidateSteps);
+        if (cost >= bestCost) {
+            return false;
+        }
+        *deviceForOperation = std::move(candidate);
+        bestCost = cost;
+        return true;
+    };
+
+    bool improved = true;
+    while (improved && evaluations < kMaxEvaluations) {
+        improved = false;
+        // Moving a whole step to the device of a neighboring step merges
+        // them, which single operation moves often cannot do one at a time.
+        getCost(*deviceForOperation, &steps);
+        for (const PlannedStep& step : steps) {
+            const int currentDevice = (*deviceForOperation)[step.operations[0]];
+            for (size_t deviceIndex = 0; deviceIndex < mDeviceCount; deviceIndex++) {
+                if (int(deviceIndex) != currentDevice && tryMove(step.operations, deviceIndex)) {
+                    improved = true;
+                    break;
+                }
+            }
+        }
+        for (uint32_t operationIndex = 0; operationIndex < deviceForOperation->size();
+             operationIndex++) {
+            for (size_t deviceIndex = 0; deviceIndex < mDeviceCount; deviceIndex++) {
+                if (int(deviceIndex) != (*deviceForOperation)[operationIndex] &&
+                    tryMove({operationIndex}, deviceIndex)) {
+                    improved = true;
+                    break;
+                }
+            }
+        }
+    }
+    VLOG(COMPILATION) << "PartitioningCostModel: final cost " << bestCost << " after "
+                      << evaluations << " evaluations";
+}
+
+}  // anonymous namespace
+
 int ModelBuilder::partitionTheWork(const std::vector<std::shared_ptr<Device>>& devices,
-                                   uint32_t preference, ExecutionPlan* plan) const {
-    // This function uses a heuristic approach to partitioning the graph.
-    // It should be good enough for the first release.
+                                   uint32_t preference, uint32_t partitioner,
+                                   const PerformanceHistory* history,
+                                   ExecutionPlan* plan) const {
+    // This function uses a heuristic approach to partitioning the graph,
+    // optionally refined by a cost model.
 
     const size_t nonCpuDeviceCount = devices.size();
     // The device count is the number of HAL devices + 1. The +1 is for the CPU.
@@ -780,7 +1296,8 @@ int ModelBuilder::partitionTheWork(const std::vector<std::shared_ptr<Device>>& d
     const size_t operationCount = mOperations.size();
 
     VLOG(COMPILATION) << "ModelBuilder::partitionTheWork: deviceCount = " << deviceCount
-                      << ", operationCount = " << operationCount;
+                      << ", operationCount = " << operationCount
+                      << ", partitioner = " << partitioner;
 
     // If we only have the CPU, or if the graph has no operations, no need to try to partition.
     if (nonCpuDeviceCount == 0 || operationCount == 0) {
@@ -799,11 +1316,16 @@ int ModelBuilder::partitionTheWork(const std::vector<std::shared_ptr<Device>>& d
     // The value of the vector is the index in the devices vector, with devices.size()
     // representing the CPU.
     std::vector<int> bestDeviceForOperation(operationCount);
-    int status = findBestDeviceForEachOperation(preference, devices, deviceCount,
-                                                &bestDeviceForOperation);
+    std::vector<std::vector<float>> perfForOperation;
+    int status = findBestDeviceForEachOperation(preference, devices, deviceCount, history,
+                                                &bestDeviceForOperation, &perfForOperation);
     if (status != ANEURALNETWORKS_NO_ERROR) {
         return status;
     }
+    if (partitioner == DeviceManager::kPartitionerCostModel) {
+        PartitioningCostModel(this, perfForOperation, deviceCount)
+                .minimize(&bestDeviceForOperation);
+    }
 
     // If one device will run all the operations, we don't need to split the work.
     if (std::adjacent_find(bestDeviceForOperation.begin(), bestDeviceForOperation.end(),
@@ -818,58 +1340,24 @@ int ModelBuilder::partitionTheWork(const std::vector<std::shared_ptr<Device>>& d
     }
 
     // No easy solution, we need to split the work.
-
-    // We keep track of the operations that are ready to run for each device.
-    std::vector<std::queue<uint32_t>> perDeviceQueue(deviceCount);
-
-    // This helper function enqueues the operation on the appropriate queue.
-    auto enqueueOnAppropriateDevice = [&](uint32_t operationIndex) {
-        int deviceIndex = bestDeviceForOperation[operationIndex];
-        perDeviceQueue[deviceIndex].push(operationIndex);
-        VLOG(COMPILATION) << "enqueueOnAppropriateDevice " << operationIndex << " onto "
-                          << deviceIndex;
-    };
-
-    // This helper function finds a device that has operations ready to process.
-    // We start by looking at the CPU. We do this to try to maximize the
-    // size of the graph we'll send to non-CPU devices. If the CPU runs first,
-    // it will have the chance to prepare more of the inputs required by the
-    // other devices. This function returns -1 if all queues are empty.
-    auto findNextDeviceToProcess = [&]() -> int {
-        for (int i = deviceCount - 1; i >= 0; i--) {
-            if (!perDeviceQueue[i].empty()) {
-                return i;
-            }
-        }
-        return -1;
-    };
-
-    OperandTracker tracker(this, enqueueOnAppropriateDevice);
-    // For each iteration of this loop, we'll create an execution step.
-    while (true) {
-        // Find the device we'll do this step for.
-        int deviceIndex = findNextDeviceToProcess();
-        VLOG(COMPILATION) << "findNextDeviceToProcess: " << deviceIndex;
-        if (deviceIndex < 0) {
-            break;
-        }
+    std::vector<PlannedStep> plannedSteps;
+    formSteps(this, bestDeviceForOperation, deviceCount, &plannedSteps);
+    for (const PlannedStep& plannedStep : plannedSteps) {
+        const int deviceIndex = plannedStep.deviceIndex;
+        VLOG(COMPILATION) << "ModelBuilder::partitionTheWork: step with "
+                          << plannedStep.operations.size() << " operations on " << deviceIndex;
         // nullptr represents the CPU.
         std::shared_ptr<Device> device =
                 static_cast<size_t>(deviceIndex) < nonCpuDeviceCount
                         ? devices[deviceIndex] : nullptr;
 
-        // Assign as much as possible to this device.
         std::shared_ptr<ExecutionStep> step = plan->createNewStep(device);
-        auto& queue = perDeviceQueue[deviceIndex];
-        while (!queue.empty()) {
-            uint32_t operationIndex = queue.front();
-            queue.pop();
+        for (uint32_t operationIndex : plannedStep.operations) {
             int n = step->addOperation(operationIndex, *this);
             if (n != ANEURALNETWORKS_NO_ERROR) {
                 LOG(ERROR) << "failed to add operation " << operationIndex << " to step";
                 return n;
             }
-            tracker.markProcessed(operationIndex, enqueueOnAppropriateDevice);
         }
     }
 
@@ -936,10 +1424,13 @@ int ModelBuilder::findBestDeviceForEachOperation(
         uint32_t preference,
         const std::vector<std::shared_ptr<Device>>& devices,
         const size_t deviceCount,
-        std::vector<int>* bestDeviceForOperation) const {
+        const PerformanceHistory* history,
+        std::vector<int>* bestDeviceForOperation,
+        std::vector<std::vector<float>>* perfForOperation) const {
 
     // Note that deviceCount includes CPU, which has no entry in devices[]
     const size_t nonCpuDeviceCount = deviceCount - 1;
+    const float kCannotRun = std::numeric_limits<float>::infinity();
 
     std::vector<CanDo> canDo(nonCpuDeviceCount);
     for (size_t deviceIndex = 0; deviceIndex < nonCpuDeviceCount; deviceIndex++) {
@@ -948,7 +1439,13 @@ int ModelBuilder::findBestDeviceForEachOperation(
 
     // Figure out the best driver for each operation.
     const size_t operationCount = mOperations.size();
+    perfForOperation->assign(operationCount, std::vector<float>(deviceCount, kCannotRun));
     for (size_t operationIndex = 0; operationIndex < operationCount; operationIndex++) {
+        auto& perfForDevice = (*perfForOperation)[operationIndex];
+        // By definition, the performance of the CPU is 1.0.
+        if (mOperations[operationIndex].type != OperationType::OEM_OPERATION) {
+            perfForDevice[nonCpuDeviceCount] = 1.0;
+        }
         // Find which non-CPU device gives the best performance for this operation.
         int bestChoice = -1;
         float bestPerfVal = 0.0;  // Do not check bestPerfVal if bestChoice < 0.
@@ -956,9 +1453,22 @@ int ModelBuilder::findBestDeviceForEachOperation(
             const auto& device = devices[deviceIndex];
             if (canDo[deviceIndex].check(operationIndex)) {
                 const PerformanceInfo perf = getPerformanceInfo(device, operationIndex);
-                const float perfVal =
+                float perfVal =
                             (preference == ANEURALNETWORKS_PREFER_LOW_POWER ? perf.powerUsage
                                                                             : perf.execTime);
+                // Measured execution times, when there are enough of them,
+                // are more reliable than what the driver reports.  Power
+                // is not measured.
+                float measuredPerfVal;
+                if (history != nullptr && preference != ANEURALNETWORKS_PREFER_LOW_POWER &&
+                    history->getRelativeExecTime(device.get(), this, operationIndex,
+                                                 &measuredPerfVal)) {
+                    VLOG(COMPILATION) << "Device " << device->getName() << " operation "
+                                      << operationIndex << ": measured performance "
+                                      << measuredPerfVal << ", reported " << perfVal;
+                    perfVal = measuredPerfVal;
+                }
+                perfForDevice[deviceIndex] = perfVal;
                 if (bestChoice < 0 || perfVal < bestPerfVal) {
                     bestChoice = deviceIndex;
                     bestPerfVal = perfVal;
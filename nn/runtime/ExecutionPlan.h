@@ -25,12 +25,14 @@
 #include "NeuralNetworks.h"
 #include "Utils.h"
 
+#include <chrono>
 #include <set>
 
 namespace android {
 namespace nn {
 
 class CompilationBuilder;
+class CpuPreparedModel;
 class Device;
 class ExecutionBuilder;
 class ExecutionPlan;
@@ -80,14 +82,22 @@ public:
     // If this step has a submodel output of unknown size, sets
     // *hasOutputOfUnknownSize to true; otherwise, leaves it
     // unchanged.
-    int finishSubModel(const ModelBuilder* fromModel, bool* hasOutputOfUnknownSize,
-                       int32_t executionPreference);
+    int finishSubModel(const ModelBuilder* fromModel, bool* hasOutputOfUnknownSize);
+
+    // Compiles the submodel for the device of this step, or prepares it
+    // for the CPU.  Only valid after a successful finishSubModel().  May
+    // be called concurrently for different steps.
+    int compileSubModel(int32_t executionPreference);
 
     const ModelBuilder* getSubModel() const { return &mSubModel; }
     std::shared_ptr<Device> getDevice() const { return mDevice; }
 
-    // only available after calling finishSubModel()
+    // only available after calling compileSubModel()
     sp<IPreparedModel> getPreparedSubModel() const { return mPreparedSubModel; }
+    std::shared_ptr<CpuPreparedModel> getCpuPreparedSubModel() const {
+        return mCpuPreparedSubModel;
+    }
+    std::chrono::microseconds getCompileTime() const { return mCompileTime; }
 
     // Map inputs and outputs from ExecutionBuilder to StepExecutor.
     void mapInputsAndOutputs(std::shared_ptr<StepExecutor> stepExecutor) const;
@@ -106,6 +116,8 @@ private:
     ModelBuilder mSubModel;
     std::shared_ptr<Device> mDevice;  // nullptr signifies CPU
     sp<IPreparedModel> mPreparedSubModel;  // not used for CPU
+    std::shared_ptr<CpuPreparedModel> mCpuPreparedSubModel;  // only used for CPU, may be nullptr
+    std::chrono::microseconds mCompileTime{0};  // spent in compileSubModel()
 
     // Inputs of original model that are also inputs of this submodel:
     //     (fromModel index, subModel index)
@@ -168,6 +180,12 @@ public:
     //   signifying there are no more steps.
     // - If ExecutionPlan::next() returns anything other than ANEURALNETWORKS_NO_ERROR,
     //   a problem has occurred.
+    //
+    // A reusable Controller may be used for several executions of the same
+    // ExecutionBuilder, calling ExecutionPlan::rewind() before each execution
+    // but the first.  It keeps the StepExecutors it created, and next() and
+    // makeStepExecutor() return them again, rebound to the arguments the
+    // ExecutionBuilder currently has.
     class Controller {
         friend class ExecutionPlan;
     private:
@@ -183,22 +201,53 @@ public:
 
         Controller(const ExecutionPlan* plan, const ExecutionBuilder* executionBuilder,
                    std::shared_ptr<const SubModelInputsAndOutputsType> subModelInputsAndOutputs,
-                   uint32_t totalSizeOfTemporaries);
+                   uint32_t totalSizeOfTemporaries, uint32_t reusableStepCount);
 
         const ExecutionPlan* mPlan;
         const ExecutionBuilder* mExecutionBuilder;
         std::shared_ptr<const SubModelInputsAndOutputsType> mSubModelInputsAndOutputs;  // may be nullptr
         Memory mTemporaries;
+        bool mTemporariesFailed = false;
         size_t mNextStepIndex;
+        // Indexed by step; empty unless the Controller is reusable.
+        std::vector<std::shared_ptr<StepExecutor>> mStepExecutors;
     };
 
-    std::shared_ptr<Controller> makeController(const ExecutionBuilder* executionBuilder) const;
+    std::shared_ptr<Controller> makeController(const ExecutionBuilder* executionBuilder,
+                                               bool reusable = false) const;
+
+    // Prepares a reusable Controller for another execution.
+    void rewind(std::shared_ptr<Controller> controller) const;
 
     int next(std::shared_ptr<Controller> controller, std::shared_ptr<StepExecutor>* executor) const;
 
     // Create the same executor as the last one created by next().
     int fallback(std::shared_ptr<Controller> controller, std::shared_ptr<StepExecutor>* executor) const;
 
+    // Alternative to next() for a COMPOUND plan whose steps need not run
+    // one at a time, in order (see hasIndependentSteps()).  A step may start
+    // once all the steps it depends on have completed; steps that do not
+    // depend on one another may run concurrently.
+    //
+    // Sets *executor to point to a new StepExecutor for the given step.
+    // Does not change the position of the controller for next().
+    int makeStepExecutor(std::shared_ptr<Controller> controller, uint32_t stepIndex,
+                         std::shared_ptr<StepExecutor>* executor) const;
+
+    // True if this is a COMPOUND plan with at least two steps that do not
+    // depend on one another.
+    bool hasIndependentSteps() const;
+
+    // True if some step of this plan runs on a device rather than on the CPU.
+    bool usesDevice() const;
+
+    // Only valid for a COMPOUND plan.
+    uint32_t getStepCount() const;
+    // Steps that depend on the given step, i.e. read some of its results.
+    const std::vector<uint32_t>& getStepSuccessors(uint32_t stepIndex) const;
+    // Number of steps the given step depends on.
+    uint32_t getStepPredecessorCount(uint32_t stepIndex) const;
+
     std::shared_ptr<ExecutionStep> createNewStep(const std::shared_ptr<Device> device);
 
     void becomeSingleStep(const std::shared_ptr<Device> device,
@@ -225,6 +274,16 @@ public:
 private:
     void findTempsAsSubModelOutputs();
 
+    // For a reusable controller: if it already has a StepExecutor for the
+    // given step, rebinds it to the arguments of the ExecutionBuilder, sets
+    // *executor to point to it and returns true.
+    bool reuseStepExecutor(const std::shared_ptr<Controller>& controller, uint32_t stepIndex,
+                           std::shared_ptr<StepExecutor>* executor) const;
+    // For a reusable controller: keeps the StepExecutor created for the
+    // given step.
+    void keepStepExecutor(const std::shared_ptr<Controller>& controller, uint32_t stepIndex,
+                          const std::shared_ptr<StepExecutor>& executor) const;
+
     struct Body {
         virtual ~Body() {}
         virtual void dump() const = 0;
@@ -244,6 +303,7 @@ private:
         std::shared_ptr<Device> mDevice;  // nullptr signifies CPU
         const ModelBuilder* mModel;
         sp<IPreparedModel> mPreparedModel;  // not used for CPU
+        std::shared_ptr<CpuPreparedModel> mCpuPreparedModel;  // only used for CPU, may be nullptr
     };
 
     struct CompoundBody : Body {
@@ -264,8 +324,40 @@ private:
         std::unordered_map<uint32_t, uint32_t> mTemporaryToDefiningStep;
 
         bool mHasSubModelOutputOfUnknownSize = false;
+
+        // Time finish() spent compiling the submodels.  The steps are
+        // compiled concurrently, so this is less than the sum of the
+        // compilation times of the steps.
+        std::chrono::microseconds mCompileTime{0};
+
+        // Layout of the Memory each Controller uses to represent the
+        // TEMPORARYs that are live across partition boundaries: map from
+        // original operand index to offset.  Temporaries that are never live
+        // during the same step share storage.  Computed by finish(), nullptr
+        // if there are no such temporaries.
+        std::shared_ptr<const std::map<uint32_t, uint32_t>> mSubModelInputsAndOutputs;
+        uint32_t mTotalSizeOfTemporaries = 0;
+        // What mTotalSizeOfTemporaries would be without any sharing.
+        uint64_t mUnsharedSizeOfTemporaries = 0;
+
+        // Dependencies between steps, computed by finish().  A step depends
+        // on the steps defining the temporaries and the model outputs it
+        // reads, which always have lower indexes.
+        //
+        // mStepSuccessors[i] lists the steps that depend on step i, and
+        // mStepPredecessorCounts[i] is the number of steps step i depends on.
+        std::vector<std::vector<uint32_t>> mStepSuccessors;
+        std::vector<uint32_t> mStepPredecessorCounts;
+        // mStepPrecedes[i][j] is true if step j depends on step i, directly
+        // or through other steps.
+        std::vector<std::vector<bool>> mStepPrecedes;
+        // True if some steps may run concurrently, unless disabled through
+        // the debug.nn.partition.concurrent property.
+        bool mHasIndependentSteps = false;
     private:
         void findTempsAsSubModelOutputs();
+        void findStepDependencies();
+        void layOutTemporaries(const ModelBuilder* fromModel);
     };
 
     enum { EMPTY, SIMPLE, COMPOUND } mState = EMPTY;
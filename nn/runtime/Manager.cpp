@@ -166,6 +166,7 @@ DeviceManager::DeviceManager() {
 #ifdef NN_DEBUGGABLE
     mPartitioning = getProp("debug.nn.partition", kPartitioningDefault);
     mDebugNNCpuOnly = (getProp("debug.nn.cpuonly") != 0);
+    mPartitioner = getProp("debug.nn.partitioner", kPartitionerDefault);
 #endif  // NN_DEBUGGABLE
 }
 
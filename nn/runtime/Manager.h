@@ -92,6 +92,23 @@ public:
         return partitioning == kPartitioningWithFallback;
     }
 
+    // How to assign the operations to devices when partitioning?
+    // 0 - Heuristic: each operation goes to the device reporting the best
+    //     performance for its operand type, and the steps are whatever
+    //     follows from that.
+    // 1 - Cost model: start from the heuristic, then move operations and
+    //     whole steps between devices as long as this lowers an estimate
+    //     of the total cost, which also accounts for the temporaries
+    //     copied between steps and for the overhead of each step.  The
+    //     constants of the estimate have not been calibrated on devices,
+    //     so this is only used when selected, through the system property
+    //     debug.nn.partitioner or CompilationBuilder::setPartitioner().
+    enum {
+        kPartitionerHeuristic = 0,
+        kPartitionerCostModel = 1
+    };
+    uint32_t getPartitioner() const { return mPartitioner; }
+
     // Returns the singleton manager.
     static DeviceManager* get();
 
@@ -117,6 +134,9 @@ private:
 
     static const uint32_t kPartitioningDefault = kPartitioningWithFallback;
     uint32_t mPartitioning = kPartitioningDefault;
+
+    static const uint32_t kPartitionerDefault = kPartitionerHeuristic;
+    uint32_t mPartitioner = kPartitionerDefault;
 };
 
 } // namespace nn
@@ -21,9 +21,103 @@
 #include "HalInterfaces.h"
 #include "Utils.h"
 
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <unistd.h>
+
 namespace android {
 namespace nn {
 
+namespace {
+
+// At most this many regions are kept by a SharedMemoryPool while no
+// execution uses them.
+const size_t kMaxFreeRegions = 8;
+
+// A line of /proc/self/maps.
+struct Mapping {
+    uintptr_t start = 0;
+    uintptr_t stop = 0;
+    char perms[5] = {};
+    // Where start is in the mapped file, and which file that is.
+    uint64_t fileOffset = 0;
+    unsigned int deviceMajor = 0;
+    unsigned int deviceMinor = 0;
+    uint64_t inode = 0;
+};
+
+// Reads the mappings of the process that cover [address, address + size),
+// by increasing address.  Returns false if part of the range is not mapped.
+bool getMappings(uintptr_t address, size_t size, std::vector<Mapping>* mappings) {
+    std::ifstream maps("/proc/self/maps");
+    uintptr_t next = address;
+    const uintptr_t end = address + size;
+    std::string line;
+    // The mappings are listed by increasing address.
+    while (next < end && std::getline(maps, line)) {
+        Mapping mapping;
+        if (sscanf(line.c_str(),
+                   "%" SCNxPTR "-%" SCNxPTR " %4s %" SCNx64 " %x:%x %" SCNu64,
+                   &mapping.start, &mapping.stop, mapping.perms, &mapping.fileOffset,
+                   &mapping.deviceMajor, &mapping.deviceMinor, &mapping.inode) != 7) {
+            return false;
+        }
+        if (mapping.stop <= next) {
+            continue;
+        }
+        if (mapping.start > next) {
+            return false;
+        }
+        next = mapping.stop;
+        mappings->push_back(mapping);
+    }
+    return next >= end;
+}
+
+// Returns whether buffer is a readable and writable shared mapping of the
+// same size bytes of the same file as mapping, the runtime's own mapping of
+// a memory.  Only compares the files and offsets listed in /proc/self/maps,
+// so that the bytes of the application are never touched.
+bool mapsSameMemory(const uint8_t* mapping, const uint8_t* buffer, size_t size) {
+    std::vector<Mapping> ours;
+    if (!getMappings(reinterpret_cast<uintptr_t>(mapping), 1, &ours)) {
+        return false;
+    }
+    const Mapping& memory = ours.front();
+    // An anonymous mapping is not a mapping of any file.
+    if (memory.inode == 0) {
+        return false;
+    }
+    const uint64_t memoryOffset =
+            memory.fileOffset + (reinterpret_cast<uintptr_t>(mapping) - memory.start);
+
+    std::vector<Mapping> theirs;
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(buffer);
+    if (!getMappings(begin, size, &theirs)) {
+        return false;
+    }
+    for (const Mapping& part : theirs) {
+        if (part.perms[0] != 'r' || part.perms[1] != 'w' || part.perms[3] != 's' ||
+            part.deviceMajor != memory.deviceMajor || part.deviceMinor != memory.deviceMinor ||
+            part.inode != memory.inode) {
+            return false;
+        }
+        // The first part may start before buffer.
+        const uintptr_t from = std::max(part.start, begin);
+        if (part.fileOffset + (from - part.start) != memoryOffset + (from - begin)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
 int Memory::create(uint32_t size) {
     mHidlMemory = allocateSharedMemory(size);
     mMemory = mapMemory(mHidlMemory);
@@ -43,6 +137,112 @@ bool Memory::validateSize(uint32_t offset, uint32_t length) const {
     }
 }
 
+int RegisteredBuffers::add(const Memory* memory, void* buffer) {
+    std::shared_ptr<const Memory> registered = memory->duplicate();
+    if (registered == nullptr || !memory->isWritable()) {
+        LOG(ERROR) << "ANeuralNetworksCompilation_registerBuffer memory is not a writable fd";
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    uint8_t* mapping = nullptr;
+    int n = memory->getPointer(&mapping);
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return n;
+    }
+    const uint8_t* begin = static_cast<const uint8_t*>(buffer);
+    const size_t size = memory->getSize();
+    if (!mapsSameMemory(mapping, begin, size)) {
+        LOG(ERROR) << "ANeuralNetworksCompilation_registerBuffer buffer is not a shared mapping "
+                      "of the memory";
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto next = mBuffers.lower_bound(begin);
+    if (next != mBuffers.end() && next->first < begin + size) {
+        LOG(ERROR) << "ANeuralNetworksCompilation_registerBuffer buffer overlaps another one";
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    if (next != mBuffers.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second->getSize() > begin) {
+            LOG(ERROR) << "ANeuralNetworksCompilation_registerBuffer buffer overlaps another one";
+            return ANEURALNETWORKS_BAD_DATA;
+        }
+    }
+    mBuffers.emplace(begin, std::move(registered));
+    mCount = mBuffers.size();
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+std::shared_ptr<const Memory> RegisteredBuffers::find(const void* buffer, uint32_t length,
+                                                      uint32_t* offset) const {
+    if (mCount == 0) {
+        return nullptr;
+    }
+    const uint8_t* begin = static_cast<const uint8_t*>(buffer);
+    std::lock_guard<std::mutex> lock(mMutex);
+    // The last registered buffer that starts at or before begin.
+    auto it = mBuffers.upper_bound(begin);
+    if (it == mBuffers.begin()) {
+        return nullptr;
+    }
+    --it;
+    const std::shared_ptr<const Memory>& memory = it->second;
+    const size_t position = begin - it->first;
+    if (position + length > memory->getSize()) {
+        return nullptr;
+    }
+    *offset = static_cast<uint32_t>(position);
+    return memory;
+}
+
+int SharedMemoryPool::reserve(uint32_t size) {
+    std::unique_ptr<Memory> memory = std::make_unique<Memory>();
+    int n = memory->create(size);
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return n;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    mFreeRegions.push_back(std::move(memory));
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+std::shared_ptr<Memory> SharedMemoryPool::acquire(uint32_t size) {
+    std::unique_ptr<Memory> memory;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        // Take the smallest free region that is large enough.
+        auto best = mFreeRegions.end();
+        for (auto it = mFreeRegions.begin(); it != mFreeRegions.end(); ++it) {
+            if ((*it)->getSize() >= size &&
+                (best == mFreeRegions.end() || (*it)->getSize() < (*best)->getSize())) {
+                best = it;
+            }
+        }
+        if (best != mFreeRegions.end()) {
+            memory = std::move(*best);
+            mFreeRegions.erase(best);
+        }
+    }
+    if (memory == nullptr) {
+        VLOG(EXECUTION) << "SharedMemoryPool: allocating " << size << " bytes";
+        memory = std::make_unique<Memory>();
+        if (memory->create(size) != ANEURALNETWORKS_NO_ERROR) {
+            return nullptr;
+        }
+    }
+    auto self = shared_from_this();
+    return std::shared_ptr<Memory>(memory.release(),
+                                   [self](Memory* region) { self->release(region); });
+}
+
+void SharedMemoryPool::release(Memory* memory) {
+    std::unique_ptr<Memory> region(memory);
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mFreeRegions.size() < kMaxFreeRegions) {
+        mFreeRegions.push_back(std::move(region));
+    }
+}
+
 MemoryFd::~MemoryFd() {
     // Unmap the memory.
     if (mMapping) {
@@ -100,6 +300,23 @@ int MemoryFd::set(size_t size, int prot, int fd, size_t offset) {
     return ANEURALNETWORKS_NO_ERROR;
 }
 
+std::unique_ptr<Memory> MemoryFd::duplicate() const {
+    if (mHandle == nullptr) {
+        return nullptr;
+    }
+    std::unique_ptr<MemoryFd> memory = std::make_unique<MemoryFd>();
+    if (memory->set(mHidlMemory.size(), mHandle->data[1], mHandle->data[0],
+                    getSizeFromInts(mHandle->data[2], mHandle->data[3])) !=
+        ANEURALNETWORKS_NO_ERROR) {
+        return nullptr;
+    }
+    return std::move(memory);
+}
+
+bool MemoryFd::isWritable() const {
+    return mHandle != nullptr && (mHandle->data[1] & PROT_WRITE) != 0;
+}
+
 int MemoryFd::getPointer(uint8_t** buffer) const {
     if (mMapping) {
         *buffer = mMapping;
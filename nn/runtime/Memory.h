@@ -22,7 +22,12 @@
 
 #include <cutils/native_handle.h>
 #include <sys/mman.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 namespace android {
 namespace nn {
@@ -53,7 +58,19 @@ public:
     }
 
     virtual bool validateSize(uint32_t offset, uint32_t length) const;
+
+    size_t getSize() const { return mHidlMemory.size(); }
+
 protected:
+    friend class RegisteredBuffers;
+
+    // Returns a new memory object for the same region as this one, or
+    // nullptr if that is not supported.
+    virtual std::unique_ptr<Memory> duplicate() const { return nullptr; }
+
+    // Returns whether the memory may be written through its mapping.
+    virtual bool isWritable() const { return true; }
+
     // The hidl_memory handle for this shared memory.  We will pass this value when
     // communicating with the drivers.
     hardware::hidl_memory mHidlMemory;
@@ -78,11 +95,73 @@ public:
 
     int getPointer(uint8_t** buffer) const override;
 
+protected:
+    std::unique_ptr<Memory> duplicate() const override;
+    bool isWritable() const override;
+
 private:
     native_handle_t* mHandle = nullptr;
     mutable uint8_t* mMapping = nullptr;
 };
 
+// Keeps the shared memory that carries the pointer arguments of executions
+// to the drivers, so that the executions of a compilation reuse memory that
+// is already allocated and mapped rather than allocating it every time.
+//
+// Thread safe.  Must be owned by a shared_ptr.
+class SharedMemoryPool : public std::enable_shared_from_this<SharedMemoryPool> {
+public:
+    // Allocates a region of size bytes ahead of its first use.
+    int reserve(uint32_t size);
+
+    // Returns a region of at least size bytes, allocating it if no free
+    // region is large enough, or nullptr on failure.  The region goes back
+    // to the pool when the last reference to it is dropped.
+    std::shared_ptr<Memory> acquire(uint32_t size);
+
+private:
+    void release(Memory* memory);
+
+    std::mutex mMutex;
+    // Regions not currently in use by any execution.
+    std::vector<std::unique_ptr<Memory>> mFreeRegions;
+};
+
+// The buffers in which the application has mapped memories, registered
+// with a compilation so that the pointer arguments of its executions that
+// lie within them can be passed to drivers without being copied.  See
+// ANeuralNetworksCompilation_registerBuffer.
+//
+// Thread safe.
+class RegisteredBuffers {
+public:
+    // Records that the application has mapped memory at buffer.
+    //
+    // Fails unless the memory is writable and buffer is a shared mapping of
+    // it, as otherwise the outputs the drivers write to the memory would not
+    // appear in the buffer.  Also fails if buffer overlaps a buffer already
+    // registered, as we could not tell which memory a pointer into both
+    // belongs to.
+    int add(const Memory* memory, void* buffer);
+
+    // If [buffer, buffer + length) lies within a registered buffer, returns
+    // a memory for the same region as the one it was registered for, and
+    // sets *offset to the position of buffer in that memory.  Otherwise
+    // returns nullptr.  The returned memory remains valid as long as it is
+    // referenced, even if the registered memory is freed meanwhile.
+    //
+    // Cheap when no buffer is registered, which is the common case.
+    std::shared_ptr<const Memory> find(const void* buffer, uint32_t length,
+                                       uint32_t* offset) const;
+
+private:
+    mutable std::mutex mMutex;
+    // The number of entries of mBuffers, read without taking mMutex.
+    std::atomic<size_t> mCount{0};
+    // By address, a duplicate of the memory each buffer was registered for.
+    std::map<const uint8_t*, std::shared_ptr<const Memory>> mBuffers;
+};
+
 // A utility class to accumulate mulitple Memory objects and assign each
 // a distinct index number, starting with 0.
 //
@@ -32,6 +32,7 @@ class CompilationBuilder;
 class Device;
 class ExecutionPlan;
 class Memory;
+class PerformanceHistory;
 
 class ModelBuilder {
 public:
@@ -73,6 +74,8 @@ public:
     const Operand& getOutputOperand(uint32_t i) const {
         return mOperands[getOutputOperandIndex(i)];
     }
+    const std::vector<uint32_t>& getInputOperandIndexes() const { return mInputIndexes; }
+    const std::vector<uint32_t>& getOutputOperandIndexes() const { return mOutputIndexes; }
     const Operand& getOperand(uint32_t index) const { return mOperands[index]; }
     const Operation& getOperation(uint32_t index) const { return mOperations[index]; }
     const MemoryTracker& getMemories() const { return mMemories; }
@@ -81,17 +84,26 @@ public:
         return mSmallOperandValues.data() + offset;
     }
 
+    // partitioner is one of DeviceManager::kPartitioner*.  If history is not
+    // nullptr, the execution times it measured replace the performance the
+    // devices report.
     int partitionTheWork(const std::vector<std::shared_ptr<Device>>& devices,
-                         uint32_t preference, ExecutionPlan* plan) const;
+                         uint32_t preference, uint32_t partitioner,
+                         const PerformanceHistory* history, ExecutionPlan* plan) const;
 
  private:
     // TODO: move partitionTheWork, findBestDeviceForEachOperation,
     // sortIntoRunOrder to CompilationBuilder?
 
+    // Also sets (*perfForOperation)[operationIndex][deviceIndex] to the
+    // performance of each device for each operation, relative to the CPU,
+    // or to infinity if the device cannot execute the operation.
     int findBestDeviceForEachOperation(uint32_t preference,
                                        const std::vector<std::shared_ptr<Device>>& devices,
                                        const size_t deviceCount,
-                                       std::vector<int>* bestDeviceForOperation) const;
+                                       const PerformanceHistory* history,
+                                       std::vector<int>* bestDeviceForOperation,
+                                       std::vector<std::vector<float>>* perfForOperation) const;
     PerformanceInfo getPerformanceInfo(const std::shared_ptr<Device> device,
                                        uint32_t operationIndex) const;
 
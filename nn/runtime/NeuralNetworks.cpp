@@ -22,6 +22,7 @@
 
 #include "NeuralNetworks.h"
 
+#include "BatchBuilder.h"
 #include "Callbacks.h"
 #include "CompilationBuilder.h"
 #include "ExecutionBuilder.h"
@@ -29,6 +30,8 @@
 #include "Memory.h"
 #include "NeuralNetworksOEM.h"
 #include "ModelBuilder.h"
+#include "PerformanceHistory.h"
+#include "StreamBuilder.h"
 #include "Tracing.h"
 #include "Utils.h"
 
@@ -421,6 +424,19 @@ int ANeuralNetworksCompilation_finish(ANeuralNetworksCompilation* compilation) {
     return c->finish();
 }
 
+int ANeuralNetworksCompilation_registerBuffer(ANeuralNetworksCompilation* compilation,
+                                              const ANeuralNetworksMemory* memory,
+                                              void* buffer) {
+    NNTRACE_RT(NNTRACE_PHASE_COMPILATION, "ANeuralNetworksCompilation_registerBuffer");
+    if (!compilation || !memory || !buffer) {
+        LOG(ERROR) << "ANeuralNetworksCompilation_registerBuffer passed a nullptr";
+        return ANEURALNETWORKS_UNEXPECTED_NULL;
+    }
+    CompilationBuilder* c = reinterpret_cast<CompilationBuilder*>(compilation);
+    const Memory* m = reinterpret_cast<const Memory*>(memory);
+    return c->registerBuffer(m, buffer);
+}
+
 int ANeuralNetworksExecution_create(ANeuralNetworksCompilation* compilation,
                                     ANeuralNetworksExecution** execution) {
     NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "ANeuralNetworksExecution_create");
@@ -444,6 +460,16 @@ void ANeuralNetworksExecution_free(ANeuralNetworksExecution* execution) {
     delete r;
 }
 
+int ANeuralNetworksExecution_setReusable(ANeuralNetworksExecution* execution, bool reusable) {
+    NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "ANeuralNetworksExecution_setReusable");
+    if (!execution) {
+        LOG(ERROR) << "ANeuralNetworksExecution_setReusable passed a nullptr";
+        return ANEURALNETWORKS_UNEXPECTED_NULL;
+    }
+    ExecutionBuilder* r = reinterpret_cast<ExecutionBuilder*>(execution);
+    return r->setReusable(reusable);
+}
+
 int ANeuralNetworksExecution_setInput(ANeuralNetworksExecution* execution, int32_t index,
                                       const ANeuralNetworksOperandType* type, const void* buffer,
                                       size_t length) {
@@ -526,6 +552,19 @@ int ANeuralNetworksExecution_startCompute(ANeuralNetworksExecution* execution,
     return ANEURALNETWORKS_NO_ERROR;
 }
 
+int ANeuralNetworksExecution_compute(ANeuralNetworksExecution* execution) {
+    NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "ANeuralNetworksExecution_compute");
+    if (!execution) {
+        LOG(ERROR) << "ANeuralNetworksExecution_compute passed a nullptr";
+        return ANEURALNETWORKS_UNEXPECTED_NULL;
+    }
+    // ExecutionBuilder::compute() checks the state of the execution, and that
+    // all its inputs and outputs have been specified.
+
+    ExecutionBuilder* r = reinterpret_cast<ExecutionBuilder*>(execution);
+    return r->compute();
+}
+
 int ANeuralNetworksEvent_wait(ANeuralNetworksEvent* event) {
     NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "ANeuralNetworksEvent_wait");
     if (event == nullptr) {
@@ -547,3 +586,192 @@ void ANeuralNetworksEvent_free(ANeuralNetworksEvent* event) {
         delete e;
     }
 }
+
+int ANeuralNetworksBatch_create(ANeuralNetworksCompilation* compilation,
+                                ANeuralNetworksBatch** batch) {
+    NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "ANeuralNetworksBatch_create");
+    if (!compilation || !batch) {
+        LOG(ERROR) << "ANeuralNetworksBatch_create passed a nullptr";
+        return ANEURALNETWORKS_UNEXPECTED_NULL;
+    }
+
+    CompilationBuilder* c = reinterpret_cast<CompilationBuilder*>(compilation);
+    BatchBuilder* b = nullptr;
+    int result = c->createBatch(&b);
+    *batch = reinterpret_cast<ANeuralNetworksBatch*>(b);
+    return result;
+}
+
+void ANeuralNetworksBatch_free(ANeuralNetworksBatch* batch) {
+    NNTRACE_RT(NNTRACE_PHASE_TERMINATION, "ANeuralNetworksBatch_free");
+    // No validation.  Free of nullptr is valid.
+    BatchBuilder* b = reinterpret_cast<BatchBuilder*>(batch);
+    delete b;
+}
+
+int ANeuralNetworksBatch_compute(ANeuralNetworksBatch* batch,
+                                 ANeuralNetworksExecution* const* executions, uint32_t count) {
+    NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "ANeuralNetworksBatch_compute");
+    if (!batch || (!executions && count != 0)) {
+        LOG(ERROR) << "ANeuralNetworksBatch_compute passed a nullptr";
+        return ANEURALNETWORKS_UNEXPECTED_NULL;
+    }
+    std::vector<ExecutionBuilder*> builders(count);
+    for (uint32_t i = 0; i < count; i++) {
+        if (!executions[i]) {
+            LOG(ERROR) << "ANeuralNetworksBatch_compute passed a nullptr execution";
+            return ANEURALNETWORKS_UNEXPECTED_NULL;
+        }
+        builders[i] = reinterpret_cast<ExecutionBuilder*>(executions[i]);
+    }
+
+    BatchBuilder* b = reinterpret_cast<BatchBuilder*>(batch);
+    return b->compute(builders);
+}
+
+int ANeuralNetworksBatch_setQueueLimits(ANeuralNetworksBatch* batch, uint32_t maxSize,
+                                        uint64_t maxDelayNanos) {
+    NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "ANeuralNetworksBatch_setQueueLimits");
+    if (!batch) {
+        LOG(ERROR) << "ANeuralNetworksBatch_setQueueLimits passed a nullptr";
+        return ANEURALNETWORKS_UNEXPECTED_NULL;
+    }
+
+    BatchBuilder* b = reinterpret_cast<BatchBuilder*>(batch);
+    return b->setQueueLimits(maxSize, std::chrono::nanoseconds(maxDelayNanos));
+}
+
+int ANeuralNetworksBatch_startCompute(ANeuralNetworksBatch* batch,
+                                      ANeuralNetworksExecution* execution,
+                                      ANeuralNetworksEvent** event) {
+    NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "ANeuralNetworksBatch_startCompute");
+    if (!batch || !execution || !event) {
+        LOG(ERROR) << "ANeuralNetworksBatch_startCompute passed a nullptr";
+        return ANEURALNETWORKS_UNEXPECTED_NULL;
+    }
+
+    BatchBuilder* b = reinterpret_cast<BatchBuilder*>(batch);
+    ExecutionBuilder* r = reinterpret_cast<ExecutionBuilder*>(execution);
+
+    // See ANeuralNetworksExecution_startCompute().
+    std::unique_ptr<sp<ExecutionCallback>> e = std::make_unique<sp<ExecutionCallback>>();
+    *event = nullptr;
+
+    int n = b->startCompute(r, e.get());
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return n;
+    }
+    *event = reinterpret_cast<ANeuralNetworksEvent*>(e.release());
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+int ANeuralNetworksStream_create(ANeuralNetworksCompilation* compilation,
+                                 ANeuralNetworksStream** stream) {
+    NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "ANeuralNetworksStream_create");
+    if (!compilation || !stream) {
+        LOG(ERROR) << "ANeuralNetworksStream_create passed a nullptr";
+        return ANEURALNETWORKS_UNEXPECTED_NULL;
+    }
+
+    CompilationBuilder* c = reinterpret_cast<CompilationBuilder*>(compilation);
+    StreamBuilder* s = nullptr;
+    int result = c->createStream(&s);
+    *stream = reinterpret_cast<ANeuralNetworksStream*>(s);
+    return result;
+}
+
+void ANeuralNetworksStream_free(ANeuralNetworksStream* stream) {
+    NNTRACE_RT(NNTRACE_PHASE_TERMINATION, "ANeuralNetworksStream_free");
+    // No validation.  Free of nullptr is valid.
+    StreamBuilder* s = reinterpret_cast<StreamBuilder*>(stream);
+    delete s;
+}
+
+int ANeuralNetworksStream_bindState(ANeuralNetworksStream* stream, uint32_t outputIndex,
+                                    uint32_t inputIndex) {
+    NNTRACE_RT(NNTRACE_PHASE_INPUTS_AND_OUTPUTS, "ANeuralNetworksStream_bindState");
+    if (!stream) {
+        LOG(ERROR) << "ANeuralNetworksStream_bindState passed a nullptr";
+        return ANEURALNETWORKS_UNEXPECTED_NULL;
+    }
+    StreamBuilder* s = reinterpret_cast<StreamBuilder*>(stream);
+    return s->bindState(outputIndex, inputIndex);
+}
+
+int ANeuralNetworksStream_setState(ANeuralNetworksStream* stream, uint32_t inputIndex,
+                                   const void* buffer, size_t length) {
+    NNTRACE_RT(NNTRACE_PHASE_INPUTS_AND_OUTPUTS, "ANeuralNetworksStream_setState");
+    if (!stream || !buffer) {
+        LOG(ERROR) << "ANeuralNetworksStream_setState passed a nullptr";
+        return ANEURALNETWORKS_UNEXPECTED_NULL;
+    }
+    StreamBuilder* s = reinterpret_cast<StreamBuilder*>(stream);
+    return s->setState(inputIndex, buffer, length);
+}
+
+int ANeuralNetworksStream_setInput(ANeuralNetworksStream* stream, int32_t index,
+                                   const void* buffer, size_t length) {
+    NNTRACE_RT(NNTRACE_PHASE_INPUTS_AND_OUTPUTS, "ANeuralNetworksStream_setInput");
+    if (!stream || (!buffer && length != 0)) {
+        LOG(ERROR) << "ANeuralNetworksStream_setInput passed a nullptr";
+        return ANEURALNETWORKS_UNEXPECTED_NULL;
+    }
+    StreamBuilder* s = reinterpret_cast<StreamBuilder*>(stream);
+    return s->setInput(index, buffer, length);
+}
+
+int ANeuralNetworksStream_setOutput(ANeuralNetworksStream* stream, int32_t index, void* buffer,
+                                    size_t length) {
+    NNTRACE_RT(NNTRACE_PHASE_INPUTS_AND_OUTPUTS, "ANeuralNetworksStream_setOutput");
+    if (!stream || !buffer) {
+        LOG(ERROR) << "ANeuralNetworksStream_setOutput passed a nullptr";
+        return ANEURALNETWORKS_UNEXPECTED_NULL;
+    }
+    StreamBuilder* s = reinterpret_cast<StreamBuilder*>(stream);
+    return s->setOutput(index, buffer, length);
+}
+
+int ANeuralNetworksStream_compute(ANeuralNetworksStream* stream, uint32_t timestepCount) {
+    NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "ANeuralNetworksStream_compute");
+    if (!stream) {
+        LOG(ERROR) << "ANeuralNetworksStream_compute passed a nullptr";
+        return ANEURALNETWORKS_UNEXPECTED_NULL;
+    }
+    StreamBuilder* s = reinterpret_cast<StreamBuilder*>(stream);
+    return s->compute(timestepCount);
+}
+
+int ANeuralNetworksPerformanceHistory_setEnabled(bool enabled) {
+    NNTRACE_RT(NNTRACE_PHASE_INITIALIZATION, "ANeuralNetworksPerformanceHistory_setEnabled");
+    PerformanceHistory::get()->setEnabled(enabled);
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+int ANeuralNetworksPerformanceHistory_setCacheFile(const char* filename) {
+    NNTRACE_RT(NNTRACE_PHASE_INITIALIZATION, "ANeuralNetworksPerformanceHistory_setCacheFile");
+    if (!filename) {
+        LOG(ERROR) << "ANeuralNetworksPerformanceHistory_setCacheFile passed a nullptr";
+        return ANEURALNETWORKS_UNEXPECTED_NULL;
+    }
+    if (!PerformanceHistory::get()->setCacheFile(filename)) {
+        LOG(ERROR) << "ANeuralNetworksPerformanceHistory_setCacheFile passed " << filename
+                   << ", but the cache file is already set to another file";
+        return ANEURALNETWORKS_BAD_STATE;
+    }
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+int ANeuralNetworksPerformanceHistory_dump(int fd) {
+    NNTRACE_RT(NNTRACE_PHASE_UNSPECIFIED, "ANeuralNetworksPerformanceHistory_dump");
+    if (!PerformanceHistory::get()->dump(fd)) {
+        LOG(ERROR) << "ANeuralNetworksPerformanceHistory_dump could not write to " << fd;
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+int ANeuralNetworksPerformanceHistory_reset() {
+    NNTRACE_RT(NNTRACE_PHASE_UNSPECIFIED, "ANeuralNetworksPerformanceHistory_reset");
+    PerformanceHistory::get()->reset();
+    return ANEURALNETWORKS_NO_ERROR;
+}
@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "PerformanceHistory"
+
+#include "PerformanceHistory.h"
+
+#include "Manager.h"
+#include "ModelBuilder.h"
+#include "Utils.h"
+#include "nnCache.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include <android-base/file.h>
+
+#ifdef NN_DEBUGGABLE
+#include <android-base/properties.h>
+#endif  // NN_DEBUGGABLE
+
+namespace android {
+namespace nn {
+
+namespace {
+
+// Both the device and the CPU need this many measurements of a signature
+// before they replace the reported performance.
+const uint64_t kMinSamples = 3;
+
+// The table is saved to the cache after this many recorded executions.
+const uint32_t kRecordsBetweenSaves = 32;
+
+const char kCacheKey[] = "android.nn.PerformanceHistory";
+const uint32_t kCacheVersion = 2;
+const size_t kCacheMaxValueSize = 64 * 1024;
+const size_t kCacheMaxTotalSize = 256 * 1024;
+
+// Minimal serialization of the table for NNCache.
+class Writer {
+public:
+    template <typename T>
+    void write(const T& value) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        mBuffer.insert(mBuffer.end(), bytes, bytes + sizeof(T));
+    }
+    void write(const std::string& value) {
+        write(static_cast<uint32_t>(value.size()));
+        mBuffer.insert(mBuffer.end(), value.begin(), value.end());
+    }
+    const std::vector<uint8_t>& getBuffer() const { return mBuffer; }
+
+private:
+    std::vector<uint8_t> mBuffer;
+};
+
+class Reader {
+public:
+    Reader(const uint8_t* data, size_t size) : mData(data), mSize(size) {}
+    template <typename T>
+    bool read(T* value) {
+        if (mSize - mOffset < sizeof(T)) {
+            return false;
+        }
+        memcpy(value, mData + mOffset, sizeof(T));
+        mOffset += sizeof(T);
+        return true;
+    }
+    bool read(std::string* value) {
+        uint32_t size = 0;
+        if (!read(&size) || mSize - mOffset < size) {
+            return false;
+        }
+        value->assign(reinterpret_cast<const char*>(mData + mOffset), size);
+        mOffset += size;
+        return true;
+    }
+
+private:
+    const uint8_t* mData;
+    size_t mSize;
+    size_t mOffset = 0;
+};
+
+double getOutputSize(const ModelBuilder* model, const Operation& operation) {
+    double size = 0;
+    for (uint32_t operandIndex : operation.outputs) {
+        size += sizeOfData(model->getOperand(operandIndex));
+    }
+    // Operations whose outputs are of unknown size still take some time.
+    return std::max(size, 1.0);
+}
+
+}  // anonymous namespace
+
+PerformanceHistory* PerformanceHistory::get() {
+    // Never destroyed, like the other runtime singletons.
+    static PerformanceHistory* history = [] {
+        PerformanceHistory* history = new PerformanceHistory();
+#ifdef NN_DEBUGGABLE
+        history->setEnabled(getProp("debug.nn.profile") != 0);
+        const std::string filename = android::base::GetProperty("debug.nn.profile.file", "");
+        if (!filename.empty()) {
+            history->setCacheFile(filename);
+        }
+#endif  // NN_DEBUGGABLE
+        return history;
+    }();
+    return history;
+}
+
+std::string PerformanceHistory::getDeviceIdentity(const Device* device) {
+    if (device == nullptr) {
+        return std::string();
+    }
+    std::ostringstream identity;
+    auto writePerformance = [&identity](const PerformanceInfo& perf) {
+        identity << "/" << perf.execTime << ":" << perf.powerUsage;
+    };
+    identity << device->getName();
+    writePerformance(device->getFloat32Performance());
+    writePerformance(device->getQuantized8Performance());
+    writePerformance(device->getRelaxedFloat32toFloat16Performance());
+    return identity.str();
+}
+
+PerformanceHistory::Key PerformanceHistory::makeKey(const std::string& deviceIdentity,
+                                                    const ModelBuilder* model,
+                                                    uint32_t operationIndex) {
+    const Operation& operation = model->getOperation(operationIndex);
+    // Same choice of operand as ModelBuilder::getPerformanceInfo().
+    const OperandType operandType = model->getOperand(operation.inputs[0]).type;
+    return Key(deviceIdentity, operation.type, operandType,
+               model->isComputationFloat32RelaxedToFloat16());
+}
+
+void PerformanceHistory::recordExecution(const Device* device, const ModelBuilder* model,
+                                         std::chrono::nanoseconds duration) {
+    const auto& operations = model->getOperations();
+    if (!mEnabled || operations.empty()) {
+        return;
+    }
+    const std::string deviceIdentity = getDeviceIdentity(device);
+    double totalSize = 0;
+    for (const Operation& operation : operations) {
+        totalSize += getOutputSize(model, operation);
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (uint32_t operationIndex = 0; operationIndex < operations.size(); operationIndex++) {
+        const double size = getOutputSize(model, operations[operationIndex]);
+        Entry& entry = mEntries[makeKey(deviceIdentity, model, operationIndex)];
+        entry.samples++;
+        entry.nanoseconds += duration.count() * size / totalSize;
+        entry.bytes += size;
+    }
+    if (mCacheEnabled && ++mRecordsSinceSave >= kRecordsBetweenSaves) {
+        saveLocked();
+    }
+}
+
+bool PerformanceHistory::getRelativeExecTime(const Device* device, const ModelBuilder* model,
+                                             uint32_t operationIndex, float* perf) const {
+    if (!mEnabled) {
+        return false;
+    }
+    const Key deviceKey = makeKey(getDeviceIdentity(device), model, operationIndex);
+    const Key cpuKey = makeKey(std::string(), model, operationIndex);
+    std::lock_guard<std::mutex> lock(mMutex);
+    const auto deviceIt = mEntries.find(deviceKey);
+    const auto cpuIt = mEntries.find(cpuKey);
+    if (deviceIt == mEntries.end() || cpuIt == mEntries.end()) {
+        return false;
+    }
+    const Entry& deviceEntry = deviceIt->second;
+    const Entry& cpuEntry = cpuIt->second;
+    if (deviceEntry.samples < kMinSamples || cpuEntry.samples < kMinSamples ||
+        cpuEntry.nanoseconds <= 0) {
+        return false;
+    }
+    *perf = (deviceEntry.nanoseconds / deviceEntry.bytes) /
+            (cpuEntry.nanoseconds / cpuEntry.bytes);
+    return true;
+}
+
+bool PerformanceHistory::dump(int fd) const {
+    std::ostringstream table;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        table << "PerformanceHistory: " << mEntries.size() << " entries\n";
+        for (const auto& entry : mEntries) {
+            const Key& key = entry.first;
+            const Entry& value = entry.second;
+            table << "  " << (std::get<0>(key).empty() ? "CPU" : std::get<0>(key)) << " "
+                  << toString(std::get<1>(key)) << " " << toString(std::get<2>(key))
+                  << (std::get<3>(key) ? " relaxed" : "") << ": " << value.samples
+                  << " samples, " << value.nanoseconds / value.bytes << " ns/byte\n";
+        }
+    }
+    return android::base::WriteStringToFd(table.str(), fd);
+}
+
+void PerformanceHistory::reset() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mEntries.clear();
+    if (mCacheEnabled) {
+        saveLocked();
+    }
+}
+
+bool PerformanceHistory::setCacheFile(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mCacheEnabled) {
+        // NNCache is only initialized once, and the table already loaded.
+        return filename == mCacheFilename;
+    }
+    NNCache* cache = NNCache::get();
+    cache->initialize(sizeof(kCacheKey), kCacheMaxValueSize, kCacheMaxTotalSize);
+    cache->setCacheFilename(filename.c_str());
+    mCacheEnabled = true;
+    mCacheFilename = filename;
+    loadLocked();
+    return true;
+}
+
+void PerformanceHistory::loadLocked() {
+    uint8_t* data = nullptr;
+    const ssize_t size = NNCache::get()->getBlob(kCacheKey, sizeof(kCacheKey), &data,
+                                                 [](size_t size) { return malloc(size); });
+    if (size <= 0 || data == nullptr) {
+        return;
+    }
+    Reader reader(data, size);
+    uint32_t version = 0;
+    uint32_t count = 0;
+    bool ok = reader.read(&version) && version == kCacheVersion && reader.read(&count);
+    std::map<Key, Entry> entries;
+    for (uint32_t i = 0; ok && i < count; i++) {
+        std::string deviceIdentity;
+        int32_t operationType;
+        int32_t operandType;
+        uint8_t relaxed;
+        Entry entry;
+        ok = reader.read(&deviceIdentity) && reader.read(&operationType) &&
+             reader.read(&operandType) && reader.read(&relaxed) && reader.read(&entry.samples) &&
+             reader.read(&entry.nanoseconds) && reader.read(&entry.bytes);
+        if (ok) {
+            entries[Key(deviceIdentity, static_cast<OperationType>(operationType),
+                        static_cast<OperandType>(operandType), relaxed != 0)] = entry;
+        }
+    }
+    free(data);
+    if (!ok) {
+        LOG(WARNING) << "PerformanceHistory: ignoring malformed cache entry";
+        return;
+    }
+    // Measurements of this process come on top of the saved ones.
+    for (const auto& entry : mEntries) {
+        Entry& merged = entries[entry.first];
+        merged.samples += entry.second.samples;
+        merged.nanoseconds += entry.second.nanoseconds;
+        merged.bytes += entry.second.bytes;
+    }
+    mEntries = std::move(entries);
+    VLOG(EXECUTION) << "PerformanceHistory: loaded " << count << " entries";
+}
+
+void PerformanceHistory::saveLocked() {
+    mRecordsSinceSave = 0;
+    Writer writer;
+    writer.write(kCacheVersion);
+    writer.write(static_cast<uint32_t>(mEntries.size()));
+    for (const auto& entry : mEntries) {
+        const Key& key = entry.first;
+        writer.write(std::get<0>(key));
+        writer.write(static_cast<int32_t>(std::get<1>(key)));
+        writer.write(static_cast<int32_t>(std::get<2>(key)));
+        writer.write(static_cast<uint8_t>(std::get<3>(key)));
+        writer.write(entry.second.samples);
+        writer.write(entry.second.nanoseconds);
+        writer.write(entry.second.bytes);
+    }
+    const auto& buffer = writer.getBuffer();
+    if (buffer.size() > kCacheMaxValueSize) {
+        LOG(WARNING) << "PerformanceHistory: table too large to be cached";
+        return;
+    }
+    NNCache::get()->setBlob(kCacheKey, sizeof(kCacheKey), buffer.data(), buffer.size());
+}
+
+}  // namespace nn
+}  // namespace android
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_ML_NN_RUNTIME_PERFORMANCE_HISTORY_H
+#define ANDROID_ML_NN_RUNTIME_PERFORMANCE_HISTORY_H
+
+#include "HalInterfaces.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace android {
+namespace nn {
+
+class Device;
+class ModelBuilder;
+
+// Measured execution times of the operations on each device, which the
+// partitioner can use in place of the performance the drivers report in
+// their Capabilities.
+//
+// Times are recorded per execution of a (sub)model on a device, and split
+// between its operations in proportion to the size of their outputs.  They
+// are accumulated per device and operation signature: operation type,
+// type of the first input (the one that selects the PerformanceInfo of the
+// device), and whether float32 computations are relaxed to float16.  A
+// device is identified by its name and the Capabilities it reports, so
+// that two devices with the same name but different Capabilities, e.g. a
+// driver before and after an update, do not share measurements.
+//
+// A history is disabled when created: it then neither records executions
+// nor overrides the reported performance.  The history of the process,
+// returned by get(), is enabled by the application through
+// ANeuralNetworksPerformanceHistory_setEnabled(), or by the debug.nn.profile
+// property, and is the one executions record their times in.  Tests create
+// their own instances and pass them to ModelBuilder::partitionTheWork().
+class PerformanceHistory {
+public:
+    PerformanceHistory() {}
+
+    // Returns the history of the process.
+    static PerformanceHistory* get();
+
+    void setEnabled(bool enabled) { mEnabled = enabled; }
+    bool isEnabled() const { return mEnabled; }
+
+    // Records that model took duration to execute on device, nullptr
+    // meaning the CPU.  Does nothing if the history is disabled.
+    void recordExecution(const Device* device, const ModelBuilder* model,
+                         std::chrono::nanoseconds duration);
+
+    // If the history is enabled, and executions of operations with the same
+    // signature as the given one have been measured enough on both the
+    // device and the CPU, sets *perf to the time the device takes relative
+    // to the CPU, like PerformanceInfo::execTime, and returns true.
+    bool getRelativeExecTime(const Device* device, const ModelBuilder* model,
+                             uint32_t operationIndex, float* perf) const;
+
+    // Writes the table to the file descriptor, one line per entry.
+    // Returns false if it could not be written.
+    bool dump(int fd) const;
+
+    // Forgets all the measurements, including those in the cache.
+    void reset();
+
+    // Loads the table from, and later saves it to, the given file, through
+    // NNCache.  The cache of the process can only hold one file, so this
+    // should only be called on the history of the process, and the file
+    // cannot be changed once set: returns false if filename differs from
+    // the one set before.
+    bool setCacheFile(const std::string& filename);
+
+private:
+    // (device identity, operation type, operand type, relaxed); the device
+    // identity of the CPU is empty.
+    typedef std::tuple<std::string, OperationType, OperandType, bool> Key;
+
+    struct Entry {
+        uint64_t samples = 0;
+        double nanoseconds = 0;
+        double bytes = 0;
+    };
+
+    static std::string getDeviceIdentity(const Device* device);
+    static Key makeKey(const std::string& deviceIdentity, const ModelBuilder* model,
+                       uint32_t operationIndex);
+
+    void loadLocked();
+    void saveLocked();
+
+    std::atomic<bool> mEnabled{false};
+    mutable std::mutex mMutex;
+    std::map<Key, Entry> mEntries;
+    bool mCacheEnabled = false;
+    std::string mCacheFilename;
+    uint32_t mRecordsSinceSave = 0;
+};
+
+}  // namespace nn
+}  // namespace android
+
+#endif  // ANDROID_ML_NN_RUNTIME_PERFORMANCE_HISTORY_H
@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "StreamBuilder"
+
+#include "StreamBuilder.h"
+
+#include "CompilationBuilder.h"
+#include "ModelBuilder.h"
+#include "Tracing.h"
+#include "Utils.h"
+
+#include <cstring>
+
+namespace android {
+namespace nn {
+
+StreamBuilder::StreamBuilder(const CompilationBuilder* compilation) :
+        mExecution(compilation),
+        mModel(mExecution.getModel()),
+        mInputs(mModel->inputCount()),
+        mOutputs(mModel->outputCount()) {
+    mExecution.setReusable(true);
+    // Zero for operands that are not fully specified, which cannot be
+    // streamed.
+    for (uint32_t i = 0; i < mInputs.size(); i++) {
+        mInputs[i].stride = sizeOfData(mModel->getInputOperand(i));
+    }
+    for (uint32_t i = 0; i < mOutputs.size(); i++) {
+        mOutputs[i].stride = sizeOfData(mModel->getOutputOperand(i));
+    }
+}
+
+StreamBuilder::State* StreamBuilder::findStateOfInput(uint32_t inputIndex) {
+    for (State& state : mStates) {
+        if (state.inputIndex == inputIndex) {
+            return &state;
+        }
+    }
+    return nullptr;
+}
+
+StreamBuilder::State* StreamBuilder::findStateOfOutput(uint32_t outputIndex) {
+    for (State& state : mStates) {
+        if (state.outputIndex == outputIndex) {
+            return &state;
+        }
+    }
+    return nullptr;
+}
+
+int StreamBuilder::bindState(uint32_t outputIndex, uint32_t inputIndex) {
+    if (mStarted) {
+        LOG(ERROR) << "ANeuralNetworksStream_bindState called after the stream was computed";
+        return ANEURALNETWORKS_BAD_STATE;
+    }
+    if (outputIndex >= mOutputs.size() || inputIndex >= mInputs.size()) {
+        LOG(ERROR) << "ANeuralNetworksStream_bindState bad index " << outputIndex << " "
+                   << inputIndex;
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    if (findStateOfOutput(outputIndex) != nullptr || findStateOfInput(inputIndex) != nullptr) {
+        LOG(ERROR) << "ANeuralNetworksStream_bindState output " << outputIndex << " or input "
+                   << inputIndex << " already bound";
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    const Operand& output = mModel->getOutputOperand(outputIndex);
+    const Operand& input = mModel->getInputOperand(inputIndex);
+    if (output.type != input.type || output.dimensions != input.dimensions ||
+        output.scale != input.scale || output.zeroPoint != input.zeroPoint ||
+        mInputs[inputIndex].stride == 0) {
+        LOG(ERROR) << "ANeuralNetworksStream_bindState output " << outputIndex << " and input "
+                   << inputIndex << " are not of the same, fully specified, type";
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    State state;
+    state.outputIndex = outputIndex;
+    state.inputIndex = inputIndex;
+    state.buffers[0].assign(mInputs[inputIndex].stride, 0);
+    state.buffers[1].assign(mInputs[inputIndex].stride, 0);
+    mStates.push_back(std::move(state));
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+int StreamBuilder::setState(uint32_t inputIndex, const void* buffer, size_t length) {
+    State* state = findStateOfInput(inputIndex);
+    if (state == nullptr) {
+        LOG(ERROR) << "ANeuralNetworksStream_setState input " << inputIndex << " is not a state";
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    std::vector<uint8_t>& current = state->buffers[mCurrent];
+    if (length != current.size()) {
+        LOG(ERROR) << "ANeuralNetworksStream_setState bad length " << length << " for input "
+                   << inputIndex;
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    memcpy(current.data(), buffer, length);
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+int StreamBuilder::setInput(uint32_t index, const void* buffer, size_t length) {
+    if (index >= mInputs.size()) {
+        LOG(ERROR) << "ANeuralNetworksStream_setInput bad index " << index << " "
+                   << mInputs.size();
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    if (findStateOfInput(index) != nullptr) {
+        LOG(ERROR) << "ANeuralNetworksStream_setInput input " << index << " is a state";
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    Sequence& sequence = mInputs[index];
+    // An omitted optional input is omitted at every timestep.
+    if (buffer != nullptr &&
+        (sequence.stride == 0 || length == 0 || length % sequence.stride != 0)) {
+        LOG(ERROR) << "ANeuralNetworksStream_setInput length " << length << " of input " << index
+                   << " is not a whole number of timesteps";
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    sequence.buffer = static_cast<uint8_t*>(const_cast<void*>(buffer));
+    sequence.length = length;
+    sequence.specified = true;
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+int StreamBuilder::setOutput(uint32_t index, void* buffer, size_t length) {
+    if (index >= mOutputs.size()) {
+        LOG(ERROR) << "ANeuralNetworksStream_setOutput bad index " << index << " "
+                   << mOutputs.size();
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    if (findStateOfOutput(index) != nullptr) {
+        LOG(ERROR) << "ANeuralNetworksStream_setOutput output " << index << " is a state";
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    Sequence& sequence = mOutputs[index];
+    if (sequence.stride == 0 || length == 0 || length % sequence.stride != 0) {
+        LOG(ERROR) << "ANeuralNetworksStream_setOutput length " << length << " of output "
+                   << index << " is not a whole number of timesteps";
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    sequence.buffer = static_cast<uint8_t*>(buffer);
+    sequence.length = length;
+    sequence.specified = true;
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+uint8_t* StreamBuilder::getTimestepData(Sequence* sequence, uint32_t timestep) {
+    if (!sequence->specified) {
+        return sequence->scratch.data();
+    }
+    if (sequence->buffer == nullptr || sequence->length == sequence->stride) {
+        return sequence->buffer;
+    }
+    return sequence->buffer + size_t(timestep) * sequence->stride;
+}
+
+int StreamBuilder::bindArguments() {
+    for (uint32_t i = 0; i < mInputs.size(); i++) {
+        const State* state = findStateOfInput(i);
+        const void* data = state != nullptr ? state->buffers[mCurrent].data()
+                                            : getTimestepData(&mInputs[i], 0);
+        const size_t length = data != nullptr ? mInputs[i].stride : 0;
+        int n = mExecution.setInput(i, nullptr, data, length);
+        if (n != ANEURALNETWORKS_NO_ERROR) {
+            return n;
+        }
+    }
+    for (uint32_t i = 0; i < mOutputs.size(); i++) {
+        State* state = findStateOfOutput(i);
+        void* data = state != nullptr ? state->buffers[1 - mCurrent].data()
+                                      : getTimestepData(&mOutputs[i], 0);
+        int n = mExecution.setOutput(i, nullptr, data, mOutputs[i].stride);
+        if (n != ANEURALNETWORKS_NO_ERROR) {
+            return n;
+        }
+    }
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+int StreamBuilder::bindTimestep(uint32_t timestep) {
+    for (uint32_t i = 0; i < mInputs.size(); i++) {
+        const State* state = findStateOfInput(i);
+        const void* data = state != nullptr ? state->buffers[mCurrent].data()
+                                            : getTimestepData(&mInputs[i], timestep);
+        // An omitted input stays omitted.
+        if (data == nullptr) {
+            continue;
+        }
+        int n = mExecution.rebindInput(i, data);
+        if (n != ANEURALNETWORKS_NO_ERROR) {
+            return n;
+        }
+    }
+    for (uint32_t i = 0; i < mOutputs.size(); i++) {
+        State* state = findStateOfOutput(i);
+        void* data = state != nullptr ? state->buffers[1 - mCurrent].data()
+                                      : getTimestepData(&mOutputs[i], timestep);
+        int n = mExecution.rebindOutput(i, data);
+        if (n != ANEURALNETWORKS_NO_ERROR) {
+            return n;
+        }
+    }
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+int StreamBuilder::compute(uint32_t timestepCount) {
+    NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "StreamBuilder::compute");
+    if (timestepCount == 0) {
+        LOG(ERROR) << "ANeuralNetworksStream_compute passed no timestep";
+        return ANEURALNETWORKS_BAD_DATA;
+    }
+    // A sequence that does not hold a single timestep must hold them all.
+    auto holdsTimesteps = [timestepCount](const Sequence& sequence) {
+        return sequence.buffer == nullptr || sequence.length == sequence.stride ||
+               sequence.length >= uint64_t(timestepCount) * sequence.stride;
+    };
+    for (uint32_t i = 0; i < mInputs.size(); i++) {
+        if (findStateOfInput(i) != nullptr) {
+            continue;
+        }
+        if (!mInputs[i].specified) {
+            LOG(ERROR) << "ANeuralNetworksStream_compute not all inputs specified";
+            return ANEURALNETWORKS_BAD_DATA;
+        }
+        if (!holdsTimesteps(mInputs[i])) {
+            LOG(ERROR) << "ANeuralNetworksStream_compute input " << i << " is too short for "
+                       << timestepCount << " timesteps";
+            return ANEURALNETWORKS_BAD_DATA;
+        }
+    }
+    for (uint32_t i = 0; i < mOutputs.size(); i++) {
+        if (findStateOfOutput(i) != nullptr) {
+            continue;
+        }
+        Sequence& sequence = mOutputs[i];
+        if (!sequence.specified) {
+            if (sequence.stride == 0) {
+                LOG(ERROR) << "ANeuralNetworksStream_compute output " << i
+                           << " is not fully specified";
+                return ANEURALNETWORKS_BAD_DATA;
+            }
+            sequence.scratch.resize(sequence.stride);
+        } else if (!holdsTimesteps(sequence)) {
+            LOG(ERROR) << "ANeuralNetworksStream_compute output " << i << " is too short for "
+                       << timestepCount << " timesteps";
+            return ANEURALNETWORKS_BAD_DATA;
+        }
+    }
+
+    int n = bindArguments();
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return n;
+    }
+    mStarted = true;
+    for (uint32_t timestep = 0; timestep < timestepCount; timestep++) {
+        if (timestep > 0) {
+            n = bindTimestep(timestep);
+            if (n != ANEURALNETWORKS_NO_ERROR) {
+                return n;
+            }
+        }
+        n = mExecution.compute();
+        if (n != ANEURALNETWORKS_NO_ERROR) {
+            VLOG(EXECUTION) << "StreamBuilder::compute failed at timestep " << timestep;
+            return n;
+        }
+        // The outputs of this timestep are the state of the next one.
+        mCurrent = 1 - mCurrent;
+    }
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+}  // namespace nn
+}  // namespace android
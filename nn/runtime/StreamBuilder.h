@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_ML_NN_RUNTIME_STREAM_BUILDER_H
+#define ANDROID_ML_NN_RUNTIME_STREAM_BUILDER_H
+
+#include "ExecutionBuilder.h"
+#include "NeuralNetworks.h"
+
+#include <vector>
+
+namespace android {
+namespace nn {
+
+class CompilationBuilder;
+class ModelBuilder;
+
+// Applies a recurrent model to a sequence of timesteps, carrying the state
+// of the model from one timestep to the next inside the runtime.
+//
+// Some outputs of the model are bound to inputs with bindState(): the value
+// an output takes at a timestep is the value of the input at the next one.
+// The state is kept in two buffers per binding, which the input and the
+// output swap between timesteps, so it is never copied.
+//
+// The other inputs and outputs are sequences, laid out one timestep after
+// the other in the buffers given to setInput() and setOutput().  An input
+// or output whose buffer only holds one timestep is used by every
+// timestep.
+//
+// compute() runs all the timesteps on the calling thread, with a single
+// reusable ExecutionBuilder whose arguments are only repointed from one
+// timestep to the next.
+class StreamBuilder {
+public:
+    StreamBuilder(const CompilationBuilder* compilation);
+
+    int bindState(uint32_t outputIndex, uint32_t inputIndex);
+    int setState(uint32_t inputIndex, const void* buffer, size_t length);
+    int setInput(uint32_t index, const void* buffer, size_t length);
+    int setOutput(uint32_t index, void* buffer, size_t length);
+    int compute(uint32_t timestepCount);
+
+private:
+    struct State {
+        uint32_t outputIndex;
+        uint32_t inputIndex;
+        // The input reads buffers[mCurrent], the output writes the other.
+        std::vector<uint8_t> buffers[2];
+    };
+    struct Sequence {
+        uint8_t* buffer = nullptr;
+        size_t length = 0;
+        bool specified = false;
+        // The size of one timestep, i.e. of the operand.
+        uint32_t stride = 0;
+        // Only for an output that is neither bound to a state nor
+        // specified: where the execution writes it.
+        std::vector<uint8_t> scratch;
+    };
+
+    State* findStateOfInput(uint32_t inputIndex);
+    State* findStateOfOutput(uint32_t outputIndex);
+    uint8_t* getTimestepData(Sequence* sequence, uint32_t timestep);
+    // Sets the arguments of mExecution for the first timestep.
+    int bindArguments();
+    // Points the arguments of mExecution to the given timestep.
+    int bindTimestep(uint32_t timestep);
+
+    ExecutionBuilder mExecution;
+    const ModelBuilder* mModel;
+    std::vector<State> mStates;
+    uint32_t mCurrent = 0;
+    std::vector<Sequence> mInputs;
+    std::vector<Sequence> mOutputs;
+    // States may only be bound before the first computation.
+    bool mStarted = false;
+};
+
+}  // namespace nn
+}  // namespace android
+
+#endif  // ANDROID_ML_NN_RUNTIME_STREAM_BUILDER_H
@@ -1521,6 +1521,13 @@ typedef enum {
      *
      * Supported tensor {@link OperandCode}:
      * * {@link ANEURALNETWORKS_TENSOR_FLOAT32}
+     * * {@link ANEURALNETWORKS_TENSOR_QUANT8_ASYMM}
+     *
+     * For {@link ANEURALNETWORKS_TENSOR_QUANT8_ASYMM}, as for
+     * {@link ANEURALNETWORKS_ADD}, input0, input1 and the output can have
+     * different scales and zeroPoints. The quotient is computed on the
+     * dequantized inputs, and saturates to the range of the output. A division
+     * by zero saturates the output too, except 0 / 0, which is 0.
      *
      * Supported tensor rank: up to 4
      *
@@ -1740,6 +1747,12 @@ typedef enum {
      *
      * Supported tensor {@link OperandCode}:
      * * {@link ANEURALNETWORKS_TENSOR_FLOAT32}
+     * * {@link ANEURALNETWORKS_TENSOR_QUANT8_ASYMM}
+     *
+     * For {@link ANEURALNETWORKS_TENSOR_QUANT8_ASYMM}, as for
+     * {@link ANEURALNETWORKS_ADD}, input0, input1 and the output can have
+     * different scales and zeroPoints. The difference is computed on the
+     * dequantized inputs, and saturates to the range of the output.
      *
      * Supported tensor rank: up to 4
      *
@@ -2044,7 +2057,8 @@ typedef struct ANeuralNetworksCompilation ANeuralNetworksCompilation;
  *
  * <p>An execution can be applied to a model with
  * {@link ANeuralNetworksExecution_startCompute} only once. Create new executions
- * to do new evaluations of the model.</p>
+ * to do new evaluations of the model, or make the execution reusable with
+ * {@link ANeuralNetworksExecution_setReusable}.</p>
  *
  * <p>It is the application's responsibility to make sure that only one thread
  * modifies an execution at a given time. It is however safe for more than one
@@ -2125,6 +2139,76 @@ typedef int32_t ANeuralNetworksOperationType;
  */
 typedef struct ANeuralNetworksEvent ANeuralNetworksEvent;
 
+/**
+ * ANeuralNetworksBatch is an opaque type that can be used to evaluate
+ * several executions of the same compilation together.
+ *
+ * <p>It is meant for a compilation whose model takes a single sample at a
+ * time: the first dimension of each of its inputs and outputs, the batch
+ * dimension, is 1 or left unspecified. Each execution sets its inputs and
+ * outputs for one sample, with a batch dimension of 1. The batch packs the
+ * inputs of its executions along that dimension, applies the model once to
+ * all of them, and copies the results back to the outputs of each
+ * execution.</p>
+ *
+ * <p>To use:<ul>
+ *    <li>Create a new batch by calling the
+ *        {@link ANeuralNetworksBatch_create} function.</li>
+ *    <li>Either evaluate a set of executions with
+ *        {@link ANeuralNetworksBatch_compute}, or schedule executions one at
+ *        a time with {@link ANeuralNetworksBatch_startCompute}: they are
+ *        then evaluated together once enough of them have been scheduled,
+ *        or after a delay (see {@link ANeuralNetworksBatch_setQueueLimits}).</li>
+ *    <li>Destroy the batch with
+ *        {@link ANeuralNetworksBatch_free}.</li></ul></p>
+ *
+ * <p>Models with operations that do not process the samples of a batch
+ * independently, such as {@link ANEURALNETWORKS_RESHAPE} or the recurrent
+ * operations, are not packed: their executions are evaluated one at a
+ * time, with the same results.</p>
+ *
+ * <p>An execution must not be modified, and must not be evaluated by other
+ * means, while a batch evaluates it.</p>
+ *
+ * Available since API level 28.
+ */
+typedef struct ANeuralNetworksBatch ANeuralNetworksBatch;
+
+/**
+ * ANeuralNetworksStream is an opaque type that can be used to apply a
+ * recurrent model to a sequence of timesteps.
+ *
+ * <p>A recurrent model, for instance one built around
+ * {@link ANEURALNETWORKS_LSTM}, {@link ANEURALNETWORKS_RNN} or
+ * {@link ANEURALNETWORKS_SVDF}, takes its state as inputs and produces the
+ * state of the next timestep as outputs. A stream binds each of these
+ * outputs to the corresponding input, and keeps the state in the runtime
+ * from one timestep to the next: the application only provides the
+ * sequences of the other inputs, and collects the sequences of the other
+ * outputs.</p>
+ *
+ * <p>To use:<ul>
+ *    <li>Create a new stream by calling the
+ *        {@link ANeuralNetworksStream_create} function.</li>
+ *    <li>Bind the state outputs to the state inputs with
+ *        {@link ANeuralNetworksStream_bindState}, and optionally set the
+ *        initial state with {@link ANeuralNetworksStream_setState}.</li>
+ *    <li>Set the sequences of the other inputs and outputs with
+ *        {@link ANeuralNetworksStream_setInput} and
+ *        {@link ANeuralNetworksStream_setOutput}.</li>
+ *    <li>Evaluate timesteps with {@link ANeuralNetworksStream_compute},
+ *        as many times as needed: the state carries over from one call to
+ *        the next.</li>
+ *    <li>Destroy the stream with
+ *        {@link ANeuralNetworksStream_free}.</li></ul></p>
+ *
+ * <p>A stream can be applied to a single sequence at a time. It is not
+ * thread safe.</p>
+ *
+ * Available since API level 28.
+ */
+typedef struct ANeuralNetworksStream ANeuralNetworksStream;
+
 
 /**
  * Creates a shared memory object from a file descriptor.
@@ -2509,6 +2593,49 @@ int ANeuralNetworksCompilation_setPreference(ANeuralNetworksCompilation* compila
  */
 int ANeuralNetworksCompilation_finish(ANeuralNetworksCompilation* compilation) __INTRODUCED_IN(27);
 
+/**
+ * Tells a compilation where the application has mapped a memory object.
+ *
+ * The application maps the file descriptor the memory object was created
+ * from itself, and passes the address of its mapping of the beginning of
+ * the memory object.  Afterwards, any buffer passed to
+ * {@link ANeuralNetworksExecution_setInput} or
+ * {@link ANeuralNetworksExecution_setOutput} of an execution of the
+ * compilation that lies entirely within the mapping is passed to the drivers
+ * as a region of the memory object, as with
+ * {@link ANeuralNetworksExecution_setInputFromMemory} and
+ * {@link ANeuralNetworksExecution_setOutputFromMemory}, rather than being
+ * copied into and out of shared memory for each execution.
+ *
+ * The memory object must have been created with PROT_WRITE, and the
+ * mapping must be a readable and writable MAP_SHARED mapping of the whole
+ * memory object, so that the outputs written to the memory object appear
+ * in it.  The mapping is checked against the file and the offset the
+ * memory object was created from, without accessing its bytes.
+ *
+ * The mapping must remain valid until the compilation is freed, and must
+ * not overlap another mapping registered with the compilation.  The memory
+ * object may be freed before the compilation.
+ *
+ * This function may be called before or after
+ * {@link ANeuralNetworksCompilation_finish}, and concurrently with the
+ * executions of the compilation.
+ *
+ * Available since API level 28.
+ *
+ * @param compilation The compilation.
+ * @param memory The memory object.
+ * @param buffer The address at which the application has mapped the memory
+ *               object.
+ *
+ * @return ANEURALNETWORKS_NO_ERROR if successful, ANEURALNETWORKS_BAD_DATA if
+ *         the memory object is not writable, if buffer is not a shared
+ *         mapping of it, or if the mapping overlaps another registered one.
+ */
+int ANeuralNetworksCompilation_registerBuffer(ANeuralNetworksCompilation* compilation,
+                                              const ANeuralNetworksMemory* memory,
+                                              void* buffer) __INTRODUCED_IN(28);
+
 /**
  * Create a {@link ANeuralNetworksExecution} to apply the given compilation.
  * This only creates the object. Computation is only performed once
@@ -2548,6 +2675,40 @@ int ANeuralNetworksExecution_create(ANeuralNetworksCompilation* compilation,
  */
 void ANeuralNetworksExecution_free(ANeuralNetworksExecution* execution) __INTRODUCED_IN(27);
 
+/**
+ * Specifies whether the {@link ANeuralNetworksExecution} can be evaluated
+ * more than once.
+ *
+ * <p>Once a computation of a reusable execution has completed, its inputs
+ * and outputs may be associated with other buffers or memory regions, and
+ * the execution evaluated again with
+ * {@link ANeuralNetworksExecution_startCompute} or
+ * {@link ANeuralNetworksExecution_compute}. The work that only depends on the
+ * compilation, such as the partitioning of the inputs and outputs between
+ * the steps of the execution, is done for the first computation and reused
+ * by the following ones.</p>
+ *
+ * <p>While a computation is running, the functions that modify or evaluate
+ * the execution return ANEURALNETWORKS_BAD_STATE. Evaluating an execution
+ * that is not reusable a second time also returns
+ * ANEURALNETWORKS_BAD_STATE.</p>
+ *
+ * <p>By default, an execution is not reusable. This function must be called
+ * before the first computation of the execution.</p>
+ *
+ * See {@link ANeuralNetworksExecution} for information on multithreaded usage.
+ *
+ * Available since API level 28.
+ *
+ * @param execution The execution to be modified.
+ * @param reusable 'true' if the execution is to be evaluated more than once.
+ *
+ * @return ANEURALNETWORKS_NO_ERROR if successful, ANEURALNETWORKS_BAD_STATE
+ *         if the execution has already been evaluated.
+ */
+int ANeuralNetworksExecution_setReusable(ANeuralNetworksExecution* execution, bool reusable)
+        __INTRODUCED_IN(28);
+
 /**
  * Associate a user buffer with an input of the model of the
  * {@link ANeuralNetworksExecution}.
@@ -2737,6 +2898,25 @@ int ANeuralNetworksExecution_setOutputFromMemory(ANeuralNetworksExecution* execu
 int ANeuralNetworksExecution_startCompute(ANeuralNetworksExecution* execution,
                                           ANeuralNetworksEvent** event) __INTRODUCED_IN(27);
 
+/**
+ * Performs evaluation of the execution.
+ *
+ * <p>Evaluates the execution on the calling thread, and returns once the
+ * model has been applied and the outputs are ready to be consumed. This
+ * avoids the event, and the handoff to and from another thread, that
+ * {@link ANeuralNetworksExecution_startCompute} involves, which matters for
+ * models that take little time to execute.</p>
+ *
+ * See {@link ANeuralNetworksExecution} for information on multithreaded usage.
+ *
+ * Available since API level 28.
+ *
+ * @param execution The execution to be evaluated.
+ *
+ * @return ANEURALNETWORKS_NO_ERROR if the evaluation completed successfully.
+ */
+int ANeuralNetworksExecution_compute(ANeuralNetworksExecution* execution) __INTRODUCED_IN(28);
+
 /**
  * Waits until the execution completes.
  *
@@ -2760,6 +2940,291 @@ int ANeuralNetworksEvent_wait(ANeuralNetworksEvent* event) __INTRODUCED_IN(27);
  */
 void ANeuralNetworksEvent_free(ANeuralNetworksEvent* event) __INTRODUCED_IN(27);
 
+/**
+ * Create a {@link ANeuralNetworksBatch} to evaluate executions of the given
+ * compilation together.
+ *
+ * <p>The provided compilation must outlive the batch.</p>
+ *
+ * Available since API level 28.
+ *
+ * @param compilation The {@link ANeuralNetworksCompilation} to be evaluated.
+ * @param batch The newly created object or NULL if unsuccessful.
+ *
+ * @return ANEURALNETWORKS_NO_ERROR if successful, ANEURALNETWORKS_BAD_STATE
+ *         if the compilation is not finished.
+ */
+int ANeuralNetworksBatch_create(ANeuralNetworksCompilation* compilation,
+                                ANeuralNetworksBatch** batch) __INTRODUCED_IN(28);
+
+/**
+ * Destroy a batch.
+ *
+ * <p>Executions scheduled with {@link ANeuralNetworksBatch_startCompute}
+ * that have not been evaluated yet are evaluated before the function
+ * returns.</p>
+ *
+ * Available since API level 28.
+ *
+ * @param batch The batch to be destroyed. Passing NULL is acceptable and
+ *              results in no operation.
+ */
+void ANeuralNetworksBatch_free(ANeuralNetworksBatch* batch) __INTRODUCED_IN(28);
+
+/**
+ * Evaluates executions of the compilation of the batch together, and
+ * returns once all of them have completed.
+ *
+ * Available since API level 28.
+ *
+ * @param batch The batch.
+ * @param executions The executions to be evaluated, whose inputs and
+ *                   outputs have all been set.
+ * @param count The number of executions.
+ *
+ * @return ANEURALNETWORKS_NO_ERROR if all the evaluations completed
+ *         successfully. Otherwise the error of the first evaluation that
+ *         failed; the other executions are still evaluated.
+ */
+int ANeuralNetworksBatch_compute(ANeuralNetworksBatch* batch,
+                                 ANeuralNetworksExecution* const* executions, uint32_t count)
+        __INTRODUCED_IN(28);
+
+/**
+ * Sets when the executions scheduled with
+ * {@link ANeuralNetworksBatch_startCompute} are evaluated: as soon as maxSize
+ * of them are waiting, or maxDelayNanos after the first of them was
+ * scheduled, whichever comes first.
+ *
+ * <p>By default, up to 16 executions are evaluated together, and they wait
+ * for at most a millisecond.</p>
+ *
+ * Available since API level 28.
+ *
+ * @param batch The batch to be modified.
+ * @param maxSize The largest number of executions to evaluate together.
+ *                Must be greater than 0.
+ * @param maxDelayNanos How long, in nanoseconds, an execution may wait for
+ *                      others.
+ *
+ * @return ANEURALNETWORKS_NO_ERROR if successful.
+ */
+int ANeuralNetworksBatch_setQueueLimits(ANeuralNetworksBatch* batch, uint32_t maxSize,
+                                        uint64_t maxDelayNanos) __INTRODUCED_IN(28);
+
+/**
+ * Schedules an execution of the compilation of the batch, to be evaluated
+ * together with the executions scheduled around the same time.
+ *
+ * <p>The event is signaled once the execution has completed, and is used as
+ * with {@link ANeuralNetworksExecution_startCompute}.</p>
+ *
+ * Available since API level 28.
+ *
+ * @param batch The batch.
+ * @param execution The execution to be scheduled, whose inputs and outputs
+ *                  have all been set.
+ * @param event The event that will be signaled on completion. event is set to
+ *              NULL if there's an error.
+ *
+ * @return ANEURALNETWORKS_NO_ERROR if successful.
+ */
+int ANeuralNetworksBatch_startCompute(ANeuralNetworksBatch* batch,
+                                      ANeuralNetworksExecution* execution,
+                                      ANeuralNetworksEvent** event) __INTRODUCED_IN(28);
+
+/**
+ * Create a {@link ANeuralNetworksStream} to apply the given compilation to
+ * sequences of timesteps.
+ *
+ * <p>The inputs and outputs of the model, including the state, must be
+ * fully specified.</p>
+ *
+ * Available since API level 28.
+ *
+ * @param compilation The {@link ANeuralNetworksCompilation} to be evaluated.
+ * @param stream The newly created object or NULL if unsuccessful.
+ *
+ * @return ANEURALNETWORKS_NO_ERROR if successful, ANEURALNETWORKS_BAD_STATE
+ *         if the compilation is not finished.
+ */
+int ANeuralNetworksStream_create(ANeuralNetworksCompilation* compilation,
+                                 ANeuralNetworksStream** stream) __INTRODUCED_IN(28);
+
+/**
+ * Destroy a stream.
+ *
+ * Available since API level 28.
+ *
+ * @param stream The stream to be destroyed. Passing NULL is acceptable and
+ *               results in no operation.
+ */
+void ANeuralNetworksStream_free(ANeuralNetworksStream* stream) __INTRODUCED_IN(28);
+
+/**
+ * Binds an output of the model to an input, so that the value the output
+ * takes at a timestep is the value of the input at the next timestep.
+ *
+ * <p>The output and the input must have the same type. The state is zero
+ * until set with {@link ANeuralNetworksStream_setState}.</p>
+ *
+ * <p>States must be bound before the first call to
+ * {@link ANeuralNetworksStream_compute}.</p>
+ *
+ * Available since API level 28.
+ *
+ * @param stream The stream to be modified.
+ * @param outputIndex The index of the output producing the state.
+ * @param inputIndex The index of the input consuming the state.
+ *
+ * @return ANEURALNETWORKS_NO_ERROR if successful, ANEURALNETWORKS_BAD_STATE
+ *         if the stream has already been evaluated.
+ */
+int ANeuralNetworksStream_bindState(ANeuralNetworksStream* stream, uint32_t outputIndex,
+                                    uint32_t inputIndex) __INTRODUCED_IN(28);
+
+/**
+ * Sets the value of a state, for the next timestep to be evaluated.
+ *
+ * Available since API level 28.
+ *
+ * @param stream The stream to be modified.
+ * @param inputIndex The index of an input bound to an output with
+ *                   {@link ANeuralNetworksStream_bindState}.
+ * @param buffer The buffer containing the state, which is copied.
+ * @param length The length in bytes of the buffer.
+ *
+ * @return ANEURALNETWORKS_NO_ERROR if successful.
+ */
+int ANeuralNetworksStream_setState(ANeuralNetworksStream* stream, uint32_t inputIndex,
+                                   const void* buffer, size_t length) __INTRODUCED_IN(28);
+
+/**
+ * Associate a user buffer with the sequence of an input of the model.
+ *
+ * <p>The buffer holds the values of the input for successive timesteps, one
+ * after the other. A buffer holding a single value is used for all the
+ * timesteps. Passing buffer NULL and length 0 indicates an omitted optional
+ * input.</p>
+ *
+ * <p>The buffer must not be modified while
+ * {@link ANeuralNetworksStream_compute} runs.</p>
+ *
+ * Available since API level 28.
+ *
+ * @param stream The stream to be modified.
+ * @param index The index of the input argument, which must not be bound to
+ *              a state.
+ * @param buffer The buffer containing the sequence.
+ * @param length The length in bytes of the buffer.
+ *
+ * @return ANEURALNETWORKS_NO_ERROR if successful.
+ */
+int ANeuralNetworksStream_setInput(ANeuralNetworksStream* stream, int32_t index,
+                                   const void* buffer, size_t length) __INTRODUCED_IN(28);
+
+/**
+ * Associate a user buffer with the sequence of an output of the model.
+ *
+ * <p>The buffer receives the values of the output for successive timesteps,
+ * one after the other. A buffer holding a single value receives the value
+ * of the last timestep. An output which is not set is discarded.</p>
+ *
+ * Available since API level 28.
+ *
+ * @param stream The stream to be modified.
+ * @param index The index of the output argument, which must not be bound
+ *              to a state.
+ * @param buffer The buffer where the sequence is to be written.
+ * @param length The length in bytes of the buffer.
+ *
+ * @return ANEURALNETWORKS_NO_ERROR if successful.
+ */
+int ANeuralNetworksStream_setOutput(ANeuralNetworksStream* stream, int32_t index, void* buffer,
+                                    size_t length) __INTRODUCED_IN(28);
+
+/**
+ * Evaluates timesteps of the stream, and returns once they have all
+ * completed.
+ *
+ * <p>Each call starts again from the beginning of the buffers given to
+ * {@link ANeuralNetworksStream_setInput} and
+ * {@link ANeuralNetworksStream_setOutput}, and from the state left by the
+ * previous call.</p>
+ *
+ * Available since API level 28.
+ *
+ * @param stream The stream.
+ * @param timestepCount The number of timesteps to evaluate. The sequences
+ *                      must hold at least that many timesteps.
+ *
+ * @return ANEURALNETWORKS_NO_ERROR if all the timesteps completed
+ *         successfully.
+ */
+int ANeuralNetworksStream_compute(ANeuralNetworksStream* stream, uint32_t timestepCount)
+        __INTRODUCED_IN(28);
+
+
+/**
+ * Enables or disables the performance history of the process.
+ *
+ * <p>When enabled, the runtime measures how long each device takes to
+ * execute the models it is given, and compilations finished afterwards use
+ * these measurements, once there are enough of them, instead of the
+ * performance the devices report. Only the
+ * {@link ANEURALNETWORKS_PREFER_FAST_SINGLE_ANSWER} and
+ * {@link ANEURALNETWORKS_PREFER_SUSTAINED_SPEED} preferences use them.</p>
+ *
+ * <p>The performance history is disabled by default.</p>
+ *
+ * Available since API level 28.
+ *
+ * @param enabled Whether to measure executions and use the measurements.
+ *
+ * @return ANEURALNETWORKS_NO_ERROR if successful.
+ */
+int ANeuralNetworksPerformanceHistory_setEnabled(bool enabled) __INTRODUCED_IN(28);
+
+/**
+ * Loads the performance history of the process from a file, and saves it
+ * there periodically, so that measurements persist across runs of the
+ * application.
+ *
+ * <p>The file can only be set once per process. Setting it again to the
+ * same file has no effect, and setting it to another file fails.</p>
+ *
+ * Available since API level 28.
+ *
+ * @param filename The file, which must be writable by the application.
+ *
+ * @return ANEURALNETWORKS_NO_ERROR if successful, ANEURALNETWORKS_BAD_STATE
+ *         if the cache file was already set to another file.
+ */
+int ANeuralNetworksPerformanceHistory_setCacheFile(const char* filename) __INTRODUCED_IN(28);
+
+/**
+ * Writes the performance history of the process to a file descriptor, in a
+ * human readable form.
+ *
+ * Available since API level 28.
+ *
+ * @param fd The file descriptor, which must be open for writing.
+ *
+ * @return ANEURALNETWORKS_NO_ERROR if successful, ANEURALNETWORKS_BAD_DATA
+ *         if the history could not be written.
+ */
+int ANeuralNetworksPerformanceHistory_dump(int fd) __INTRODUCED_IN(28);
+
+/**
+ * Forgets all the measurements of the performance history of the process,
+ * including those saved to its cache file.
+ *
+ * Available since API level 28.
+ *
+ * @return ANEURALNETWORKS_NO_ERROR if successful.
+ */
+int ANeuralNetworksPerformanceHistory_reset() __INTRODUCED_IN(28);
+
 __END_DECLS
 
 #endif  // ANDROID_ML_NN_RUNTIME_NEURAL_NETWORKS_H
@@ -237,7 +237,7 @@ public:
 
     Result wait() { return static_cast<Result>(ANeuralNetworksEvent_wait(mEvent)); }
 
-    // Only for use by Execution
+    // Only for use by Execution and Batch
     void set(ANeuralNetworksEvent* newEvent) {
         ANeuralNetworksEvent_free(mEvent);
         mEvent = newEvent;
@@ -284,6 +284,12 @@ public:
 
     Result finish() { return static_cast<Result>(ANeuralNetworksCompilation_finish(mCompilation)); }
 
+    // See ANeuralNetworksCompilation_registerBuffer.
+    Result registerBuffer(const Memory& memory, void* buffer) {
+        return static_cast<Result>(
+                ANeuralNetworksCompilation_registerBuffer(mCompilation, memory.get(), buffer));
+    }
+
     ANeuralNetworksCompilation* getHandle() const { return mCompilation; }
 
 private:
@@ -320,6 +326,10 @@ public:
         return *this;
     }
 
+    Result setReusable(bool reusable) {
+        return static_cast<Result>(ANeuralNetworksExecution_setReusable(mExecution, reusable));
+    }
+
     Result setInput(uint32_t index, const void* buffer, size_t length,
                     const ANeuralNetworksOperandType* type = nullptr) {
         return static_cast<Result>(
@@ -365,10 +375,133 @@ public:
         return result;
     }
 
+    // Same as compute(), on the calling thread.
+    Result computeSynchronously() {
+        return static_cast<Result>(ANeuralNetworksExecution_compute(mExecution));
+    }
+
+    ANeuralNetworksExecution* getHandle() const { return mExecution; }
+
 private:
     ANeuralNetworksExecution* mExecution = nullptr;
 };
 
+class Batch {
+public:
+    Batch(const Compilation* compilation) {
+        int result = ANeuralNetworksBatch_create(compilation->getHandle(), &mBatch);
+        if (result != 0) {
+            // TODO Handle the error
+        }
+    }
+
+    ~Batch() { ANeuralNetworksBatch_free(mBatch); }
+
+    // Disallow copy semantics to ensure the runtime object can only be freed
+    // once. Copy semantics could be enabled if some sort of reference counting
+    // or deep-copy system for runtime objects is added later.
+    Batch(const Batch&) = delete;
+    Batch& operator=(const Batch&) = delete;
+
+    // Move semantics to remove access to the runtime object from the wrapper
+    // object that is being moved. This ensures the runtime object will be
+    // freed only once.
+    Batch(Batch&& other) { *this = std::move(other); }
+    Batch& operator=(Batch&& other) {
+        if (this != &other) {
+            ANeuralNetworksBatch_free(mBatch);
+            mBatch = other.mBatch;
+            other.mBatch = nullptr;
+        }
+        return *this;
+    }
+
+    Result compute(const std::vector<Execution*>& executions) {
+        std::vector<ANeuralNetworksExecution*> handles;
+        for (const Execution* execution : executions) {
+            handles.push_back(execution->getHandle());
+        }
+        return static_cast<Result>(
+                    ANeuralNetworksBatch_compute(mBatch, handles.data(), handles.size()));
+    }
+
+    Result setQueueLimits(uint32_t maxSize, uint64_t maxDelayNanos) {
+        return static_cast<Result>(
+                    ANeuralNetworksBatch_setQueueLimits(mBatch, maxSize, maxDelayNanos));
+    }
+
+    Result startCompute(Execution* execution, Event* event) {
+        ANeuralNetworksEvent* ev = nullptr;
+        Result result = static_cast<Result>(
+                    ANeuralNetworksBatch_startCompute(mBatch, execution->getHandle(), &ev));
+        event->set(ev);
+        return result;
+    }
+
+    ANeuralNetworksBatch* getHandle() const { return mBatch; }
+
+private:
+    ANeuralNetworksBatch* mBatch = nullptr;
+};
+
+class Stream {
+public:
+    Stream(const Compilation* compilation) {
+        int result = ANeuralNetworksStream_create(compilation->getHandle(), &mStream);
+        if (result != 0) {
+            // TODO Handle the error
+        }
+    }
+
+    ~Stream() { ANeuralNetworksStream_free(mStream); }
+
+    // Disallow copy semantics to ensure the runtime object can only be freed
+    // once. Copy semantics could be enabled if some sort of reference counting
+    // or deep-copy system for runtime objects is added later.
+    Stream(const Stream&) = delete;
+    Stream& operator=(const Stream&) = delete;
+
+    // Move semantics to remove access to the runtime object from the wrapper
+    // object that is being moved. This ensures the runtime object will be
+    // freed only once.
+    Stream(Stream&& other) { *this = std::move(other); }
+    Stream& operator=(Stream&& other) {
+        if (this != &other) {
+            ANeuralNetworksStream_free(mStream);
+            mStream = other.mStream;
+            other.mStream = nullptr;
+        }
+        return *this;
+    }
+
+    Result bindState(uint32_t outputIndex, uint32_t inputIndex) {
+        return static_cast<Result>(
+                    ANeuralNetworksStream_bindState(mStream, outputIndex, inputIndex));
+    }
+
+    Result setState(uint32_t inputIndex, const void* buffer, size_t length) {
+        return static_cast<Result>(
+                    ANeuralNetworksStream_setState(mStream, inputIndex, buffer, length));
+    }
+
+    Result setInput(uint32_t index, const void* buffer, size_t length) {
+        return static_cast<Result>(
+                    ANeuralNetworksStream_setInput(mStream, index, buffer, length));
+    }
+
+    Result setOutput(uint32_t index, void* buffer, size_t length) {
+        return static_cast<Result>(
+                    ANeuralNetworksStream_setOutput(mStream, index, buffer, length));
+    }
+
+    Result compute(uint32_t timestepCount) {
+        return static_cast<Result>(ANeuralNetworksStream_compute(mStream, timestepCount));
+    }
+
+private:
+    ANeuralNetworksStream* mStream = nullptr;
+};
+
 }  // namespace wrapper
 }  // namespace nn
 }  // namespace android
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares the latency of ANeuralNetworksExecution_compute with that of
+// ANeuralNetworksExecution_startCompute followed by ANeuralNetworksEvent_wait,
+// for a model small enough for the overhead of the runtime to matter.
+
+#include "NeuralNetworksWrapper.h"
+
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <vector>
+
+namespace android {
+namespace nn {
+namespace wrapper {
+namespace {
+
+// A single ADD of two {1, size} tensors.
+Model makeAddModel(uint32_t size) {
+    OperandType tensorType(Type::TENSOR_FLOAT32, {1, size});
+    OperandType scalarType(Type::INT32, {});
+    int32_t activation(ANEURALNETWORKS_FUSED_NONE);
+    Model model;
+    auto a = model.addOperand(&tensorType);
+    auto b = model.addOperand(&tensorType);
+    auto c = model.addOperand(&tensorType);
+    auto d = model.addOperand(&scalarType);
+    model.setOperandValue(d, &activation, sizeof(activation));
+    model.addOperation(ANEURALNETWORKS_ADD, {a, b, d}, {c});
+    model.identifyInputsAndOutputs({a, b}, {c});
+    model.finish();
+    return model;
+}
+
+Result computeAsync(Execution* execution) {
+    Event event;
+    Result result = execution->startCompute(&event);
+    if (result != Result::NO_ERROR) {
+        return result;
+    }
+    return event.wait();
+}
+
+Result computeSync(Execution* execution) {
+    return execution->computeSynchronously();
+}
+
+// Runs the model once per iteration, and reports the median and the 99th
+// percentile of the latencies, in microseconds, next to the mean.
+void runExecution(benchmark::State& state, Result (*compute)(Execution*)) {
+    const uint32_t size = state.range(0);
+    Model model = makeAddModel(size);
+    Compilation compilation(&model);
+    if (compilation.finish() != Result::NO_ERROR) {
+        state.SkipWithError("compilation failed");
+        return;
+    }
+    std::vector<float> input0(size, 1.f);
+    std::vector<float> input1(size, 2.f);
+    std::vector<float> output(size);
+    std::vector<double> latencies;
+    for (auto _ : state) {
+        const auto start = std::chrono::steady_clock::now();
+        Execution execution(&compilation);
+        execution.setInput(0, input0.data(), size * sizeof(float));
+        execution.setInput(1, input1.data(), size * sizeof(float));
+        execution.setOutput(0, output.data(), size * sizeof(float));
+        if (compute(&execution) != Result::NO_ERROR) {
+            state.SkipWithError("execution failed");
+            return;
+        }
+        latencies.push_back(std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    state.counters["p50_us"] = latencies[latencies.size() / 2];
+    state.counters["p99_us"] = latencies[latencies.size() * 99 / 100];
+}
+
+void BM_StartComputeAndWait(benchmark::State& state) {
+    runExecution(state, computeAsync);
+}
+BENCHMARK(BM_StartComputeAndWait)->Arg(4)->Arg(1 << 10)->Arg(1 << 16);
+
+void BM_Compute(benchmark::State& state) {
+    runExecution(state, computeSync);
+}
+BENCHMARK(BM_Compute)->Arg(4)->Arg(1 << 10)->Arg(1 << 16);
+
+}  // namespace
+}  // namespace wrapper
+}  // namespace nn
+}  // namespace android
+
+BENCHMARK_MAIN();
@@ -86,7 +86,11 @@ Compilation createAndCompileModel(Model* model, std::function<void(Model*)> crea
     return compilation;
 }
 
-void executeWithCompilation(Model* model, Compilation* compilation,
+// Whether the executions are computed with ANeuralNetworksExecution_startCompute
+// and ANeuralNetworksEvent_wait, or with ANeuralNetworksExecution_compute.
+enum class ComputeMode { ASYNC, SYNC };
+
+void executeWithCompilation(Model* model, Compilation* compilation, ComputeMode computeMode,
                             std::function<bool(int)> isIgnored,
                             std::vector<MixedTypedExample>& examples,
                             std::string dumpFile) {
@@ -126,7 +130,8 @@ void executeWithCompilation(Model* model, Compilation* compilation,
         });
 
         NNTRACE_APP_SWITCH(NNTRACE_PHASE_EXECUTION, "executeWithCompilation example");
-        Result r = execution.compute();
+        Result r = computeMode == ComputeMode::ASYNC ? execution.compute()
+                                                     : execution.computeSynchronously();
         ASSERT_EQ(Result::NO_ERROR, r);
 
         NNTRACE_APP_SWITCH(NNTRACE_PHASE_RESULTS, "executeWithCompilation example");
@@ -155,7 +160,15 @@ void executeOnce(std::function<void(Model*)> createModel,
     NNTRACE_APP(NNTRACE_PHASE_OVERALL, "executeOnce");
     Model model;
     Compilation compilation = createAndCompileModel(&model, createModel);
-    executeWithCompilation(&model, &compilation, isIgnored, examples, dumpFile);
+    {
+        SCOPED_TRACE("ASYNC");
+        executeWithCompilation(&model, &compilation, ComputeMode::ASYNC, isIgnored, examples,
+                               dumpFile);
+    }
+    {
+        SCOPED_TRACE("SYNC");
+        executeWithCompilation(&model, &compilation, ComputeMode::SYNC, isIgnored, examples, "");
+    }
 }
 
 
@@ -185,7 +198,8 @@ void executeMultithreadedSharedCompilation(std::function<void(Model*)> createMod
     std::vector<std::thread> threads;
     for (int i = 0; i < 10; i++) {
         threads.push_back(std::thread([&]() {
-            executeWithCompilation(&model, &compilation, isIgnored, examples, "");
+            executeWithCompilation(&model, &compilation, ComputeMode::ASYNC, isIgnored,
+                                   examples, "");
         }));
     }
     std::for_each(threads.begin(), threads.end(), [](std::thread& t) {
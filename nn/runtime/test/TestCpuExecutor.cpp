@@ -0,0 +1,952 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This test only tests internal APIs, and has dependencies on internal header
+// files, including NN API HIDL definitions.
+// It is not part of CTS.
+
+#include "CpuExecutor.h"
+#include "HalInterfaces.h"
+#include "ModelBuilder.h"
+#include "NeuralNetworksWrapper.h"
+
+#include <cstring>
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <list>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace ::android::nn;
+using WrapperModel = ::android::nn::wrapper::Model;
+using WrapperOperandType = ::android::nn::wrapper::OperandType;
+using WrapperType = ::android::nn::wrapper::Type;
+
+const uint32_t kBranchCount = 8;
+const uint32_t kSize = 256;
+
+// The buffer holding the value of an argument of a request, whatever the
+// type of its elements.
+struct Argument {
+    template <typename T>
+    Argument(std::vector<T>* values)
+        : buffer(reinterpret_cast<uint8_t*>(values->data())),
+          length(values->size() * sizeof(T)) {}
+    uint8_t* buffer;
+    uint32_t length;
+};
+
+// Returns the arguments whose buffers are the given values.
+template <typename T>
+std::vector<Argument> toArguments(std::vector<std::vector<T>>* values) {
+    std::vector<Argument> arguments;
+    for (std::vector<T>& value : *values) {
+        arguments.emplace_back(&value);
+    }
+    return arguments;
+}
+
+// Runs the prepared model with one memory pool per argument.
+void runWithArguments(CpuPreparedModel* preparedModel, const std::vector<Argument>& inputs,
+                      const std::vector<Argument>& outputs) {
+    Request request;
+    std::vector<RunTimePoolInfo> requestPoolInfos;
+    auto addArguments = [&requestPoolInfos](const std::vector<Argument>& values,
+                                            hidl_vec<RequestArgument>* arguments) {
+        arguments->resize(values.size());
+        for (uint32_t i = 0; i < values.size(); i++) {
+            (*arguments)[i] = {.hasNoValue = false,
+                               .location = {.poolIndex = uint32_t(requestPoolInfos.size()),
+                                            .offset = 0,
+                                            .length = values[i].length},
+                               .dimensions = {}};
+            requestPoolInfos.emplace_back(values[i].buffer);
+        }
+    };
+    addArguments(inputs, &request.inputs);
+    addArguments(outputs, &request.outputs);
+    ASSERT_EQ(preparedModel->run(request, requestPoolInfos), ANEURALNETWORKS_NO_ERROR);
+}
+
+class CpuExecutorTest : public ::testing::Test {
+protected:
+    void createBranchingModel(WrapperModel* model);
+    void createUnrolledLSTMModel(WrapperModel* model, uint32_t timestepCount);
+    void createFullyConnectedModel(WrapperModel* model, bool relaxed, uint32_t* weights);
+    void createHashtableLookupModel(WrapperModel* model, bool constantKeys, uint32_t* keys,
+                                    std::vector<int32_t>* keysValue);
+
+    // Sets the value of a constant operand of the model.  The model only
+    // points to values larger than
+    // ANEURALNETWORKS_MAX_SIZE_OF_IMMEDIATELY_COPIED_VALUES, so the test
+    // keeps them until it is done.
+    template <typename T>
+    void setOperandValue(WrapperModel* model, uint32_t operand, const std::vector<T>& values) {
+        const uint8_t* begin = reinterpret_cast<const uint8_t*>(values.data());
+        mValues.emplace_back(begin, begin + values.size() * sizeof(T));
+        model->setOperandValue(operand, mValues.back().data(), mValues.back().size());
+    }
+
+private:
+    std::list<std::vector<uint8_t>> mValues;
+};
+
+// Builds a model with independent branches computing (input + constant)^2,
+// whose results are then added together.  The constants are i + 1 for
+// branch i.
+void CpuExecutorTest::createBranchingModel(WrapperModel* model) {
+    WrapperOperandType tensorType(WrapperType::TENSOR_FLOAT32, {1, kSize});
+    WrapperOperandType scalarType(WrapperType::INT32, {});
+    static const int32_t kActivation = ANEURALNETWORKS_FUSED_NONE;
+
+    const uint32_t input = model->addOperand(&tensorType);
+    const uint32_t activation = model->addOperand(&scalarType);
+    model->setOperandValue(activation, &kActivation, sizeof(kActivation));
+    std::vector<uint32_t> branchOutputs;
+    for (uint32_t i = 0; i < kBranchCount; i++) {
+        const uint32_t constant = model->addOperand(&tensorType);
+        setOperandValue(model, constant, std::vector<float>(kSize, i + 1.0f));
+        const uint32_t sum = model->addOperand(&tensorType);
+        model->addOperation(ANEURALNETWORKS_ADD, {input, constant, activation}, {sum});
+        const uint32_t square = model->addOperand(&tensorType);
+        model->addOperation(ANEURALNETWORKS_MUL, {sum, sum, activation}, {square});
+        branchOutputs.push_back(square);
+    }
+    uint32_t total = branchOutputs[0];
+    for (uint32_t i = 1; i < kBranchCount; i++) {
+        const uint32_t newTotal = model->addOperand(&tensorType);
+        model->addOperation(ANEURALNETWORKS_ADD, {total, branchOutputs[i], activation},
+                            {newTotal});
+        total = newTotal;
+    }
+    model->identifyInputsAndOutputs({input}, {total});
+    ASSERT_TRUE(model->isValid());
+    ASSERT_EQ(model->finish(), ::android::nn::wrapper::Result::NO_ERROR);
+}
+
+Model getHidlModel(const WrapperModel& model) {
+    Model hidlModel;
+    reinterpret_cast<const ModelBuilder*>(model.getHandle())->setHidlModel(&hidlModel);
+    return hidlModel;
+}
+
+// Runs the prepared model of createBranchingModel() and checks the results.
+void runAndCheck(CpuPreparedModel* preparedModel, float inputValue) {
+    std::vector<float> input(kSize, inputValue);
+    std::vector<float> output(kSize, 0.0f);
+    runWithArguments(preparedModel, {&input}, {&output});
+
+    float expected = 0.0f;
+    for (uint32_t i = 0; i < kBranchCount; i++) {
+        expected += (inputValue + i + 1) * (inputValue + i + 1);
+    }
+    for (float value : output) {
+        ASSERT_FLOAT_EQ(value, expected);
+    }
+}
+
+// Builds FULLY_CONNECTED -> MUL by a per-channel constant -> ADD of a
+// per-channel constant -> RELU, all of which fuse into the FULLY_CONNECTED.
+void createFusibleModel(WrapperModel* model) {
+    WrapperOperandType inputType(WrapperType::TENSOR_FLOAT32, {2, 4});
+    WrapperOperandType weightsType(WrapperType::TENSOR_FLOAT32, {3, 4});
+    WrapperOperandType channelType(WrapperType::TENSOR_FLOAT32, {3});
+    WrapperOperandType outputType(WrapperType::TENSOR_FLOAT32, {2, 3});
+    WrapperOperandType scalarType(WrapperType::INT32, {});
+    static const float kWeights[] = {1, 2, 3, 4, -1, -2, -3, -4, 0.5, 0, -0.5, 1};
+    static const float kBias[] = {1, -1, 0.25};
+    static const float kScale[] = {2, -3, 0.5};
+    static const float kOffset[] = {-20, 4, 1};
+    static const int32_t kActivation = ANEURALNETWORKS_FUSED_NONE;
+
+    auto addConstant = [model](const WrapperOperandType& type, const void* data, size_t length) {
+        const uint32_t operand = model->addOperand(&type);
+        model->setOperandValue(operand, data, length);
+        return operand;
+    };
+    const uint32_t input = model->addOperand(&inputType);
+    const uint32_t weights = addConstant(weightsType, kWeights, sizeof(kWeights));
+    const uint32_t bias = addConstant(channelType, kBias, sizeof(kBias));
+    const uint32_t scale = addConstant(channelType, kScale, sizeof(kScale));
+    const uint32_t offset = addConstant(channelType, kOffset, sizeof(kOffset));
+    const uint32_t activation = addConstant(scalarType, &kActivation, sizeof(kActivation));
+    const uint32_t fullyConnected = model->addOperand(&outputType);
+    const uint32_t scaled = model->addOperand(&outputType);
+    const uint32_t offsetted = model->addOperand(&outputType);
+    const uint32_t output = model->addOperand(&outputType);
+    model->addOperation(ANEURALNETWORKS_FULLY_CONNECTED, {input, weights, bias, activation},
+                        {fullyConnected});
+    model->addOperation(ANEURALNETWORKS_MUL, {fullyConnected, scale, activation}, {scaled});
+    model->addOperation(ANEURALNETWORKS_ADD, {offset, scaled, activation}, {offsetted});
+    model->addOperation(ANEURALNETWORKS_RELU, {offsetted}, {output});
+    model->identifyInputsAndOutputs({input}, {output});
+    ASSERT_TRUE(model->isValid());
+    ASSERT_EQ(model->finish(), ::android::nn::wrapper::Result::NO_ERROR);
+}
+
+TEST_F(CpuExecutorTest, OperationFusion) {
+    WrapperModel model;
+    createFusibleModel(&model);
+    std::vector<float> input = {1, 2, 3, 4, -4, 3, -2, 1};
+    const uint32_t outputLength = 6 * sizeof(float);
+    std::vector<float> outputs[2];
+    for (bool fuse : {false, true}) {
+        SCOPED_TRACE(fuse);
+        CpuPreparedModel preparedModel(getHidlModel(model));
+        preparedModel.setFuseOperations(fuse);
+        ASSERT_TRUE(preparedModel.initialize());
+        const FusionReport& report = preparedModel.getFusionReport();
+        if (fuse) {
+            ASSERT_EQ(preparedModel.getModel().operations.size(), 1u);
+            ASSERT_EQ(report.fusedPairs.size(), 3u);
+            EXPECT_EQ(report.fusedPairs[0].second, OperationType::MUL);
+            EXPECT_EQ(report.fusedPairs[1].second, OperationType::ADD);
+            EXPECT_EQ(report.fusedPairs[2].second, OperationType::RELU);
+            EXPECT_EQ(report.eliminatedBytes, 3 * outputLength);
+        } else {
+            EXPECT_EQ(preparedModel.getModel().operations.size(), 4u);
+            EXPECT_TRUE(report.fusedPairs.empty());
+        }
+
+        std::vector<float>& output = outputs[fuse];
+        output.assign(6, -1.0f);
+        runWithArguments(&preparedModel, {&input}, {&output});
+    }
+    // The first output channel of the second batch is negative before the
+    // RELU.
+    EXPECT_EQ(outputs[false][3], 0.0f);
+    for (uint32_t i = 0; i < 6; i++) {
+        EXPECT_NEAR(outputs[false][i], outputs[true][i], 1e-5f) << "output " << i;
+    }
+}
+
+// Builds a quantized FULLY_CONNECTED computing {31, 8} from {1, 2, 3, 4}.
+void createQuantizedFullyConnectedModel(WrapperModel* model, uint32_t* weights,
+                                        uint32_t* output) {
+    WrapperOperandType inputType(WrapperType::TENSOR_QUANT8_ASYMM, {1, 4}, 1.0f, 0);
+    WrapperOperandType weightsType(WrapperType::TENSOR_QUANT8_ASYMM, {2, 4}, 0.5f, 128);
+    WrapperOperandType biasType(WrapperType::TENSOR_INT32, {2}, 0.5f, 0);
+    WrapperOperandType outputType(WrapperType::TENSOR_QUANT8_ASYMM, {1, 2}, 1.0f, 0);
+    WrapperOperandType scalarType(WrapperType::INT32, {});
+    static const int32_t kActivation = ANEURALNETWORKS_FUSED_NONE;
+    // {1, 2, 3, 4} and {-1, 0, 1, 2}.
+    static const uint8_t kWeights[] = {130, 132, 134, 136, 126, 128, 130, 132};
+    // {1, -2}.
+    static const int32_t kBias[] = {2, -4};
+
+    const uint32_t activation = model->addOperand(&scalarType);
+    model->setOperandValue(activation, &kActivation, sizeof(kActivation));
+    *weights = model->addOperand(&weightsType);
+    model->setOperandValue(*weights, kWeights, sizeof(kWeights));
+    const uint32_t bias = model->addOperand(&biasType);
+    model->setOperandValue(bias, kBias, sizeof(kBias));
+    const uint32_t input = model->addOperand(&inputType);
+    *output = model->addOperand(&outputType);
+    model->addOperation(ANEURALNETWORKS_FULLY_CONNECTED, {input, *weights, bias, activation},
+                        {*output});
+    model->identifyInputsAndOutputs({input}, {*output});
+    ASSERT_TRUE(model->isValid());
+    ASSERT_EQ(model->finish(), ::android::nn::wrapper::Result::NO_ERROR);
+}
+
+TEST_F(CpuExecutorTest, PreparedWeights) {
+    WrapperModel model;
+    uint32_t weights = 0;
+    uint32_t output = 0;
+    createQuantizedFullyConnectedModel(&model, &weights, &output);
+    const Model hidlModel = getHidlModel(model);
+    const Operand& weightsOperand = hidlModel.operands[weights];
+    ASSERT_EQ(weightsOperand.lifetime, OperandLifeTime::CONSTANT_COPY);
+
+    PreparedWeights preparedWeights;
+    ASSERT_TRUE(preparedWeights.initialize(hidlModel, {}));
+    // Bytes are always aligned, so the quantized weights are read in place.
+    EXPECT_EQ(preparedWeights.getBuffer(weights), nullptr);
+    EXPECT_EQ(preparedWeights.getCopiedSize(), 0u);
+    const QuantizedMultiplier* multiplier = preparedWeights.getOutputMultiplier(output);
+    ASSERT_NE(multiplier, nullptr);
+    // 0.5 in Q0.31, with no shift.
+    EXPECT_EQ(multiplier->multiplier, 1 << 30);
+    EXPECT_EQ(multiplier->shift, 0);
+
+    // The prepared model gets the same results from them on each execution.
+    CpuPreparedModel preparedModel(hidlModel);
+    ASSERT_TRUE(preparedModel.initialize());
+    for (int i = 0; i < 2; i++) {
+        std::vector<uint8_t> input = {1, 2, 3, 4};
+        std::vector<uint8_t> output = {0, 0};
+        runWithArguments(&preparedModel, {&input}, {&output});
+        EXPECT_EQ(output[0], 31);
+        EXPECT_EQ(output[1], 8);
+    }
+}
+
+TEST_F(CpuExecutorTest, PreparedWeightsAlignment) {
+    WrapperOperandType tensorType(WrapperType::TENSOR_FLOAT32, {1, 2});
+    WrapperOperandType biasType(WrapperType::TENSOR_FLOAT32, {1});
+    WrapperOperandType outputType(WrapperType::TENSOR_FLOAT32, {1, 1});
+    WrapperOperandType scalarType(WrapperType::INT32, {});
+    const float weightsValue[] = {1.0f, 2.0f};
+    const float biasValue[] = {0.5f};
+    const int32_t activation = ANEURALNETWORKS_FUSED_NONE;
+
+    WrapperModel model;
+    const uint32_t input = model.addOperand(&tensorType);
+    const uint32_t weights = model.addOperand(&tensorType);
+    model.setOperandValue(weights, weightsValue, sizeof(weightsValue));
+    const uint32_t bias = model.addOperand(&biasType);
+    model.setOperandValue(bias, biasValue, sizeof(biasValue));
+    const uint32_t scalar = model.addOperand(&scalarType);
+    model.setOperandValue(scalar, &activation, sizeof(activation));
+    const uint32_t output = model.addOperand(&outputType);
+    model.addOperation(ANEURALNETWORKS_FULLY_CONNECTED, {input, weights, bias, scalar}, {output});
+    model.identifyInputsAndOutputs({input}, {output});
+    ASSERT_EQ(model.finish(), ::android::nn::wrapper::Result::NO_ERROR);
+
+    // ModelBuilder aligns the weights, so move them to an odd offset, which
+    // is not aligned for a float.
+    Model hidlModel = getHidlModel(model);
+    Operand& operand = hidlModel.operands[weights];
+    ASSERT_EQ(operand.lifetime, OperandLifeTime::CONSTANT_COPY);
+    std::vector<uint8_t> values(hidlModel.operandValues.begin(), hidlModel.operandValues.end());
+    const uint32_t offset = values.size() | 1;
+    values.resize(offset + sizeof(weightsValue));
+    memcpy(&values[offset], weightsValue, sizeof(weightsValue));
+    hidlModel.operandValues = values;
+    operand.location.offset = offset;
+
+    PreparedWeights copied;
+    ASSERT_TRUE(copied.initialize(hidlModel, {}));
+    const uint8_t* copy = copied.getBuffer(weights);
+    ASSERT_NE(copy, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(copy) % kScratchArenaAlignment, 0u);
+    EXPECT_EQ(memcmp(copy, weightsValue, sizeof(weightsValue)), 0);
+    EXPECT_EQ(copied.getCopiedSize(), sizeof(weightsValue));
+
+    // The same weights in a memory pool are read where they are mapped.
+    operand.lifetime = OperandLifeTime::CONSTANT_REFERENCE;
+    operand.location.poolIndex = 0;
+    std::vector<RunTimePoolInfo> poolInfos;
+    poolInfos.emplace_back(values.data());
+    PreparedWeights referenced;
+    ASSERT_TRUE(referenced.initialize(hidlModel, poolInfos));
+    EXPECT_EQ(referenced.getBuffer(weights), nullptr);
+    EXPECT_EQ(referenced.getCopiedSize(), 0u);
+}
+
+TEST_F(CpuExecutorTest, OperationDependencies) {
+    WrapperModel model;
+    createBranchingModel(&model);
+    const Model hidlModel = getHidlModel(model);
+    OperationDependencies dependencies;
+    dependencies.initialize(hidlModel);
+    ASSERT_EQ(dependencies.getOperationCount(), hidlModel.operations.size());
+    EXPECT_EQ(dependencies.getMaxWidth(), kBranchCount);
+
+    // The last operation depends on all the others, directly or not.
+    const uint32_t last = dependencies.getOperationCount() - 1;
+    EXPECT_TRUE(dependencies.getConsumers(last).empty());
+    for (uint32_t i = 0; i < last; i++) {
+        EXPECT_TRUE(dependencies.precedes(i, last));
+        EXPECT_FALSE(dependencies.precedes(last, i));
+    }
+    // The first operations of the branches only depend on the model input.
+    uint32_t independentCount = 0;
+    for (uint32_t i = 0; i <= last; i++) {
+        if (dependencies.getProducerCount(i) == 0) {
+            independentCount++;
+        }
+    }
+    EXPECT_EQ(independentCount, kBranchCount);
+}
+
+TEST_F(CpuExecutorTest, ConcurrentTemporariesDoNotOverlap) {
+    WrapperModel model;
+    createBranchingModel(&model);
+    const Model hidlModel = getHidlModel(model);
+    OperationDependencies dependencies;
+    dependencies.initialize(hidlModel);
+    TemporaryMemoryPlan plan;
+    plan.initialize(hidlModel, &dependencies);
+
+    // Finds the operations writing and reading each temporary.
+    const uint32_t operandCount = hidlModel.operands.size();
+    std::vector<std::vector<uint32_t>> users(operandCount);
+    for (uint32_t i = 0; i < hidlModel.operations.size(); i++) {
+        for (uint32_t operand : hidlModel.operations[i].outputs) {
+            users[operand].insert(users[operand].begin(), i);
+        }
+        for (uint32_t operand : hidlModel.operations[i].inputs) {
+            users[operand].push_back(i);
+        }
+    }
+    auto isDoneBefore = [&](uint32_t operand1, uint32_t operand2) {
+        for (uint32_t user : users[operand1]) {
+            if (!dependencies.precedes(user, users[operand2][0])) {
+                return false;
+            }
+        }
+        return true;
+    };
+    const uint32_t size = kSize * sizeof(float);
+    for (uint32_t i = 0; i < operandCount; i++) {
+        if (plan.getOffset(i) == TemporaryMemoryPlan::kNotPlanned) {
+            continue;
+        }
+        for (uint32_t j = 0; j < i; j++) {
+            if (plan.getOffset(j) == TemporaryMemoryPlan::kNotPlanned ||
+                isDoneBefore(i, j) || isDoneBefore(j, i)) {
+                continue;
+            }
+            const bool overlap = plan.getOffset(i) < plan.getOffset(j) + size &&
+                                 plan.getOffset(j) < plan.getOffset(i) + size;
+            EXPECT_FALSE(overlap) << "operands " << i << " and " << j << " overlap";
+        }
+    }
+    // The temporaries still share memory.
+    EXPECT_LT(plan.getArenaSize(), plan.getTotalSizeOfTemporaries());
+}
+
+TEST_F(CpuExecutorTest, ParallelOperations) {
+    WrapperModel model;
+    createBranchingModel(&model);
+    for (bool parallel : {false, true}) {
+        SCOPED_TRACE(parallel);
+        CpuPreparedModel preparedModel(getHidlModel(model));
+        preparedModel.setParallelOperations(parallel);
+        ASSERT_TRUE(preparedModel.initialize());
+        for (int i = 0; i < 10; i++) {
+            runAndCheck(&preparedModel, i * 0.5f);
+        }
+    }
+}
+
+TEST_F(CpuExecutorTest, ConcurrentParallelExecutions) {
+    WrapperModel model;
+    createBranchingModel(&model);
+    CpuPreparedModel preparedModel(getHidlModel(model));
+    preparedModel.setParallelOperations(true);
+    ASSERT_TRUE(preparedModel.initialize());
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&preparedModel, t] {
+            for (int i = 0; i < 20; i++) {
+                runAndCheck(&preparedModel, t + i * 0.25f);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+const uint32_t kLSTMInputSize = 3;
+const uint32_t kLSTMCellCount = 4;
+
+// Builds an LSTM unrolled over timestepCount timesteps, all of them with the
+// same weights.  The inputs are those of the timesteps followed by the
+// initial output and cell states, the outputs those of the timesteps
+// followed by the final output and cell states.
+void CpuExecutorTest::createUnrolledLSTMModel(WrapperModel* model, uint32_t timestepCount) {
+    WrapperOperandType inputType(WrapperType::TENSOR_FLOAT32, {1, kLSTMInputSize});
+    WrapperOperandType inputWeightsType(WrapperType::TENSOR_FLOAT32,
+                                        {kLSTMCellCount, kLSTMInputSize});
+    WrapperOperandType recurrentWeightsType(WrapperType::TENSOR_FLOAT32,
+                                            {kLSTMCellCount, kLSTMCellCount});
+    WrapperOperandType vectorType(WrapperType::TENSOR_FLOAT32, {kLSTMCellCount});
+    WrapperOperandType stateType(WrapperType::TENSOR_FLOAT32, {1, kLSTMCellCount});
+    WrapperOperandType scratchType(WrapperType::TENSOR_FLOAT32, {1, 4 * kLSTMCellCount});
+    WrapperOperandType intScalarType(WrapperType::INT32, {});
+    WrapperOperandType floatScalarType(WrapperType::FLOAT32, {});
+    static const int32_t kTanh = 4;
+    static const float kNoClip = 0.0f;
+
+    // Four input weights, four recurrent weights and four biases.
+    std::vector<uint32_t> weights;
+    for (uint32_t i = 0; i < 12; i++) {
+        const WrapperOperandType& type =
+                i < 4 ? inputWeightsType : i < 8 ? recurrentWeightsType : vectorType;
+        const uint32_t size = i < 4 ? kLSTMCellCount * kLSTMInputSize
+                                    : i < 8 ? kLSTMCellCount * kLSTMCellCount : kLSTMCellCount;
+        std::vector<float> values(size);
+        for (uint32_t j = 0; j < size; j++) {
+            values[j] = 0.1f * (static_cast<int32_t>((i * 7 + j * 5) % 11) - 5);
+        }
+        weights.push_back(model->addOperand(&type));
+        setOperandValue(model, weights.back(), values);
+    }
+    auto addNoValue = [model](const WrapperOperandType& type) {
+        const uint32_t operand = model->addOperand(&type);
+        model->setOperandValue(operand, nullptr, 0);
+        return operand;
+    };
+    const uint32_t cellToInput = addNoValue(vectorType);
+    const uint32_t cellToForget = addNoValue(vectorType);
+    const uint32_t cellToOutput = addNoValue(vectorType);
+    const uint32_t projectionWeights = addNoValue(recurrentWeightsType);
+    const uint32_t projectionBias = addNoValue(vectorType);
+    const uint32_t activation = model->addOperand(&intScalarType);
+    model->setOperandValue(activation, &kTanh, sizeof(kTanh));
+    const uint32_t cellClip = model->addOperand(&floatScalarType);
+    model->setOperandValue(cellClip, &kNoClip, sizeof(kNoClip));
+    const uint32_t projectionClip = model->addOperand(&floatScalarType);
+    model->setOperandValue(projectionClip, &kNoClip, sizeof(kNoClip));
+
+    std::vector<uint32_t> inputs;
+    std::vector<uint32_t> outputs;
+    const uint32_t initialOutputState = model->addOperand(&stateType);
+    const uint32_t initialCellState = model->addOperand(&stateType);
+    uint32_t outputState = initialOutputState;
+    uint32_t cellState = initialCellState;
+    for (uint32_t t = 0; t < timestepCount; t++) {
+        const uint32_t input = model->addOperand(&inputType);
+        std::vector<uint32_t> operationInputs = {input};
+        operationInputs.insert(operationInputs.end(), weights.begin(), weights.begin() + 8);
+        operationInputs.insert(operationInputs.end(),
+                               {cellToInput, cellToForget, cellToOutput, weights[8],
+                                weights[9], weights[10], weights[11], projectionWeights,
+                                projectionBias, outputState, cellState, activation, cellClip,
+                                projectionClip});
+        const uint32_t scratch = model->addOperand(&scratchType);
+        const uint32_t nextOutputState = model->addOperand(&stateType);
+        const uint32_t nextCellState = model->addOperand(&stateType);
+        const uint32_t output = model->addOperand(&stateType);
+        model->addOperation(ANEURALNETWORKS_LSTM, operationInputs,
+                            {scratch, nextOutputState, nextCellState, output});
+        inputs.push_back(input);
+        outputs.push_back(output);
+        outputState = nextOutputState;
+        cellState = nextCellState;
+    }
+    inputs.push_back(initialOutputState);
+    inputs.push_back(initialCellState);
+    outputs.push_back(outputState);
+    outputs.push_back(cellState);
+    model->identifyInputsAndOutputs(inputs, outputs);
+    ASSERT_TRUE(model->isValid());
+    ASSERT_EQ(model->finish(), ::android::nn::wrapper::Result::NO_ERROR);
+}
+
+TEST_F(CpuExecutorTest, LSTMSequence) {
+    const uint32_t timestepCount = 3;
+    WrapperModel unrolledModel;
+    createUnrolledLSTMModel(&unrolledModel, timestepCount);
+    CpuPreparedModel unrolled(getHidlModel(unrolledModel));
+    ASSERT_TRUE(unrolled.initialize());
+    WrapperModel singleModel;
+    createUnrolledLSTMModel(&singleModel, 1);
+    CpuPreparedModel single(getHidlModel(singleModel));
+    ASSERT_TRUE(single.initialize());
+
+    // The timesteps of the unrolled model make one sequence.
+    PreparedWeights weights;
+    ASSERT_TRUE(weights.initialize(unrolled.getModel(), {}));
+    ASSERT_EQ(weights.getLSTMSequenceCount(), 1u);
+    EXPECT_EQ(weights.getLSTMSequence(0).inputs.size(), timestepCount);
+    EXPECT_EQ(weights.getLSTMSequence(0).gateCount, 4u);
+    ASSERT_TRUE(weights.initialize(single.getModel(), {}));
+    EXPECT_EQ(weights.getLSTMSequenceCount(), 0u);
+
+    std::vector<std::vector<float>> inputs;
+    for (uint32_t t = 0; t < timestepCount; t++) {
+        inputs.push_back({0.5f * t, 1.0f - t, -0.25f});
+    }
+    inputs.push_back(std::vector<float>(kLSTMCellCount, 0.1f));
+    inputs.push_back(std::vector<float>(kLSTMCellCount, -0.2f));
+    std::vector<std::vector<float>> outputs(timestepCount + 2,
+                                            std::vector<float>(kLSTMCellCount, 0.0f));
+    runWithArguments(&unrolled, toArguments(&inputs), toArguments(&outputs));
+
+    // The same timesteps, one execution each, carrying the state.
+    std::vector<std::vector<float>> stepInputs = {inputs[0], inputs[timestepCount],
+                                                  inputs[timestepCount + 1]};
+    for (uint32_t t = 0; t < timestepCount; t++) {
+        SCOPED_TRACE(t);
+        stepInputs[0] = inputs[t];
+        std::vector<std::vector<float>> stepOutputs(3, std::vector<float>(kLSTMCellCount, 0.0f));
+        runWithArguments(&single, toArguments(&stepInputs), toArguments(&stepOutputs));
+        for (uint32_t i = 0; i < kLSTMCellCount; i++) {
+            EXPECT_NEAR(outputs[t][i], stepOutputs[0][i], 1e-5f) << "output " << i;
+        }
+        stepInputs[1] = stepOutputs[1];
+        stepInputs[2] = stepOutputs[2];
+    }
+    for (uint32_t i = 0; i < kLSTMCellCount; i++) {
+        EXPECT_NEAR(outputs[timestepCount][i], stepInputs[1][i], 1e-5f) << "state " << i;
+        EXPECT_NEAR(outputs[timestepCount + 1][i], stepInputs[2][i], 1e-5f) << "cell " << i;
+    }
+}
+
+// Builds a model computing 2 * input + input, where both terms go through
+// RESHAPEs: the first one of a temporary, the other ones of the model input.
+void createReshapingModel(WrapperModel* model, uint32_t* sum, uint32_t* sumView,
+                          uint32_t* inputView, uint32_t* inputViewView) {
+    WrapperOperandType inputType(WrapperType::TENSOR_FLOAT32, {2, 3});
+    WrapperOperandType flatType(WrapperType::TENSOR_FLOAT32, {6});
+    WrapperOperandType outputType(WrapperType::TENSOR_FLOAT32, {3, 2});
+    WrapperOperandType shapeType(WrapperType::TENSOR_INT32, {1});
+    WrapperOperandType outputShapeType(WrapperType::TENSOR_INT32, {2});
+    WrapperOperandType scalarType(WrapperType::INT32, {});
+    static const int32_t kActivation = ANEURALNETWORKS_FUSED_NONE;
+    static const int32_t kFlatShape[] = {6};
+    static const int32_t kOutputShape[] = {3, 2};
+
+    const uint32_t input = model->addOperand(&inputType);
+    const uint32_t activation = model->addOperand(&scalarType);
+    model->setOperandValue(activation, &kActivation, sizeof(kActivation));
+    const uint32_t flatShape = model->addOperand(&shapeType);
+    model->setOperandValue(flatShape, kFlatShape, sizeof(kFlatShape));
+    const uint32_t outputShape = model->addOperand(&outputShapeType);
+    model->setOperandValue(outputShape, kOutputShape, sizeof(kOutputShape));
+    *sum = model->addOperand(&inputType);
+    *sumView = model->addOperand(&outputType);
+    *inputView = model->addOperand(&flatType);
+    *inputViewView = model->addOperand(&outputType);
+    const uint32_t output = model->addOperand(&outputType);
+    model->addOperation(ANEURALNETWORKS_ADD, {input, input, activation}, {*sum});
+    model->addOperation(ANEURALNETWORKS_RESHAPE, {*sum, outputShape}, {*sumView});
+    model->addOperation(ANEURALNETWORKS_RESHAPE, {input, flatShape}, {*inputView});
+    model->addOperation(ANEURALNETWORKS_RESHAPE, {*inputView, outputShape}, {*inputViewView});
+    model->addOperation(ANEURALNETWORKS_ADD, {*sumView, *inputViewView, activation}, {output});
+    model->identifyInputsAndOutputs({input}, {output});
+    ASSERT_TRUE(model->isValid());
+    ASSERT_EQ(model->finish(), ::android::nn::wrapper::Result::NO_ERROR);
+}
+
+TEST_F(CpuExecutorTest, ReshapeViews) {
+    WrapperModel model;
+    uint32_t sum = 0, sumView = 0, inputView = 0, inputViewView = 0;
+    createReshapingModel(&model, &sum, &sumView, &inputView, &inputViewView);
+    const Model hidlModel = getHidlModel(model);
+
+    // The outputs of the RESHAPEs of temporaries share their memory.
+    TemporaryMemoryPlan plan;
+    plan.initialize(hidlModel);
+    ASSERT_NE(plan.getOffset(sum), TemporaryMemoryPlan::kNotPlanned);
+    EXPECT_EQ(plan.getOffset(sumView), plan.getOffset(sum));
+    ASSERT_NE(plan.getOffset(inputView), TemporaryMemoryPlan::kNotPlanned);
+    EXPECT_EQ(plan.getOffset(inputViewView), plan.getOffset(inputView));
+
+    for (bool parallel : {false, true}) {
+        SCOPED_TRACE(parallel);
+        CpuPreparedModel preparedModel(hidlModel);
+        preparedModel.setParallelOperations(parallel);
+        preparedModel.setFuseOperations(false);
+        ASSERT_TRUE(preparedModel.initialize());
+        std::vector<float> input = {1, 2, 3, 4, 5, 6};
+        std::vector<float> output(6, 0.0f);
+        runWithArguments(&preparedModel, {&input}, {&output});
+        for (uint32_t i = 0; i < 6; i++) {
+            EXPECT_EQ(output[i], 3.0f * input[i]) << "output " << i;
+        }
+    }
+}
+
+// Builds a model applying TRANSPOSE with the given permutation to an input
+// of the given dimensions.
+void createTransposeModel(WrapperModel* model, const std::vector<uint32_t>& dimensions,
+                          const std::vector<int32_t>& perm) {
+    std::vector<uint32_t> outputDimensions;
+    for (int32_t axis : perm) {
+        outputDimensions.push_back(dimensions[axis]);
+    }
+    WrapperOperandType inputType(WrapperType::TENSOR_FLOAT32, dimensions);
+    WrapperOperandType outputType(WrapperType::TENSOR_FLOAT32, outputDimensions);
+    WrapperOperandType permType(WrapperType::TENSOR_INT32, {uint32_t(perm.size())});
+
+    const uint32_t input = model->addOperand(&inputType);
+    const uint32_t permOperand = model->addOperand(&permType);
+    model->setOperandValue(permOperand, perm.data(), perm.size() * sizeof(int32_t));
+    const uint32_t output = model->addOperand(&outputType);
+    model->addOperation(ANEURALNETWORKS_TRANSPOSE, {input, permOperand}, {output});
+    model->identifyInputsAndOutputs({input}, {output});
+    ASSERT_TRUE(model->isValid());
+    ASSERT_EQ(model->finish(), ::android::nn::wrapper::Result::NO_ERROR);
+}
+
+TEST_F(CpuExecutorTest, LargeTranspose) {
+    // Large enough to be split between threads, and not a multiple of the
+    // tiles of the transpose.
+    const std::vector<uint32_t> dimensions = {2, 33, 45, 70};
+    const uint32_t size = 2 * 33 * 45 * 70;
+    const uint32_t inputStrides[] = {33 * 45 * 70, 45 * 70, 70, 1};
+    const std::vector<std::vector<int32_t>> perms = {
+            {0, 3, 1, 2}, {0, 2, 3, 1}, {0, 1, 3, 2}, {3, 2, 1, 0}, {1, 0, 2, 3}};
+    for (const std::vector<int32_t>& perm : perms) {
+        SCOPED_TRACE(::testing::PrintToString(perm));
+        WrapperModel model;
+        createTransposeModel(&model, dimensions, perm);
+        CpuPreparedModel preparedModel(getHidlModel(model));
+        ASSERT_TRUE(preparedModel.initialize());
+        std::vector<float> input(size);
+        for (uint32_t i = 0; i < size; i++) {
+            input[i] = i;
+        }
+        std::vector<float> output(size, -1.0f);
+        runWithArguments(&preparedModel, {&input}, {&output});
+
+        uint32_t outputIndex = 0;
+        uint32_t index[4];
+        for (index[0] = 0; index[0] < dimensions[perm[0]]; index[0]++) {
+            for (index[1] = 0; index[1] < dimensions[perm[1]]; index[1]++) {
+                for (index[2] = 0; index[2] < dimensions[perm[2]]; index[2]++) {
+                    for (index[3] = 0; index[3] < dimensions[perm[3]]; index[3]++) {
+                        uint32_t inputIndex = 0;
+                        for (uint32_t i = 0; i < 4; i++) {
+                            inputIndex += index[i] * inputStrides[perm[i]];
+                        }
+                        ASSERT_EQ(output[outputIndex++], input[inputIndex]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_F(CpuExecutorTest, TransposeRejectsRepeatedAxes) {
+    const Shape permShape = {OperandType::TENSOR_INT32, {2}, 0.0f, 0};
+    const int32_t repeatedFirst[] = {0, 0};
+    const int32_t repeatedLast[] = {1, 1};
+    const int32_t swapped[] = {1, 0};
+    for (const std::vector<uint32_t>& dimensions :
+         std::vector<std::vector<uint32_t>>{{2, 3}, {3, 1}}) {
+        SCOPED_TRACE(::testing::PrintToString(dimensions));
+        const Shape input = {OperandType::TENSOR_FLOAT32, dimensions, 0.0f, 0};
+        Shape output;
+        EXPECT_FALSE(transposePrepare(input, repeatedFirst, permShape, &output));
+        EXPECT_FALSE(transposePrepare(input, repeatedLast, permShape, &output));
+        ASSERT_TRUE(transposePrepare(input, swapped, permShape, &output));
+        EXPECT_EQ(output.dimensions, std::vector<uint32_t>({dimensions[1], dimensions[0]}));
+    }
+}
+
+// Builds a model computing operation(input1, input2) on quant8 tensors, with
+// input2 broadcast along the rows of input1.
+void createQuant8BroadcastModel(WrapperModel* model, ANeuralNetworksOperationType operation) {
+    WrapperOperandType input1Type(WrapperType::TENSOR_QUANT8_ASYMM, {2, 3}, 0.5f, 10);
+    WrapperOperandType input2Type(WrapperType::TENSOR_QUANT8_ASYMM, {3}, 0.25f, 4);
+    WrapperOperandType outputType(WrapperType::TENSOR_QUANT8_ASYMM, {2, 3}, 0.5f, 128);
+    WrapperOperandType scalarType(WrapperType::INT32, {});
+    static const int32_t kActivation = ANEURALNETWORKS_FUSED_NONE;
+
+    const uint32_t input1 = model->addOperand(&input1Type);
+    const uint32_t input2 = model->addOperand(&input2Type);
+    const uint32_t activation = model->addOperand(&scalarType);
+    model->setOperandValue(activation, &kActivation, sizeof(kActivation));
+    const uint32_t output = model->addOperand(&outputType);
+    model->addOperation(operation, {input1, input2, activation}, {output});
+    model->identifyInputsAndOutputs({input1, input2}, {output});
+    ASSERT_TRUE(model->isValid());
+    ASSERT_EQ(model->finish(), ::android::nn::wrapper::Result::NO_ERROR);
+}
+
+TEST_F(CpuExecutorTest, Quant8SubAndDiv) {
+    struct TestCase {
+        ANeuralNetworksOperationType operation;
+        std::vector<uint8_t> input2;
+        std::vector<uint8_t> expected;
+    };
+    // Real values {0, 1, 2, 3, -4, 5}.
+    std::vector<uint8_t> input1 = {10, 12, 14, 16, 2, 20};
+    const std::vector<TestCase> cases = {
+            // {1, -1, 4}, giving {-1, 2, -2, 2, -3, 1}.
+            {ANEURALNETWORKS_SUB, {8, 0, 20}, {126, 132, 124, 132, 122, 130}},
+            // {1, -1, 4}, giving {0, -1, 0.5, 3, 4, 1.25}, 1.25 being rounded
+            // away from zero.
+            {ANEURALNETWORKS_DIV, {8, 0, 20}, {128, 126, 129, 134, 136, 131}},
+            // {0, 0, 4}: the divisions by zero saturate, except 0 / 0, which is 0.
+            {ANEURALNETWORKS_DIV, {4, 4, 20}, {128, 255, 129, 255, 0, 131}},
+    };
+    for (const auto& testCase : cases) {
+        SCOPED_TRACE(testCase.operation);
+        WrapperModel model;
+        createQuant8BroadcastModel(&model, testCase.operation);
+        CpuPreparedModel preparedModel(getHidlModel(model));
+        ASSERT_TRUE(preparedModel.initialize());
+
+        std::vector<uint8_t> input2 = testCase.input2;
+        std::vector<uint8_t> output(6, 0);
+        runWithArguments(&preparedModel, {&input1, &input2}, {&output});
+        EXPECT_EQ(output, testCase.expected);
+    }
+}
+
+const uint32_t kFullyConnectedBatches = 2;
+const uint32_t kFullyConnectedInputSize = 64;
+const uint32_t kFullyConnectedUnits = 32;
+
+// Builds a FULLY_CONNECTED model with constant weights, whose float32
+// computations are relaxed to float16 or not.  Sets *weights to the index
+// of the weights operand.
+void CpuExecutorTest::createFullyConnectedModel(WrapperModel* model, bool relaxed,
+                                                uint32_t* weights) {
+    WrapperOperandType inputType(WrapperType::TENSOR_FLOAT32,
+                                 {kFullyConnectedBatches, kFullyConnectedInputSize});
+    WrapperOperandType weightsType(WrapperType::TENSOR_FLOAT32,
+                                   {kFullyConnectedUnits, kFullyConnectedInputSize});
+    WrapperOperandType biasType(WrapperType::TENSOR_FLOAT32, {kFullyConnectedUnits});
+    WrapperOperandType outputType(WrapperType::TENSOR_FLOAT32,
+                                  {kFullyConnectedBatches, kFullyConnectedUnits});
+    WrapperOperandType scalarType(WrapperType::INT32, {});
+    static const int32_t kActivation = ANEURALNETWORKS_FUSED_RELU;
+    std::vector<float> weightsValue(kFullyConnectedUnits * kFullyConnectedInputSize);
+    for (uint32_t i = 0; i < weightsValue.size(); i++) {
+        weightsValue[i] = 0.01f * static_cast<int32_t>(i % 37) - 0.17f;
+    }
+
+    const uint32_t input = model->addOperand(&inputType);
+    *weights = model->addOperand(&weightsType);
+    setOperandValue(model, *weights, weightsValue);
+    const uint32_t bias = model->addOperand(&biasType);
+    setOperandValue(model, bias, std::vector<float>(kFullyConnectedUnits, 0.5f));
+    const uint32_t activation = model->addOperand(&scalarType);
+    model->setOperandValue(activation, &kActivation, sizeof(kActivation));
+    const uint32_t output = model->addOperand(&outputType);
+    model->addOperation(ANEURALNETWORKS_FULLY_CONNECTED, {input, *weights, bias, activation},
+                        {output});
+    model->identifyInputsAndOutputs({input}, {output});
+    model->relaxComputationFloat32toFloat16(relaxed);
+    ASSERT_TRUE(model->isValid());
+    ASSERT_EQ(model->finish(), ::android::nn::wrapper::Result::NO_ERROR);
+}
+
+TEST_F(CpuExecutorTest, RelaxedFullyConnected) {
+    std::vector<float> outputs[2];
+    for (bool relaxed : {false, true}) {
+        SCOPED_TRACE(relaxed);
+        WrapperModel model;
+        uint32_t weights = 0;
+        createFullyConnectedModel(&model, relaxed, &weights);
+        CpuPreparedModel preparedModel(getHidlModel(model));
+        ASSERT_TRUE(preparedModel.initialize());
+#if NN_HAS_FLOAT16
+        // Only the weights of the relaxed model are stored as float16.
+        std::vector<RunTimePoolInfo> poolInfos;
+        ASSERT_TRUE(setRunTimePoolInfosFromHidlMemories(&poolInfos,
+                                                        preparedModel.getModel().pools));
+        PreparedWeights preparedWeights;
+        ASSERT_TRUE(preparedWeights.initialize(preparedModel.getModel(), poolInfos));
+        EXPECT_EQ(preparedWeights.getFloat16Buffer(weights) != nullptr, relaxed);
+#endif
+
+        std::vector<float> input(kFullyConnectedBatches * kFullyConnectedInputSize);
+        for (uint32_t i = 0; i < input.size(); i++) {
+            input[i] = 0.02f * static_cast<int32_t>(i % 23) - 0.2f;
+        }
+        outputs[relaxed].assign(kFullyConnectedBatches * kFullyConnectedUnits, 0.0f);
+        runWithArguments(&preparedModel, {&input}, {&outputs[relaxed]});
+    }
+    // Within the tolerance of the generated tests for relaxed models.
+    for (uint32_t i = 0; i < outputs[0].size(); i++) {
+        EXPECT_NEAR(outputs[0][i], outputs[1][i], 5.0f * 0.0009765625f) << "output " << i;
+    }
+}
+
+const uint32_t kHashtableKeys = 1000;
+const uint32_t kHashtableRowSize = 4;
+const uint32_t kHashtableLookups = 10000;
+
+// Builds a HASHTABLE_LOOKUP model whose sorted keys span the whole int32
+// range, and are constant or an input after the lookups.  Sets *keys to the
+// index of the keys operand.
+void CpuExecutorTest::createHashtableLookupModel(WrapperModel* model, bool constantKeys,
+                                                 uint32_t* keys,
+                                                 std::vector<int32_t>* keysValue) {
+    WrapperOperandType lookupsType(WrapperType::TENSOR_INT32, {kHashtableLookups});
+    WrapperOperandType keysType(WrapperType::TENSOR_INT32, {kHashtableKeys});
+    WrapperOperandType valuesType(WrapperType::TENSOR_FLOAT32,
+                                  {kHashtableKeys, kHashtableRowSize});
+    WrapperOperandType outputType(WrapperType::TENSOR_FLOAT32,
+                                  {kHashtableLookups, kHashtableRowSize});
+    WrapperOperandType hitsType(WrapperType::TENSOR_QUANT8_ASYMM, {kHashtableLookups}, 1.f, 0);
+    keysValue->resize(kHashtableKeys);
+    for (uint32_t i = 0; i < kHashtableKeys; i++) {
+        (*keysValue)[i] = static_cast<int32_t>(i * 4099) - 2000000;
+    }
+    keysValue->front() = std::numeric_limits<int32_t>::min();
+    keysValue->back() = std::numeric_limits<int32_t>::max();
+    std::vector<float> valuesValue(kHashtableKeys * kHashtableRowSize);
+    for (uint32_t i = 0; i < valuesValue.size(); i++) {
+        valuesValue[i] = static_cast<float>(i);
+    }
+
+    const uint32_t lookups = model->addOperand(&lookupsType);
+    *keys = model->addOperand(&keysType);
+    if (constantKeys) {
+        setOperandValue(model, *keys, *keysValue);
+    }
+    const uint32_t values = model->addOperand(&valuesType);
+    setOperandValue(model, values, valuesValue);
+    const uint32_t output = model->addOperand(&outputType);
+    const uint32_t hits = model->addOperand(&hitsType);
+    model->addOperation(ANEURALNETWORKS_HASHTABLE_LOOKUP, {lookups, *keys, values},
+                        {output, hits});
+    if (constantKeys) {
+        model->identifyInputsAndOutputs({lookups}, {output, hits});
+    } else {
+        model->identifyInputsAndOutputs({lookups, *keys}, {output, hits});
+    }
+    ASSERT_TRUE(model->isValid());
+    ASSERT_EQ(model->finish(), ::android::nn::wrapper::Result::NO_ERROR);
+}
+
+TEST_F(CpuExecutorTest, HashtableLookup) {
+    for (bool constantKeys : {false, true}) {
+        SCOPED_TRACE(constantKeys);
+        WrapperModel model;
+        uint32_t keys = 0;
+        std::vector<int32_t> keysValue;
+        createHashtableLookupModel(&model, constantKeys, &keys, &keysValue);
+        CpuPreparedModel preparedModel(getHidlModel(model));
+        ASSERT_TRUE(preparedModel.initialize());
+        // Only constant keys are indexed.
+        std::vector<RunTimePoolInfo> poolInfos;
+        ASSERT_TRUE(setRunTimePoolInfosFromHidlMemories(&poolInfos,
+                                                        preparedModel.getModel().pools));
+        PreparedWeights preparedWeights;
+        ASSERT_TRUE(preparedWeights.initialize(preparedModel.getModel(), poolInfos));
+        EXPECT_EQ(preparedWeights.getHashtableLookupIndex(keys) != nullptr, constantKeys);
+
+        // Every third lookup flips the lowest bit of a key, and misses.
+        std::vector<int32_t> lookups(kHashtableLookups);
+        for (uint32_t i = 0; i < kHashtableLookups; i++) {
+            const uint32_t row = (i * 7) % (kHashtableKeys - 1) + (i % 2);
+            lookups[i] = keysValue[row] ^ (i % 3 == 0 ? 1 : 0);
+        }
+        std::vector<float> output(kHashtableLookups * kHashtableRowSize, -1.f);
+        std::vector<uint8_t> hits(kHashtableLookups, 2);
+        std::vector<Argument> inputs = {&lookups};
+        if (!constantKeys) {
+            inputs.emplace_back(&keysValue);
+        }
+        runWithArguments(&preparedModel, inputs, {&output, &hits});
+
+        for (uint32_t i = 0; i < kHashtableLookups; i++) {
+            const uint32_t row = (i * 7) % (kHashtableKeys - 1) + (i % 2);
+            const bool hit = i % 3 != 0;
+            ASSERT_EQ(hits[i], hit ? 1 : 0) << "lookup " << i;
+            for (uint32_t j = 0; j < kHashtableRowSize; j++) {
+                const float expected = hit ? static_cast<float>(row * kHashtableRowSize + j) : 0.f;
+                ASSERT_EQ(output[i * kHashtableRowSize + j], expected) << "lookup " << i;
+            }
+        }
+    }
+}
+
+}  // namespace
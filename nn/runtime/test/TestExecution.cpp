@@ -27,6 +27,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <future>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -160,6 +161,54 @@ private:
     TestDriver11 m11Driver;
 };
 
+// Wraps an IPreparedModel to hold each execution until the test releases it.
+class BlockingPreparedModel : public IPreparedModel {
+public:
+    BlockingPreparedModel(sp<IPreparedModel> preparedModel, std::shared_future<void> release) :
+            mPreparedModel(preparedModel), mRelease(release) {}
+
+    Return<ErrorStatus> execute(const Request& request,
+                                const sp<IExecutionCallback>& callback) override {
+        mRelease.wait();
+        return mPreparedModel->execute(request, callback);
+    }
+private:
+    sp<IPreparedModel> mPreparedModel;
+    std::shared_future<void> mRelease;
+};
+
+// Behaves like TestDriver11, except that it produces BlockingPreparedModel.
+class BlockingDriver : public TestDriver11 {
+public:
+    BlockingDriver(const std::string& name, std::shared_future<void> release) :
+            TestDriver11(name, ErrorStatus::NONE), mRelease(release) {}
+
+    Return<ErrorStatus> prepareModel_1_1(
+        const HidlModel& model,
+        ExecutionPreference preference,
+        const sp<IPreparedModelCallback>& actualCallback) override {
+
+        sp<PreparedModelCallback> localCallback = new PreparedModelCallback;
+        Return<ErrorStatus> prepareModelReturn =
+                TestDriver11::prepareModel_1_1(model, preference, localCallback);
+        if (!prepareModelReturn.isOkUnchecked()) {
+            return prepareModelReturn;
+        }
+        localCallback->wait();
+        if (localCallback->getStatus() != ErrorStatus::NONE) {
+            actualCallback->notify(localCallback->getStatus(), localCallback->getPreparedModel());
+        } else {
+            actualCallback->notify(ErrorStatus::NONE,
+                                   new BlockingPreparedModel(localCallback->getPreparedModel(),
+                                                             mRelease));
+        }
+        return prepareModelReturn;
+    }
+
+private:
+    std::shared_future<void> mRelease;
+};
+
 // This class adds some simple utilities on top of
 // ::android::nn::wrapper::Compilation in order to provide access to
 // certain features from CompilationBuilder that are not exposed by
@@ -207,8 +256,9 @@ public:
             mCompilation(&mModel) { }
 
 protected:
-    // Unit test method
+    // Unit test methods
     void TestWait();
+    void TestCompute();
 
     const std::string kName;
 
@@ -263,6 +313,17 @@ template<class DriverClass> void ExecutionTestTemplate<DriverClass>::TestWait()
     }
 }
 
+template<class DriverClass> void ExecutionTestTemplate<DriverClass>::TestCompute() {
+    SCOPED_TRACE(kName);
+    ASSERT_EQ(mCompilation.finish(kName, kForceErrorStatus), Result::NO_ERROR);
+    WrapperExecution execution(&mCompilation);
+    ASSERT_NO_FATAL_FAILURE(setInputOutput(&execution));
+    ASSERT_EQ(execution.computeSynchronously(), kExpectResult);
+    if (kExpectResult == Result::NO_ERROR) {
+        ASSERT_EQ(mOutputBuffer, kOutputBufferExpected);
+    }
+}
+
 auto kTestValues = ::testing::Values(std::make_tuple(ErrorStatus::NONE,
                                                      Result::NO_ERROR),
                                      std::make_tuple(ErrorStatus::DEVICE_UNAVAILABLE,
@@ -278,13 +339,64 @@ class ExecutionTest11 : public ExecutionTestTemplate<TestDriver11> {};
 TEST_P(ExecutionTest11, Wait) {
     TestWait();
 }
+TEST_P(ExecutionTest11, Compute) {
+    TestCompute();
+}
 INSTANTIATE_TEST_CASE_P(Flavor, ExecutionTest11, kTestValues);
 
 class ExecutionTest10 : public ExecutionTestTemplate<TestDriver10> {};
 TEST_P(ExecutionTest10, Wait) {
     TestWait();
 }
+TEST_P(ExecutionTest10, Compute) {
+    TestCompute();
+}
 INSTANTIATE_TEST_CASE_P(Flavor, ExecutionTest10, kTestValues);
 
+// An execution can't be modified or computed again until its computation
+// is done.
+TEST(ExecutionStateTest, Computing) {
+    const WrapperOperandType tensorType(WrapperType::TENSOR_FLOAT32, { 1 });
+    WrapperModel model;
+    uint32_t input = model.addOperand(&tensorType);
+    uint32_t output = model.addOperand(&tensorType);
+    model.addOperation(ANEURALNETWORKS_FLOOR, { input }, { output });
+    model.identifyInputsAndOutputs({ input }, { output });
+    ASSERT_EQ(model.finish(), Result::NO_ERROR);
+
+    std::promise<void> release;
+    WrapperCompilation compilation(&model);
+    auto builder = reinterpret_cast<CompilationBuilder*>(compilation.getHandle());
+    builder->setPartitioning(DeviceManager::kPartitioningWithoutFallback);
+    auto device = std::make_shared<Device>(
+            "blocking", new BlockingDriver("blocking", release.get_future().share()));
+    ASSERT_TRUE(device->initialize());
+    ASSERT_EQ(builder->finish({device}), ANEURALNETWORKS_NO_ERROR);
+
+    float inputBuffer = 3.14, outputBuffer = 0;
+    WrapperExecution execution(&compilation);
+    ASSERT_EQ(execution.setReusable(true), Result::NO_ERROR);
+    ASSERT_EQ(execution.setInput(0, &inputBuffer, sizeof(inputBuffer)), Result::NO_ERROR);
+    ASSERT_EQ(execution.setOutput(0, &outputBuffer, sizeof(outputBuffer)), Result::NO_ERROR);
+    WrapperEvent event;
+    ASSERT_EQ(execution.startCompute(&event), Result::NO_ERROR);
+
+    // The driver holds the computation until released.
+    EXPECT_EQ(execution.setInput(0, &inputBuffer, sizeof(inputBuffer)), Result::BAD_STATE);
+    EXPECT_EQ(execution.setOutput(0, &outputBuffer, sizeof(outputBuffer)), Result::BAD_STATE);
+    WrapperEvent event2;
+    EXPECT_EQ(execution.startCompute(&event2), Result::BAD_STATE);
+    EXPECT_EQ(execution.computeSynchronously(), Result::BAD_STATE);
+
+    release.set_value();
+    ASSERT_EQ(event.wait(), Result::NO_ERROR);
+    EXPECT_EQ(outputBuffer, 3);
+
+    inputBuffer = 2.5;
+    ASSERT_EQ(execution.setInput(0, &inputBuffer, sizeof(inputBuffer)), Result::NO_ERROR);
+    ASSERT_EQ(execution.computeSynchronously(), Result::NO_ERROR);
+    EXPECT_EQ(outputBuffer, 2);
+}
+
 }  // namespace
 }  // namespace android
@@ -28,6 +28,7 @@
 #include <gtest/gtest.h>
 
 #include <fstream>
+#include <memory>
 #include <string>
 
 using WrapperCompilation = ::android::nn::wrapper::Compilation;
@@ -222,6 +223,82 @@ TEST_F(MemoryLeakTest, Instantiate) {
     close(fd);
 }
 
+TEST_F(MemoryLeakTest, RegisterBuffer) {
+    static const size_t size = 64;
+    int fd = ASharedMemory_create(nullptr, size);
+    ASSERT_GE(fd, 0);
+    uint8_t* buf = (uint8_t*)mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ASSERT_NE(buf, nullptr);
+
+    using ::android::nn::Memory;
+    using ::android::nn::RegisteredBuffers;
+    uint32_t offset = 0;
+    RegisteredBuffers buffers;
+    {
+        WrapperMemory mem(size, PROT_READ | PROT_WRITE, fd, 0);
+        ASSERT_TRUE(mem.isValid());
+        ASSERT_EQ(buffers.find(buf + 16, 8, &offset), nullptr);
+        ASSERT_EQ(buffers.add(reinterpret_cast<const Memory*>(mem.get()), buf),
+                  ANEURALNETWORKS_NO_ERROR);
+
+        std::shared_ptr<const Memory> registered = buffers.find(buf + 16, 8, &offset);
+        ASSERT_NE(registered, nullptr);
+        ASSERT_EQ(registered->getSize(), size);
+        ASSERT_EQ(offset, 16u);
+        ASSERT_EQ(buffers.find(buf, size, &offset), registered);
+        ASSERT_EQ(offset, 0u);
+        // Partly outside of the buffer.
+        ASSERT_EQ(buffers.find(buf + 60, 8, &offset), nullptr);
+
+        // The buffer of another memory may not overlap.
+        WrapperMemory other(size, PROT_READ | PROT_WRITE, fd, 0);
+        ASSERT_TRUE(other.isValid());
+        ASSERT_EQ(buffers.add(reinterpret_cast<const Memory*>(other.get()), buf),
+                  ANEURALNETWORKS_BAD_DATA);
+    }
+    // The buffer stays registered once the memory is freed, as the
+    // compilation may outlive the memory, and the memory found still maps it.
+    std::shared_ptr<const Memory> registered = buffers.find(buf + 16, 8, &offset);
+    ASSERT_NE(registered, nullptr);
+    uint8_t* mapping = nullptr;
+    ASSERT_EQ(registered->getPointer(&mapping), ANEURALNETWORKS_NO_ERROR);
+    buf[16] = 42;
+    ASSERT_EQ(mapping[16], 42);
+    registered.reset();
+
+    ASSERT_EQ(munmap(buf, size), 0);
+    close(fd);
+}
+
+TEST_F(MemoryLeakTest, SharedMemoryPool) {
+    auto pool = std::make_shared<::android::nn::SharedMemoryPool>();
+    ASSERT_EQ(pool->reserve(100), ANEURALNETWORKS_NO_ERROR);
+
+    std::shared_ptr<::android::nn::Memory> region = pool->acquire(64);
+    ASSERT_NE(region, nullptr);
+    ASSERT_EQ(region->getSize(), 100u);
+    const ::android::nn::Memory* reserved = region.get();
+
+    // The reserved region is in use, so a new one is allocated.
+    std::shared_ptr<::android::nn::Memory> other = pool->acquire(64);
+    ASSERT_NE(other, nullptr);
+    ASSERT_NE(other.get(), reserved);
+    ASSERT_EQ(other->getSize(), 64u);
+
+    // Released regions are reused, the smallest that fits first.
+    region.reset();
+    other.reset();
+    region = pool->acquire(80);
+    ASSERT_EQ(region.get(), reserved);
+    other = pool->acquire(32);
+    ASSERT_NE(other, nullptr);
+    ASSERT_EQ(other->getSize(), 64u);
+
+    uint8_t* data = nullptr;
+    ASSERT_EQ(region->getPointer(&data), ANEURALNETWORKS_NO_ERROR);
+    ASSERT_NE(data, nullptr);
+}
+
 #ifndef NNTEST_ONLY_PUBLIC_API
 // Regression test for http://b/73663843, conv_2d trying to allocate too much memory.
 TEST_F(MemoryLeakTest, convTooLarge) {
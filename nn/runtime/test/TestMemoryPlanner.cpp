@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MemoryPlanner.h"
+
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+namespace {
+
+using ::android::nn::MemoryPlanner;
+
+struct BufferInfo {
+    uint32_t size;
+    uint32_t firstUse;
+    uint32_t lastUse;
+};
+
+// Checks that buffers alive at the same time do not overlap, and that all
+// offsets are aligned and within the arena.
+void checkPlan(const MemoryPlanner& planner, const std::vector<BufferInfo>& buffers,
+               uint32_t alignment) {
+    for (uint32_t i = 0; i < buffers.size(); i++) {
+        const uint32_t offset = planner.getOffset(i);
+        EXPECT_EQ(offset % alignment, 0u);
+        EXPECT_LE(offset + buffers[i].size, planner.getArenaSize());
+        for (uint32_t j = 0; j < i; j++) {
+            const bool aliveTogether = buffers[i].firstUse <= buffers[j].lastUse &&
+                                       buffers[j].firstUse <= buffers[i].lastUse;
+            if (!aliveTogether) {
+                continue;
+            }
+            const uint32_t otherOffset = planner.getOffset(j);
+            const bool overlap = offset < otherOffset + buffers[j].size &&
+                                 otherOffset < offset + buffers[i].size;
+            EXPECT_FALSE(overlap) << "buffers " << i << " and " << j << " overlap";
+        }
+    }
+}
+
+TEST(MemoryPlannerTest, Empty) {
+    MemoryPlanner planner(16);
+    planner.plan();
+    EXPECT_EQ(planner.getArenaSize(), 0u);
+    EXPECT_EQ(planner.getTotalSize(), 0u);
+}
+
+TEST(MemoryPlannerTest, Chain) {
+    // A chain of operations, each reading the output of the previous one:
+    // only two buffers are ever alive at the same time.
+    std::vector<BufferInfo> buffers = {
+            {1000, 0, 1}, {2000, 1, 2}, {1000, 2, 3}, {2000, 3, 4}, {1000, 4, 5}};
+    MemoryPlanner planner(16);
+    for (const auto& b : buffers) {
+        planner.addBuffer(b.size, b.firstUse, b.lastUse);
+    }
+    planner.plan();
+    checkPlan(planner, buffers, 16);
+    EXPECT_EQ(planner.getTotalSize(), 7000u);
+    EXPECT_EQ(planner.getArenaSize(), 3008u);
+}
+
+TEST(MemoryPlannerTest, AllAlive) {
+    std::vector<BufferInfo> buffers = {{10, 0, 5}, {20, 1, 5}, {30, 2, 5}};
+    MemoryPlanner planner(64);
+    for (const auto& b : buffers) {
+        planner.addBuffer(b.size, b.firstUse, b.lastUse);
+    }
+    planner.plan();
+    checkPlan(planner, buffers, 64);
+    EXPECT_EQ(planner.getArenaSize(), 192u);
+}
+
+TEST(MemoryPlannerTest, ConflictFunction) {
+    // Only the first two buffers may be alive at the same time, whatever
+    // their lifetimes say.
+    MemoryPlanner planner(16);
+    planner.addBuffer(100, 0, 0);
+    planner.addBuffer(100, 1, 1);
+    planner.addBuffer(100, 0, 1);
+    planner.plan([](uint32_t bufferIndex1, uint32_t bufferIndex2) {
+        return bufferIndex1 + bufferIndex2 == 1;
+    });
+    EXPECT_NE(planner.getOffset(0), planner.getOffset(1));
+    EXPECT_EQ(planner.getOffset(2), 0u);
+    EXPECT_EQ(planner.getArenaSize(), 224u);
+}
+
+TEST(MemoryPlannerTest, Random) {
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<uint32_t> sizeDistribution(1, 4096);
+    std::uniform_int_distribution<uint32_t> useDistribution(0, 50);
+    for (int trial = 0; trial < 20; trial++) {
+        std::vector<BufferInfo> buffers;
+        MemoryPlanner planner(32);
+        for (int i = 0; i < 100; i++) {
+            uint32_t firstUse = useDistribution(generator);
+            uint32_t lastUse = useDistribution(generator);
+            if (firstUse > lastUse) {
+                std::swap(firstUse, lastUse);
+            }
+            buffers.push_back({sizeDistribution(generator), firstUse, lastUse});
+            planner.addBuffer(buffers.back().size, firstUse, lastUse);
+        }
+        planner.plan();
+        checkPlan(planner, buffers, 32);
+        EXPECT_LE(planner.getArenaSize(), planner.getTotalSize() + 100 * 32);
+    }
+}
+
+}  // namespace
@@ -23,12 +23,14 @@
 #include "NeuralNetworks.h"
 #include "NeuralNetworksOEM.h"
 #include "NeuralNetworksWrapper.h"
+#include "PerformanceHistory.h"
 #include "SampleDriver.h"
 #include "Utils.h"
 #include "ValidateHal.h"
 
 #include <gtest/gtest.h>
 
+#include <chrono>
 #include <map>
 #include <queue>
 
@@ -130,6 +132,7 @@ using ExecutionPlan = ::android::nn::ExecutionPlan;
 using ExecutionStep = ::android::nn::ExecutionStep;
 using HidlModel = ::android::hardware::neuralnetworks::V1_1::Model;
 using ModelBuilder = ::android::nn::ModelBuilder;
+using PerformanceHistory = ::android::nn::PerformanceHistory;
 using Result = ::android::nn::wrapper::Result;
 using SampleDriver = ::android::nn::sample_driver::SampleDriver;
 using WrapperCompilation = ::android::nn::wrapper::Compilation;
@@ -330,11 +333,16 @@ public:
         return output;
     }
 
-    // Run the partitioning algorithm to create an ExecutionPlan.
+    // Run the partitioning algorithm to create an ExecutionPlan.  Most
+    // tests check the exact steps that the per-operation heuristic
+    // produces, hence the default partitioner.  No measured performance is
+    // used unless a history is given.
     int partitionTheWork(const std::vector<std::shared_ptr<Device>>& devices,
-                         ExecutePreference preference, ExecutionPlan* plan) {
+                         ExecutePreference preference, ExecutionPlan* plan,
+                         uint32_t partitioner = DeviceManager::kPartitionerHeuristic,
+                         const PerformanceHistory* history = nullptr) {
         return reinterpret_cast<ModelBuilder*>(getHandle())->partitionTheWork(
-            devices, static_cast<uint32_t>(preference), plan);
+            devices, static_cast<uint32_t>(preference), partitioner, history, plan);
     }
 
 #ifdef VERBOSE
@@ -374,7 +382,10 @@ private:
 // This class adds some utilities on top of ::android::nn::wrapper::Compilation.
 class PartitioningCompilation : public WrapperCompilation {
 public:
-    PartitioningCompilation(const WrapperModel* model) : WrapperCompilation(model) { }
+    // Uses the per-operation heuristic, like PartitioningModel::partitionTheWork().
+    PartitioningCompilation(const WrapperModel* model) : WrapperCompilation(model) {
+        builder()->setPartitioner(DeviceManager::kPartitionerHeuristic);
+    }
 
     Result setPartitioning(uint32_t partitioning) {
         return static_cast<Result>(builder()->setPartitioning(partitioning));
@@ -1090,6 +1101,189 @@ TEST_F(PartitioningTest, ModelOutputAsSubmodelInput) {
     }
 }
 
+TEST_F(PartitioningTest, StepDependencies) {
+    // Two operations that do not depend on each other, on different
+    // devices, and a third one consuming their results: the first two
+    // steps may run concurrently, the last one must wait for both.
+    PartitioningModel model;
+    uint32_t opnd0 = model.addFloatOperand();
+    uint32_t opnd1 = model.addFloatOperand();
+    uint32_t opnd2 = model.addOperation2To1(0, opnd0, opnd1);
+    uint32_t opnd3 = model.addOperation2To1(1, opnd0, opnd1);
+    uint32_t opnd4 = model.addOperation2To1(1, opnd2, opnd3);
+    model.identifyInputsAndOutputs({ opnd0, opnd1 }, { opnd3, opnd4 });
+    model.finish();
+    ASSERT_TRUE(model.isValid());
+
+    const auto devices = makeDevices(
+        {
+            {"0", { .float32Performance = { .execTime = 0.5, .powerUsage = 0.5 },
+                            .quantized8Performance = { .execTime = 0.5, .powerUsage = 0.5 } }, 1<<0},
+            {"1", { .float32Performance = { .execTime = 0.5, .powerUsage = 0.5 },
+                            .quantized8Performance = { .execTime = 0.5, .powerUsage = 0.5 } }, 1<<1}
+        });
+    ExecutionPlan plan;
+    ASSERT_EQ(model.partitionTheWork(devices, ExecutePreference::PREFER_LOW_POWER, &plan),
+              ANEURALNETWORKS_NO_ERROR);
+    ASSERT_EQ(plan.forTest_getKind(), ExecutionPlan::Kind::COMPOUND);
+    const auto& steps = plan.forTest_compoundGetSteps();
+    ASSERT_EQ(steps.size(), size_t(3));
+    ASSERT_EQ(steps[0]->getDevice(), devices[1]);
+    ASSERT_EQ(steps[1]->getDevice(), devices[0]);
+    ASSERT_EQ(steps[2]->getDevice(), devices[1]);
+
+    // steps[2] reads the temporary opnd2 from steps[1], and the model output
+    // opnd3 from steps[0].
+    ASSERT_EQ(steps[2]->getTempsAsSubModelInputs().size(), size_t(1));
+    ASSERT_EQ(steps[2]->getOutputsAsSubModelInputs().size(), size_t(1));
+
+    ASSERT_TRUE(plan.hasIndependentSteps());
+    ASSERT_EQ(plan.getStepCount(), 3u);
+    ASSERT_EQ(plan.getStepPredecessorCount(0), 0u);
+    ASSERT_EQ(plan.getStepPredecessorCount(1), 0u);
+    ASSERT_EQ(plan.getStepPredecessorCount(2), 2u);
+    ASSERT_EQ(plan.getStepSuccessors(0), (std::vector<uint32_t>{ 2 }));
+    ASSERT_EQ(plan.getStepSuccessors(1), (std::vector<uint32_t>{ 2 }));
+    ASSERT_EQ(plan.getStepSuccessors(2), (std::vector<uint32_t>{}));
+}
+
+TEST_F(PartitioningTest, CostModel) {
+    // A chain of three operations.  Device "0" is the fastest for the first
+    // and last ones, but cannot do the middle one; device "1" can do all of
+    // them, a bit more slowly.
+    PartitioningModel model;
+    uint32_t opnd0 = model.addFloatOperand();
+    uint32_t opnd1 = model.addFloatOperand();
+    uint32_t opnd2 = model.addOperation2To1(0, opnd0, opnd1);
+    uint32_t opnd3 = model.addOperation2To1(1, opnd2, opnd1);
+    uint32_t opnd4 = model.addOperation2To1(0, opnd3, opnd1);
+    model.identifyInputsAndOutputs({ opnd0, opnd1 }, { opnd4 });
+    model.finish();
+    ASSERT_TRUE(model.isValid());
+
+    const auto devices = makeDevices(
+        {
+            {"0", { .float32Performance = { .execTime = 0.5, .powerUsage = 0.5 },
+                            .quantized8Performance = { .execTime = 0.5, .powerUsage = 0.5 } }, 1<<0},
+            {"1", { .float32Performance = { .execTime = 0.6, .powerUsage = 0.6 },
+                            .quantized8Performance = { .execTime = 0.6, .powerUsage = 0.6 } },
+                    (1<<0) | (1<<1)}
+        });
+
+    // The heuristic goes back and forth between the devices.
+    ExecutionPlan planHeuristic;
+    ASSERT_EQ(model.partitionTheWork(devices, ExecutePreference::PREFER_LOW_POWER,
+                                     &planHeuristic, DeviceManager::kPartitionerHeuristic),
+              ANEURALNETWORKS_NO_ERROR);
+    ASSERT_EQ(planHeuristic.forTest_getKind(), ExecutionPlan::Kind::COMPOUND);
+    ASSERT_EQ(planHeuristic.forTest_compoundGetSteps().size(), size_t(3));
+
+    // With such small operands, the cost of the extra steps and of the
+    // temporaries crossing them outweighs what device "0" saves.
+    ExecutionPlan planCostModel;
+    ASSERT_EQ(model.partitionTheWork(devices, ExecutePreference::PREFER_LOW_POWER,
+                                     &planCostModel, DeviceManager::kPartitionerCostModel),
+              ANEURALNETWORKS_NO_ERROR);
+    ASSERT_EQ(planCostModel.forTest_getKind(), ExecutionPlan::Kind::SIMPLE);
+    ASSERT_NE(planCostModel.forTest_simpleGetDevice().get(), nullptr);
+    ASSERT_EQ(planCostModel.forTest_simpleGetDevice()->getName(), "1");
+}
+
+TEST_F(PartitioningTest, MeasuredPerformance) {
+    PartitioningModel model;
+    uint32_t opnd0 = model.addFloatOperand();
+    uint32_t opnd1 = model.addFloatOperand();
+    uint32_t opnd2 = model.addOperation2To1(0, opnd0, opnd1);
+    model.identifyInputsAndOutputs({ opnd0, opnd1 }, { opnd2 });
+    model.finish();
+    ASSERT_TRUE(model.isValid());
+
+    const auto devices = makeDevices(
+        {
+            {"good", { .float32Performance = { .execTime = 0.5, .powerUsage = 0.5 },
+                       .quantized8Performance = { .execTime = 0.5, .powerUsage = 0.5 } },
+                     1<<0},
+            {"bad", { .float32Performance = { .execTime = 0.9, .powerUsage = 0.9 },
+                      .quantized8Performance = { .execTime = 0.9, .powerUsage = 0.9 } },
+                    1<<0}
+        });
+
+    // Make "good" turn out to be slower than the CPU, and "bad" faster.  A
+    // disabled history records nothing.
+    PerformanceHistory history;
+    const ModelBuilder* modelBuilder = reinterpret_cast<const ModelBuilder*>(model.getHandle());
+    auto recordExecutions = [&history, &devices, modelBuilder] {
+        for (int i = 0; i < 3; i++) {
+            history.recordExecution(devices[0].get(), modelBuilder,
+                                    std::chrono::microseconds(300));
+            history.recordExecution(nullptr, modelBuilder, std::chrono::microseconds(200));
+            history.recordExecution(devices[1].get(), modelBuilder,
+                                    std::chrono::microseconds(100));
+        }
+    };
+    recordExecutions();
+    history.setEnabled(true);
+    ExecutionPlan planDisabled;
+    ASSERT_EQ(model.partitionTheWork(devices, ExecutePreference::PREFER_FAST_SINGLE_ANSWER,
+                                     &planDisabled, DeviceManager::kPartitionerHeuristic,
+                                     &history),
+              ANEURALNETWORKS_NO_ERROR);
+    ASSERT_EQ(planDisabled.forTest_getKind(), ExecutionPlan::Kind::SIMPLE);
+    ASSERT_NE(planDisabled.forTest_simpleGetDevice().get(), nullptr);
+    ASSERT_EQ(planDisabled.forTest_simpleGetDevice()->getName(), "good");
+
+    recordExecutions();
+    ExecutionPlan planMeasured;
+    ASSERT_EQ(model.partitionTheWork(devices, ExecutePreference::PREFER_FAST_SINGLE_ANSWER,
+                                     &planMeasured, DeviceManager::kPartitionerHeuristic,
+                                     &history),
+              ANEURALNETWORKS_NO_ERROR);
+    ASSERT_EQ(planMeasured.forTest_getKind(), ExecutionPlan::Kind::SIMPLE);
+    ASSERT_NE(planMeasured.forTest_simpleGetDevice().get(), nullptr);
+    ASSERT_EQ(planMeasured.forTest_simpleGetDevice()->getName(), "bad");
+
+    // Power is not measured.
+    ExecutionPlan planLowPower;
+    ASSERT_EQ(model.partitionTheWork(devices, ExecutePreference::PREFER_LOW_POWER,
+                                     &planLowPower, DeviceManager::kPartitionerHeuristic,
+                                     &history),
+              ANEURALNETWORKS_NO_ERROR);
+    ASSERT_EQ(planLowPower.forTest_getKind(), ExecutionPlan::Kind::SIMPLE);
+    ASSERT_NE(planLowPower.forTest_simpleGetDevice().get(), nullptr);
+    ASSERT_EQ(planLowPower.forTest_simpleGetDevice()->getName(), "good");
+
+    // A device with the same name but other Capabilities has not been
+    // measured.
+    const auto updatedDevices = makeDevices(
+        {
+            {"good", { .float32Performance = { .execTime = 0.4, .powerUsage = 0.5 },
+                       .quantized8Performance = { .execTime = 0.5, .powerUsage = 0.5 } },
+                     1<<0},
+            {"bad", { .float32Performance = { .execTime = 0.9, .powerUsage = 0.9 },
+                      .quantized8Performance = { .execTime = 0.9, .powerUsage = 0.9 } },
+                    1<<0}
+        });
+    ExecutionPlan planUpdated;
+    ASSERT_EQ(model.partitionTheWork(updatedDevices, ExecutePreference::PREFER_FAST_SINGLE_ANSWER,
+                                     &planUpdated, DeviceManager::kPartitionerHeuristic,
+                                     &history),
+              ANEURALNETWORKS_NO_ERROR);
+    ASSERT_EQ(planUpdated.forTest_getKind(), ExecutionPlan::Kind::SIMPLE);
+    ASSERT_NE(planUpdated.forTest_simpleGetDevice().get(), nullptr);
+    ASSERT_EQ(planUpdated.forTest_simpleGetDevice()->getName(), "good");
+
+    // Without measurements, the reported performance is used again.
+    history.reset();
+    ExecutionPlan planReported;
+    ASSERT_EQ(model.partitionTheWork(devices, ExecutePreference::PREFER_FAST_SINGLE_ANSWER,
+                                     &planReported, DeviceManager::kPartitionerHeuristic,
+                                     &history),
+              ANEURALNETWORKS_NO_ERROR);
+    ASSERT_EQ(planReported.forTest_getKind(), ExecutionPlan::Kind::SIMPLE);
+    ASSERT_NE(planReported.forTest_simpleGetDevice().get(), nullptr);
+    ASSERT_EQ(planReported.forTest_simpleGetDevice()->getName(), "good");
+}
+
 TEST_F(PartitioningTest, OemOperations) {
     // Trivial model consisting solely of OEM operation.
     PartitioningModel model;
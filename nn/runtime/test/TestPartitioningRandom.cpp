@@ -219,6 +219,10 @@ public:
         return static_cast<Result>(builder()->setPartitioning(partitioning));
     }
 
+    Result setPartitioner(uint32_t partitioner) {
+        return static_cast<Result>(builder()->setPartitioner(partitioner));
+    }
+
     using WrapperCompilation::finish;
     Result finish(const std::vector<std::shared_ptr<Device>>& devices) {
         return static_cast<Result>(builder()->finish(devices));
@@ -343,13 +347,19 @@ TestMemories::~TestMemories() {
     }
 }
 
-class RandomPartitioningTest : public ::testing::TestWithParam<unsigned> {
+// The test parameter is (seed, partitioner), so that both partitioners
+// (see DeviceManager::kPartitioner*) are tested on the same random models.
+class RandomPartitioningTest
+        : public ::testing::TestWithParam<std::tuple<unsigned, uint32_t>> {
 public:
-    RandomPartitioningTest() : mRandNumEng(GetParam() /* seed */), mRandNumUnitDist(0.0, 1.0) {}
+    RandomPartitioningTest() : mRandNumEng(getSeed()), mRandNumUnitDist(0.0, 1.0) {}
 
     static Signature getSignature(const HidlModel& model, const Operation& operation);
 
 protected:
+    unsigned getSeed() const { return std::get<0>(GetParam()); }
+    uint32_t getPartitioner() const { return std::get<1>(GetParam()); }
+
     void graphDump(const WrapperModel& model);
 
     bool randBool() {
@@ -469,7 +479,8 @@ Signature RandomPartitioningTest::getSignature(const HidlModel& model, const Ope
 
 void RandomPartitioningTest::graphDump([[maybe_unused]] const WrapperModel& model) {
 #ifdef GRAPH
-    const std::string name = "Test-" + std::to_string(GetParam());
+    const std::string name = "Test-" + std::to_string(getSeed()) + "-" +
+            std::to_string(getPartitioner());
     nn::bridge_tests::graphDump(name.c_str(),
                                 reinterpret_cast<const ModelBuilder*>(model.getHandle()));
 #endif
@@ -539,10 +550,15 @@ private:
 };
 
 INSTANTIATE_TEST_CASE_P(Seed, RandomPartitioningTest,
-                        ::testing::Range(kFirstSeed, kFirstSeed + kNumTestCases));
+                        ::testing::Combine(
+                                ::testing::Range(kFirstSeed, kFirstSeed + kNumTestCases),
+                                ::testing::Values(
+                                        uint32_t(DeviceManager::kPartitionerHeuristic),
+                                        uint32_t(DeviceManager::kPartitionerCostModel))));
 
 TEST_P(RandomPartitioningTest, Test) {
-    LOG(INFO) << "RandomPartitioningTest: GetParam() = " << GetParam();
+    LOG(INFO) << "RandomPartitioningTest: seed = " << getSeed()
+              << ", partitioner = " << getPartitioner();
 
 #ifdef VERBOSE
     std::cout << std::setprecision(2) << std::fixed << std::setw(4);
@@ -950,11 +966,13 @@ TEST_P(RandomPartitioningTest, Test) {
     TestCompilation *c2 = nullptr;
     ASSERT_EQ(cNoFallback.setPartitioning(DeviceManager::kPartitioningWithoutFallback),
               Result::NO_ERROR);
+    ASSERT_EQ(cNoFallback.setPartitioner(getPartitioner()), Result::NO_ERROR);
     auto compilationResult = cNoFallback.finish(devices);
     if (hasUnknownDimensions && compilationResult == Result::OP_FAILED &&
         cNoFallback.getExecutionPlan().forTest_hasSubModelOutputsOfUnknownSize()) {
         ASSERT_EQ(cWithFallback.setPartitioning(DeviceManager::kPartitioningWithFallback),
                   Result::NO_ERROR);
+        ASSERT_EQ(cWithFallback.setPartitioner(getPartitioner()), Result::NO_ERROR);
         ASSERT_EQ(cWithFallback.finish(devices), Result::NO_ERROR);
         c2 = &cWithFallback;
     } else {
@@ -965,7 +983,8 @@ TEST_P(RandomPartitioningTest, Test) {
 #ifdef VERBOSE
     {
         std::cout << "signatures = " << signatures.size()
-                  << ", devices = " << devices.size() << std::endl;
+                  << ", devices = " << devices.size()
+                  << ", partitioner = " << getPartitioner() << std::endl;
         const ExecutionPlan& plan = c2->getExecutionPlan();
         switch (plan.forTest_getKind()) {
             case ExecutionPlan::Kind::SIMPLE:
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+using ::android::nn::ThreadPool;
+
+// Counts down to zero, and lets threads wait until it gets there.
+class Latch {
+public:
+    explicit Latch(int count) : mCount(count) {}
+    void countDown() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (--mCount == 0) {
+            mCondition.notify_all();
+        }
+    }
+    void wait() {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this] { return mCount <= 0; });
+    }
+private:
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    int mCount;
+};
+
+TEST(ThreadPoolTest, RunsAllTasks) {
+    const int kNumTasks = 1000;
+    ThreadPool pool(4, kNumTasks);
+    EXPECT_EQ(pool.getNumThreads(), 4u);
+    std::atomic<int> count(0);
+    Latch done(kNumTasks);
+    for (int i = 0; i < kNumTasks; i++) {
+        pool.schedule([&count, &done] {
+            count++;
+            done.countDown();
+        });
+    }
+    done.wait();
+    EXPECT_EQ(count, kNumTasks);
+}
+
+TEST(ThreadPoolTest, RunsOnWorker) {
+    ThreadPool pool(1, 1);
+    EXPECT_FALSE(pool.isWorkerThread());
+    bool onWorker = false;
+    std::thread::id id;
+    Latch done(1);
+    pool.schedule([&] {
+        onWorker = pool.isWorkerThread();
+        id = std::this_thread::get_id();
+        done.countDown();
+    });
+    done.wait();
+    EXPECT_TRUE(onWorker);
+    EXPECT_NE(id, std::this_thread::get_id());
+}
+
+TEST(ThreadPoolTest, NestedTaskRunsInline) {
+    // With a single worker, a task waiting for a task it scheduled would
+    // deadlock if the nested task were queued.
+    ThreadPool pool(1, 16);
+    Latch done(1);
+    bool nestedRan = false;
+    pool.schedule([&] {
+        Latch nestedDone(1);
+        pool.schedule([&] {
+            nestedRan = true;
+            nestedDone.countDown();
+        });
+        nestedDone.wait();
+        done.countDown();
+    });
+    done.wait();
+    EXPECT_TRUE(nestedRan);
+}
+
+TEST(ThreadPoolTest, NonBlockingTaskIsQueuedFromWorker) {
+    // The outer task waits for the inner one, which therefore has to run on
+    // the other worker.
+    ThreadPool pool(2, 16);
+    Latch innerDone(1);
+    Latch outerDone(1);
+    std::thread::id outerId;
+    std::thread::id innerId;
+    pool.schedule([&] {
+        outerId = std::this_thread::get_id();
+        pool.scheduleNonBlocking([&] {
+            innerId = std::this_thread::get_id();
+            innerDone.countDown();
+        });
+        innerDone.wait();
+        outerDone.countDown();
+    });
+    outerDone.wait();
+    EXPECT_NE(innerId, outerId);
+}
+
+TEST(ThreadPoolTest, FullQueueBlocksCaller) {
+    ThreadPool pool(1, 1);
+    Latch blockerStarted(1);
+    Latch release(1);
+    Latch done(3);
+    // Occupy the worker, then fill the queue.
+    pool.schedule([&] {
+        blockerStarted.countDown();
+        release.wait();
+        done.countDown();
+    });
+    blockerStarted.wait();
+    pool.schedule([&] { done.countDown(); });
+    // Waits for room rather than growing the queue or running the task on
+    // the calling thread.
+    std::atomic<bool> scheduled(false);
+    std::thread::id callerId;
+    std::thread::id id;
+    std::thread caller([&] {
+        callerId = std::this_thread::get_id();
+        pool.schedule([&] {
+            id = std::this_thread::get_id();
+            done.countDown();
+        });
+        scheduled = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_FALSE(scheduled);
+    release.countDown();
+    caller.join();
+    done.wait();
+    EXPECT_TRUE(scheduled);
+    EXPECT_NE(id, callerId);
+}
+
+TEST(ThreadPoolTest, FullQueueRunsInlineOnWorker) {
+    ThreadPool pool(2, 1);
+    Latch blockerStarted(1);
+    Latch release(1);
+    Latch done(3);
+    // Occupy one worker, and keep the other one from taking tasks off the
+    // queue until it is full.
+    pool.schedule([&] {
+        blockerStarted.countDown();
+        release.wait();
+        done.countDown();
+    });
+    blockerStarted.wait();
+    std::thread::id outerId;
+    std::thread::id innerId;
+    pool.schedule([&] {
+        outerId = std::this_thread::get_id();
+        pool.scheduleNonBlocking([&] {
+            release.wait();
+            done.countDown();
+        });
+        pool.scheduleNonBlocking([&] { innerId = std::this_thread::get_id(); });
+        release.countDown();
+        done.countDown();
+    });
+    done.wait();
+    EXPECT_EQ(innerId, outerId);
+}
+
+TEST(ThreadPoolTest, DestructorRunsQueuedTasks) {
+    std::atomic<int> count(0);
+    {
+        ThreadPool pool(2, 100);
+        for (int i = 0; i < 100; i++) {
+            pool.schedule([&count] { count++; });
+        }
+    }
+    EXPECT_EQ(count, 100);
+}
+
+}  // namespace
@@ -16,6 +16,10 @@
 
 #include "NeuralNetworksWrapper.h"
 
+#ifndef NNTEST_ONLY_PUBLIC_API
+#include "BatchBuilder.h"
+#endif
+
 //#include <android-base/logging.h>
 #include <gtest/gtest.h>
 
@@ -154,6 +158,160 @@ TEST_F(TrivialTest, AddThree) {
     ASSERT_EQ(CompareMatrices(expected3b, actual), 0);
 }
 
+TEST_F(TrivialTest, ReusableExecution) {
+    Model modelAdd3;
+    CreateAddThreeTensorModel(&modelAdd3, matrix3);
+
+    Compilation compilation(&modelAdd3);
+    compilation.finish();
+    Execution execution(&compilation);
+    ASSERT_EQ(execution.setReusable(true), Result::NO_ERROR);
+
+    Matrix3x4 actual;
+    memset(&actual, 0, sizeof(actual));
+    ASSERT_EQ(execution.setInput(0, matrix1, sizeof(Matrix3x4)), Result::NO_ERROR);
+    ASSERT_EQ(execution.setInput(1, matrix2, sizeof(Matrix3x4)), Result::NO_ERROR);
+    ASSERT_EQ(execution.setOutput(0, actual, sizeof(Matrix3x4)), Result::NO_ERROR);
+    ASSERT_EQ(execution.compute(), Result::NO_ERROR);
+    ASSERT_EQ(CompareMatrices(expected3, actual), 0);
+
+    // Respecify one input and the output, keep the other input.
+    Matrix3x4 actual2;
+    memset(&actual2, 0, sizeof(actual2));
+    ASSERT_EQ(execution.setInput(1, matrix1, sizeof(Matrix3x4)), Result::NO_ERROR);
+    ASSERT_EQ(execution.setOutput(0, actual2, sizeof(Matrix3x4)), Result::NO_ERROR);
+    ASSERT_EQ(execution.compute(), Result::NO_ERROR);
+    ASSERT_EQ(CompareMatrices(expected3b, actual2), 0);
+
+    // And once more, asynchronously.
+    memset(&actual, 0, sizeof(actual));
+    ASSERT_EQ(execution.setInput(1, matrix2, sizeof(Matrix3x4)), Result::NO_ERROR);
+    ASSERT_EQ(execution.setOutput(0, actual, sizeof(Matrix3x4)), Result::NO_ERROR);
+    Event event;
+    ASSERT_EQ(execution.startCompute(&event), Result::NO_ERROR);
+    ASSERT_EQ(event.wait(), Result::NO_ERROR);
+    ASSERT_EQ(CompareMatrices(expected3, actual), 0);
+
+    // Too late to change the mind.
+    ASSERT_EQ(execution.setReusable(false), Result::BAD_STATE);
+}
+
+// Create a model that adds a constant row to a single sample, i.e. a
+// {1, 4} tensor.
+void CreateAddRowModel(Model* model, const Matrix4 row) {
+    OperandType sampleType(Type::TENSOR_FLOAT32, {1, 4});
+    OperandType rowType(Type::TENSOR_FLOAT32, {4});
+    OperandType scalarType(Type::INT32, {});
+    int32_t activation(ANEURALNETWORKS_FUSED_NONE);
+    auto a = model->addOperand(&sampleType);
+    auto b = model->addOperand(&rowType);
+    auto c = model->addOperand(&sampleType);
+    auto d = model->addOperand(&scalarType);
+    model->setOperandValue(b, row, sizeof(Matrix4));
+    model->setOperandValue(d, &activation, sizeof(activation));
+    model->addOperation(ANEURALNETWORKS_ADD, {a, b, d}, {c});
+    model->identifyInputsAndOutputs({a}, {c});
+    ASSERT_TRUE(model->isValid());
+    model->finish();
+}
+
+TEST_F(TrivialTest, Batch) {
+    Model modelAddRow;
+    CreateAddRowModel(&modelAddRow, matrix2b);
+    Compilation compilation(&modelAddRow);
+    compilation.finish();
+    Batch batch(&compilation);
+
+    // One execution per row of the matrix, evaluated twice.
+    Matrix3x4 actual;
+    memset(&actual, 0, sizeof(actual));
+    std::vector<Execution> executions;
+    std::vector<Execution*> executionPointers;
+    for (int i = 0; i < 3; i++) {
+        executions.emplace_back(&compilation);
+    }
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(executions[i].setReusable(true), Result::NO_ERROR);
+        ASSERT_EQ(executions[i].setInput(0, matrix1[i], sizeof(Matrix4)), Result::NO_ERROR);
+        ASSERT_EQ(executions[i].setOutput(0, actual[i], sizeof(Matrix4)), Result::NO_ERROR);
+        executionPointers.push_back(&executions[i]);
+    }
+    ASSERT_EQ(batch.compute(executionPointers), Result::NO_ERROR);
+    ASSERT_EQ(CompareMatrices(expected2b, actual), 0);
+#ifndef NNTEST_ONLY_PUBLIC_API
+    // As one computation, rather than one per execution.
+    auto batchBuilder = reinterpret_cast<android::nn::BatchBuilder*>(batch.getHandle());
+    EXPECT_EQ(batchBuilder->getBatchedComputationCount(), 1u);
+#endif
+
+    // The same executions, through the queue.  The delay is long enough for
+    // all of them to be evaluated together.
+    memset(&actual, 0, sizeof(actual));
+    ASSERT_EQ(batch.setQueueLimits(3, 1000000000), Result::NO_ERROR);
+    Event events[3];
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(batch.startCompute(&executions[i], &events[i]), Result::NO_ERROR);
+    }
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(events[i].wait(), Result::NO_ERROR);
+    }
+    ASSERT_EQ(CompareMatrices(expected2b, actual), 0);
+#ifndef NNTEST_ONLY_PUBLIC_API
+    EXPECT_EQ(batchBuilder->getBatchedComputationCount(), 2u);
+#endif
+}
+
+// Create a model that accumulates its input: the first output is the sum
+// of the input and of the state, and so is the second output, which is the
+// next state.
+void CreateAccumulatorModel(Model* model) {
+    OperandType sampleType(Type::TENSOR_FLOAT32, {1, 4});
+    OperandType scalarType(Type::INT32, {});
+    int32_t activation(ANEURALNETWORKS_FUSED_NONE);
+    auto x = model->addOperand(&sampleType);
+    auto state = model->addOperand(&sampleType);
+    auto y = model->addOperand(&sampleType);
+    auto nextState = model->addOperand(&sampleType);
+    auto d = model->addOperand(&scalarType);
+    model->setOperandValue(d, &activation, sizeof(activation));
+    model->addOperation(ANEURALNETWORKS_ADD, {state, x, d}, {y});
+    model->addOperation(ANEURALNETWORKS_ADD, {state, x, d}, {nextState});
+    model->identifyInputsAndOutputs({x, state}, {y, nextState});
+    ASSERT_TRUE(model->isValid());
+    model->finish();
+}
+
+TEST_F(TrivialTest, Stream) {
+    Model modelAccumulator;
+    CreateAccumulatorModel(&modelAccumulator);
+    Compilation compilation(&modelAccumulator);
+    compilation.finish();
+    Stream stream(&compilation);
+    ASSERT_EQ(stream.bindState(1, 1), Result::NO_ERROR);
+
+    // One timestep per row of the matrix, from a zero state.
+    const Matrix3x4 expected = {{1.f, 2.f, 3.f, 4.f},
+                                {6.f, 8.f, 10.f, 12.f},
+                                {15.f, 18.f, 21.f, 24.f}};
+    Matrix3x4 actual;
+    memset(&actual, 0, sizeof(actual));
+    ASSERT_EQ(stream.setInput(0, matrix1, sizeof(Matrix3x4)), Result::NO_ERROR);
+    ASSERT_EQ(stream.setOutput(0, actual, sizeof(Matrix3x4)), Result::NO_ERROR);
+    ASSERT_EQ(stream.compute(3), Result::NO_ERROR);
+    ASSERT_EQ(CompareMatrices(expected, actual), 0);
+
+    // The state is the input, not an output, and is set explicitly.
+    ASSERT_EQ(stream.setInput(1, matrix1, sizeof(Matrix3x4)), Result::BAD_DATA);
+    ASSERT_EQ(stream.bindState(0, 0), Result::BAD_STATE);
+    ASSERT_EQ(stream.setState(1, matrix2b, sizeof(Matrix4)), Result::NO_ERROR);
+    memset(&actual, 0, sizeof(actual));
+    ASSERT_EQ(stream.compute(1), Result::NO_ERROR);
+    for (int j = 0; j < 4; j++) {
+        EXPECT_EQ(actual[0][j], expected2b[0][j]);
+        EXPECT_EQ(actual[1][j], 0.f);
+    }
+}
+
 TEST_F(TrivialTest, BroadcastAddTwo) {
     Model modelBroadcastAdd2;
     // activation: NONE.
@@ -21,6 +21,8 @@
 #include <gtest/gtest.h>
 #include <string>
 #include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
 
 
 // This file tests all the validations done by the Neural Networks API.
@@ -120,7 +122,28 @@ protected:
         ANeuralNetworksExecution_free(mExecution);
         ValidationTestCompilation::TearDown();
     }
+
+    // Sets the inputs and the output of an execution of mCompilation.
+    void setArguments(ANeuralNetworksExecution* execution) {
+        ASSERT_EQ(ANeuralNetworksExecution_setInput(execution, 0, nullptr, &mInput0,
+                                                    sizeof(float)),
+                  ANEURALNETWORKS_NO_ERROR);
+        ASSERT_EQ(ANeuralNetworksExecution_setInput(execution, 1, nullptr, &mInput1,
+                                                    sizeof(float)),
+                  ANEURALNETWORKS_NO_ERROR);
+        ASSERT_EQ(ANeuralNetworksExecution_setInput(execution, 2, nullptr, &mActivation,
+                                                    sizeof(mActivation)),
+                  ANEURALNETWORKS_NO_ERROR);
+        ASSERT_EQ(ANeuralNetworksExecution_setOutput(execution, 0, nullptr, &mOutput,
+                                                     sizeof(float)),
+                  ANEURALNETWORKS_NO_ERROR);
+    }
+
     ANeuralNetworksExecution* mExecution = nullptr;
+    float mInput0 = 1.0f;
+    float mInput1 = 2.0f;
+    int32_t mActivation = ANEURALNETWORKS_FUSED_NONE;
+    float mOutput = 0.0f;
 };
 
 TEST_F(ValidationTest, CreateModel) {
@@ -402,6 +425,60 @@ TEST_F(ValidationTestIdentify, DuplicateOutputs) {
               ANEURALNETWORKS_BAD_DATA);
 }
 
+TEST_F(ValidationTestCompilation, RegisterBuffer) {
+    const size_t memorySize = 20;
+    int memoryFd = ASharedMemory_create("nnMemory", memorySize);
+    ASSERT_GT(memoryFd, 0);
+    ANeuralNetworksMemory* memory;
+    ASSERT_EQ(ANeuralNetworksMemory_createFromFd(memorySize, PROT_READ | PROT_WRITE, memoryFd,
+                                                 0, &memory),
+              ANEURALNETWORKS_NO_ERROR);
+    ANeuralNetworksMemory* readOnlyMemory;
+    ASSERT_EQ(ANeuralNetworksMemory_createFromFd(memorySize, PROT_READ, memoryFd, 0,
+                                                 &readOnlyMemory),
+              ANEURALNETWORKS_NO_ERROR);
+    void* shared = mmap(nullptr, memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, memoryFd, 0);
+    ASSERT_NE(shared, MAP_FAILED);
+    void* copy = mmap(nullptr, memorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE, memoryFd, 0);
+    ASSERT_NE(copy, MAP_FAILED);
+    int otherFd = ASharedMemory_create("nnOtherMemory", memorySize);
+    ASSERT_GT(otherFd, 0);
+    void* other = mmap(nullptr, memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, otherFd, 0);
+    ASSERT_NE(other, MAP_FAILED);
+    std::vector<uint8_t> buffer(memorySize);
+
+    EXPECT_EQ(ANeuralNetworksCompilation_registerBuffer(nullptr, memory, shared),
+              ANEURALNETWORKS_UNEXPECTED_NULL);
+    EXPECT_EQ(ANeuralNetworksCompilation_registerBuffer(mCompilation, nullptr, shared),
+              ANEURALNETWORKS_UNEXPECTED_NULL);
+    EXPECT_EQ(ANeuralNetworksCompilation_registerBuffer(mCompilation, memory, nullptr),
+              ANEURALNETWORKS_UNEXPECTED_NULL);
+    // These should fail, since the buffers are not shared mappings of the
+    // memory.
+    EXPECT_EQ(ANeuralNetworksCompilation_registerBuffer(mCompilation, memory, buffer.data()),
+              ANEURALNETWORKS_BAD_DATA);
+    EXPECT_EQ(ANeuralNetworksCompilation_registerBuffer(mCompilation, memory, copy),
+              ANEURALNETWORKS_BAD_DATA);
+    EXPECT_EQ(ANeuralNetworksCompilation_registerBuffer(mCompilation, memory, other),
+              ANEURALNETWORKS_BAD_DATA);
+    // This should fail, since the outputs could not be written to the memory.
+    EXPECT_EQ(ANeuralNetworksCompilation_registerBuffer(mCompilation, readOnlyMemory, shared),
+              ANEURALNETWORKS_BAD_DATA);
+    EXPECT_EQ(ANeuralNetworksCompilation_registerBuffer(mCompilation, memory, shared),
+              ANEURALNETWORKS_NO_ERROR);
+    // The same mapping may not be registered twice.
+    EXPECT_EQ(ANeuralNetworksCompilation_registerBuffer(mCompilation, memory, shared),
+              ANEURALNETWORKS_BAD_DATA);
+
+    ANeuralNetworksMemory_free(memory);
+    ANeuralNetworksMemory_free(readOnlyMemory);
+    munmap(shared, memorySize);
+    munmap(copy, memorySize);
+    munmap(other, memorySize);
+    close(otherFd);
+    close(memoryFd);
+}
+
 TEST_F(ValidationTestCompilation, SetPreference) {
     EXPECT_EQ(ANeuralNetworksCompilation_setPreference(nullptr, ANEURALNETWORKS_PREFER_LOW_POWER),
               ANEURALNETWORKS_UNEXPECTED_NULL);
@@ -577,7 +654,198 @@ TEST_F(ValidationTestExecution, StartCompute) {
               ANEURALNETWORKS_UNEXPECTED_NULL);
 }
 
+TEST_F(ValidationTestExecution, Compute) {
+    ANeuralNetworksExecution* execution;
+    EXPECT_EQ(ANeuralNetworksExecution_create(mCompilation, &execution), ANEURALNETWORKS_NO_ERROR);
+
+    EXPECT_EQ(ANeuralNetworksExecution_compute(nullptr), ANEURALNETWORKS_UNEXPECTED_NULL);
+    // This should fail, since the inputs and outputs have not been specified.
+    EXPECT_EQ(ANeuralNetworksExecution_compute(execution), ANEURALNETWORKS_BAD_DATA);
+
+    ANeuralNetworksExecution_free(execution);
+}
+
+TEST_F(ValidationTestExecution, ComputeAgain) {
+    // This should fail the second time, since the execution is not reusable.
+    ASSERT_NO_FATAL_FAILURE(setArguments(mExecution));
+    EXPECT_EQ(ANeuralNetworksExecution_compute(mExecution), ANEURALNETWORKS_NO_ERROR);
+    EXPECT_EQ(mOutput, 3.0f);
+    EXPECT_EQ(ANeuralNetworksExecution_compute(mExecution), ANEURALNETWORKS_BAD_STATE);
+    ANeuralNetworksEvent* event;
+    EXPECT_EQ(ANeuralNetworksExecution_startCompute(mExecution, &event),
+              ANEURALNETWORKS_BAD_STATE);
+
+    // A reusable execution can be modified and computed again once the
+    // previous computation is done.
+    ANeuralNetworksExecution* execution;
+    ASSERT_EQ(ANeuralNetworksExecution_create(mCompilation, &execution), ANEURALNETWORKS_NO_ERROR);
+    ASSERT_EQ(ANeuralNetworksExecution_setReusable(execution, true), ANEURALNETWORKS_NO_ERROR);
+    ASSERT_NO_FATAL_FAILURE(setArguments(execution));
+    ASSERT_EQ(ANeuralNetworksExecution_startCompute(execution, &event), ANEURALNETWORKS_NO_ERROR);
+    EXPECT_EQ(ANeuralNetworksEvent_wait(event), ANEURALNETWORKS_NO_ERROR);
+    ANeuralNetworksEvent_free(event);
+    float input1 = 4.0f;
+    EXPECT_EQ(ANeuralNetworksExecution_setInput(execution, 1, nullptr, &input1, sizeof(float)),
+              ANEURALNETWORKS_NO_ERROR);
+    EXPECT_EQ(ANeuralNetworksExecution_compute(execution), ANEURALNETWORKS_NO_ERROR);
+    EXPECT_EQ(mOutput, 5.0f);
+
+    ANeuralNetworksExecution_free(execution);
+}
+
+TEST_F(ValidationTestExecution, SetReusable) {
+    ANeuralNetworksExecution* execution;
+    EXPECT_EQ(ANeuralNetworksExecution_create(mCompilation, &execution), ANEURALNETWORKS_NO_ERROR);
+
+    EXPECT_EQ(ANeuralNetworksExecution_setReusable(nullptr, true),
+              ANEURALNETWORKS_UNEXPECTED_NULL);
+    EXPECT_EQ(ANeuralNetworksExecution_setReusable(execution, true), ANEURALNETWORKS_NO_ERROR);
+    EXPECT_EQ(ANeuralNetworksExecution_setReusable(execution, false), ANEURALNETWORKS_NO_ERROR);
+
+    ANeuralNetworksExecution_free(execution);
+}
+
+TEST_F(ValidationTestExecution, Batch) {
+    ANeuralNetworksBatch* batch;
+    EXPECT_EQ(ANeuralNetworksBatch_create(nullptr, &batch), ANEURALNETWORKS_UNEXPECTED_NULL);
+    EXPECT_EQ(ANeuralNetworksBatch_create(mCompilation, nullptr), ANEURALNETWORKS_UNEXPECTED_NULL);
+    ASSERT_EQ(ANeuralNetworksBatch_create(mCompilation, &batch), ANEURALNETWORKS_NO_ERROR);
+
+    ANeuralNetworksExecution* noExecution = nullptr;
+    ANeuralNetworksEvent* event;
+    EXPECT_EQ(ANeuralNetworksBatch_compute(nullptr, &mExecution, 1),
+              ANEURALNETWORKS_UNEXPECTED_NULL);
+    EXPECT_EQ(ANeuralNetworksBatch_compute(batch, nullptr, 1), ANEURALNETWORKS_UNEXPECTED_NULL);
+    EXPECT_EQ(ANeuralNetworksBatch_compute(batch, &noExecution, 1),
+              ANEURALNETWORKS_UNEXPECTED_NULL);
+    EXPECT_EQ(ANeuralNetworksBatch_startCompute(nullptr, mExecution, &event),
+              ANEURALNETWORKS_UNEXPECTED_NULL);
+    EXPECT_EQ(ANeuralNetworksBatch_startCompute(batch, nullptr, &event),
+              ANEURALNETWORKS_UNEXPECTED_NULL);
+    EXPECT_EQ(ANeuralNetworksBatch_startCompute(batch, mExecution, nullptr),
+              ANEURALNETWORKS_UNEXPECTED_NULL);
+    EXPECT_EQ(ANeuralNetworksBatch_setQueueLimits(nullptr, 1, 0),
+              ANEURALNETWORKS_UNEXPECTED_NULL);
+
+    // This should fail, since the queue must hold at least one execution.
+    EXPECT_EQ(ANeuralNetworksBatch_setQueueLimits(batch, 0, 0), ANEURALNETWORKS_BAD_DATA);
+
+    // These should fail, since the execution is of another compilation.
+    ANeuralNetworksCompilation* compilation;
+    ASSERT_EQ(ANeuralNetworksCompilation_create(mModel, &compilation), ANEURALNETWORKS_NO_ERROR);
+    ASSERT_EQ(ANeuralNetworksCompilation_finish(compilation), ANEURALNETWORKS_NO_ERROR);
+    ANeuralNetworksExecution* execution;
+    ASSERT_EQ(ANeuralNetworksExecution_create(compilation, &execution), ANEURALNETWORKS_NO_ERROR);
+    ASSERT_NO_FATAL_FAILURE(setArguments(execution));
+    EXPECT_EQ(ANeuralNetworksBatch_compute(batch, &execution, 1), ANEURALNETWORKS_BAD_DATA);
+    EXPECT_EQ(ANeuralNetworksBatch_startCompute(batch, execution, &event),
+              ANEURALNETWORKS_BAD_DATA);
+    ANeuralNetworksExecution_free(execution);
+    ANeuralNetworksCompilation_free(compilation);
+
+    // This should fail, since the execution appears twice.
+    ASSERT_NO_FATAL_FAILURE(setArguments(mExecution));
+    ANeuralNetworksExecution* executions[] = {mExecution, mExecution};
+    EXPECT_EQ(ANeuralNetworksBatch_compute(batch, executions, 2), ANEURALNETWORKS_BAD_DATA);
+
+    // These should fail the second time, since the execution is not reusable.
+    EXPECT_EQ(ANeuralNetworksBatch_compute(batch, &mExecution, 1), ANEURALNETWORKS_NO_ERROR);
+    EXPECT_EQ(mOutput, 3.0f);
+    EXPECT_EQ(ANeuralNetworksBatch_compute(batch, &mExecution, 1), ANEURALNETWORKS_BAD_STATE);
+    EXPECT_EQ(ANeuralNetworksBatch_startCompute(batch, mExecution, &event),
+              ANEURALNETWORKS_BAD_STATE);
+
+    ANeuralNetworksBatch_free(batch);
+}
+
+TEST_F(ValidationTestExecution, Stream) {
+    ANeuralNetworksStream* stream;
+    EXPECT_EQ(ANeuralNetworksStream_create(nullptr, &stream), ANEURALNETWORKS_UNEXPECTED_NULL);
+    EXPECT_EQ(ANeuralNetworksStream_create(mCompilation, nullptr),
+              ANEURALNETWORKS_UNEXPECTED_NULL);
+    ASSERT_EQ(ANeuralNetworksStream_create(mCompilation, &stream), ANEURALNETWORKS_NO_ERROR);
+
+    float state = 0.0f;
+    float input = 1.0f;
+    float output = 0.0f;
+    int32_t activation = ANEURALNETWORKS_FUSED_NONE;
+    EXPECT_EQ(ANeuralNetworksStream_bindState(nullptr, 0, 0), ANEURALNETWORKS_UNEXPECTED_NULL);
+    EXPECT_EQ(ANeuralNetworksStream_setState(nullptr, 0, &state, sizeof(float)),
+              ANEURALNETWORKS_UNEXPECTED_NULL);
+    EXPECT_EQ(ANeuralNetworksStream_setState(stream, 0, nullptr, sizeof(float)),
+              ANEURALNETWORKS_UNEXPECTED_NULL);
+    EXPECT_EQ(ANeuralNetworksStream_setInput(nullptr, 1, &input, sizeof(float)),
+              ANEURALNETWORKS_UNEXPECTED_NULL);
+    EXPECT_EQ(ANeuralNetworksStream_setOutput(nullptr, 0, &output, sizeof(float)),
+              ANEURALNETWORKS_UNEXPECTED_NULL);
+    EXPECT_EQ(ANeuralNetworksStream_setOutput(stream, 0, nullptr, sizeof(float)),
+              ANEURALNETWORKS_UNEXPECTED_NULL);
+    EXPECT_EQ(ANeuralNetworksStream_compute(nullptr, 1), ANEURALNETWORKS_UNEXPECTED_NULL);
+
+    // These should fail, since the indexes are out of range.
+    EXPECT_EQ(ANeuralNetworksStream_bindState(stream, 1, 0), ANEURALNETWORKS_BAD_DATA);
+    EXPECT_EQ(ANeuralNetworksStream_bindState(stream, 0, 3), ANEURALNETWORKS_BAD_DATA);
+    EXPECT_EQ(ANeuralNetworksStream_setInput(stream, 3, &input, sizeof(float)),
+              ANEURALNETWORKS_BAD_DATA);
+    EXPECT_EQ(ANeuralNetworksStream_setInput(stream, -1, &input, sizeof(float)),
+              ANEURALNETWORKS_BAD_DATA);
+    EXPECT_EQ(ANeuralNetworksStream_setOutput(stream, 1, &output, sizeof(float)),
+              ANEURALNETWORKS_BAD_DATA);
+
+    // This should fail, since input 0 is not bound to a state.
+    EXPECT_EQ(ANeuralNetworksStream_setState(stream, 0, &state, sizeof(float)),
+              ANEURALNETWORKS_BAD_DATA);
+
+    // This should fail, since input 0 is neither set nor bound to a state.
+    ASSERT_EQ(ANeuralNetworksStream_setInput(stream, 1, &input, sizeof(float)),
+              ANEURALNETWORKS_NO_ERROR);
+    ASSERT_EQ(ANeuralNetworksStream_setInput(stream, 2, &activation, sizeof(activation)),
+              ANEURALNETWORKS_NO_ERROR);
+    EXPECT_EQ(ANeuralNetworksStream_compute(stream, 2), ANEURALNETWORKS_BAD_DATA);
+
+    ASSERT_EQ(ANeuralNetworksStream_bindState(stream, 0, 0), ANEURALNETWORKS_NO_ERROR);
+    // These should fail, since output 0 is now the state.
+    EXPECT_EQ(ANeuralNetworksStream_bindState(stream, 0, 1), ANEURALNETWORKS_BAD_DATA);
+    EXPECT_EQ(ANeuralNetworksStream_setOutput(stream, 0, &output, sizeof(float)),
+              ANEURALNETWORKS_BAD_DATA);
+    // This should fail, since there is no timestep.
+    EXPECT_EQ(ANeuralNetworksStream_compute(stream, 0), ANEURALNETWORKS_BAD_DATA);
+
+    EXPECT_EQ(ANeuralNetworksStream_setState(stream, 0, &state, sizeof(float)),
+              ANEURALNETWORKS_NO_ERROR);
+    EXPECT_EQ(ANeuralNetworksStream_compute(stream, 2), ANEURALNETWORKS_NO_ERROR);
+    // This should fail, since the stream has been computed.
+    EXPECT_EQ(ANeuralNetworksStream_bindState(stream, 0, 0), ANEURALNETWORKS_BAD_STATE);
+
+    ANeuralNetworksStream_free(stream);
+}
+
 TEST_F(ValidationTestExecution, EventWait) {
     EXPECT_EQ(ANeuralNetworksEvent_wait(nullptr), ANEURALNETWORKS_UNEXPECTED_NULL);
 }
+
+TEST_F(ValidationTest, PerformanceHistory) {
+    EXPECT_EQ(ANeuralNetworksPerformanceHistory_setCacheFile(nullptr),
+              ANEURALNETWORKS_UNEXPECTED_NULL);
+    // This should fail, since the file descriptor is not open.
+    EXPECT_EQ(ANeuralNetworksPerformanceHistory_dump(-1), ANEURALNETWORKS_BAD_DATA);
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    EXPECT_EQ(ANeuralNetworksPerformanceHistory_dump(fds[1]), ANEURALNETWORKS_NO_ERROR);
+    close(fds[0]);
+    close(fds[1]);
+    EXPECT_EQ(ANeuralNetworksPerformanceHistory_reset(), ANEURALNETWORKS_NO_ERROR);
+}
+
+TEST_F(ValidationTest, PerformanceHistoryCacheFile) {
+    // The cache file of the process may already have been set, e.g. through
+    // debug.nn.profile.file, so only the second call is checked.
+    const char* kFilename = "/data/local/tmp/TestValidationPerformanceHistory";
+    const char* kOtherFilename = "/data/local/tmp/TestValidationPerformanceHistoryOther";
+    const int n = ANeuralNetworksPerformanceHistory_setCacheFile(kFilename);
+    EXPECT_EQ(ANeuralNetworksPerformanceHistory_setCacheFile(kFilename), n);
+    EXPECT_EQ(ANeuralNetworksPerformanceHistory_setCacheFile(kOtherFilename),
+              ANEURALNETWORKS_BAD_STATE);
+}
 }  // namespace
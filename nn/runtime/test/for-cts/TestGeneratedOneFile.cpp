@@ -231,9 +231,11 @@
 #include "../generated/tests/mean_float_1_relaxed.mod.py.cpp"
 #include "../generated/tests/mean_float_2.mod.py.cpp"
 #include "../generated/tests/mean_float_2_relaxed.mod.py.cpp"
+#include "../generated/tests/mean_float_3.mod.py.cpp"
 #include "../generated/tests/mean.mod.py.cpp"
 #include "../generated/tests/mean_quant8_1.mod.py.cpp"
 #include "../generated/tests/mean_quant8_2.mod.py.cpp"
+#include "../generated/tests/mean_quant8_3.mod.py.cpp"
 #include "../generated/tests/mean_relaxed.mod.py.cpp"
 #include "../generated/tests/mobilenet_224_gender_basic_fixed_relaxed.mod.py.cpp"
 #include "../generated/tests/mul_relaxed.mod.py.cpp"
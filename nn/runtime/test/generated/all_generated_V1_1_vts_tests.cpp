@@ -601,6 +601,21 @@ TEST_F(NeuralnetworksHidlTest, div) {
                              div::examples);
 }
 
+namespace div_quant8 {
+std::vector<MixedTypedExample> examples = {
+// Generated div_quant8 test
+#include "examples/div_quant8.example.cpp"
+};
+// Generated model constructor
+#include "vts_models/div_quant8.model.cpp"
+} // namespace div_quant8
+TEST_F(NeuralnetworksHidlTest, div_quant8) {
+    generated_tests::Execute(device,
+                             div_quant8::createTestModel,
+                             div_quant8::is_ignored,
+                             div_quant8::examples);
+}
+
 namespace div_relaxed {
 std::vector<MixedTypedExample> examples = {
 // Generated div_relaxed test
@@ -1261,6 +1276,21 @@ TEST_F(NeuralnetworksHidlTest, mean_float_2_relaxed) {
                              mean_float_2_relaxed::examples);
 }
 
+namespace mean_float_3 {
+std::vector<MixedTypedExample> examples = {
+// Generated mean_float_3 test
+#include "examples/mean_float_3.example.cpp"
+};
+// Generated model constructor
+#include "vts_models/mean_float_3.model.cpp"
+} // namespace mean_float_3
+TEST_F(NeuralnetworksHidlTest, mean_float_3) {
+    generated_tests::Execute(device,
+                             mean_float_3::createTestModel,
+                             mean_float_3::is_ignored,
+                             mean_float_3::examples);
+}
+
 namespace mean {
 std::vector<MixedTypedExample> examples = {
 // Generated mean test
@@ -1306,6 +1336,21 @@ TEST_F(NeuralnetworksHidlTest, mean_quant8_2) {
                              mean_quant8_2::examples);
 }
 
+namespace mean_quant8_3 {
+std::vector<MixedTypedExample> examples = {
+// Generated mean_quant8_3 test
+#include "examples/mean_quant8_3.example.cpp"
+};
+// Generated model constructor
+#include "vts_models/mean_quant8_3.model.cpp"
+} // namespace mean_quant8_3
+TEST_F(NeuralnetworksHidlTest, mean_quant8_3) {
+    generated_tests::Execute(device,
+                             mean_quant8_3::createTestModel,
+                             mean_quant8_3::is_ignored,
+                             mean_quant8_3::examples);
+}
+
 namespace mean_relaxed {
 std::vector<MixedTypedExample> examples = {
 // Generated mean_relaxed test
@@ -2491,6 +2536,21 @@ TEST_F(NeuralnetworksHidlTest, sub) {
                              sub::examples);
 }
 
+namespace sub_quant8 {
+std::vector<MixedTypedExample> examples = {
+// Generated sub_quant8 test
+#include "examples/sub_quant8.example.cpp"
+};
+// Generated model constructor
+#include "vts_models/sub_quant8.model.cpp"
+} // namespace sub_quant8
+TEST_F(NeuralnetworksHidlTest, sub_quant8) {
+    generated_tests::Execute(device,
+                             sub_quant8::createTestModel,
+                             sub_quant8::is_ignored,
+                             sub_quant8::examples);
+}
+
 namespace sub_relaxed {
 std::vector<MixedTypedExample> examples = {
 // Generated sub_relaxed test
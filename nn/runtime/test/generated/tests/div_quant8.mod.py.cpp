@@ -0,0 +1,17 @@
+// DO NOT EDIT;
+// Generated by ml/nn/runtime/test/specs/generate_test.sh
+#include "../../TestGenerated.h"
+
+namespace div_quant8 {
+std::vector<MixedTypedExample> examples = {
+// Generated div_quant8 test
+#include "generated/examples/div_quant8.example.cpp"
+};
+// Generated model constructor
+#include "generated/models/div_quant8.model.cpp"
+} // namespace div_quant8
+TEST_F(GeneratedTests, div_quant8) {
+    execute(div_quant8::CreateModel,
+            div_quant8::is_ignored,
+            div_quant8::examples);
+}
@@ -0,0 +1,17 @@
+// DO NOT EDIT;
+// Generated by ml/nn/runtime/test/specs/generate_test.sh
+#include "../../TestGenerated.h"
+
+namespace mean_quant8_3 {
+std::vector<MixedTypedExample> examples = {
+// Generated mean_quant8_3 test
+#include "generated/examples/mean_quant8_3.example.cpp"
+};
+// Generated model constructor
+#include "generated/models/mean_quant8_3.model.cpp"
+} // namespace mean_quant8_3
+TEST_F(GeneratedTests, mean_quant8_3) {
+    execute(mean_quant8_3::CreateModel,
+            mean_quant8_3::is_ignored,
+            mean_quant8_3::examples);
+}
@@ -0,0 +1,17 @@
+// DO NOT EDIT;
+// Generated by ml/nn/runtime/test/specs/generate_test.sh
+#include "../../TestGenerated.h"
+
+namespace sub_quant8 {
+std::vector<MixedTypedExample> examples = {
+// Generated sub_quant8 test
+#include "generated/examples/sub_quant8.example.cpp"
+};
+// Generated model constructor
+#include "generated/models/sub_quant8.model.cpp"
+} // namespace sub_quant8
+TEST_F(GeneratedTests, sub_quant8) {
+    execute(sub_quant8::CreateModel,
+            sub_quant8::is_ignored,
+            sub_quant8::examples);
+}
@@ -0,0 +1,32 @@
+# model
+model = Model()
+i1 = Input("op1", "TENSOR_QUANT8_ASYMM", "{2, 3}, 0.5f, 10")
+i2 = Input("op2", "TENSOR_QUANT8_ASYMM", "{3}, 0.25f, 4")
+act = Int32Scalar("act", 0)
+i3 = Output("op3", "TENSOR_QUANT8_ASYMM", "{2, 3}, 0.5f, 128")
+model = model.Operation("DIV", i1, i2, act).To(i3)
+
+# Example 1. {0, 1, 2, 3, -4, 5} / {1, -1, 4} = {0, -1, 0.5, 3, 4, 1.25}
+input0 = {i1: # input 0
+          [10, 12, 14, 16, 2, 20],
+          i2: # input 1
+          [8, 0, 20]}
+
+output0 = {i3: # output 0
+           [128, 126, 129, 134, 136, 131]}
+
+# Instantiate an example
+Example((input0, output0))
+
+# Example 2. {0, 1, 2, 3, -4, 5} / {0, 0, 4}: a division by zero saturates,
+# except 0 / 0, which is 0.
+input1 = {i1: # input 0
+          [10, 12, 14, 16, 2, 20],
+          i2: # input 1
+          [4, 4, 20]}
+
+output1 = {i3: # output 0
+           [128, 255, 129, 255, 0, 131]}
+
+# Instantiate another example
+Example((input1, output1))
@@ -0,0 +1,32 @@
+# model
+model = Model()
+i1 = Input("op1", "TENSOR_QUANT8_ASYMM", "{2, 3}, 0.5f, 10")
+i2 = Input("op2", "TENSOR_QUANT8_ASYMM", "{3}, 0.25f, 4")
+act = Int32Scalar("act", 0)
+i3 = Output("op3", "TENSOR_QUANT8_ASYMM", "{2, 3}, 0.5f, 128")
+model = model.Operation("SUB", i1, i2, act).To(i3)
+
+# Example 1. {0, 1, 2, 3, -4, 5} - {1, -1, 4} = {-1, 2, -2, 2, -3, 1}
+input0 = {i1: # input 0
+          [10, 12, 14, 16, 2, 20],
+          i2: # input 1
+          [8, 0, 20]}
+
+output0 = {i3: # output 0
+           [126, 132, 124, 132, 122, 130]}
+
+# Instantiate an example
+Example((input0, output0))
+
+# Example 2. {122.5, -5, 0, 122.5, -5, 0} - {-1, 62.75, 0}: the differences
+# outside of the range of the output saturate.
+input1 = {i1: # input 0
+          [255, 0, 10, 255, 0, 10],
+          i2: # input 1
+          [0, 255, 4]}
+
+output1 = {i3: # output 0
+           [255, 0, 128, 255, 0, 128]}
+
+# Instantiate another example
+Example((input1, output1))